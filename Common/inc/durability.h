@@ -0,0 +1,20 @@
+/*
+ * Filename:    durability.h
+ * Project:     CanWeTalkSystem
+ * By:          Salman Nouman, Minchul Hwang, Md Saiful Islam, Saje-Antoine Rose
+ * Date:        October, 19, 2026
+ * Description: This file contains the control messages of the server's write-ahead log. A client that asks for acks
+ *              is told, in the order it sent them, when its messages have been written to the log and can no longer
+ *              be lost in a crash of the server.
+ */
+
+#ifndef DURABILITY_H
+#define DURABILITY_H
+
+// Control messages exchanged over TCP
+#define DURABLE_ACKS_REQUEST ">>acks<<"         // client -> server, asks to be told when its messages are durable
+#define DURABLE_ACKS_ON_PREFIX ">>acking<< "    // server -> client, "<write|sync> <commit interval in microseconds>"
+#define DURABLE_ACKS_OFF ">>noacks<<"           // server -> client, the server keeps no write-ahead log
+#define DURABLE_ACK_PREFIX ">>durable<< "       // server -> client, "<n>": the next n messages it sent are durable
+
+#endif
@@ -0,0 +1,18 @@
+/*
+ * Filename:    history.h
+ * Project:     CanWeTalkSystem
+ * By:          Salman Nouman, Minchul Hwang, Md Saiful Islam, Saje-Antoine Rose
+ * Date:        October, 19, 2026
+ * Description: This file contains the control messages a client uses to catch up on the messages it missed. The server
+ *              numbers every broadcast; a client that remembers the last number it saw asks only for what came after it.
+ */
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+// Control messages exchanged over TCP as the body of an ordinary message
+#define HISTORY_REQUEST_PREFIX ">>since "   // client -> server, "<epoch> <last sequence number seen> <most messages wanted>"
+#define HISTORY_REPLAY_PREFIX ">>replay "   // server -> client, "<sequence number> <serialized message>"
+#define HISTORY_SYNC_PREFIX ">>sync "       // server -> client, "<epoch> <sequence number of the next broadcast>"
+
+#endif
@@ -0,0 +1,43 @@
+/*
+ * Filename:    intern.h
+ * Project:     CanWeTalkSystem
+ * By:          Salman Nouman, Minchul Hwang, Md Saiful Islam, Saje-Antoine Rose
+ * Date:        October, 19, 2026
+ * Description: This file contains the defined values, dependencies and function prototypes of the string intern table,
+ *              which lets messages refer to usernames and IP addresses by a small identifier instead of a copy
+ */
+
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INTERN_NONE 0                // identifier of the empty string
+#define INTERN_FAILED UINT32_MAX     // returned when a string could not be added, never a slot
+#define INTERN_FAILED_TEXT "?"       // what a string that could not be added reads back as, never the empty string
+#define INTERN_TABLE_SIZE 65536      // slots, must be a power of two
+#define INTERN_PROBE_LIMIT 64        // slots inspected before a string is given up on, bounds the cost once the table fills
+#define MAX_INTERNED_LENGTH 64       // longer strings are interned truncated
+
+typedef uint32_t InternId;
+
+// An interned string, freed when the last reference to it is released
+typedef struct InternEntry
+{
+    atomic_uint references;
+    uint32_t hash;
+    char text[];
+} InternEntry;
+
+InternId internString(const char* text);
+InternId internFind(const char* text);
+void internRetain(InternId id);
+void internRelease(InternId id);
+const char* internedString(InternId id);
+void internCopy(InternId id, char* buffer, size_t size);
+
+#endif
@@ -0,0 +1,18 @@
+/*
+ * Filename:    mailbox.h
+ * Project:     CanWeTalkSystem
+ * By:          Salman Nouman, Minchul Hwang, Md Saiful Islam, Saje-Antoine Rose
+ * Date:        October, 19, 2026
+ * Description: This file contains the control messages of offline delivery. A client names its user when it connects;
+ *              what was broadcast while that user had no client connected is kept on the server and delivered then.
+ */
+
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+// Control messages exchanged over TCP
+#define MAILBOX_HELLO_PREFIX ">>hello "      // client -> server, "<epoch> <last sequence number seen> <most messages wanted> <user name>"
+#define MAILBOX_DELIVERY_PREFIX ">>mail<< "  // server -> client, followed by a serialized message kept while the user was away
+#define MAILBOX_NAME_TAKEN ">>taken<<"          // server -> client, another connection holds the user name and this one is closed
+
+#endif
@@ -13,31 +13,66 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <string.h>
 #include <stdio.h>
 #include <arpa/inet.h>
+#include "transport.h"
+#include "intern.h"
 
 
 #define MAX_PARCEL_LENGTH 41
-#define MAX_MESSAGE_LENGTH 81
+#define MAX_MESSAGE_LENGTH 157 // what the client lets a user type, two lines of an 80 column input window
+#define MAX_BODY_LENGTH 1024 // longest message body carried, longer ones are truncated
+#define MESSAGE_INLINE_LENGTH 24 // bodies shorter than this are stored inside the Message itself
 #define MAX_USERNAME_LENGTH 6
 #define MAX_TIMESTAMP_LENGTH 9
-#define MAX_SERIALIZED_LENGTH 63
-#define MAX_IP_LENGTH 16
+#define MAX_IP_LENGTH 46 // INET6_ADDRSTRLEN
+#define MAX_TIMING_LENGTH 42 // @sent@stamped, two 20 digit nanosecond counts
+#define MAX_SERIALIZED_LENGTH (MAX_IP_LENGTH + MAX_TIMING_LENGTH + MAX_USERNAME_LENGTH + MAX_BODY_LENGTH + 1) // ip[@sent@stamped]|username|body
+#define TIMING_SEPARATOR '@' // follows the IP address when a message carries its timestamps, never part of an address
+#define NANOSECONDS_PER_SECOND 1000000000ull
+#define CONTROL_FRAME_FLAG 0x80000000u // set in the length of a control frame, whose payload is a bare control request
+#define SERVER_BUSY ">>busy<<" // sent by an overloaded server to a client whose message it refused or dropped
+#define PRIVATE_DELIVERY_PREFIX ">>private<< " // followed by a serialized message delivered to this client alone
+#define DIRECT_MESSAGE_COMMAND "/msg " // starts a message for one user, "/msg <user name> <text>"
+#define SEND_SUCCESS 0
+#define SEND_FAILURE -1
 
+// A message is 64 bytes whatever it says: the sender's IP address and username are interned, and the body is kept
+// inline when it is short or in its own allocation sized to it otherwise. Copying a Message moves the body and the
+// references to the interned strings with it, so exactly one copy must be passed to releaseMessage. Times are nanoseconds since the epoch, 0 when unknown.
 typedef struct Message
 {
-	char ip[MAX_IP_LENGTH];
-	char userName[MAX_USERNAME_LENGTH];
-	char message[MAX_MESSAGE_LENGTH];
-	char timeStamp[MAX_TIMESTAMP_LENGTH];
+	uint64_t sentNanoseconds;		// sender's clock when it was typed, carried on the wire
+	uint64_t stampedNanoseconds;	// server's clock when it was read off the sender's connection, carried on the wire
+	uint64_t receivedNanoseconds;	// receiving client's clock when it arrived, local only
+	InternId ipId;
+	InternId userId;
 	int senderSock;
+	uint16_t bodyLength;
+	union
+	{
+		char inlineBody[MESSAGE_INLINE_LENGTH];
+		char* heapBody;
+	} body;
 } Message;
 
-void sendLengthPrefixedMessage(const char* chunk, int socketConnection);
-void sendParcelledMessage(const Message* chatMessage, int socketConnection);
-void serializeMessage(const Message* chatMessage, char* parcel, char* serializedMessage, size_t bufferSize);
-void deserializeMessage(Message* chatMessage, const char* serializedMessage);
-void getCurrentTimestamp(char* buffer, size_t bufSize);
+bool initMessage(Message* chatMessage, const char* ip, const char* userName);
+void initMessageFrom(Message* chatMessage, InternId ipId, InternId userId);
+void setMessageBody(Message* chatMessage, const char* text, size_t length);
+const char* messageBody(const Message* chatMessage);
+const char* messageIp(const Message* chatMessage);
+const char* messageUserName(const Message* chatMessage);
+void releaseMessage(Message* chatMessage);
+int sendLengthPrefixedMessage(const char* chunk, int socketConnection);
+int sendControlFrame(const char* control, int socketConnection);
+int sendParcelledMessage(const Message* chatMessage, int socketConnection);
+void serializeMessage(const Message* chatMessage, const char* parcel, char* serializedMessage, size_t bufferSize);
+const char* parseSerializedMessage(const char* serializedMessage, char* ip, char* userName, uint64_t* sent, uint64_t* stamped);
+bool deserializeMessage(Message* chatMessage, const char* serializedMessage);
+uint64_t wallClockNanoseconds(void);
+void formatTimestamp(uint64_t nanoseconds, char* buffer, size_t bufSize);
+void formatLatency(uint64_t nanoseconds, char* buffer, size_t bufSize);
 
 #endif
\ No newline at end of file
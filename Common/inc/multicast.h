@@ -0,0 +1,39 @@
+/*
+ * Filename:    multicast.h
+ * Project:     CanWeTalkSystem
+ * By:          Salman Nouman, Minchul Hwang, Md Saiful Islam, Saje-Antoine Rose
+ * Date:        October, 19, 2026
+ * Description: This file contains the defined values, dependencies and function prototypes of the multicast fan-out,
+ *              in which the server publishes every message once to a UDP multicast group and clients repair lost
+ *              datagrams over their TCP connection
+ */
+
+#ifndef MULTICAST_H
+#define MULTICAST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include "message.h"
+
+#define DEFAULT_MULTICAST_PORT 8991
+#define MULTICAST_HEADER_LENGTH 9       // one type byte and a 64 bit big-endian sequence number
+#define MAX_DATAGRAM_LENGTH (MULTICAST_HEADER_LENGTH + MAX_SERIALIZED_LENGTH)
+
+// Datagram types
+#define MULTICAST_DATA 'D'              // carries the serialized message with the given sequence number
+#define MULTICAST_ANNOUNCE 'A'          // carries no message, names the latest sequence number published
+
+// Control messages exchanged over TCP as the body of an ordinary message
+#define MULTICAST_SUBSCRIBE ">>mcast<<"             // client -> server, asks to receive by multicast
+#define MULTICAST_UNSUBSCRIBE ">>nomcast<<"         // client -> server, could not join the group, back to TCP
+#define MULTICAST_OFFER_PREFIX ">>mcast "           // server -> client, "<group> <port> <first sequence number>"
+#define MULTICAST_NACK_PREFIX ">>nack "             // client -> server, "<first> <last>" sequence numbers missing
+#define MULTICAST_REPAIR_PREFIX ">>repair "         // server -> client, "<sequence number> <serialized message>"
+#define MULTICAST_LOST_PREFIX ">>lost "             // server -> client, "<first> <last>" no longer available
+
+size_t encodeDatagram(char type, uint64_t sequence, const char* payload, char* datagram, size_t size);
+bool decodeDatagram(char* datagram, size_t length, char* type, uint64_t* sequence, const char** payload);
+
+#endif
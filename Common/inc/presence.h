@@ -0,0 +1,24 @@
+/*
+ * Filename:    presence.h
+ * Project:     CanWeTalkSystem
+ * By:          Salman Nouman, Minchul Hwang, Md Saiful Islam, Saje-Antoine Rose
+ * Date:        October, 19, 2026
+ * Description: This file contains the control messages of the presence service. A client asks once for the roster of
+ *              users online; afterwards the server only tells it who came and went, each change numbered by the version
+ *              of the roster it leads to.
+ */
+
+#ifndef PRESENCE_H
+#define PRESENCE_H
+
+// Control messages exchanged over TCP
+#define PRESENCE_SUBSCRIBE ">>roster?<<"        // client -> server, asks for the roster and the changes that follow
+#define PRESENCE_ROSTER_PREFIX ">>roster<< "    // server -> client, "<version> <+ if more parts follow, = for the last> <name>..."
+#define PRESENCE_DELTA_PREFIX ">>presence<< "   // server -> client, "<version it applies to> <version it leads to> <+name or -name>..."
+#define PRESENCE_MORE_PARTS '+'
+#define PRESENCE_LAST_PART '='
+#define PRESENCE_JOINED '+'
+#define PRESENCE_LEFT '-'
+#define PRESENCE_MAX_PART_LENGTH 1024           // names carried by one roster part or delta, so each fits a control frame
+
+#endif
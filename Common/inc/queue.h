@@ -11,28 +11,80 @@
 
 #include "message.h"
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 
 #define EMPTY_QUEUE 0
 #define MESSAGE_DEQUEUED 1
+#define CONTROL_DEQUEUED 2
+#define QUEUE_CONTROL_BURST 8 // control messages taken in a row before a waiting bulk message gets its turn
+#define QUEUE_DEFAULT_FLOW 0 // flow of bulk messages enqueued without naming one
+#define QUEUE_FAIR_QUANTUM (MAX_BODY_LENGTH + 1) // bytes a flow of weight 1 is granted per turn, the cost of the longest message
 
 // Queue structs here
 typedef struct QueueNode // Nodes in queue
 {
 	Message message;
+	uint64_t enqueuedNanoseconds;	// CLOCK_MONOTONIC time the message was queued
 	struct QueueNode* next;
 } QueueNode;
 
+// One sender's share of the bulk lane of a fair queue. Flows with messages waiting take turns in deficit round robin
+// order; each turn grants weight * QUEUE_FAIR_QUANTUM bytes and every message costs its body length plus one
+typedef struct QueueFlow
+{
+	QueueNode* front;
+	QueueNode* rear;
+	unsigned int length;				// messages waiting in this flow
+	int weight;							// quanta granted per turn
+	int deficit;						// bytes it may still take in its current turn
+	int nextActive;						// next flow in the round, -1 at its end
+	bool active;						// in the round, which is the case exactly while it has messages
+	bool granted;						// already received the quanta of its current turn
+	uint64_t served;					// messages taken since the delays were last read
+	uint64_t sojournTotalNanoseconds;	// their summed queueing delay
+	uint64_t sojournMaxNanoseconds;		// the longest of them
+} QueueFlow;
+
+// Queueing delay of one flow since it was last read
+typedef struct QueueFlowDelay
+{
+	uint64_t served;
+	uint64_t totalNanoseconds;
+	uint64_t maxNanoseconds;
+	unsigned int queued;				// messages still waiting when it was read
+} QueueFlowDelay;
+
+// Two lanes share one lock and one condition: control messages overtake bulk ones, but after QUEUE_CONTROL_BURST of
+// them in a row a waiting bulk message is served, so neither lane can starve the other
 typedef struct  // Message Queue
 {
     QueueNode* front;
     QueueNode* rear;
+    QueueNode* controlFront;
+    QueueNode* controlRear;
+    int controlStreak;              // control messages served in a row while bulk ones waited
     pthread_mutex_t lock;
-    pthread_cond_t cond;
+    pthread_cond_t cond;            // signalled on every enqueue, waits use CLOCK_MONOTONIC deadlines
+    atomic_uint length;             // lets a spinning consumer look for work without taking the lock
+    uint64_t lastSojournNanoseconds; // how long the message dequeued last had waited, read by the consumer after dequeuing
+    QueueFlow* flows;               // per sender bulk lanes once the queue is fair, NULL keeps the single bulk lane
+    int flowCount;
+    int activeHead;                 // flow whose turn it is, -1 if no flow has messages
+    int activeTail;
 } MessageQueue;
 
 void queueInit(MessageQueue* queue);
 void enqueue(MessageQueue *queue, const Message* message);
+void enqueueControl(MessageQueue *queue, const Message* message);
+bool queueEnableFairness(MessageQueue* queue, int flowCount);
+void queueSetFlowWeight(MessageQueue* queue, int flow, int weight);
+void enqueueFlow(MessageQueue *queue, const Message* message, int flow);
+void queueTakeFlowDelays(MessageQueue* queue, QueueFlowDelay* delays, int count);
 int dequeue(MessageQueue *queue, Message* msgOut);
+int dequeueControl(MessageQueue *queue, Message* msgOut);
+int dequeueBatch(MessageQueue *queue, Message* msgOut, uint64_t* sojournNanoseconds, int max);
+int dequeueWait(MessageQueue *queue, Message* msgOut, long spinMicroseconds, int parkMilliseconds);
 void freeQueue(MessageQueue* queue);
 
 
@@ -0,0 +1,23 @@
+/*
+ * Filename:    search.h
+ * Project:     CanWeTalkSystem
+ * By:          Salman Nouman, Minchul Hwang, Md Saiful Islam, Saje-Antoine Rose
+ * Date:        October, 19, 2026
+ * Description: This file contains the commands and control messages of the server's message search. The server keeps
+ *              every broadcast and finds those that contain all the words of a query, the newest first, a page at a time.
+ */
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#define SEARCH_COMMAND "/search "               // typed in chat-client, "/search <words>" shows the newest page of matches
+#define SEARCH_PAGE_COMMAND "/page "            // typed in chat-client, "/page <n>" shows another page of the last search
+#define SEARCH_PAGE_SIZE 10                     // matches per page
+
+// Control messages exchanged over TCP
+#define SEARCH_REQUEST_PREFIX ">>search "       // client -> server, "<page from 1> <word>..."
+#define SEARCH_RESULT_PREFIX ">>found<< "       // server -> client, followed by a serialized matching message, oldest first
+#define SEARCH_SUMMARY_PREFIX ">>searched<< "   // server -> client after the page, "<page> <pages> <matches>"
+#define SEARCH_UNAVAILABLE ">>nosearch<<"       // server -> client, the server keeps no searchable history
+
+#endif
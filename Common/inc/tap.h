@@ -0,0 +1,73 @@
+/*
+ * Filename:    tap.h
+ * Project:     CanWeTalkSystem
+ * By:          Salman Nouman, Minchul Hwang, Md Saiful Islam, Saje-Antoine Rose
+ * Date:        October, 19, 2026
+ * Description: This file contains the layout of the broadcast tap, a ring of slots in POSIX shared memory into which
+ *              the server writes every broadcast once, and the functions with which any number of local processes
+ *              read it in place, each at its own position. The server never waits for a reader: one that falls more
+ *              than a ring behind loses the overwritten messages and is told how many.
+ */
+
+#ifndef TAP_H
+#define TAP_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "message.h"
+
+#define TAP_MAGIC 0x54415031u           // "TAP1", tells a ring from any other shared memory object
+#define TAP_VERSION 1
+#define DEFAULT_TAP_SLOTS 4096          // rounded up to a power of two by the server
+#define TAP_WAIT_FOREVER -1
+
+// Results of tapAttach and tapWait
+#define TAP_SUCCESS 0
+#define TAP_FAILURE -1
+#define TAP_READY 0                     // a message is waiting to be read
+#define TAP_TIMEOUT 1                   // none arrived in time
+#define TAP_CLOSED 2                    // the server stopped or handed over, attach again by name for its successor
+
+// Start of the shared memory object, followed by the slots
+typedef struct TapHeader
+{
+    uint32_t magic;                 // written last by the server, once the rest is set up
+    uint32_t version;
+    uint32_t slotCount;             // a power of two
+    uint32_t slotSize;              // bytes from one slot to the next
+    _Atomic uint64_t published;     // ring position of the newest complete message, positions start at 1
+    _Atomic uint32_t wakeups;       // futex word, bumped when sleeping readers are woken
+    _Atomic uint32_t waiters;       // readers sleeping on the futex word, the server wakes none while it is 0
+    _Atomic uint32_t closed;        // the server will write no more into this ring
+} TapHeader;
+
+// One message of the ring. The server clears the position while it rewrites a slot, so a reader that finds the
+// position it expected both before and after reading the message knows that the message was not torn.
+typedef struct TapSlot
+{
+    _Atomic uint64_t position;      // ring position of the message in the slot, 0 while it is rewritten
+    uint64_t sequence;              // broadcast sequence number, the one clients and the multicast group see
+    uint32_t length;                // of the serialized message, which is null-terminated as well
+    char message[MAX_SERIALIZED_LENGTH];
+} TapSlot;
+
+// A reader's own view of the ring
+typedef struct TapReader
+{
+    TapHeader* header;
+    size_t mappedLength;
+    uint64_t next;                  // ring position of the next message to read
+    uint64_t lost;                  // messages overwritten before this reader got to them
+} TapReader;
+
+size_t tapMappingLength(uint32_t slotCount);
+TapSlot* tapSlotAt(TapHeader* header, uint64_t position);
+int tapAttach(TapReader* reader, const char* name, bool fromOldest);
+const TapSlot* tapPeek(TapReader* reader);
+bool tapConsume(TapReader* reader, const TapSlot* slot);
+int tapWait(TapReader* reader, int timeoutMilliseconds);
+void tapDetach(TapReader* reader);
+
+#endif
@@ -0,0 +1,61 @@
+/*
+ * Filename:    transport.h
+ * Project:     CanWeTalkSystem
+ * By:          Salman Nouman, Minchul Hwang, Md Saiful Islam, Saje-Antoine Rose
+ * Date:        October, 19, 2026
+ * Description: This file contains the defined values, dependencies and function prototypes of the socket transport,
+ *              which is either plain TCP or TLS (offloaded to the kernel when possible) in the CanWeTalkSystem
+ */
+
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <arpa/inet.h>
+#include <sys/resource.h>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+
+#define TRANSPORT_SUCCESS 0
+#define TRANSPORT_ERROR -1
+
+// Session states; a descriptor without a session is plain TCP
+#define TRANSPORT_HANDSHAKING 1      // TLS expected, nothing may be sent yet
+#define TRANSPORT_KERNEL_TLS 2       // the kernel encrypts records, send/writev work on the plain fd
+#define TRANSPORT_USERSPACE_TLS 3    // no kTLS, every byte goes through OpenSSL
+
+#define TRANSPORT_WAIT_MILLISECONDS 5000    // longest a sender waits for a TLS peer to accept data
+
+typedef struct TransportSession
+{
+    SSL* ssl;
+    int state;
+    bool kernelSend;
+    bool kernelRecv;
+    pthread_mutex_t lock;        // serializes OpenSSL calls in user space mode
+} TransportSession;
+
+int transportInit(void);
+int transportServerContext(const char* certFile, const char* keyFile);
+int transportClientContext(const char* caFile, bool verifyPeer);
+void transportExpectTls(int socketConnection);
+int transportAccept(int socketConnection);
+int transportConnect(int socketConnection, const char* serverName);
+ssize_t transportSend(int socketConnection, const void* buffer, size_t length, int flags);
+ssize_t transportRecvAll(int socketConnection, void* buffer, size_t length);
+bool transportPending(int socketConnection);
+bool transportHandoffSafe(int socketConnection);
+const char* transportDescribe(int socketConnection);
+void transportClose(int socketConnection);
+
+#endif
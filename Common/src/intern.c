@@ -0,0 +1,240 @@
+/*
+ * Filename:    intern.c
+ * Project:     CanWeTalkSystem
+ * By:          Salman Nouman, Minchul Hwang, Md Saiful Islam, Saje-Antoine Rose
+ * Date:        October, 19, 2026
+ * Description: This file contains the string intern table. It is an open addressed hash table in which a string keeps
+ *              its slot for as long as anybody holds a reference to it, so a slot's index is a stable identifier. Every
+ *              identifier handed out carries one reference; whoever keeps it releases it once, and the string is freed
+ *              with its last holder, leaving a marker that lookups step over and insertions reuse. Adding and freeing
+ *              strings takes a mutex, while reading the text of an identifier one holds and taking another reference to
+ *              it take no lock. The hash is keyed with a random value per process, so that nobody sending names can
+ *              predict which of them land in the same probe window.
+ */
+
+#include "../inc/intern.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <sys/random.h>
+#include <unistd.h>
+
+static _Atomic(InternEntry*) internSlots[INTERN_TABLE_SIZE];
+static InternEntry removedEntry;     // marks a slot whose string was freed, lookups go on past it
+static pthread_mutex_t internMutex = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t hashKey;
+static bool hashKeyed = false;
+
+/*
+ * Function:    hashText
+ * Description: This function hashes the part of a string that is interned. Caller holds internMutex.
+ * Parameters:  const char* text: The string
+ *              size_t length: Its length, at most MAX_INTERNED_LENGTH - 1
+ * Returns:     uint32_t: The FNV-1a hash, started from the process's key
+ */
+static uint32_t hashText(const char* text, size_t length)
+{
+    if (!hashKeyed)
+    {
+        if (getrandom(&hashKey, sizeof(hashKey), 0) != sizeof(hashKey))
+        {
+            hashKey = (uint32_t)(uintptr_t)&hashKey ^ (uint32_t)getpid();
+        }
+        hashKeyed = true;
+    }
+
+    uint32_t hash = 2166136261u ^ hashKey;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash = (hash ^ (unsigned char)text[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/*
+ * Function:    lookUp
+ * Description: This function looks a string up and takes a reference to it if it is there. Caller holds internMutex.
+ * Parameters:  const char* text: The string
+ *              size_t length: Its length, at most MAX_INTERNED_LENGTH - 1
+ *              uint32_t hash: Its hash
+ *              int* freeSlot: Receives the first slot of its probe window a new string can go into, -1 for none
+ * Returns:     InternId: Its identifier, INTERN_NONE if it is not interned
+ */
+static InternId lookUp(const char* text, size_t length, uint32_t hash, int* freeSlot)
+{
+    *freeSlot = -1;
+    for (uint32_t probe = 0; probe < INTERN_PROBE_LIMIT; probe++)
+    {
+        uint32_t slot = (hash + probe) & (INTERN_TABLE_SIZE - 1);
+        InternEntry* entry = atomic_load_explicit(&internSlots[slot], memory_order_relaxed);
+        if (entry == NULL || entry == &removedEntry)
+        {
+            if (*freeSlot < 0)
+            {
+                *freeSlot = slot;
+            }
+            if (entry == NULL)
+            {
+                break; // never used, the string would be here
+            }
+            continue;
+        }
+        if (entry->hash == hash && strncmp(entry->text, text, length) == 0 && entry->text[length] == '\0')
+        {
+            // A string whose last reference is being released is taken back before it is freed
+            atomic_fetch_add_explicit(&entry->references, 1, memory_order_relaxed);
+            return slot + 1;
+        }
+    }
+    return INTERN_NONE;
+}
+
+/*
+ * Function:    internString
+ * Description: This function returns the identifier of a string, adding it to the table if nobody holds it.
+ * Parameters:  const char* text: The string to intern
+ * Returns:     InternId: Its identifier, holding one reference the caller releases with internRelease. INTERN_NONE for
+ *              the empty string, INTERN_FAILED when no slot was free within INTERN_PROBE_LIMIT or memory ran out
+ */
+InternId internString(const char* text)
+{
+    size_t length = strnlen(text, MAX_INTERNED_LENGTH - 1);
+    int freeSlot;
+
+    if (length == 0)
+    {
+        return INTERN_NONE;
+    }
+    pthread_mutex_lock(&internMutex);
+    uint32_t hash = hashText(text, length);
+    InternId id = lookUp(text, length, hash, &freeSlot);
+    if (id != INTERN_NONE)
+    {
+        pthread_mutex_unlock(&internMutex);
+        return id;
+    }
+
+    InternEntry* created = freeSlot < 0 ? NULL : malloc(sizeof(InternEntry) + length + 1);
+    if (created == NULL)
+    {
+        pthread_mutex_unlock(&internMutex);
+        fprintf(stderr, "intern table: no room for \"%.*s\"\n", (int)length, text);
+        return INTERN_FAILED;
+    }
+    atomic_init(&created->references, 1);
+    created->hash = hash;
+    memcpy(created->text, text, length);
+    created->text[length] = '\0';
+    atomic_store_explicit(&internSlots[freeSlot], created, memory_order_release);
+    pthread_mutex_unlock(&internMutex);
+    return freeSlot + 1;
+}
+
+/*
+ * Function:    internFind
+ * Description: This function returns the identifier of a string somebody holds already, without adding it.
+ * Parameters:  const char* text: The string to look up
+ * Returns:     InternId: Its identifier, holding one reference the caller releases with internRelease. INTERN_NONE for
+ *              the empty string or one nobody holds
+ */
+InternId internFind(const char* text)
+{
+    size_t length = strnlen(text, MAX_INTERNED_LENGTH - 1);
+    int freeSlot;
+
+    if (length == 0)
+    {
+        return INTERN_NONE;
+    }
+    pthread_mutex_lock(&internMutex);
+    InternId id = lookUp(text, length, hashText(text, length), &freeSlot);
+    pthread_mutex_unlock(&internMutex);
+    return id;
+}
+
+/*
+ * Function:    internRetain
+ * Description: This function takes one more reference to a string the caller holds.
+ * Parameters:  InternId id: An identifier the caller holds a reference to, INTERN_NONE and INTERN_FAILED are ignored
+ * Returns:     void
+ */
+void internRetain(InternId id)
+{
+    if (id == INTERN_NONE || id > INTERN_TABLE_SIZE)
+    {
+        return;
+    }
+    InternEntry* entry = atomic_load_explicit(&internSlots[id - 1], memory_order_acquire);
+    atomic_fetch_add_explicit(&entry->references, 1, memory_order_relaxed);
+}
+
+/*
+ * Function:    internRelease
+ * Description: This function gives a reference back and frees the string once nobody holds it. The count is dropped
+ *              without the lock; whoever drops it to 0 frees the string under the lock unless a lookup took it back
+ *              meanwhile.
+ * Parameters:  InternId id: An identifier the caller holds a reference to, INTERN_NONE and INTERN_FAILED are ignored
+ * Returns:     void
+ */
+void internRelease(InternId id)
+{
+    if (id == INTERN_NONE || id > INTERN_TABLE_SIZE)
+    {
+        return;
+    }
+    InternEntry* entry = atomic_load_explicit(&internSlots[id - 1], memory_order_acquire);
+    if (atomic_fetch_sub_explicit(&entry->references, 1, memory_order_acq_rel) != 1)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&internMutex);
+    // The slot is read again: another release may have freed the string and a new one taken its place
+    entry = atomic_load_explicit(&internSlots[id - 1], memory_order_relaxed);
+    if (entry != NULL && entry != &removedEntry && atomic_load_explicit(&entry->references, memory_order_acquire) == 0)
+    {
+        atomic_store_explicit(&internSlots[id - 1], &removedEntry, memory_order_relaxed);
+        free(entry);
+    }
+    pthread_mutex_unlock(&internMutex);
+}
+
+/*
+ * Function:    internedString
+ * Description: This function returns the text of an interned string.
+ * Parameters:  InternId id: An identifier the caller holds a reference to
+ * Returns:     const char*: The string, valid until that reference is released. INTERN_FAILED_TEXT for INTERN_FAILED
+ */
+const char* internedString(InternId id)
+{
+    if (id == INTERN_NONE)
+    {
+        return "";
+    }
+    if (id > INTERN_TABLE_SIZE)
+    {
+        return INTERN_FAILED_TEXT;
+    }
+    return atomic_load_explicit(&internSlots[id - 1], memory_order_acquire)->text;
+}
+
+/*
+ * Function:    internCopy
+ * Description: This function copies the text of an identifier the caller may not hold. A string freed meanwhile is
+ *              copied as empty, and one that took its slot since then is copied instead.
+ * Parameters:  InternId id: The identifier
+ *              char* buffer: Receives the text
+ *              size_t size: The size of buffer
+ * Returns:     void
+ */
+void internCopy(InternId id, char* buffer, size_t size)
+{
+    if (id == INTERN_NONE || id > INTERN_TABLE_SIZE)
+    {
+        snprintf(buffer, size, "%s", internedString(id));
+        return;
+    }
+    pthread_mutex_lock(&internMutex);
+    InternEntry* entry = atomic_load_explicit(&internSlots[id - 1], memory_order_relaxed);
+    snprintf(buffer, size, "%s", entry == NULL || entry == &removedEntry ? "" : entry->text);
+    pthread_mutex_unlock(&internMutex);
+}
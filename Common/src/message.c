@@ -10,28 +10,206 @@
 #include "../inc/message.h"
 
 /*
- * Function:    sendLengthPrefixedMessage
- * Description: This function is responsible for sending a length-prefixed message over a socket connection.
+ * Function:    initMessage
+ * Description: This function prepares an empty message from a sender. Any body or sender the structure held before is
+ *              not released.
+ * Parameters:  Message* chatMessage: The message to initialize
+ *              const char* ip: The sender's IP address
+ *              const char* userName: The sender's username, truncated to MAX_USERNAME_LENGTH - 1 characters
+ * Returns:     bool: false if the intern table had no room for the address or the name, which then read back as
+ *              INTERN_FAILED_TEXT
+ */
+bool initMessage(Message* chatMessage, const char* ip, const char* userName)
+{
+    char shortName[MAX_USERNAME_LENGTH];
+    snprintf(shortName, sizeof(shortName), "%s", userName);
+
+    memset(chatMessage, 0, sizeof(Message));
+    chatMessage->ipId = internString(ip);
+    chatMessage->userId = internString(shortName);
+    chatMessage->senderSock = -1;
+    return chatMessage->ipId != INTERN_FAILED && chatMessage->userId != INTERN_FAILED;
+}
+
+/*
+ * Function:    initMessageFrom
+ * Description: This function prepares an empty message from a sender whose address and name are interned already, taking
+ *              a reference to each. Any body or sender the structure held before is not released.
+ * Parameters:  Message* chatMessage: The message to initialize
+ *              InternId ipId: The sender's IP address, the caller holds a reference to it
+ *              InternId userId: The sender's username, the caller holds a reference to it
+ * Returns:     void
+ */
+void initMessageFrom(Message* chatMessage, InternId ipId, InternId userId)
+{
+    memset(chatMessage, 0, sizeof(Message));
+    internRetain(ipId);
+    internRetain(userId);
+    chatMessage->ipId = ipId;
+    chatMessage->userId = userId;
+    chatMessage->senderSock = -1;
+}
+
+/*
+ * Function:    releaseBody
+ * Description: This function frees the body of a message if it has its own allocation and leaves the body empty.
+ * Parameters:  Message* chatMessage: The message
+ * Returns:     void
+ */
+static void releaseBody(Message* chatMessage)
+{
+    if (chatMessage->bodyLength >= MESSAGE_INLINE_LENGTH)
+    {
+        free(chatMessage->body.heapBody);
+    }
+    chatMessage->bodyLength = 0;
+    chatMessage->body.inlineBody[0] = '\0';
+}
+
+/*
+ * Function:    setMessageBody
+ * Description: This function replaces the body of a message. A body shorter than MESSAGE_INLINE_LENGTH is copied into the
+ *              message, a longer one into an allocation of its own size. Bodies over MAX_BODY_LENGTH are truncated, and a
+ *              failed allocation truncates the body to what fits inline.
+ * Parameters:  Message* chatMessage: The message to change
+ *              const char* text: The new body, it does not need to be null-terminated
+ *              size_t length: The number of characters in text
+ * Returns:     void
+ */
+void setMessageBody(Message* chatMessage, const char* text, size_t length)
+{
+    releaseBody(chatMessage);
+    if (length > MAX_BODY_LENGTH)
+    {
+        length = MAX_BODY_LENGTH;
+    }
+
+    if (length >= MESSAGE_INLINE_LENGTH)
+    {
+        char* heapBody = malloc(length + 1);
+        if (heapBody != NULL)
+        {
+            memcpy(heapBody, text, length);
+            heapBody[length] = '\0';
+            chatMessage->body.heapBody = heapBody;
+            chatMessage->bodyLength = length;
+            return;
+        }
+        perror("malloc failed");
+        length = MESSAGE_INLINE_LENGTH - 1;
+    }
+    memcpy(chatMessage->body.inlineBody, text, length);
+    chatMessage->body.inlineBody[length] = '\0';
+    chatMessage->bodyLength = length;
+}
+
+/*
+ * Function:    messageBody
+ * Description: This function returns the body of a message.
+ * Parameters:  const Message* chatMessage: The message
+ * Returns:     const char*: The null-terminated body, valid until the message is released or its body replaced
+ */
+const char* messageBody(const Message* chatMessage)
+{
+    return chatMessage->bodyLength >= MESSAGE_INLINE_LENGTH ? chatMessage->body.heapBody : chatMessage->body.inlineBody;
+}
+
+/*
+ * Function:    messageIp
+ * Description: This function returns the IP address of the sender of a message.
+ * Parameters:  const Message* chatMessage: The message
+ * Returns:     const char*: The IP address
+ */
+const char* messageIp(const Message* chatMessage)
+{
+    return internedString(chatMessage->ipId);
+}
+
+/*
+ * Function:    messageUserName
+ * Description: This function returns the username of the sender of a message.
+ * Parameters:  const Message* chatMessage: The message
+ * Returns:     const char*: The username
+ */
+const char* messageUserName(const Message* chatMessage)
+{
+    return internedString(chatMessage->userId);
+}
+
+/*
+ * Function:    releaseMessage
+ * Description: This function frees the body of a message if it has its own allocation, leaves the body empty and gives
+ *              back the message's references to its sender's address and name.
+ * Parameters:  Message* chatMessage: The message
+ * Returns:     void
+ */
+void releaseMessage(Message* chatMessage)
+{
+    releaseBody(chatMessage);
+    internRelease(chatMessage->ipId);
+    internRelease(chatMessage->userId);
+    chatMessage->ipId = INTERN_NONE;
+    chatMessage->userId = INTERN_NONE;
+}
+
+/*
+ * Function:    sendFrame
+ * Description: This function is responsible for sending a length-prefixed frame over a socket connection,
+ *              plain or TLS. A peer that went away is reported to the caller rather than raising SIGPIPE.
  * Parameters:  const char* chunk: Message content which is sent in a chunk
  *              int socketConnection: The socket file descriptor
- * Returns:     void
+ *              uint32_t type: 0 for a message, CONTROL_FRAME_FLAG for a control frame
+ * Returns:     int: SEND_SUCCESS or SEND_FAILURE
  */
-void sendLengthPrefixedMessage(const char* chunk, int socketConnection)
+static int sendFrame(const char* chunk, int socketConnection, uint32_t type)
 {
-    uint32_t msgLength = htonl(strlen(chunk)); // Convert message length to network byte order
-    // Send the length of the message
-    if (send(socketConnection, &msgLength, sizeof(msgLength), 0) < 0) 
-	{
-        perror("send");
-        exit(EXIT_FAILURE);
+    size_t chunkLength = strlen(chunk);
+    char* frame = malloc(sizeof(uint32_t) + chunkLength);
+    if (frame == NULL)
+    {
+        perror("malloc failed");
+        return SEND_FAILURE;
     }
 
-    // Send the message itself
-    if (send(socketConnection, chunk, strlen(chunk), 0) < 0) 
+    // The length and the message go out in one send so that TLS seals them in a single record
+    uint32_t msgLength = htonl(chunkLength | type); // Convert message length to network byte order
+    memcpy(frame, &msgLength, sizeof(msgLength));
+    memcpy(frame + sizeof(msgLength), chunk, chunkLength);
+
+    ssize_t sent = transportSend(socketConnection, frame, sizeof(msgLength) + chunkLength, 0);
+    free(frame);
+    if (sent < 0) 
 	{
         perror("send");
-        exit(EXIT_FAILURE);
+        return SEND_FAILURE;
     }
+    return SEND_SUCCESS;
+}
+
+/*
+ * Function:    sendLengthPrefixedMessage
+ * Description: This function sends one serialized message as a length-prefixed frame.
+ * Parameters:  const char* chunk: Message content which is sent in a chunk
+ *              int socketConnection: The socket file descriptor
+ * Returns:     int: SEND_SUCCESS or SEND_FAILURE
+ */
+int sendLengthPrefixedMessage(const char* chunk, int socketConnection)
+{
+    return sendFrame(chunk, socketConnection, 0);
+}
+
+/*
+ * Function:    sendControlFrame
+ * Description: This function sends a control request such as >>bye<< as a typed frame. Its length carries
+ *              CONTROL_FRAME_FLAG and its payload is the bare request, so the receiver can tell it from a chat
+ *              message by the length alone and act on it without deserializing anything.
+ * Parameters:  const char* control: The control request
+ *              int socketConnection: The socket file descriptor
+ * Returns:     int: SEND_SUCCESS or SEND_FAILURE
+ */
+int sendControlFrame(const char* control, int socketConnection)
+{
+    return sendFrame(control, socketConnection, CONTROL_FRAME_FLAG);
 }
 
 /*
@@ -39,11 +217,12 @@ void sendLengthPrefixedMessage(const char* chunk, int socketConnection)
  * Description: This function is responsible for sending a large message in smaller chunks over a socket connection
  * Parameters:  const Message* chatMessage: A pointer to a Message structure containing information about the message to be sent.
  *              int socketConnection: The socket file descriptor
- * Returns:     void
+ * Returns:     int: SEND_SUCCESS or SEND_FAILURE
  */
-void sendParcelledMessage(const Message* chatMessage, int socketConnection) 
+int sendParcelledMessage(const Message* chatMessage, int socketConnection) 
 {
-    int messageLength = strlen(chatMessage->message);
+    const char* body = messageBody(chatMessage);
+    int messageLength = chatMessage->bodyLength;
 	char serializedMessage[MAX_SERIALIZED_LENGTH];
     int begin = 0; // begin index of the current chunk
     char parcel[MAX_PARCEL_LENGTH];
@@ -61,7 +240,7 @@ void sendParcelledMessage(const Message* chatMessage, int socketConnection)
 		else 
 		{
             // Ensure we don't split in the middle of a word
-            while (chatMessage->message[begin + chunkLength] != ' ' && chunkLength > 0) 
+            while (body[begin + chunkLength] != ' ' && chunkLength > 0) 
 			{
                 chunkLength--;
             }
@@ -72,92 +251,201 @@ void sendParcelledMessage(const Message* chatMessage, int socketConnection)
             }
         }
 		
-        strncpy(parcel, chatMessage->message + begin, chunkLength);
+        memcpy(parcel, body + begin, chunkLength);
         parcel[chunkLength] = '\0'; // Null terminate the parcel
 
 		serializeMessage(chatMessage, parcel, serializedMessage, MAX_SERIALIZED_LENGTH);
 
-        sendLengthPrefixedMessage(serializedMessage, socketConnection);
+        if (sendLengthPrefixedMessage(serializedMessage, socketConnection) != SEND_SUCCESS)
+        {
+            return SEND_FAILURE;
+        }
 
         begin += chunkLength;
-        if (chatMessage->message[begin] == ' ') 
+        if (body[begin] == ' ') 
 		{
             begin++; // Skip the space at the beginning of the next chunk
         }
     }
+    return SEND_SUCCESS;
+}
+
+
+/*
+ * Function:    wallClockNanoseconds
+ * Description: This function reads the wall clock, which is what senders, the server and receivers compare their
+ *              timestamps by. Latency between hosts is only as accurate as their clocks are synchronized.
+ * Parameters:  void
+ * Returns:     uint64_t: Nanoseconds since the epoch
+ */
+uint64_t wallClockNanoseconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	return (uint64_t)now.tv_sec * NANOSECONDS_PER_SECOND + (uint64_t)now.tv_nsec;
 }
 
 
 /*
- * Function:    getCurrentTimestamp
- * Description: This function gets the current time, formats it accordingly and puts it into a buffer
- * Parameters:  char* buffer: The buffer tohold the timestamp
+ * Function:    formatTimestamp
+ * Description: This function formats a time of day as HH:MM:SS. The hours and minutes are worked out by localtime
+ *              once per minute and kept per thread, since every time zone is offset by whole minutes the seconds
+ *              only need a division.
+ * Parameters:  uint64_t nanoseconds: The time, nanoseconds since the epoch
+ *              char* buffer: The buffer to hold the timestamp
  *              size_t bufSize: The size of the buffer
  * Returns:     void
  */
-void getCurrentTimestamp(char* buffer, size_t bufSize)
+void formatTimestamp(uint64_t nanoseconds, char* buffer, size_t bufSize)
 {
-	time_t now = time(NULL);
-	struct tm *localNow = localtime(&now);
-	strftime(buffer, bufSize, "%H:%M:%S", localNow);
+	static _Thread_local time_t cachedMinute = -1;
+	static _Thread_local char cachedHoursMinutes[MAX_TIMESTAMP_LENGTH];
+
+	time_t seconds = (time_t)(nanoseconds / NANOSECONDS_PER_SECOND);
+	time_t minute = seconds - seconds % 60;
+	if (minute != cachedMinute)
+	{
+		struct tm localMinute;
+		localtime_r(&minute, &localMinute);
+		strftime(cachedHoursMinutes, sizeof(cachedHoursMinutes), "%H:%M:", &localMinute);
+		cachedMinute = minute;
+	}
+	snprintf(buffer, bufSize, "%s%02d", cachedHoursMinutes, (int)(seconds % 60));
+}
+
+
+/*
+ * Function:    formatLatency
+ * Description: This function formats a duration with three significant digits in the largest fitting unit.
+ * Parameters:  uint64_t nanoseconds: The duration
+ *              char* buffer: The buffer to hold the text
+ *              size_t bufSize: The size of the buffer
+ * Returns:     void
+ */
+void formatLatency(uint64_t nanoseconds, char* buffer, size_t bufSize)
+{
+	if (nanoseconds < 1000)
+	{
+		snprintf(buffer, bufSize, "%" PRIu64 "ns", nanoseconds);
+	}
+	else if (nanoseconds < 1000000)
+	{
+		snprintf(buffer, bufSize, "%.3gus", nanoseconds / 1e3);
+	}
+	else if (nanoseconds < NANOSECONDS_PER_SECOND)
+	{
+		snprintf(buffer, bufSize, "%.3gms", nanoseconds / 1e6);
+	}
+	else
+	{
+		snprintf(buffer, bufSize, "%.3gs", nanoseconds / 1e9);
+	}
 }
 
 
 /*
  * Function:    serializeMessage
  * Description: This function sereializes a chats message in order to be sent over a network. It uses a | charachter as a 
- *              delianiater between the messages content
+ *              delianiater between the messages content. A message that carries timestamps has them appended to the
+ *              IP address, ip@sent@stamped, so the field count stays the same
  * Parameters:  const Message* chatMessage: A pointer to a Message structure containing information about the message to be sent.
- *              char* parcel: The messages content
+ *              const char* parcel: The messages content
  *              char* serializedMessage: A buffer to store the serialized message
  *              size_t bufSize: The size of the buffer
  * Returns:     void
  */
-void serializeMessage(const Message* chatMessage, char* parcel, char* serializedMessage, size_t bufferSize)
+void serializeMessage(const Message* chatMessage, const char* parcel, char* serializedMessage, size_t bufferSize)
 {
 	    // Serializing message here using the '|' character
-    snprintf(serializedMessage, bufferSize, "%s|%s|%s",
-             chatMessage->ip, chatMessage->userName, parcel);
+    if (chatMessage->sentNanoseconds == 0 && chatMessage->stampedNanoseconds == 0)
+    {
+        snprintf(serializedMessage, bufferSize, "%s|%s|%s",
+                 messageIp(chatMessage), messageUserName(chatMessage), parcel);
+        return;
+    }
+    snprintf(serializedMessage, bufferSize, "%s%c%" PRIu64 "%c%" PRIu64 "|%s|%s",
+             messageIp(chatMessage), TIMING_SEPARATOR, chatMessage->sentNanoseconds, TIMING_SEPARATOR,
+             chatMessage->stampedNanoseconds, messageUserName(chatMessage), parcel);
 }
 
 
 /*
- * Function:    deserializeMessage
- * Description: This function takes a serialized message and deserialiazes it and extracts the related message components into a Message structure
- *              delianiater between the messages content
- * Parameters:  Message* chatMessage: A pointer to a Message structure containing information about the message sent.
- *              const char* serializedMessage: A buffer to store the serialized message
- * Returns:     void
+ * Function:    parseSerializedMessage
+ * Description: This function splits a serialized message into its fields without interning any of them, the timestamps
+ *              included if it carries any. It uses a | charachter as a delianiater between the messages content.
+ * Parameters:  const char* serializedMessage: The serialized message
+ *              char* ip: Receives the sender's IP address, MAX_IP_LENGTH bytes, or NULL when it is not wanted
+ *              char* userName: Receives the sender's username, MAX_USERNAME_LENGTH bytes
+ *              uint64_t* sent: Receives the sender's timestamp, 0 if there is none
+ *              uint64_t* stamped: Receives the server's timestamp, 0 if there is none
+ * Returns:     const char*: The body, which points into serializedMessage
  */
-void deserializeMessage(Message* chatMessage, const char* serializedMessage) 
+const char* parseSerializedMessage(const char* serializedMessage, char* ip, char* userName, uint64_t* sent, uint64_t* stamped)
 {
-    char *token;
-    char *rest = strdup(serializedMessage); // Duplicating to not modify the original
-    char *originalRest = rest; // Memory pointer for freeing later
+    const char* body = "";
+    *sent = 0;
+    *stamped = 0;
+    userName[0] = '\0';
 
-    // Extract IP
-    token = strtok_r(rest, "|", &rest);
-    if (token) 
-	{
-		strncpy(chatMessage->ip, token, MAX_IP_LENGTH);
-	}	
-    chatMessage->ip[MAX_IP_LENGTH - 1] = '\0'; // Ensure null-termination
+    // Everything after the second '|' is the body, so a body may itself contain the delimiter
+    const char* ipEnd = strchr(serializedMessage, '|');
+    if (ipEnd == NULL)
+    {
+        ipEnd = serializedMessage + strlen(serializedMessage);
+    }
+    const char* timing = memchr(serializedMessage, TIMING_SEPARATOR, ipEnd - serializedMessage);
+    if (timing != NULL)
+    {
+        char* sentEnd;
+        *sent = strtoull(timing + 1, &sentEnd, 10);
+        if (*sentEnd == TIMING_SEPARATOR)
+        {
+            *stamped = strtoull(sentEnd + 1, NULL, 10);
+        }
+    }
+    if (ip != NULL)
+    {
+        const char* addressEnd = timing != NULL ? timing : ipEnd;
+        snprintf(ip, MAX_IP_LENGTH, "%.*s", (int)(addressEnd - serializedMessage), serializedMessage);
+    }
 
-    // Extract Username
-    token = strtok_r(NULL, "|", &rest);
-    if (token)
-	{
-		strncpy(chatMessage->userName, token, MAX_USERNAME_LENGTH);
-	}
-    chatMessage->userName[MAX_USERNAME_LENGTH - 1] = '\0';
+    if (*ipEnd == '|')
+    {
+        const char* userStart = ipEnd + 1;
+        const char* userEnd = strchr(userStart, '|');
+        if (userEnd == NULL)
+        {
+            userEnd = userStart + strlen(userStart);
+        }
+        snprintf(userName, MAX_USERNAME_LENGTH, "%.*s", (int)(userEnd - userStart), userStart);
+        if (*userEnd == '|')
+        {
+            body = userEnd + 1;
+        }
+    }
+    return body;
+}
 
-    // Extract Message
-    token = strtok_r(NULL, "|", &rest);
-    if (token)
-	{
-		strncpy(chatMessage->message, token, MAX_PARCEL_LENGTH);
-	}
-    chatMessage->message[MAX_PARCEL_LENGTH - 1] = '\0';
+/*
+ * Function:    deserializeMessage
+ * Description: This function takes a serialized message and deserialiazes it and extracts the related message components
+ *              into a Message structure, interning the sender's address and name. Any body or sender the structure held
+ *              before is not released.
+ * Parameters:  Message* chatMessage: A pointer to a Message structure containing information about the message sent.
+ *              const char* serializedMessage: A buffer to store the serialized message
+ * Returns:     bool: false if the intern table had no room for the address or the name, see initMessage
+ */
+bool deserializeMessage(Message* chatMessage, const char* serializedMessage) 
+{
+    char ip[MAX_IP_LENGTH];
+    char userName[MAX_USERNAME_LENGTH];
+    uint64_t sent;
+    uint64_t stamped;
+    const char* body = parseSerializedMessage(serializedMessage, ip, userName, &sent, &stamped);
 
-    free(originalRest); // Free the duplicated string
+    bool interned = initMessage(chatMessage, ip, userName);
+    chatMessage->sentNanoseconds = sent;
+    chatMessage->stampedNanoseconds = stamped;
+    setMessageBody(chatMessage, body, strlen(body));
+    return interned;
 }
@@ -0,0 +1,65 @@
+/*
+ * Filename:    multicast.c
+ * Project:     CanWeTalkSystem
+ * By:          Salman Nouman, Minchul Hwang, Md Saiful Islam, Saje-Antoine Rose
+ * Date:        October, 19, 2026
+ * Description: This file contains the encoding of the datagrams the server publishes to its multicast group.
+ */
+
+#include "../inc/multicast.h"
+
+/*
+ * Function:    encodeDatagram
+ * Description: This function writes a datagram: its type, its sequence number in network byte order and the payload.
+ * Parameters:  char type: MULTICAST_DATA or MULTICAST_ANNOUNCE
+ *              uint64_t sequence: The sequence number
+ *              const char* payload: The serialized message, NULL for an announcement
+ *              char* datagram: The buffer to write to
+ *              size_t size: The size of the buffer, MAX_DATAGRAM_LENGTH always suffices
+ * Returns:     size_t: The length of the datagram, 0 if it does not fit
+ */
+size_t encodeDatagram(char type, uint64_t sequence, const char* payload, char* datagram, size_t size)
+{
+    size_t payloadLength = payload == NULL ? 0 : strlen(payload);
+    if (MULTICAST_HEADER_LENGTH + payloadLength > size)
+    {
+        return 0;
+    }
+
+    datagram[0] = type;
+    for (int i = 0; i < 8; i++)
+    {
+        datagram[1 + i] = (char)(sequence >> (56 - 8 * i));
+    }
+    memcpy(datagram + MULTICAST_HEADER_LENGTH, payload, payloadLength);
+    return MULTICAST_HEADER_LENGTH + payloadLength;
+}
+
+/*
+ * Function:    decodeDatagram
+ * Description: This function splits a received datagram into its parts. The payload is null-terminated in place, so
+ *              the buffer must have room for one byte past the datagram.
+ * Parameters:  char* datagram: The received bytes
+ *              size_t length: Their number
+ *              char* type: Receives the type
+ *              uint64_t* sequence: Receives the sequence number
+ *              const char** payload: Receives the serialized message, empty for an announcement
+ * Returns:     bool: false if the datagram is too short or of an unknown type
+ */
+bool decodeDatagram(char* datagram, size_t length, char* type, uint64_t* sequence, const char** payload)
+{
+    if (length < MULTICAST_HEADER_LENGTH || (datagram[0] != MULTICAST_DATA && datagram[0] != MULTICAST_ANNOUNCE))
+    {
+        return false;
+    }
+
+    *type = datagram[0];
+    *sequence = 0;
+    for (int i = 0; i < 8; i++)
+    {
+        *sequence = (*sequence << 8) | (unsigned char)datagram[1 + i];
+    }
+    datagram[length] = '\0';
+    *payload = datagram + MULTICAST_HEADER_LENGTH;
+    return true;
+}
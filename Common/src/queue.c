@@ -18,76 +18,507 @@
 void queueInit(MessageQueue* queue)
 {
 	queue->front = queue->rear = NULL;
+    queue->controlFront = queue->controlRear = NULL;
+    queue->controlStreak = 0;
+    queue->lastSojournNanoseconds = 0;
+    queue->flows = NULL;
+    queue->flowCount = 0;
+    queue->activeHead = queue->activeTail = -1;
+    atomic_init(&queue->length, 0);
     pthread_mutex_init(&queue->lock, NULL);
-    pthread_cond_init(&queue->cond, NULL);
+
+    // Timed waits should not stretch or shrink when the wall clock is adjusted
+    pthread_condattr_t condAttributes;
+    pthread_condattr_init(&condAttributes);
+    pthread_condattr_setclock(&condAttributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&queue->cond, &condAttributes);
+    pthread_condattr_destroy(&condAttributes);
+}
+
+/*
+ * Function:    monotonicNanoseconds
+ * Description: Reads the monotonic clock, which stamps queued messages.
+ * Parameters:  void
+ * Returns:     uint64_t: The current time in nanoseconds
+ */
+static uint64_t monotonicNanoseconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+/*
+ * Function:    newNode
+ * Description: Copies a message into a new queue node stamped with the current time.
+ * Parameters:  const Message* message: Pointer to the message to be enqueued.
+ * Returns:     QueueNode*: The node, not linked into any lane yet
+ */
+static QueueNode* newNode(const Message* message)
+{
+    QueueNode* node = malloc(sizeof(QueueNode));
+    if (node == NULL)
+    {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+
+    // Copy the provided message into the new node
+    memcpy(&node->message, message, sizeof(Message));
+    node->enqueuedNanoseconds = monotonicNanoseconds();
+    node->next = NULL;
+    return node;
+}
+
+/*
+ * Function:    linkNode
+ * Description: Adds a node to the end of one lane of a message queue. The caller holds the queue lock.
+ * Parameters:  QueueNode** front: The front of the lane
+ *              QueueNode** rear: The rear of the lane
+ *              QueueNode* node: The node to add
+ * Returns:     void
+ */
+static void linkNode(QueueNode** front, QueueNode** rear, QueueNode* node)
+{
+    if (*rear == NULL) 
+	{ // Empty lane
+        *front = *rear = node;
+    } 
+	else 
+	{ // Non-empty lane
+        (*rear)->next = node;
+        *rear = node;
+    }
+}
+
+/*
+ * Function:    appendToLane
+ * Description: Adds a message to the end of one lane of a message queue and wakes a waiting consumer.
+ * Parameters:  MessageQueue* queue: Pointer to the message queue structure.
+ *              QueueNode** front: The front of the lane
+ *              QueueNode** rear: The rear of the lane
+ *              const Message* message: Pointer to the message to be enqueued.
+ * Returns:     void
+ */
+static void appendToLane(MessageQueue *queue, QueueNode** front, QueueNode** rear, const Message* message)
+{
+    QueueNode* node = newNode(message);
+
+    pthread_mutex_lock(&queue->lock);
+    linkNode(front, rear, node);
+    atomic_fetch_add_explicit(&queue->length, 1, memory_order_release);
+
+    pthread_cond_signal(&queue->cond);
+    pthread_mutex_unlock(&queue->lock);
 }
 
 /*
  * Function:    enqueue
- * Description: Adds a message to the end of a message queue.
+ * Description: Adds a message to the end of the bulk lane of a message queue, in the default flow of a fair queue. The
+ *              queue takes over the message body, so the caller must not release its copy afterwards.
  * Parameters:  MessageQueue* queue: Pointer to the message queue structure.
  *              const Message* message: Pointer to the message to be enqueued.
  * Returns:     void
  */
 void enqueue(MessageQueue *queue, const Message* message)
 {
+    enqueueFlow(queue, message, QUEUE_DEFAULT_FLOW);
+}
+
+/*
+ * Function:    enqueueControl
+ * Description: Adds a message to the end of the control lane of a message queue, ahead of every waiting bulk message.
+ *              The queue takes over the message body.
+ * Parameters:  MessageQueue* queue: Pointer to the message queue structure.
+ *              const Message* message: Pointer to the message to be enqueued.
+ * Returns:     void
+ */
+void enqueueControl(MessageQueue *queue, const Message* message)
+{
+    appendToLane(queue, &queue->controlFront, &queue->controlRear, message);
+}
+
+/*
+ * Function:    queueEnableFairness
+ * Description: Splits the bulk lane of an empty message queue into flows served in deficit round robin order, so that a
+ *              sender filling its flow only delays its own messages. Choosing the next message takes constant time: a
+ *              turn grants at least the cost of the longest message, so the flow at the head of the round can always
+ *              take one once it had its turn. Every flow starts with weight 1.
+ * Parameters:  MessageQueue* queue: Pointer to the message queue structure.
+ *              int flowCount: The number of flows, flows 0 to flowCount - 1
+ * Returns:     bool: false if the flows could not be allocated, the queue then keeps its single bulk lane
+ */
+bool queueEnableFairness(MessageQueue* queue, int flowCount)
+{
+    QueueFlow* flows = calloc(flowCount, sizeof(QueueFlow));
+    if (flows == NULL)
+    {
+        return false;
+    }
+    for (int i = 0; i < flowCount; i++)
+    {
+        flows[i].weight = 1;
+        flows[i].nextActive = -1;
+    }
+
     pthread_mutex_lock(&queue->lock);
-    QueueNode* newNode = malloc(sizeof(QueueNode));
-    
-    // Copy the provided message into the new node
-    memcpy(&newNode->message, message, sizeof(Message));
-    newNode->next = NULL;
+    queue->flows = flows;
+    queue->flowCount = flowCount;
+    pthread_mutex_unlock(&queue->lock);
+    return true;
+}
 
-    if (queue->rear == NULL) 
-	{ // Empty queue
-        queue->front = queue->rear = newNode;
-    } 
-	else 
-	{ // Non-empty queue
-        queue->rear->next = newNode;
-        queue->rear = newNode;
+/*
+ * Function:    queueSetFlowWeight
+ * Description: Sets the share of a flow of a fair queue. A flow of weight 2 may take twice the bytes of a flow of
+ *              weight 1 per round. Takes effect from the flow's next turn.
+ * Parameters:  MessageQueue* queue: Pointer to the message queue structure.
+ *              int flow: The flow
+ *              int weight: Quanta granted per turn, at least 1
+ * Returns:     void
+ */
+void queueSetFlowWeight(MessageQueue* queue, int flow, int weight)
+{
+    pthread_mutex_lock(&queue->lock);
+    if (queue->flows != NULL && flow >= 0 && flow < queue->flowCount)
+    {
+        queue->flows[flow].weight = weight < 1 ? 1 : weight;
     }
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/*
+ * Function:    enqueueFlow
+ * Description: Adds a message to the end of one flow of the bulk lane of a fair queue. A flow that had no messages
+ *              joins the end of the round. A queue that is not fair ignores the flow. The queue takes over the message
+ *              body.
+ * Parameters:  MessageQueue* queue: Pointer to the message queue structure.
+ *              const Message* message: Pointer to the message to be enqueued.
+ *              int flow: The flow, QUEUE_DEFAULT_FLOW if it is out of range
+ * Returns:     void
+ */
+void enqueueFlow(MessageQueue *queue, const Message* message, int flow)
+{
+    QueueNode* node = newNode(message);
+
+    pthread_mutex_lock(&queue->lock);
+    if (queue->flows == NULL)
+    {
+        linkNode(&queue->front, &queue->rear, node);
+    }
+    else
+    {
+        if (flow < 0 || flow >= queue->flowCount)
+        {
+            flow = QUEUE_DEFAULT_FLOW;
+        }
+        QueueFlow* queueFlow = &queue->flows[flow];
+        linkNode(&queueFlow->front, &queueFlow->rear, node);
+        queueFlow->length++;
+        if (!queueFlow->active)
+        {
+            queueFlow->active = true;
+            queueFlow->nextActive = -1;
+            if (queue->activeTail == -1)
+            {
+                queue->activeHead = flow;
+            }
+            else
+            {
+                queue->flows[queue->activeTail].nextActive = flow;
+            }
+            queue->activeTail = flow;
+        }
+    }
+    atomic_fetch_add_explicit(&queue->length, 1, memory_order_release);
 
     pthread_cond_signal(&queue->cond);
     pthread_mutex_unlock(&queue->lock);
 }
 
+/*
+ * Function:    queueTakeFlowDelays
+ * Description: Reads how long the messages taken from each flow of a fair queue waited since the previous read, and
+ *              starts counting afresh.
+ * Parameters:  MessageQueue* queue: Pointer to the message queue structure.
+ *              QueueFlowDelay* delays: Array receiving the delays of flows 0 to count - 1
+ *              int count: Size of the array, flows beyond the queue's are reported as idle
+ * Returns:     void
+ */
+void queueTakeFlowDelays(MessageQueue* queue, QueueFlowDelay* delays, int count)
+{
+    memset(delays, 0, count * sizeof(QueueFlowDelay));
+    pthread_mutex_lock(&queue->lock);
+    for (int i = 0; i < count && i < queue->flowCount; i++)
+    {
+        QueueFlow* flow = &queue->flows[i];
+        delays[i].served = flow->served;
+        delays[i].totalNanoseconds = flow->sojournTotalNanoseconds;
+        delays[i].maxNanoseconds = flow->sojournMaxNanoseconds;
+        delays[i].queued = flow->length;
+        flow->served = 0;
+        flow->sojournTotalNanoseconds = 0;
+        flow->sojournMaxNanoseconds = 0;
+    }
+    pthread_mutex_unlock(&queue->lock);
+}
+
 
 /*
- * Function:    dequeue
- * Description: Removes a message from the front of a message queue.
+ * Function:    takeFromLane
+ * Description: Takes the message at the front of one lane of a message queue. The caller holds the queue lock.
  * Parameters:  MessageQueue* queue: Pointer to the message queue structure.
+ *              QueueNode** front: The front of the lane
+ *              QueueNode** rear: The rear of the lane
  *              Message* msgOut: Pointer to a Message structure where the dequeued message will be stored.
- * Returns:     int: 1 if successful (message dequeued), 0 if the queue was empty.
+ * Returns:     bool: false if the lane was empty
  */
-int dequeue(MessageQueue *queue, Message* msgOut)
+static bool takeFromLane(MessageQueue *queue, QueueNode** front, QueueNode** rear, Message* msgOut)
 {
-	pthread_mutex_lock(&queue->lock);
-    
-    if (queue->front == NULL) 
-	{ // Check for empty queue
-        pthread_mutex_unlock(&queue->lock);
-        return EMPTY_QUEUE; // Indicate queue was empty
+    if (*front == NULL) 
+	{ // Check for empty lane
+        return false;
     }
 
-    QueueNode* temp = queue->front;
+    QueueNode* temp = *front;
     memcpy(msgOut, &temp->message, sizeof(Message)); // Copy the message out
-    queue->front = queue->front->next;
+    queue->lastSojournNanoseconds = monotonicNanoseconds() - temp->enqueuedNanoseconds;
+    *front = (*front)->next;
 
-    if (queue->front == NULL) 
+    if (*front == NULL) 
 	{
-        queue->rear = NULL;
+        *rear = NULL;
     }
+    atomic_fetch_sub_explicit(&queue->length, 1, memory_order_relaxed);
 
     free(temp);
+    return true;
+}
+
+/*
+ * Function:    takeFromFlows
+ * Description: Takes the next bulk message of a fair queue in deficit round robin order. The flow at the head of the
+ *              round receives its quanta when its turn starts and gives up the turn once its deficit no longer covers
+ *              its next message, keeping what is left for its next turn. A flow that runs empty leaves the round with
+ *              nothing, so an idle sender cannot save up credit. The caller holds the queue lock.
+ * Parameters:  MessageQueue* queue: Pointer to the message queue structure.
+ *              Message* msgOut: Pointer to a Message structure where the dequeued message will be stored.
+ * Returns:     bool: false if no flow had a message
+ */
+static bool takeFromFlows(MessageQueue *queue, Message* msgOut)
+{
+    // At most two passes: a flow that just received its quanta can always pay for its next message
+    while (queue->activeHead != -1)
+    {
+        int index = queue->activeHead;
+        QueueFlow* flow = &queue->flows[index];
+        if (!flow->granted)
+        {
+            flow->deficit += flow->weight * QUEUE_FAIR_QUANTUM;
+            flow->granted = true;
+        }
+
+        int cost = flow->front->message.bodyLength + 1;
+        if (cost <= flow->deficit)
+        {
+            flow->deficit -= cost;
+            takeFromLane(queue, &flow->front, &flow->rear, msgOut);
+            flow->length--;
+            flow->served++;
+            flow->sojournTotalNanoseconds += queue->lastSojournNanoseconds;
+            if (queue->lastSojournNanoseconds > flow->sojournMaxNanoseconds)
+            {
+                flow->sojournMaxNanoseconds = queue->lastSojournNanoseconds;
+            }
+            if (flow->front == NULL)
+            {
+                flow->active = false;
+                flow->granted = false;
+                flow->deficit = 0;
+                queue->activeHead = flow->nextActive;
+                if (queue->activeHead == -1)
+                {
+                    queue->activeTail = -1;
+                }
+            }
+            return true;
+        }
+
+        // Turn over, the flow goes to the end of the round
+        flow->granted = false;
+        if (flow->nextActive != -1)
+        {
+            queue->activeHead = flow->nextActive;
+            flow->nextActive = -1;
+            queue->flows[queue->activeTail].nextActive = index;
+            queue->activeTail = index;
+        }
+    }
+    return false;
+}
+
+/*
+ * Function:    takeBulk
+ * Description: Takes the next bulk message, from the single bulk lane or from the flows of a fair queue. The caller
+ *              holds the queue lock.
+ * Parameters:  MessageQueue* queue: Pointer to the message queue structure.
+ *              Message* msgOut: Pointer to a Message structure where the dequeued message will be stored.
+ * Returns:     bool: false if no bulk message was waiting
+ */
+static bool takeBulk(MessageQueue *queue, Message* msgOut)
+{
+    if (queue->flows != NULL)
+    {
+        return takeFromFlows(queue, msgOut);
+    }
+    return takeFromLane(queue, &queue->front, &queue->rear, msgOut);
+}
+
+/*
+ * Function:    bulkWaiting
+ * Description: Tells whether a bulk message is waiting. The caller holds the queue lock.
+ * Parameters:  const MessageQueue* queue: Pointer to the message queue structure.
+ * Returns:     bool: true if the bulk lane or a flow has a message
+ */
+static bool bulkWaiting(const MessageQueue *queue)
+{
+    return queue->front != NULL || queue->activeHead != -1;
+}
+
+/*
+ * Function:    removeFront
+ * Description: Takes the next message of a message queue, from the control lane unless it had QUEUE_CONTROL_BURST
+ *              turns in a row while bulk messages waited. The caller holds the queue lock.
+ * Parameters:  MessageQueue* queue: Pointer to the message queue structure.
+ *              Message* msgOut: Pointer to a Message structure where the dequeued message will be stored.
+ * Returns:     int: CONTROL_DEQUEUED or MESSAGE_DEQUEUED for the lane it came from, EMPTY_QUEUE if the queue was empty.
+ */
+static int removeFront(MessageQueue *queue, Message* msgOut)
+{
+    if (queue->controlFront != NULL && (!bulkWaiting(queue) || queue->controlStreak < QUEUE_CONTROL_BURST))
+    {
+        takeFromLane(queue, &queue->controlFront, &queue->controlRear, msgOut);
+        queue->controlStreak = bulkWaiting(queue) ? queue->controlStreak + 1 : 0;
+        return CONTROL_DEQUEUED;
+    }
+
+    queue->controlStreak = 0;
+    return takeBulk(queue, msgOut) ? MESSAGE_DEQUEUED : EMPTY_QUEUE;
+}
+
+
+/*
+ * Function:    dequeue
+ * Description: Removes a message from the front of a message queue. The caller owns the message body and releases it
+ *              with releaseMessage once done.
+ * Parameters:  MessageQueue* queue: Pointer to the message queue structure.
+ *              Message* msgOut: Pointer to a Message structure where the dequeued message will be stored.
+ * Returns:     int: MESSAGE_DEQUEUED or CONTROL_DEQUEUED if successful (message dequeued), 0 if the queue was empty.
+ */
+int dequeue(MessageQueue *queue, Message* msgOut)
+{
+	pthread_mutex_lock(&queue->lock);
+    int result = removeFront(queue, msgOut);
+    pthread_mutex_unlock(&queue->lock);
+    return result;
+}
+
+/*
+ * Function:    dequeueControl
+ * Description: Removes a message from the control lane only, leaving bulk messages where they are.
+ * Parameters:  MessageQueue* queue: Pointer to the message queue structure.
+ *              Message* msgOut: Pointer to a Message structure where the dequeued message will be stored.
+ * Returns:     int: CONTROL_DEQUEUED if successful, EMPTY_QUEUE if the control lane was empty.
+ */
+int dequeueControl(MessageQueue *queue, Message* msgOut)
+{
+	pthread_mutex_lock(&queue->lock);
+    bool taken = takeFromLane(queue, &queue->controlFront, &queue->controlRear, msgOut);
     pthread_mutex_unlock(&queue->lock);
-    return MESSAGE_DEQUEUED; // Indicate success
+    return taken ? CONTROL_DEQUEUED : EMPTY_QUEUE;
+}
+
+
+/*
+ * Function:    dequeueBatch
+ * Description: Removes up to max bulk messages from the front of a message queue under one lock. It stops early when a
+ *              control message is waiting, so taking a batch never delays the control lane by more than the batch.
+ * Parameters:  MessageQueue* queue: Pointer to the message queue structure.
+ *              Message* msgOut: Array receiving the dequeued messages, the caller owns their bodies
+ *              uint64_t* sojournNanoseconds: Array receiving how long each one waited, NULL if not wanted
+ *              int max: Size of the arrays
+ * Returns:     int: The number of messages dequeued, 0 if there were none.
+ */
+int dequeueBatch(MessageQueue *queue, Message* msgOut, uint64_t* sojournNanoseconds, int max)
+{
+    int taken = 0;
+	pthread_mutex_lock(&queue->lock);
+    while (taken < max && queue->controlFront == NULL && takeBulk(queue, &msgOut[taken]))
+    {
+        if (sojournNanoseconds != NULL)
+        {
+            sojournNanoseconds[taken] = queue->lastSojournNanoseconds;
+        }
+        taken++;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return taken;
+}
+
+
+/*
+ * Function:    dequeueWait
+ * Description: Removes a message from the front of a message queue, waiting for one if the queue is empty. The caller
+ *              first spins, watching the queue length without taking the lock, so a message that arrives soon is picked
+ *              up without a context switch. After that it parks on the queue's condition variable, which every enqueue
+ *              signals. The park is bounded so that the caller can check its own stop condition.
+ * Parameters:  MessageQueue* queue: Pointer to the message queue structure.
+ *              Message* msgOut: Pointer to a Message structure where the dequeued message will be stored.
+ *              long spinMicroseconds: How long to spin before parking, 0 parks straight away
+ *              int parkMilliseconds: The longest time to stay parked
+ * Returns:     int: MESSAGE_DEQUEUED or CONTROL_DEQUEUED if successful, EMPTY_QUEUE if nothing arrived in time.
+ */
+int dequeueWait(MessageQueue *queue, Message* msgOut, long spinMicroseconds, int parkMilliseconds)
+{
+    struct timespec start;
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    now = start;
+    while ((now.tv_sec - start.tv_sec) * 1000000L + (now.tv_nsec - start.tv_nsec) / 1000 < spinMicroseconds)
+    {
+        int result;
+        if (atomic_load_explicit(&queue->length, memory_order_acquire) > 0 && (result = dequeue(queue, msgOut)) != EMPTY_QUEUE)
+        {
+            return result;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    }
+
+    struct timespec deadline = now;
+    deadline.tv_sec += parkMilliseconds / 1000;
+    deadline.tv_nsec += (parkMilliseconds % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&queue->lock);
+    if (!bulkWaiting(queue) && queue->controlFront == NULL)
+    {
+        // A spurious or timed out wake-up just returns EMPTY_QUEUE, callers loop anyway
+        pthread_cond_timedwait(&queue->cond, &queue->lock, &deadline);
+    }
+    int result = removeFront(queue, msgOut);
+    pthread_mutex_unlock(&queue->lock);
+    return result;
 }
 
 
 /*
  * Function:    freeQueue
- * Description: Frees the memory associated with a message queue.
+ * Description: Frees the memory associated with a message queue, including the bodies of messages still queued.
  * Parameters:  MessageQueue* queue: Pointer to the message queue structure.
  * Returns:     void
  */
@@ -95,17 +526,42 @@ void freeQueue(MessageQueue* queue)
 {
     pthread_mutex_lock(&queue->lock);
 
-    QueueNode* current = queue->front;
-    while (current != NULL) 
-	{
-        QueueNode* temp = current;
-        current = current->next;
-        
-        free(temp); // Free the node itself
+    QueueNode* lanes[] = { queue->front, queue->controlFront };
+    for (size_t lane = 0; lane < sizeof(lanes) / sizeof(lanes[0]); lane++)
+    {
+        QueueNode* current = lanes[lane];
+        while (current != NULL) 
+        {
+            QueueNode* temp = current;
+            current = current->next;
+            
+            releaseMessage(&temp->message);
+            free(temp); // Free the node itself
+        }
+    }
+
+    for (int flow = 0; flow < queue->flowCount; flow++)
+    {
+        QueueNode* current = queue->flows[flow].front;
+        while (current != NULL)
+        {
+            QueueNode* temp = current;
+            current = current->next;
+
+            releaseMessage(&temp->message);
+            free(temp);
+        }
     }
+    free(queue->flows);
 
     queue->front = NULL;
     queue->rear = NULL;
+    queue->controlFront = NULL;
+    queue->controlRear = NULL;
+    queue->flows = NULL;
+    queue->flowCount = 0;
+    queue->activeHead = queue->activeTail = -1;
+    atomic_store(&queue->length, 0);
     pthread_mutex_unlock(&queue->lock);
 
     // Destroy the mutex and condition variable
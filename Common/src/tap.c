@@ -0,0 +1,191 @@
+/*
+ * Filename:    tap.c
+ * Project:     CanWeTalkSystem
+ * By:          Salman Nouman, Minchul Hwang, Md Saiful Islam, Saje-Antoine Rose
+ * Date:        October, 19, 2026
+ * Description: This file contains the reading side of the broadcast tap. A reader maps the ring by its name, looks at
+ *              each message where the server wrote it and checks afterwards that the slot was not rewritten in the
+ *              meantime. A reader with nothing left to read sleeps on a futex in the shared memory, which the server
+ *              only wakes when a reader said it is sleeping, so readers that keep up cost the server nothing.
+ */
+
+#include "../inc/tap.h"
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+/*
+ * Function:    tapMappingLength
+ * Description: This function returns the size of a ring's shared memory object.
+ * Parameters:  uint32_t slotCount: Its number of slots
+ * Returns:     size_t: The bytes of the header and the slots
+ */
+size_t tapMappingLength(uint32_t slotCount)
+{
+    return sizeof(TapHeader) + (size_t)slotCount * sizeof(TapSlot);
+}
+
+/*
+ * Function:    tapSlotAt
+ * Description: This function returns the slot a ring position is written to.
+ * Parameters:  TapHeader* header: The mapped ring
+ *              uint64_t position: The ring position
+ * Returns:     TapSlot*: Its slot
+ */
+TapSlot* tapSlotAt(TapHeader* header, uint64_t position)
+{
+    return (TapSlot*)((char*)(header + 1) + (position & (header->slotCount - 1)) * header->slotSize);
+}
+
+/*
+ * Function:    tapAttach
+ * Description: This function maps the ring the server created under a name. It is mapped writable because a reader
+ *              that goes to sleep counts itself among the waiters.
+ * Parameters:  TapReader* reader: Receives the mapping and the starting position
+ *              const char* name: The name given to the server with -tap<NAME>
+ *              bool fromOldest: Start at the oldest message still in the ring rather than at the next one published
+ * Returns:     int: TAP_SUCCESS, or TAP_FAILURE if there is no open ring of this version under the name
+ */
+int tapAttach(TapReader* reader, const char* name, bool fromOldest)
+{
+    struct stat status;
+    int fd = shm_open(name, O_RDWR | O_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        return TAP_FAILURE;
+    }
+    if (fstat(fd, &status) < 0 || (size_t)status.st_size < sizeof(TapHeader))
+    {
+        close(fd);
+        return TAP_FAILURE;
+    }
+
+    TapHeader* header = mmap(NULL, status.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (header == MAP_FAILED)
+    {
+        return TAP_FAILURE;
+    }
+    // The server writes the magic last, a ring it is still setting up is not attached to, nor one a predecessor
+    // closed while its successor has not replaced it under the name yet
+    if (atomic_load_explicit((_Atomic uint32_t*)&header->magic, memory_order_acquire) != TAP_MAGIC ||
+        header->version != TAP_VERSION || header->slotSize != sizeof(TapSlot) ||
+        tapMappingLength(header->slotCount) > (size_t)status.st_size || atomic_load(&header->closed))
+    {
+        munmap(header, status.st_size);
+        return TAP_FAILURE;
+    }
+
+    uint64_t published = atomic_load(&header->published);
+    reader->header = header;
+    reader->mappedLength = status.st_size;
+    reader->lost = 0;
+    reader->next = published + 1;
+    if (fromOldest)
+    {
+        reader->next = published >= header->slotCount ? published - header->slotCount + 1 : 1;
+    }
+    return TAP_SUCCESS;
+}
+
+/*
+ * Function:    tapPeek
+ * Description: This function returns the next message without copying it. Messages the server overwrote before the
+ *              reader got to them are skipped and counted as lost. The message may still be overwritten while the
+ *              caller looks at it, which tapConsume tells afterwards.
+ * Parameters:  TapReader* reader: The reader
+ * Returns:     const TapSlot*: The slot holding the next message, NULL if none was published yet
+ */
+const TapSlot* tapPeek(TapReader* reader)
+{
+    TapHeader* header = reader->header;
+    while (true)
+    {
+        uint64_t published = atomic_load_explicit(&header->published, memory_order_acquire);
+        if (reader->next > published)
+        {
+            return NULL;
+        }
+        if (published - reader->next >= header->slotCount)
+        {
+            // Lapped: the oldest message still in the ring is the one a ring behind the newest
+            reader->lost += published - header->slotCount + 1 - reader->next;
+            reader->next = published - header->slotCount + 1;
+        }
+
+        const TapSlot* slot = tapSlotAt(header, reader->next);
+        if (atomic_load_explicit(&slot->position, memory_order_acquire) == reader->next)
+        {
+            return slot;
+        }
+        // Being rewritten with a newer message already
+        reader->lost++;
+        reader->next++;
+    }
+}
+
+/*
+ * Function:    tapConsume
+ * Description: This function moves past the message tapPeek returned and tells whether it was intact all along.
+ * Parameters:  TapReader* reader: The reader
+ *              const TapSlot* slot: What tapPeek returned
+ * Returns:     bool: false if the server rewrote the slot meanwhile, whatever was read from it must be discarded
+ */
+bool tapConsume(TapReader* reader, const TapSlot* slot)
+{
+    atomic_thread_fence(memory_order_acquire);
+    bool intact = atomic_load_explicit(&slot->position, memory_order_relaxed) == reader->next;
+    if (!intact)
+    {
+        reader->lost++;
+    }
+    reader->next++;
+    return intact;
+}
+
+/*
+ * Function:    tapWait
+ * Description: This function sleeps until the next message is published or the ring is closed. The reader counts
+ *              itself a waiter before it looks at the published position a last time, so the server either sees the
+ *              waiter and wakes it or published early enough for the reader to see the message and not sleep.
+ * Parameters:  TapReader* reader: The reader
+ *              int timeoutMilliseconds: How long to sleep at most, TAP_WAIT_FOREVER for no limit
+ * Returns:     int: TAP_READY, TAP_TIMEOUT or TAP_CLOSED
+ */
+int tapWait(TapReader* reader, int timeoutMilliseconds)
+{
+    TapHeader* header = reader->header;
+
+    atomic_fetch_add(&header->waiters, 1);
+    uint32_t word = atomic_load(&header->wakeups);
+    if (atomic_load(&header->published) < reader->next && !atomic_load(&header->closed))
+    {
+        struct timespec timeout = { timeoutMilliseconds / 1000, (timeoutMilliseconds % 1000) * 1000000L };
+        syscall(SYS_futex, (uint32_t*)&header->wakeups, FUTEX_WAIT, word,
+                timeoutMilliseconds < 0 ? NULL : &timeout, NULL, 0);
+    }
+    atomic_fetch_sub(&header->waiters, 1);
+
+    if (atomic_load(&header->published) >= reader->next)
+    {
+        return TAP_READY;
+    }
+    return atomic_load(&header->closed) ? TAP_CLOSED : TAP_TIMEOUT;
+}
+
+/*
+ * Function:    tapDetach
+ * Description: This function unmaps the ring.
+ * Parameters:  TapReader* reader: The reader
+ * Returns:     void
+ */
+void tapDetach(TapReader* reader)
+{
+    if (reader->header != NULL)
+    {
+        munmap(reader->header, reader->mappedLength);
+        reader->header = NULL;
+    }
+}
@@ -0,0 +1,464 @@
+/*
+ * Filename:    transport.c
+ * Project:     CanWeTalkSystem
+ * By:          Salman Nouman, Minchul Hwang, Md Saiful Islam, Saje-Antoine Rose
+ * Date:        October, 19, 2026
+ * Description: This file contains the socket transport. Plain connections use send/recv directly. TLS connections
+ *              are handshaken with OpenSSL and then, when the kernel supports it, have their record encryption
+ *              offloaded to kTLS so that sending stays a plain send() on the descriptor; otherwise every byte goes
+ *              through OpenSSL in user space. Sessions are looked up by descriptor so callers only pass sockets.
+ */
+
+#include "../inc/transport.h"
+
+static SSL_CTX* tlsContext = NULL;
+static TransportSession** sessions = NULL;   // indexed by descriptor
+static int sessionCapacity = 0;
+
+/*
+ * Function:    lookupSession
+ * Description: This function returns the TLS session of a descriptor.
+ * Parameters:  int socketConnection: The socket file descriptor
+ * Returns:     TransportSession*: The session, or NULL for a plain connection
+ */
+static TransportSession* lookupSession(int socketConnection)
+{
+    if (sessions == NULL || socketConnection < 0 || socketConnection >= sessionCapacity)
+    {
+        return NULL;
+    }
+    return sessions[socketConnection];
+}
+
+/*
+ * Function:    waitForSocket
+ * Description: This function waits until a socket is ready for the direction OpenSSL asked for.
+ * Parameters:  int socketConnection: The socket file descriptor
+ *              int sslError: SSL_ERROR_WANT_READ or SSL_ERROR_WANT_WRITE
+ *              int timeout: Milliseconds to wait, -1 for no limit
+ * Returns:     bool: true if the socket became ready
+ */
+static bool waitForSocket(int socketConnection, int sslError, int timeout)
+{
+    struct pollfd pollSocket = { socketConnection, sslError == SSL_ERROR_WANT_WRITE ? POLLOUT : POLLIN, 0 };
+    int ready;
+    do
+    {
+        ready = poll(&pollSocket, 1, timeout);
+    } while (ready < 0 && errno == EINTR);
+    return ready > 0;
+}
+
+/*
+ * Function:    transportInit
+ * Description: This function allocates the session table, one pointer per possible descriptor.
+ * Parameters:  void
+ * Returns:     int: TRANSPORT_SUCCESS or TRANSPORT_ERROR
+ */
+int transportInit(void)
+{
+    struct rlimit fileLimit;
+    if (getrlimit(RLIMIT_NOFILE, &fileLimit) < 0 || fileLimit.rlim_cur == RLIM_INFINITY)
+    {
+        fileLimit.rlim_cur = 65536;
+    }
+    sessionCapacity = (int)fileLimit.rlim_cur;
+    sessions = calloc(sessionCapacity, sizeof(TransportSession*));
+    return sessions == NULL ? TRANSPORT_ERROR : TRANSPORT_SUCCESS;
+}
+
+/*
+ * Function:    createContext
+ * Description: This function creates the OpenSSL context shared by every session, asking for kTLS.
+ * Parameters:  const SSL_METHOD* method: Client or server method
+ * Returns:     int: TRANSPORT_SUCCESS or TRANSPORT_ERROR
+ */
+static int createContext(const SSL_METHOD* method)
+{
+    tlsContext = SSL_CTX_new(method);
+    if (tlsContext == NULL)
+    {
+        ERR_print_errors_fp(stderr);
+        return TRANSPORT_ERROR;
+    }
+    SSL_CTX_set_min_proto_version(tlsContext, TLS1_2_VERSION);
+    // kTLS needs a cipher the kernel implements; AES-GCM is the common denominator
+    SSL_CTX_set_ciphersuites(tlsContext, "TLS_AES_128_GCM_SHA256:TLS_AES_256_GCM_SHA384");
+    SSL_CTX_set_cipher_list(tlsContext, "ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-GCM-SHA256:ECDHE-ECDSA-AES256-GCM-SHA384:ECDHE-RSA-AES256-GCM-SHA384");
+    SSL_CTX_set_options(tlsContext, SSL_OP_ENABLE_KTLS);
+    // Idle sessions give their record buffers back instead of keeping 34 KB each
+    SSL_CTX_set_mode(tlsContext, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER | SSL_MODE_RELEASE_BUFFERS);
+    return TRANSPORT_SUCCESS;
+}
+
+/*
+ * Function:    transportServerContext
+ * Description: This function prepares TLS for the server with its certificate chain and private key.
+ * Parameters:  const char* certFile: PEM certificate chain
+ *              const char* keyFile: PEM private key
+ * Returns:     int: TRANSPORT_SUCCESS or TRANSPORT_ERROR
+ */
+int transportServerContext(const char* certFile, const char* keyFile)
+{
+    if (createContext(TLS_server_method()) != TRANSPORT_SUCCESS)
+    {
+        return TRANSPORT_ERROR;
+    }
+    if (SSL_CTX_use_certificate_chain_file(tlsContext, certFile) != 1 ||
+        SSL_CTX_use_PrivateKey_file(tlsContext, keyFile, SSL_FILETYPE_PEM) != 1)
+    {
+        ERR_print_errors_fp(stderr);
+        return TRANSPORT_ERROR;
+    }
+    return TRANSPORT_SUCCESS;
+}
+
+/*
+ * Function:    transportClientContext
+ * Description: This function prepares TLS for the client.
+ * Parameters:  const char* caFile: PEM file of trusted CAs, NULL for the system store
+ *              bool verifyPeer: false accepts any server certificate (testing with self-signed certificates)
+ * Returns:     int: TRANSPORT_SUCCESS or TRANSPORT_ERROR
+ */
+int transportClientContext(const char* caFile, bool verifyPeer)
+{
+    if (createContext(TLS_client_method()) != TRANSPORT_SUCCESS)
+    {
+        return TRANSPORT_ERROR;
+    }
+    if ((caFile != NULL && SSL_CTX_load_verify_locations(tlsContext, caFile, NULL) != 1) ||
+        (caFile == NULL && SSL_CTX_set_default_verify_paths(tlsContext) != 1))
+    {
+        ERR_print_errors_fp(stderr);
+        return TRANSPORT_ERROR;
+    }
+    SSL_CTX_set_verify(tlsContext, verifyPeer ? SSL_VERIFY_PEER : SSL_VERIFY_NONE, NULL);
+    return TRANSPORT_SUCCESS;
+}
+
+/*
+ * Function:    transportExpectTls
+ * Description: This function marks a freshly accepted descriptor as TLS. Until its handshake completes anything
+ *              sent to it is dropped, exactly as if the client had connected a moment later.
+ * Parameters:  int socketConnection: The socket file descriptor
+ * Returns:     void
+ */
+void transportExpectTls(int socketConnection)
+{
+    if (socketConnection < 0 || socketConnection >= sessionCapacity)
+    {
+        return;
+    }
+    TransportSession* session = calloc(1, sizeof(TransportSession));
+    if (session == NULL)
+    {
+        return;
+    }
+    session->state = TRANSPORT_HANDSHAKING;
+    pthread_mutex_init(&session->lock, NULL);
+    sessions[socketConnection] = session;
+}
+
+/*
+ * Function:    finishHandshake
+ * Description: This function runs the handshake on a blocking socket, bounded by TRANSPORT_WAIT_MILLISECONDS of
+ *              silence, and then records whether kTLS took over.
+ *              Without kernel offload the socket is switched to non-blocking so that a reader waiting for data
+ *              never holds the session lock while a sender needs it.
+ * Parameters:  TransportSession* session: The session being established
+ *              int socketConnection: The socket file descriptor
+ *              const char* serverName: Name the client expects in the certificate (sent as SNI), NULL on the server
+ *              bool isServer: Which side of the handshake to run
+ * Returns:     int: TRANSPORT_SUCCESS or TRANSPORT_ERROR
+ */
+static int finishHandshake(TransportSession* session, int socketConnection, const char* serverName, bool isServer)
+{
+    session->ssl = SSL_new(tlsContext);
+    if (session->ssl == NULL || SSL_set_fd(session->ssl, socketConnection) != 1)
+    {
+        return TRANSPORT_ERROR;
+    }
+    struct in6_addr literal;
+    if (serverName != NULL && (inet_pton(AF_INET, serverName, &literal) == 1 || inet_pton(AF_INET6, serverName, &literal) == 1))
+    {
+        // An address is matched against the certificate's IP entries and is never sent as SNI
+        X509_VERIFY_PARAM_set1_ip_asc(SSL_get0_param(session->ssl), serverName);
+    }
+    else if (serverName != NULL)
+    {
+        SSL_set_tlsext_host_name(session->ssl, serverName);
+        SSL_set1_host(session->ssl, serverName);
+    }
+    // A peer that stalls the handshake must not hold its thread forever
+    struct timeval limit = { TRANSPORT_WAIT_MILLISECONDS / 1000, (TRANSPORT_WAIT_MILLISECONDS % 1000) * 1000 };
+    struct timeval noLimit = { 0, 0 };
+    setsockopt(socketConnection, SOL_SOCKET, SO_RCVTIMEO, &limit, sizeof(limit));
+    setsockopt(socketConnection, SOL_SOCKET, SO_SNDTIMEO, &limit, sizeof(limit));
+    int handshake = isServer ? SSL_accept(session->ssl) : SSL_connect(session->ssl);
+    setsockopt(socketConnection, SOL_SOCKET, SO_RCVTIMEO, &noLimit, sizeof(noLimit));
+    setsockopt(socketConnection, SOL_SOCKET, SO_SNDTIMEO, &noLimit, sizeof(noLimit));
+    if (handshake != 1)
+    {
+        ERR_print_errors_fp(stderr);
+        return TRANSPORT_ERROR;
+    }
+
+    session->kernelSend = BIO_get_ktls_send(SSL_get_wbio(session->ssl));
+    session->kernelRecv = BIO_get_ktls_recv(SSL_get_rbio(session->ssl));
+    if (session->kernelSend)
+    {
+        session->state = TRANSPORT_KERNEL_TLS;
+    }
+    else
+    {
+        int flags = fcntl(socketConnection, F_GETFL);
+        fcntl(socketConnection, F_SETFL, flags | O_NONBLOCK);
+        session->state = TRANSPORT_USERSPACE_TLS;
+    }
+    return TRANSPORT_SUCCESS;
+}
+
+/*
+ * Function:    transportAccept
+ * Description: This function performs the server side TLS handshake of a descriptor marked by transportExpectTls.
+ *              For any other descriptor there is nothing to do.
+ * Parameters:  int socketConnection: The socket file descriptor
+ * Returns:     int: TRANSPORT_SUCCESS or TRANSPORT_ERROR
+ */
+int transportAccept(int socketConnection)
+{
+    TransportSession* session = lookupSession(socketConnection);
+    if (session == NULL)
+    {
+        return TRANSPORT_SUCCESS; // plain connection, nothing to negotiate
+    }
+    if (tlsContext == NULL)
+    {
+        return TRANSPORT_ERROR;
+    }
+    return finishHandshake(session, socketConnection, NULL, true);
+}
+
+/*
+ * Function:    transportConnect
+ * Description: This function performs the client side TLS handshake on a connected socket.
+ * Parameters:  int socketConnection: The socket file descriptor
+ *              const char* serverName: Name checked against the certificate and sent as SNI, may be NULL
+ * Returns:     int: TRANSPORT_SUCCESS or TRANSPORT_ERROR
+ */
+int transportConnect(int socketConnection, const char* serverName)
+{
+    if (tlsContext == NULL)
+    {
+        return TRANSPORT_ERROR;
+    }
+    transportExpectTls(socketConnection);
+    TransportSession* session = lookupSession(socketConnection);
+    if (session == NULL)
+    {
+        return TRANSPORT_ERROR;
+    }
+    if (finishHandshake(session, socketConnection, serverName, false) != TRANSPORT_SUCCESS)
+    {
+        transportClose(socketConnection);
+        return TRANSPORT_ERROR;
+    }
+    return TRANSPORT_SUCCESS;
+}
+
+/*
+ * Function:    transportSend
+ * Description: This function sends a whole buffer. Plain and kTLS connections use send() on the descriptor, user space
+ *              TLS goes through SSL_write. With MSG_DONTWAIT a plain or kTLS send returns what fit without waiting,
+ *              and a user space TLS send that would have to wait fails.
+ * Parameters:  int socketConnection: The socket file descriptor
+ *              const void* buffer: The bytes to send
+ *              size_t length: Number of bytes
+ *              int flags: 0 or MSG_DONTWAIT
+ * Returns:     ssize_t: Bytes sent, or -1 on failure
+ */
+ssize_t transportSend(int socketConnection, const void* buffer, size_t length, int flags)
+{
+    TransportSession* session = lookupSession(socketConnection);
+    size_t sent = 0;
+
+    if (session != NULL && session->state == TRANSPORT_HANDSHAKING)
+    {
+        return length;
+    }
+
+    if (session == NULL || session->state == TRANSPORT_KERNEL_TLS)
+    {
+        while (sent < length)
+        {
+            ssize_t written = send(socketConnection, (const char*)buffer + sent, length - sent, flags | MSG_NOSIGNAL);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                if ((errno == EAGAIN || errno == EWOULDBLOCK) && (flags & MSG_DONTWAIT))
+                {
+                    return sent;
+                }
+                return -1;
+            }
+            sent += written;
+        }
+        return sent;
+    }
+
+    // User space TLS: SSL_write without partial writes either sends everything or asks to be retried
+    pthread_mutex_lock(&session->lock);
+    int result;
+    while ((result = SSL_write(session->ssl, buffer, length)) <= 0)
+    {
+        int sslError = SSL_get_error(session->ssl, result);
+        if (sslError != SSL_ERROR_WANT_WRITE && sslError != SSL_ERROR_WANT_READ)
+        {
+            pthread_mutex_unlock(&session->lock);
+            return -1;
+        }
+        pthread_mutex_unlock(&session->lock);
+        // A record may be half written here, so a non-blocking caller that gives up must drop the connection
+        if (!waitForSocket(socketConnection, sslError, (flags & MSG_DONTWAIT) ? 0 : TRANSPORT_WAIT_MILLISECONDS))
+        {
+            return -1;
+        }
+        pthread_mutex_lock(&session->lock);
+    }
+    pthread_mutex_unlock(&session->lock);
+    return length;
+}
+
+/*
+ * Function:    transportRecvAll
+ * Description: This function receives exactly length bytes, waiting as long as it takes.
+ * Parameters:  int socketConnection: The socket file descriptor
+ *              void* buffer: Receives the bytes
+ *              size_t length: Number of bytes
+ * Returns:     ssize_t: length, 0 if the peer closed, or -1 on failure
+ */
+ssize_t transportRecvAll(int socketConnection, void* buffer, size_t length)
+{
+    TransportSession* session = lookupSession(socketConnection);
+    size_t received = 0;
+
+    if (session == NULL)
+    {
+        while (received < length)
+        {
+            ssize_t count = recv(socketConnection, (char*)buffer + received, length - received, MSG_WAITALL);
+            if (count < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (count <= 0)
+            {
+                return count;
+            }
+            received += count;
+        }
+        return received;
+    }
+    if (session->state == TRANSPORT_HANDSHAKING)
+    {
+        return -1;
+    }
+
+    // Only the connection's reader calls this, senders in kTLS mode never touch the SSL object
+    bool locking = session->state == TRANSPORT_USERSPACE_TLS;
+    while (received < length)
+    {
+        if (locking)
+        {
+            pthread_mutex_lock(&session->lock);
+        }
+        int count = SSL_read(session->ssl, (char*)buffer + received, length - received);
+        int sslError = count > 0 ? SSL_ERROR_NONE : SSL_get_error(session->ssl, count);
+        if (locking)
+        {
+            pthread_mutex_unlock(&session->lock);
+        }
+
+        if (count > 0)
+        {
+            received += count;
+        }
+        else if (sslError == SSL_ERROR_WANT_READ || sslError == SSL_ERROR_WANT_WRITE)
+        {
+            waitForSocket(socketConnection, sslError, -1);
+        }
+        else
+        {
+            return sslError == SSL_ERROR_ZERO_RETURN ? 0 : -1;
+        }
+    }
+    return received;
+}
+
+/*
+ * Function:    transportPending
+ * Description: This function tells whether decrypted bytes are already buffered, in which case the socket itself may
+ *              never become readable again for them and the caller must not wait on it.
+ * Parameters:  int socketConnection: The socket file descriptor
+ * Returns:     bool: true if a read would not block
+ */
+bool transportPending(int socketConnection)
+{
+    TransportSession* session = lookupSession(socketConnection);
+    return session != NULL && session->ssl != NULL && SSL_pending(session->ssl) > 0;
+}
+
+/*
+ * Function:    transportHandoffSafe
+ * Description: This function tells whether a connection can be passed to another process as a bare descriptor.
+ *              That holds for plain TCP and for TLS with both directions offloaded to the kernel.
+ * Parameters:  int socketConnection: The socket file descriptor
+ * Returns:     bool: true if the descriptor carries no user space state
+ */
+bool transportHandoffSafe(int socketConnection)
+{
+    TransportSession* session = lookupSession(socketConnection);
+    return session == NULL || (session->kernelSend && session->kernelRecv && SSL_pending(session->ssl) == 0);
+}
+
+/*
+ * Function:    transportDescribe
+ * Description: This function names the transport of a connection for logging.
+ * Parameters:  int socketConnection: The socket file descriptor
+ * Returns:     const char*: "plain", "kTLS" or "TLS"
+ */
+const char* transportDescribe(int socketConnection)
+{
+    TransportSession* session = lookupSession(socketConnection);
+    if (session == NULL)
+    {
+        return "plain";
+    }
+    return session->state == TRANSPORT_KERNEL_TLS ? "kTLS" : "TLS";
+}
+
+/*
+ * Function:    transportClose
+ * Description: This function frees the TLS session of a descriptor. The descriptor itself is left to the caller.
+ *              Callers must make sure no other thread can still send on it.
+ * Parameters:  int socketConnection: The socket file descriptor
+ * Returns:     void
+ */
+void transportClose(int socketConnection)
+{
+    TransportSession* session = lookupSession(socketConnection);
+    if (session == NULL)
+    {
+        return;
+    }
+    sessions[socketConnection] = NULL;
+    if (session->ssl != NULL)
+    {
+        SSL_free(session->ssl);
+    }
+    pthread_mutex_destroy(&session->lock);
+    free(session);
+}
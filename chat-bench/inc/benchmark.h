@@ -0,0 +1,141 @@
+/*
+ * Filename:    benchmark.h
+ * Project:     CanWeTalkSystem
+ * By:          Salman Nouman, Minchul Hwang, Md Saiful Islam, Saje-Antoine Rose
+ * Date:        October, 19, 2026
+ * Description: This file contains the defined values, dependencies and function prototypes of chat-bench, a load
+ *              generator that measures how fast the chat-server fans messages out to its connected clients and to
+ *              the readers of its broadcast tap
+ */
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
+#include <limits.h>
+#include "../../Common/inc/message.h"
+#include "../../Common/inc/durability.h"
+#include "../../Common/inc/tap.h"
+#include <sys/un.h>
+#include <netdb.h>
+#include <netinet/tcp.h>
+
+#define BENCH_PARSING_ERROR -1
+#define BENCH_PARSING_SUCCESS 0
+
+#define PORT_NUMBER 8989
+#define TLS_PORT_NUMBER 8990
+#define UNIX_SERVER_PREFIX "unix:"
+#define DEFAULT_BENCH_CLIENTS 8
+#define DEFAULT_BENCH_MESSAGES 2000
+#define BENCH_USER_NAME "bench"
+#define BENCH_PAYLOAD "0123456789012345678901234567890123456789"  // one full parcel
+#define BENCH_WARMUP_PAYLOAD ">>warmup<<"
+#define BENCH_HEARTBEAT_REQUEST ">>ping<<"
+#define BENCH_PROBE_PREFIX "probe "            // latency probes carry their sequence number after this
+#define BENCH_IDLE_SECONDS 10              // a run gives up after this long without a delivery
+#define BENCH_WARMUP_INTERVAL_MICROSECONDS 100000
+#define BENCH_POLL_MICROSECONDS 10000
+#define BENCH_DURABLE_WINDOW 64            // messages a connection has sent but not seen acknowledged in a durable run
+#define BENCH_SERVER_BUSY ">>busy<<"
+#define DEFAULT_BENCH_TAP_READERS 1
+
+// Structure to store parsed command-line arguments of the benchmark
+typedef struct BenchArgs
+{
+    char* serverIP;
+    char* unixPath;         // set by -server unix:/path instead of an IP address
+    int clients;            // receiving connections, the first one also sends
+    int messages;           // messages sent during the measured run
+    bool useTls;
+    bool compare;           // run plaintext first, then TLS, and print the ratio
+    bool latency;           // measure round trips one message at a time instead of throughput
+    bool durable;           // every connection sends and counts the server's write-ahead log acks
+    char* tapName;          // shared memory ring of the server read alongside the connections, NULL reads none
+    int tapReaders;         // readers of the ring, each with a mapping and a position of its own
+} BenchArgs;
+
+// State of one receiving connection
+typedef struct BenchReceiver
+{
+    int socketConnection;
+    pthread_t thread;
+    atomic_bool warmedUp;           // saw at least one warm-up message
+    atomic_int delivered;           // measured messages received
+    int expected;
+    struct timespec finished;       // when the latest measured message arrived
+} BenchReceiver;
+
+// State of one reader of the server's broadcast tap
+typedef struct BenchTapReader
+{
+    TapReader tap;
+    pthread_t thread;
+    atomic_int read;                // measured messages read intact
+    atomic_bool stopping;
+    int expected;
+    struct timespec finished;       // when the latest measured message was read
+} BenchTapReader;
+
+// State of one connection of a durable run, which sends and waits for its acks itself
+typedef struct DurableSender
+{
+    int socketConnection;
+    pthread_t thread;
+    int messages;                   // messages it sends
+    int acknowledged;               // of those, reported durable by the server
+    int refused;                    // of those, refused with >>busy<< instead
+    struct timespec* sentAt;        // when each message went out
+    double* ackLatencies;           // microseconds from sending each acknowledged message to its ack
+    struct timespec finished;       // when the last ack or refusal arrived
+} DurableSender;
+
+// Outcome of one run
+typedef struct BenchResult
+{
+    long deliveries;
+    double seconds;
+    double bytes;
+    const char* transport;
+    int tapReaders;
+    long tapRead;                   // measured messages the tap readers read, all of them together
+    long tapLost;                   // messages overwritten before a tap reader got to them
+    double tapSeconds;              // until the slowest tap reader read its last measured message
+} BenchResult;
+
+// Round trip times of a latency run, in microseconds
+typedef struct LatencyResult
+{
+    int samples;
+    double minimum;
+    double median;
+    double p99;
+    double maximum;
+    const char* transport;
+} LatencyResult;
+
+// Outcome of a durable run
+typedef struct DurableResult
+{
+    long acknowledged;
+    long refused;
+    double seconds;
+    double median;                  // ack latency, microseconds
+    double p99;
+    char level[8];                  // the server's durability level, write or sync
+    long commitMicroseconds;        // the server's commit interval
+    const char* transport;
+} DurableResult;
+
+int parseBenchArgs(int argc, char* argv[], BenchArgs* benchArgs);
+int runBenchmark(const BenchArgs* benchArgs, bool useTls, BenchResult* result);
+void printBenchResult(const char* label, const BenchResult* result);
+int runLatencyBenchmark(const BenchArgs* benchArgs, bool useTls, LatencyResult* result);
+void printLatencyResult(const char* label, const LatencyResult* result);
+int runDurableBenchmark(const BenchArgs* benchArgs, bool useTls, DurableResult* result);
+void printDurableResult(const char* label, const DurableResult* result);
+
+#endif
@@ -0,0 +1,1033 @@
+/*
+ * Filename:    benchmark.c
+ * Project:     CanWeTalkSystem
+ * By:          Salman Nouman, Minchul Hwang, Md Saiful Islam, Saje-Antoine Rose
+ * Date:        October, 19, 2026
+ * Description: This file contains the benchmark itself. A number of receiving connections join the server, one of them
+ *              sends a burst of messages, and the time until every receiver has seen every message gives the fan-out
+ *              throughput. Warm-up messages are sent first so that no receiver is measured before the server has
+ *              finished setting it up (for TLS, before its handshake completed on the server side). The latency run
+ *              instead sends one probe at a time and times how long the server takes to echo it back to the sender.
+ *              The durable run has every connection send and counts the acks of the server's write-ahead log, which
+ *              shows what a commit interval costs in throughput and buys in flushes. With -tap<NAME> a fan-out
+ *              run also has readers of the server's broadcast tap count the measured messages in shared memory, which
+ *              shows that they get every message without slowing the connections down.
+ */
+
+#include "../inc/benchmark.h"
+
+/*
+ * Function:    displayBenchUsage
+ * Description: Displays the usage of the program
+ * Parameters:  void
+ * Returns:     void
+ */
+static void displayBenchUsage(void)
+{
+    printf("Usage: chat-bench -server<IPADDRESS> [-clients<N>] [-messages<N>] [-tls] [-compare] [-latency | -durable | -tap<NAME> [-tapreaders<N>]]\n");
+    printf("       chat-bench -server unix:<PATH> [-clients<N>] [-messages<N>] [-latency | -durable | -tap<NAME> [-tapreaders<N>]]\n");
+    printf("  -clients<N>   receiving connections, the server needs -maxclients of at least this (default %d)\n", DEFAULT_BENCH_CLIENTS);
+    printf("  -messages<N>  messages broadcast during the measured run (default %d)\n", DEFAULT_BENCH_MESSAGES);
+    printf("  -tls          connect to the TLS port\n");
+    printf("  -compare      run plaintext and then TLS and print both\n");
+    printf("  -latency      send one message at a time and report round trip percentiles instead of throughput\n");
+    printf("  -durable      every connection sends -messages<N>, at most %d unacknowledged, and counts the acks of a server\n", BENCH_DURABLE_WINDOW);
+    printf("                started with -wal<PATH>; reports acknowledged messages per second and the ack latency\n");
+    printf("  -tap<NAME>    also read the measured messages from the broadcast tap of a server started with -tap<NAME>\n");
+    printf("  -tapreaders<N> readers of the tap, each with its own mapping and position (default %d)\n", DEFAULT_BENCH_TAP_READERS);
+}
+
+/*
+ * Function:    parseCount
+ * Description: Parses an option of the form -name<N> into a positive integer.
+ * Parameters:  const char* arg: The command line argument
+ *              const char* name: The option name including the dash
+ *              int* value: Receives the number
+ * Returns:     bool: true if the argument is this option with a valid number
+ */
+static bool parseCount(const char* arg, const char* name, int* value)
+{
+    size_t nameLength = strlen(name);
+    char* end;
+
+    if (strncmp(arg, name, nameLength) != 0 || arg[nameLength] == '\0')
+    {
+        return false;
+    }
+    long parsed = strtol(arg + nameLength, &end, 10);
+    if (*end != '\0' || parsed <= 0 || parsed > 1000000)
+    {
+        return false;
+    }
+    *value = (int)parsed;
+    return true;
+}
+
+/*
+ * Function:    parseBenchArgs
+ * Description: Retrives the command line arguements of the benchmark and puts their values into a struct
+ * Parameters:  int argc: The number of arguments provided
+ *              char* argv[]: The arguments
+ *              BenchArgs* benchArgs: A struct to hold the parsed values
+ * Returns:     int: BENCH_PARSING_SUCCESS or BENCH_PARSING_ERROR
+ */
+int parseBenchArgs(int argc, char* argv[], BenchArgs* benchArgs)
+{
+    benchArgs->serverIP = NULL;
+    benchArgs->unixPath = NULL;
+    benchArgs->clients = DEFAULT_BENCH_CLIENTS;
+    benchArgs->messages = DEFAULT_BENCH_MESSAGES;
+    benchArgs->useTls = false;
+    benchArgs->compare = false;
+    benchArgs->latency = false;
+    benchArgs->durable = false;
+    benchArgs->tapName = NULL;
+    benchArgs->tapReaders = DEFAULT_BENCH_TAP_READERS;
+
+    for (int counter = 1; counter < argc; counter++)
+    {
+        if (strncmp(argv[counter], "-server", strlen("-server")) == 0)
+        {
+            char* serverArg = argv[counter] + strlen("-server");
+            if (*serverArg == '\0' && counter + 1 < argc)
+            {
+                serverArg = argv[++counter]; // value given as a separate argument: -server unix:/path
+            }
+            if (strncmp(serverArg, UNIX_SERVER_PREFIX, strlen(UNIX_SERVER_PREFIX)) == 0)
+            {
+                benchArgs->unixPath = serverArg + strlen(UNIX_SERVER_PREFIX);
+            }
+            else
+            {
+                benchArgs->serverIP = serverArg;
+            }
+        }
+        else if (strcmp(argv[counter], "-tls") == 0)
+        {
+            benchArgs->useTls = true;
+        }
+        else if (strcmp(argv[counter], "-compare") == 0)
+        {
+            benchArgs->compare = true;
+        }
+        else if (strcmp(argv[counter], "-latency") == 0)
+        {
+            benchArgs->latency = true;
+        }
+        else if (strcmp(argv[counter], "-durable") == 0)
+        {
+            benchArgs->durable = true;
+        }
+        else if (parseCount(argv[counter], "-clients", &benchArgs->clients) ||
+                 parseCount(argv[counter], "-messages", &benchArgs->messages) ||
+                 parseCount(argv[counter], "-tapreaders", &benchArgs->tapReaders))
+        {
+            // value already stored by parseCount, -tapreaders before -tap which would take it for a name
+        }
+        else if (strncmp(argv[counter], "-tap", strlen("-tap")) == 0 && argv[counter][strlen("-tap")] != '\0')
+        {
+            benchArgs->tapName = argv[counter] + strlen("-tap");
+        }
+        else
+        {
+            printf("Error: Invalid argument: %s\n", argv[counter]);
+            displayBenchUsage();
+            return BENCH_PARSING_ERROR;
+        }
+    }
+
+    if ((benchArgs->serverIP == NULL || *benchArgs->serverIP == '\0') && (benchArgs->unixPath == NULL || *benchArgs->unixPath == '\0'))
+    {
+        printf("Error: Please provide the server IP address or unix socket\n");
+        displayBenchUsage();
+        return BENCH_PARSING_ERROR;
+    }
+    if (benchArgs->unixPath != NULL && (benchArgs->useTls || benchArgs->compare))
+    {
+        printf("Error: TLS is only offered over TCP\n");
+        displayBenchUsage();
+        return BENCH_PARSING_ERROR;
+    }
+    if (benchArgs->durable && (benchArgs->latency || benchArgs->compare))
+    {
+        printf("Error: -durable runs on its own, without -latency or -compare\n");
+        displayBenchUsage();
+        return BENCH_PARSING_ERROR;
+    }
+    if (benchArgs->tapName != NULL && (benchArgs->latency || benchArgs->durable))
+    {
+        printf("Error: -tap is read during a fan-out run, not with -latency or -durable\n");
+        displayBenchUsage();
+        return BENCH_PARSING_ERROR;
+    }
+    return BENCH_PARSING_SUCCESS;
+}
+
+/*
+ * Function:    secondsBetween
+ * Description: Returns the time between two monotonic clock readings.
+ * Parameters:  const struct timespec* start: The earlier reading
+ *              const struct timespec* end: The later reading
+ * Returns:     double: Seconds
+ */
+static double secondsBetween(const struct timespec* start, const struct timespec* end)
+{
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/*
+ * Function:    openConnection
+ * Description: Connects to the server on the plain or TLS port, or on its unix socket, and completes the TLS
+ *              handshake if asked to. The benchmark does not verify the certificate, it only measures.
+ * Parameters:  const BenchArgs* benchArgs: The parsed options naming the server
+ *              bool useTls: Whether to use the TLS port
+ * Returns:     int: The socket descriptor or -1
+ */
+static int openConnection(const BenchArgs* benchArgs, bool useTls)
+{
+    if (benchArgs->unixPath != NULL)
+    {
+        struct sockaddr_un unixAddress;
+        int unixConnection = socket(AF_UNIX, SOCK_STREAM, 0);
+        memset(&unixAddress, 0, sizeof(unixAddress));
+        unixAddress.sun_family = AF_UNIX;
+        strncpy(unixAddress.sun_path, benchArgs->unixPath, sizeof(unixAddress.sun_path) - 1);
+        if (unixConnection < 0 || connect(unixConnection, (struct sockaddr*)&unixAddress, sizeof(unixAddress)) < 0)
+        {
+            perror("Connection failed");
+            if (unixConnection >= 0)
+            {
+                close(unixConnection);
+            }
+            return -1;
+        }
+        return unixConnection;
+    }
+
+    // The benchmark takes an IPv4 or IPv6 address literal, name resolution is not what it measures
+    struct addrinfo hints;
+    struct addrinfo* serverAddress = NULL;
+    char service[8];
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICHOST | AI_NUMERICSERV;
+    snprintf(service, sizeof(service), "%d", useTls ? TLS_PORT_NUMBER : PORT_NUMBER);
+    if (getaddrinfo(benchArgs->serverIP, service, &hints, &serverAddress) != 0)
+    {
+        fprintf(stderr, "Invalid address: %s\n", benchArgs->serverIP);
+        return -1;
+    }
+
+    int socketConnection = socket(serverAddress->ai_family, SOCK_STREAM, 0);
+    if (socketConnection < 0 || connect(socketConnection, serverAddress->ai_addr, serverAddress->ai_addrlen) < 0)
+    {
+        perror("Connection failed");
+        if (socketConnection >= 0)
+        {
+            close(socketConnection);
+        }
+        freeaddrinfo(serverAddress);
+        return -1;
+    }
+    freeaddrinfo(serverAddress);
+    if (useTls && transportConnect(socketConnection, NULL) != TRANSPORT_SUCCESS)
+    {
+        fprintf(stderr, "TLS handshake failed\n");
+        close(socketConnection);
+        return -1;
+    }
+    return socketConnection;
+}
+
+/*
+ * Function:    receiveBenchMessage
+ * Description: Reads one frame and deserializes it.
+ * Parameters:  int socketConnection: The connection to read from
+ *              Message* message: Receives the message, the caller releases it
+ * Returns:     bool: false if the connection failed or sent a malformed frame
+ */
+static bool receiveBenchMessage(int socketConnection, Message* message)
+{
+    char buffer[MAX_SERIALIZED_LENGTH + 1];
+    uint32_t msgLength;
+
+    if (transportRecvAll(socketConnection, &msgLength, sizeof(msgLength)) != sizeof(msgLength))
+    {
+        return false;
+    }
+    msgLength = ntohl(msgLength);
+    if (msgLength > MAX_SERIALIZED_LENGTH ||
+        (msgLength > 0 && transportRecvAll(socketConnection, buffer, msgLength) != (ssize_t)msgLength))
+    {
+        return false;
+    }
+    buffer[msgLength] = '\0';
+    deserializeMessage(message, buffer);
+    return true;
+}
+
+/*
+ * Function:    localAddressOf
+ * Description: Writes the local address of a connection as text, the way a client puts it into its messages.
+ * Parameters:  int socketConnection: The connection
+ *              char* ip: Receives the address, it keeps 127.0.0.1 for a unix socket
+ *              size_t size: The size of ip
+ * Returns:     void
+ */
+static void localAddressOf(int socketConnection, char* ip, size_t size)
+{
+    struct sockaddr_storage localAddress;
+    socklen_t addressLength = sizeof(localAddress);
+
+    snprintf(ip, size, "127.0.0.1");
+    getsockname(socketConnection, (struct sockaddr*)&localAddress, &addressLength);
+    if (localAddress.ss_family == AF_INET)
+    {
+        inet_ntop(AF_INET, &((struct sockaddr_in*)&localAddress)->sin_addr, ip, size);
+    }
+    else if (localAddress.ss_family == AF_INET6)
+    {
+        inet_ntop(AF_INET6, &((struct sockaddr_in6*)&localAddress)->sin6_addr, ip, size);
+    }
+}
+
+/*
+ * Function:    receiverThread
+ * Description: Reads frames until every measured message arrived or the connection is shut down. Heartbeats are
+ *              ignored; warm-up messages only mark the receiver as ready.
+ * Parameters:  void* arg: The BenchReceiver of this connection
+ * Returns:     void*: NULL
+ */
+static void* receiverThread(void* arg)
+{
+    BenchReceiver* receiver = (BenchReceiver*)arg;
+
+    while (atomic_load(&receiver->delivered) < receiver->expected)
+    {
+        Message message;
+        if (!receiveBenchMessage(receiver->socketConnection, &message))
+        {
+            break;
+        }
+        if (strcmp(messageBody(&message), BENCH_WARMUP_PAYLOAD) == 0)
+        {
+            atomic_store(&receiver->warmedUp, true);
+        }
+        else if (strcmp(messageBody(&message), BENCH_PAYLOAD) == 0)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &receiver->finished);
+            atomic_fetch_add(&receiver->delivered, 1);
+        }
+        releaseMessage(&message);
+    }
+    return NULL;
+}
+
+/*
+ * Function:    sendBenchMessage
+ * Description: Sends one chat message from the benchmark user.
+ * Parameters:  int socketConnection: The sending connection
+ *              const char* ip: The IP address written into the message
+ *              const char* text: The message text, at most one parcel long
+ * Returns:     int: SEND_SUCCESS or SEND_FAILURE
+ */
+static int sendBenchMessage(int socketConnection, const char* ip, const char* text)
+{
+    Message message;
+    initMessage(&message, ip, BENCH_USER_NAME);
+    setMessageBody(&message, text, strlen(text));
+    int result = sendParcelledMessage(&message, socketConnection);
+    releaseMessage(&message);
+    return result;
+}
+
+/*
+ * Function:    waitForDeliveries
+ * Description: Waits until every receiver got every measured message, or until deliveries stopped for
+ *              BENCH_IDLE_SECONDS, and then shuts the connections down so that all receivers return.
+ * Parameters:  BenchReceiver* receivers: The receivers of the run
+ *              int clients: Their number
+ * Returns:     void
+ */
+static void waitForDeliveries(BenchReceiver* receivers, int clients)
+{
+    long previous = -1;
+    struct timespec lastProgress;
+    clock_gettime(CLOCK_MONOTONIC, &lastProgress);
+
+    while (true)
+    {
+        long total = 0;
+        bool complete = true;
+        for (int i = 0; i < clients; i++)
+        {
+            int delivered = atomic_load(&receivers[i].delivered);
+            total += delivered;
+            complete = complete && delivered >= receivers[i].expected;
+        }
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (total != previous)
+        {
+            previous = total;
+            lastProgress = now;
+        }
+        if (complete || secondsBetween(&lastProgress, &now) > BENCH_IDLE_SECONDS)
+        {
+            break;
+        }
+        usleep(BENCH_POLL_MICROSECONDS);
+    }
+
+    for (int i = 0; i < clients; i++)
+    {
+        shutdown(receivers[i].socketConnection, SHUT_RDWR);
+        pthread_join(receivers[i].thread, NULL);
+    }
+}
+
+/*
+ * Function:    tapReaderThread
+ * Description: Reads the broadcast tap until every measured message was read or the run is over. Messages are looked
+ *              at where the server wrote them; one that was rewritten while it was looked at is not counted.
+ * Parameters:  void* arg: The BenchTapReader of this reader
+ * Returns:     void*: NULL
+ */
+static void* tapReaderThread(void* arg)
+{
+    BenchTapReader* reader = (BenchTapReader*)arg;
+    size_t payloadLength = strlen("|" BENCH_PAYLOAD);
+
+    while (atomic_load(&reader->read) < reader->expected && !atomic_load(&reader->stopping))
+    {
+        const TapSlot* slot = tapPeek(&reader->tap);
+        if (slot == NULL)
+        {
+            if (tapWait(&reader->tap, BENCH_POLL_MICROSECONDS / 1000) == TAP_CLOSED)
+            {
+                break;
+            }
+            continue;
+        }
+        // Only the body of a serialized message follows its last separator
+        bool measured = slot->length >= payloadLength &&
+                        memcmp(slot->message + slot->length - payloadLength, "|" BENCH_PAYLOAD, payloadLength) == 0;
+        if (tapConsume(&reader->tap, slot) && measured)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &reader->finished);
+            atomic_fetch_add(&reader->read, 1);
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Function:    startTapReaders
+ * Description: Attaches every tap reader to the ring at the next message to be published and starts its thread.
+ * Parameters:  const BenchArgs* benchArgs: The parsed options naming the ring
+ *              BenchTapReader* readers: The readers, benchArgs->tapReaders of them
+ * Returns:     int: The number of readers started, fewer than asked for if the ring could not be read
+ */
+static int startTapReaders(const BenchArgs* benchArgs, BenchTapReader* readers)
+{
+    int started = 0;
+    for (; started < benchArgs->tapReaders; started++)
+    {
+        BenchTapReader* reader = &readers[started];
+        reader->expected = benchArgs->messages;
+        if (tapAttach(&reader->tap, benchArgs->tapName, false) != TAP_SUCCESS)
+        {
+            fprintf(stderr, "No broadcast tap named %s, was the server started with -tap%s?\n", benchArgs->tapName,
+                    benchArgs->tapName);
+            break;
+        }
+        if (pthread_create(&reader->thread, NULL, tapReaderThread, reader) != 0)
+        {
+            tapDetach(&reader->tap);
+            break;
+        }
+    }
+    return started;
+}
+
+/*
+ * Function:    finishTapReaders
+ * Description: Waits until every tap reader read every measured message, or until reading stopped for
+ *              BENCH_IDLE_SECONDS, then stops the readers and adds what they read to the result.
+ * Parameters:  BenchTapReader* readers: The readers that were started
+ *              int count: Their number
+ *              const struct timespec* start: When the measured messages started going out, NULL if they never did
+ *                                            and the readers are stopped right away
+ *              BenchResult* result: Receives the tap counts
+ * Returns:     void
+ */
+static void finishTapReaders(BenchTapReader* readers, int count, const struct timespec* start, BenchResult* result)
+{
+    long previous = -1;
+    struct timespec lastProgress;
+    clock_gettime(CLOCK_MONOTONIC, &lastProgress);
+
+    while (start != NULL)
+    {
+        long total = 0;
+        bool complete = true;
+        for (int i = 0; i < count; i++)
+        {
+            total += atomic_load(&readers[i].read);
+            complete = complete && atomic_load(&readers[i].read) >= readers[i].expected;
+        }
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (total != previous)
+        {
+            previous = total;
+            lastProgress = now;
+        }
+        if (complete || secondsBetween(&lastProgress, &now) > BENCH_IDLE_SECONDS)
+        {
+            break;
+        }
+        usleep(BENCH_POLL_MICROSECONDS);
+    }
+
+    result->tapReaders = count;
+    result->tapRead = 0;
+    result->tapLost = 0;
+    result->tapSeconds = 0;
+    for (int i = 0; i < count; i++)
+    {
+        atomic_store(&readers[i].stopping, true);
+        pthread_join(readers[i].thread, NULL);
+        int read = atomic_load(&readers[i].read);
+        double elapsed = read > 0 && start != NULL ? secondsBetween(start, &readers[i].finished) : 0;
+        result->tapSeconds = elapsed > result->tapSeconds ? elapsed : result->tapSeconds;
+        result->tapRead += read;
+        result->tapLost += readers[i].tap.lost;
+        tapDetach(&readers[i].tap);
+    }
+}
+
+/*
+ * Function:    runBenchmark
+ * Description: Performs one measured run against the server.
+ * Parameters:  const BenchArgs* benchArgs: The parsed options
+ *              bool useTls: Whether this run uses the TLS port
+ *              BenchResult* result: Receives the measurements
+ * Returns:     int: 0 on success, -1 if the run could not be set up
+ */
+int runBenchmark(const BenchArgs* benchArgs, bool useTls, BenchResult* result)
+{
+    int clients = benchArgs->clients;
+    BenchReceiver* receivers = calloc(clients, sizeof(BenchReceiver));
+    BenchTapReader* tapReaders = NULL;
+    int started = 0;
+    int tapStarted = 0;
+    int status = -1;
+    bool ready = false;
+    struct timespec start;
+
+    if (receivers == NULL)
+    {
+        perror("malloc failed");
+        return -1;
+    }
+    result->tapReaders = 0;
+    // Attached before the warm-up, so that the readers are at the ring's end when the measured messages come
+    if (benchArgs->tapName != NULL)
+    {
+        tapReaders = calloc(benchArgs->tapReaders, sizeof(BenchTapReader));
+        tapStarted = tapReaders == NULL ? 0 : startTapReaders(benchArgs, tapReaders);
+    }
+    bool tapReady = benchArgs->tapName == NULL || tapStarted == benchArgs->tapReaders;
+
+    for (; tapReady && started < clients; started++)
+    {
+        BenchReceiver* receiver = &receivers[started];
+        receiver->socketConnection = openConnection(benchArgs, useTls);
+        receiver->expected = benchArgs->messages;
+        if (receiver->socketConnection < 0)
+        {
+            break;
+        }
+        if (pthread_create(&receiver->thread, NULL, receiverThread, receiver) != 0)
+        {
+            transportClose(receiver->socketConnection);
+            close(receiver->socketConnection);
+            break;
+        }
+    }
+
+    if (started == clients)
+    {
+        int sender = receivers[0].socketConnection;
+        char ip[INET6_ADDRSTRLEN];
+        localAddressOf(sender, ip, sizeof(ip));
+
+        // Until every receiver has seen a warm-up message the server may still be setting connections up
+        for (int attempt = 0; !ready && attempt < BENCH_IDLE_SECONDS * 10; attempt++)
+        {
+            sendBenchMessage(sender, ip, BENCH_WARMUP_PAYLOAD);
+            usleep(BENCH_WARMUP_INTERVAL_MICROSECONDS);
+            ready = true;
+            for (int i = 0; i < clients; i++)
+            {
+                ready = ready && atomic_load(&receivers[i].warmedUp);
+            }
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int i = 0; ready && i < benchArgs->messages; i++)
+        {
+            if (sendBenchMessage(sender, ip, BENCH_PAYLOAD) != SEND_SUCCESS)
+            {
+                break;
+            }
+        }
+
+        result->deliveries = 0;
+        result->seconds = 0;
+        result->transport = benchArgs->unixPath != NULL ? "unix" : transportDescribe(sender);
+        waitForDeliveries(receivers, clients);
+        for (int i = 0; i < clients; i++)
+        {
+            result->deliveries += atomic_load(&receivers[i].delivered);
+            double elapsed = atomic_load(&receivers[i].delivered) > 0 ? secondsBetween(&start, &receivers[i].finished) : 0;
+            result->seconds = elapsed > result->seconds ? elapsed : result->seconds;
+        }
+        // Every delivery is one length-prefixed frame of the serialized message
+        size_t frameBytes = sizeof(uint32_t) + strlen(ip) + strlen(BENCH_USER_NAME) + strlen(BENCH_PAYLOAD) + 2;
+        result->bytes = (double)result->deliveries * frameBytes;
+        status = ready ? 0 : -1;
+        if (!ready)
+        {
+            fprintf(stderr, "Not every receiver joined, is -maxclients on the server at least %d?\n", clients);
+        }
+    }
+    else
+    {
+        // Unblock the receivers that did start
+        for (int i = 0; i < started; i++)
+        {
+            shutdown(receivers[i].socketConnection, SHUT_RDWR);
+            pthread_join(receivers[i].thread, NULL);
+        }
+    }
+
+    if (tapReaders != NULL)
+    {
+        finishTapReaders(tapReaders, tapStarted, ready ? &start : NULL, result);
+        free(tapReaders);
+    }
+    for (int i = 0; i < started; i++)
+    {
+        transportClose(receivers[i].socketConnection);
+        close(receivers[i].socketConnection);
+    }
+    free(receivers);
+    return status;
+}
+
+/*
+ * Function:    printBenchResult
+ * Description: Prints the throughput of one run, and of its tap readers if it had any.
+ * Parameters:  const char* label: Name of the run
+ *              const BenchResult* result: Its measurements
+ * Returns:     void
+ */
+void printBenchResult(const char* label, const BenchResult* result)
+{
+    double seconds = result->seconds > 0 ? result->seconds : 1e-9;
+    printf("%-10s transport %-6s deliveries %ld in %.3f s: %.0f msg/s, %.2f MB/s\n", label, result->transport,
+           result->deliveries, result->seconds, result->deliveries / seconds, result->bytes / seconds / 1e6);
+    if (result->tapReaders > 0)
+    {
+        double tapSeconds = result->tapSeconds > 0 ? result->tapSeconds : 1e-9;
+        printf("%-10s tap readers %d read %ld in %.3f s: %.0f msg/s, %ld lost\n", label, result->tapReaders,
+               result->tapRead, result->tapSeconds, result->tapRead / tapSeconds, result->tapLost);
+    }
+}
+
+/*
+ * Function:    compareDoubles
+ * Description: Orders two round trip times for qsort.
+ * Parameters:  const void* left: The first time
+ *              const void* right: The second time
+ * Returns:     int: Negative, zero or positive like strcmp
+ */
+static int compareDoubles(const void* left, const void* right)
+{
+    double difference = *(const double*)left - *(const double*)right;
+    return (difference > 0) - (difference < 0);
+}
+
+/*
+ * Function:    awaitEcho
+ * Description: Reads frames on the probing connection until the server relays the given text back, skipping
+ *              heartbeats and anything else in between.
+ * Parameters:  int socketConnection: The probing connection
+ *              const char* text: The body to wait for
+ * Returns:     bool: false if the connection failed or BENCH_IDLE_SECONDS passed without a frame
+ */
+static bool awaitEcho(int socketConnection, const char* text)
+{
+    while (true)
+    {
+        Message message;
+        if (!receiveBenchMessage(socketConnection, &message))
+        {
+            return false;
+        }
+        bool echoed = strcmp(messageBody(&message), text) == 0;
+        releaseMessage(&message);
+        if (echoed)
+        {
+            return true;
+        }
+    }
+}
+
+/*
+ * Function:    runLatencyBenchmark
+ * Description: Measures the round trip of single messages: the first connection sends a probe and waits until the
+ *              server relays it back before it sends the next, so no probe ever queues behind another. The other
+ *              connections only receive, so every probe also pays for the fan-out to them.
+ * Parameters:  const BenchArgs* benchArgs: The parsed options, -messages gives the number of probes
+ *              bool useTls: Whether this run uses the TLS port
+ *              LatencyResult* result: Receives the percentiles
+ * Returns:     int: 0 on success, -1 if the run could not be set up or a probe was lost
+ */
+int runLatencyBenchmark(const BenchArgs* benchArgs, bool useTls, LatencyResult* result)
+{
+    int clients = benchArgs->clients;
+    BenchReceiver* receivers = calloc(clients, sizeof(BenchReceiver));
+    double* roundTrips = malloc(benchArgs->messages * sizeof(double));
+    int started = 0;
+    int status = -1;
+
+    if (receivers == NULL || roundTrips == NULL)
+    {
+        perror("malloc failed");
+        free(receivers);
+        free(roundTrips);
+        return -1;
+    }
+
+    for (; started < clients; started++)
+    {
+        BenchReceiver* receiver = &receivers[started];
+        receiver->socketConnection = openConnection(benchArgs, useTls);
+        receiver->expected = INT_MAX; // the bystanders run until they are shut down
+        if (receiver->socketConnection < 0)
+        {
+            break;
+        }
+        if (started > 0 && pthread_create(&receiver->thread, NULL, receiverThread, receiver) != 0)
+        {
+            transportClose(receiver->socketConnection);
+            close(receiver->socketConnection);
+            break;
+        }
+    }
+
+    if (started == clients)
+    {
+        int prober = receivers[0].socketConnection;
+        char ip[INET6_ADDRSTRLEN];
+        char probe[MAX_PARCEL_LENGTH];
+        struct timeval idle = { BENCH_IDLE_SECONDS, 0 };
+        localAddressOf(prober, ip, sizeof(ip));
+        setsockopt(prober, SOL_SOCKET, SO_RCVTIMEO, &idle, sizeof(idle));
+
+        // The first echo proves the server has set the connection up, and warms both sides' caches
+        bool ready = sendBenchMessage(prober, ip, BENCH_WARMUP_PAYLOAD) == SEND_SUCCESS &&
+                     awaitEcho(prober, BENCH_WARMUP_PAYLOAD);
+        int samples = 0;
+        for (; ready && samples < benchArgs->messages; samples++)
+        {
+            struct timespec sent;
+            struct timespec echoed;
+            snprintf(probe, sizeof(probe), BENCH_PROBE_PREFIX "%d", samples);
+            clock_gettime(CLOCK_MONOTONIC, &sent);
+            if (sendBenchMessage(prober, ip, probe) != SEND_SUCCESS || !awaitEcho(prober, probe))
+            {
+                break;
+            }
+            clock_gettime(CLOCK_MONOTONIC, &echoed);
+            roundTrips[samples] = secondsBetween(&sent, &echoed) * 1e6;
+        }
+
+        result->transport = benchArgs->unixPath != NULL ? "unix" : transportDescribe(prober);
+        result->samples = samples;
+        if (samples == benchArgs->messages)
+        {
+            qsort(roundTrips, samples, sizeof(double), compareDoubles);
+            result->minimum = roundTrips[0];
+            result->median = roundTrips[samples / 2];
+            result->p99 = roundTrips[(int)(samples * 0.99)];
+            result->maximum = roundTrips[samples - 1];
+            status = 0;
+        }
+        else
+        {
+            fprintf(stderr, "The server stopped echoing after %d probes\n", samples);
+        }
+    }
+
+    for (int i = 0; i < started; i++)
+    {
+        shutdown(receivers[i].socketConnection, SHUT_RDWR);
+        if (i > 0)
+        {
+            pthread_join(receivers[i].thread, NULL);
+        }
+        transportClose(receivers[i].socketConnection);
+        close(receivers[i].socketConnection);
+    }
+    free(receivers);
+    free(roundTrips);
+    return status;
+}
+
+/*
+ * Function:    printLatencyResult
+ * Description: Prints the round trip percentiles of one latency run.
+ * Parameters:  const char* label: Name of the run
+ *              const LatencyResult* result: Its measurements
+ * Returns:     void
+ */
+void printLatencyResult(const char* label, const LatencyResult* result)
+{
+    printf("%-10s transport %-6s round trips %d: min %.1f us, p50 %.1f us, p99 %.1f us, max %.1f us\n", label,
+           result->transport, result->samples, result->minimum, result->median, result->p99, result->maximum);
+}
+
+/*
+ * Function:    askForAcks
+ * Description: Asks the server to acknowledge the messages of a connection once they are durable and waits for the
+ *              answer, which names the server's durability level and commit interval.
+ * Parameters:  int socketConnection: The connection
+ *              DurableResult* result: Receives the level and interval
+ * Returns:     bool: false if the server keeps no write-ahead log or did not answer
+ */
+static bool askForAcks(int socketConnection, DurableResult* result)
+{
+    if (sendControlFrame(DURABLE_ACKS_REQUEST, socketConnection) != SEND_SUCCESS)
+    {
+        return false;
+    }
+    while (true)
+    {
+        Message message;
+        if (!receiveBenchMessage(socketConnection, &message))
+        {
+            return false;
+        }
+        const char* body = messageBody(&message);
+        bool answered = strcmp(body, DURABLE_ACKS_OFF) == 0 ||
+                        (strncmp(body, DURABLE_ACKS_ON_PREFIX, strlen(DURABLE_ACKS_ON_PREFIX)) == 0 &&
+                         sscanf(body + strlen(DURABLE_ACKS_ON_PREFIX), "%7s %ld", result->level, &result->commitMicroseconds) == 2);
+        bool acking = answered && strcmp(body, DURABLE_ACKS_OFF) != 0;
+        releaseMessage(&message);
+        if (answered)
+        {
+            return acking;
+        }
+    }
+}
+
+/*
+ * Function:    durableSenderThread
+ * Description: Sends the messages of one connection of a durable run, never more than BENCH_DURABLE_WINDOW ahead of
+ *              the acks, and reads frames until every message was acknowledged or refused. The server acknowledges a
+ *              connection's messages in the order they were sent, so the n of an ack are the oldest unacknowledged.
+ *              Broadcasts of everybody's messages arrive in between and are skipped.
+ * Parameters:  void* arg: The DurableSender of this connection
+ * Returns:     void*: NULL
+ */
+static void* durableSenderThread(void* arg)
+{
+    DurableSender* sender = (DurableSender*)arg;
+    char ip[INET6_ADDRSTRLEN];
+    int sent = 0;
+    localAddressOf(sender->socketConnection, ip, sizeof(ip));
+
+    while (sender->acknowledged + sender->refused < sender->messages)
+    {
+        while (sent < sender->messages && sent - sender->acknowledged - sender->refused < BENCH_DURABLE_WINDOW)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &sender->sentAt[sent]);
+            if (sendBenchMessage(sender->socketConnection, ip, BENCH_PAYLOAD) != SEND_SUCCESS)
+            {
+                return NULL;
+            }
+            sent++;
+        }
+
+        Message message;
+        if (!receiveBenchMessage(sender->socketConnection, &message))
+        {
+            break;
+        }
+        const char* body = messageBody(&message);
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (strncmp(body, DURABLE_ACK_PREFIX, strlen(DURABLE_ACK_PREFIX)) == 0)
+        {
+            int count = atoi(body + strlen(DURABLE_ACK_PREFIX));
+            for (int i = 0; i < count && sender->acknowledged + sender->refused < sent; i++)
+            {
+                int oldest = sender->acknowledged + sender->refused;
+                sender->ackLatencies[sender->acknowledged++] = secondsBetween(&sender->sentAt[oldest], &now) * 1e6;
+            }
+            sender->finished = now;
+        }
+        else if (strcmp(body, BENCH_SERVER_BUSY) == 0)
+        {
+            sender->refused++; // never logged, so never acknowledged
+            sender->finished = now;
+        }
+        releaseMessage(&message);
+    }
+    return NULL;
+}
+
+/*
+ * Function:    runDurableBenchmark
+ * Description: Measures how many messages per second the server makes durable: every connection asks for acks and
+ *              then sends -messages<N>. The server must have been started with -wal<PATH>; rerunning it with other
+ *              -commitinterval<US> values shows the throughput against the commit interval.
+ * Parameters:  const BenchArgs* benchArgs: The parsed options
+ *              bool useTls: Whether this run uses the TLS port
+ *              DurableResult* result: Receives the measurements
+ * Returns:     int: 0 on success, -1 if the run could not be set up
+ */
+int runDurableBenchmark(const BenchArgs* benchArgs, bool useTls, DurableResult* result)
+{
+    int clients = benchArgs->clients;
+    DurableSender* senders = calloc(clients, sizeof(DurableSender));
+    double* latencies = malloc((size_t)clients * benchArgs->messages * sizeof(double));
+    int opened = 0;
+    int started = 0;
+    int status = -1;
+
+    if (senders == NULL || latencies == NULL)
+    {
+        perror("malloc failed");
+        free(senders);
+        free(latencies);
+        return -1;
+    }
+
+    for (int i = 0; i < clients; i++)
+    {
+        senders[i].socketConnection = -1;
+    }
+    result->acknowledged = 0;
+    result->refused = 0;
+    result->seconds = 0;
+    result->median = 0;
+    result->p99 = 0;
+    bool acking = true;
+    for (; opened < clients && acking; opened++)
+    {
+        DurableSender* sender = &senders[opened];
+        struct timeval idle = { BENCH_IDLE_SECONDS, 0 };
+        int enable = 1;
+        sender->messages = benchArgs->messages;
+        sender->sentAt = malloc(benchArgs->messages * sizeof(struct timespec));
+        sender->ackLatencies = latencies + (size_t)opened * benchArgs->messages;
+        sender->socketConnection = openConnection(benchArgs, useTls);
+        if (sender->sentAt == NULL || sender->socketConnection < 0)
+        {
+            break;
+        }
+        setsockopt(sender->socketConnection, SOL_SOCKET, SO_RCVTIMEO, &idle, sizeof(idle));
+        setsockopt(sender->socketConnection, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable)); // a window of small frames
+        acking = askForAcks(sender->socketConnection, result);
+    }
+    if (!acking)
+    {
+        fprintf(stderr, "The server keeps no write-ahead log, start it with -wal<PATH>\n");
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (opened == clients && acking)
+    {
+        for (; started < clients; started++)
+        {
+            if (pthread_create(&senders[started].thread, NULL, durableSenderThread, &senders[started]) != 0)
+            {
+                break;
+            }
+        }
+        for (int i = 0; i < started; i++)
+        {
+            pthread_join(senders[i].thread, NULL);
+        }
+        status = started == clients ? 0 : -1;
+    }
+
+    long measured = 0;
+    for (int i = 0; i < started; i++)
+    {
+        result->refused += senders[i].refused;
+        if (senders[i].acknowledged > 0 || senders[i].refused > 0)
+        {
+            double elapsed = secondsBetween(&start, &senders[i].finished);
+            result->seconds = elapsed > result->seconds ? elapsed : result->seconds;
+        }
+        memmove(latencies + measured, senders[i].ackLatencies, senders[i].acknowledged * sizeof(double));
+        measured += senders[i].acknowledged;
+    }
+    result->acknowledged = measured;
+    if (measured > 0)
+    {
+        qsort(latencies, measured, sizeof(double), compareDoubles);
+        result->median = latencies[measured / 2];
+        result->p99 = latencies[(long)(measured * 0.99)];
+    }
+    if (status == 0 && result->acknowledged + result->refused < (long)clients * benchArgs->messages)
+    {
+        fprintf(stderr, "Only %ld of %ld messages were acknowledged\n", result->acknowledged, (long)clients * benchArgs->messages);
+        status = -1;
+    }
+    result->transport = benchArgs->unixPath != NULL ? "unix" :
+                        senders[0].socketConnection >= 0 ? transportDescribe(senders[0].socketConnection) : "none";
+
+    for (int i = 0; i < clients; i++)
+    {
+        if (senders[i].socketConnection >= 0)
+        {
+            shutdown(senders[i].socketConnection, SHUT_RDWR);
+            transportClose(senders[i].socketConnection);
+            close(senders[i].socketConnection);
+        }
+        free(senders[i].sentAt);
+    }
+    free(senders);
+    free(latencies);
+    return status;
+}
+
+/*
+ * Function:    printDurableResult
+ * Description: Prints the throughput and ack latency of a durable run.
+ * Parameters:  const char* label: Name of the run
+ *              const DurableResult* result: Its measurements
+ * Returns:     void
+ */
+void printDurableResult(const char* label, const DurableResult* result)
+{
+    double seconds = result->seconds > 0 ? result->seconds : 1e-9;
+    printf("%-10s transport %-6s durability %s, commit interval %ld us: acknowledged %ld in %.3f s: %.0f msg/s, "
+           "ack p50 %.1f us, p99 %.1f us", label, result->transport, result->level, result->commitMicroseconds,
+           result->acknowledged, result->seconds, result->acknowledged / seconds, result->median, result->p99);
+    if (result->refused > 0)
+    {
+        printf(", %ld refused busy", result->refused);
+    }
+    printf("\n");
+}
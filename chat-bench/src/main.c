@@ -0,0 +1,85 @@
+/*
+ * Filename:    main.c
+ * Project:     CanWeTalkSystem
+ * By:          Salman Nouman, Minchul Hwang, Md Saiful Islam, Saje-Antoine Rose
+ * Date:        October, 19, 2026
+ * Description: This file contains the main function of chat-bench, which measures the broadcast fan-out throughput,
+ *              the round trip latency or the durable throughput of a running chat-server over plaintext, TLS, or both
+ *              for comparison.
+ */
+
+#include "../inc/benchmark.h"
+
+int main(int argc, char* argv[])
+{
+    BenchArgs benchArgs;
+    if (parseBenchArgs(argc, argv, &benchArgs) != BENCH_PARSING_SUCCESS)
+    {
+        return EXIT_FAILURE;
+    }
+
+    bool needTls = benchArgs.useTls || benchArgs.compare;
+    if (transportInit() != TRANSPORT_SUCCESS || (needTls && transportClientContext(NULL, false) != TRANSPORT_SUCCESS))
+    {
+        fprintf(stderr, "Unable to set up the transport\n");
+        return EXIT_FAILURE;
+    }
+
+    if (benchArgs.durable)
+    {
+        DurableResult durable;
+        if (runDurableBenchmark(&benchArgs, benchArgs.useTls, &durable) != 0)
+        {
+            return EXIT_FAILURE;
+        }
+        printDurableResult(benchArgs.useTls ? "tls" : "plaintext", &durable);
+        return EXIT_SUCCESS;
+    }
+
+    if (benchArgs.latency)
+    {
+        LatencyResult latency;
+        if (!benchArgs.useTls || benchArgs.compare)
+        {
+            if (runLatencyBenchmark(&benchArgs, false, &latency) != 0)
+            {
+                return EXIT_FAILURE;
+            }
+            printLatencyResult("plaintext", &latency);
+        }
+        if (needTls)
+        {
+            if (runLatencyBenchmark(&benchArgs, true, &latency) != 0)
+            {
+                return EXIT_FAILURE;
+            }
+            printLatencyResult("tls", &latency);
+        }
+        return EXIT_SUCCESS;
+    }
+
+    BenchResult plain;
+    BenchResult encrypted;
+    if (!benchArgs.useTls || benchArgs.compare)
+    {
+        if (runBenchmark(&benchArgs, false, &plain) != 0)
+        {
+            return EXIT_FAILURE;
+        }
+        printBenchResult("plaintext", &plain);
+    }
+    if (needTls)
+    {
+        if (runBenchmark(&benchArgs, true, &encrypted) != 0)
+        {
+            return EXIT_FAILURE;
+        }
+        printBenchResult("tls", &encrypted);
+    }
+    if (benchArgs.compare && plain.seconds > 0 && encrypted.seconds > 0)
+    {
+        printf("TLS fan-out runs at %.1f%% of plaintext throughput\n",
+               100.0 * (encrypted.deliveries / encrypted.seconds) / (plain.deliveries / plain.seconds));
+    }
+    return EXIT_SUCCESS;
+}
@@ -12,8 +12,15 @@
 #include "ui.h"
 #include "../../Common/inc/queue.h"
 
+#define HEARTBEAT_REQUEST ">>ping<<"
+#define HEARTBEAT_REPLY ">>pong<<"
+#define SERVER_BUSY_NOTICE "Server busy, a message was not delivered"
+#define SERVER_CONTROL_IP "0.0.0.0"	// sender address of the frames the server sends on its own behalf
+#define NOTICE_USER_NAME "*"			// notices from the client itself are shown as coming from the server
+
 // Global Mutexes for UI resources here
 extern pthread_mutex_t listenerMutex;
+extern pthread_mutex_t sendMutex; // Keeps heartbeat replies from interleaving with typed messages
 extern int terminateListener;
 
 // structs here
@@ -21,12 +28,17 @@ typedef struct ThreadArgs
 {
 	WINDOW* window;
 	int serverSocket;
-	MessageQueue* queue;
+	MessageQueue* queue;		// messages for the UI thread, the sender posts its local notices to it too
 	char* ip;
 	char* userName;
+	bool multicast;				// ask the server for multicast delivery
+	char* multicastInterface;	// address of the interface to join the group on, NULL for any
+	bool nameTaken;				// the server turned the user name away, another connection holds it
 } ThreadArgs;
 
 void *listenerThread(void *threadArgs);
+int sendControl(ThreadArgs *args, const char* request);
+void deliverSequenced(MessageQueue* queue, uint64_t sequence, const char* serializedMessage);
 void *senderThread(void *threadArgs);
 
 
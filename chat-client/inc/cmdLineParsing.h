@@ -25,6 +25,7 @@
 
 #define ASCII_DIGIT_START '0'
 #define ASCII_DIGIT_END '9'
+#define UNIX_SERVER_PREFIX "unix:"
 
 // Structure to store parsed command-line arguments
 typedef struct 
@@ -32,6 +33,14 @@ typedef struct
     char* userName;
     char* serverName;
     char* ipAddress;
+    char* unixPath;     // set by -server unix:/path for a server on this host
+    bool useTls;        // connect to the TLS port and handshake before chatting
+    char* tlsCaFile;    // PEM file of trusted CAs, NULL for the system store
+    bool tlsVerify;     // false accepts any certificate (self-signed test servers)
+    bool useMulticast;  // receive broadcasts from the server's multicast group
+    char* multicastInterface; // address of the interface to join the group on, NULL for any
+    bool useCache;      // keep recent messages on disk and only fetch newer ones at startup
+    char* cacheDirectory; // where the cache files live, NULL for the default
 } ClientArgs;
 
 int parseCommandLineArgs(int argc, char* argv[], ClientArgs* clientArgs);
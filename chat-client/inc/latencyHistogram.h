@@ -0,0 +1,28 @@
+/*
+ * Filename:    latencyHistogram.h
+ * Project:     CanWeTalkSystem
+ * By:          Salman Nouman, Minchul Hwang, Md Saiful Islam, Saje-Antoine Rose
+ * Date:        October, 19, 2026
+ * Description: This file contains the defined values, dependencies and function prototypes of the latency histogram,
+ *              which counts how long messages took from their sender to this client
+ */
+
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "../../Common/inc/message.h"
+
+#define LATENCY_BUCKETS 48              // bucket i holds latencies of [2^i, 2^(i+1)) nanoseconds, the last one everything longer
+#define LATENCY_COMMAND ">>latency<<"   // typed in the input window, shows the histogram instead of being sent
+#define MAX_LATENCY_TEXT 16
+#define MAX_LATENCY_LINES (LATENCY_BUCKETS + 2)
+#define MAX_LATENCY_LINE_LENGTH 64
+
+void recordLatency(uint64_t nanoseconds);
+int describeLatency(char lines[][MAX_LATENCY_LINE_LENGTH], int maxLines);
+
+#endif
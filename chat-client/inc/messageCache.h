@@ -0,0 +1,61 @@
+/*
+ * Filename:    messageCache.h
+ * Project:     CanWeTalkSystem
+ * By:          Salman Nouman, Minchul Hwang, Md Saiful Islam, Saje-Antoine Rose
+ * Date:        October, 19, 2026
+ * Description: This file contains the defined values, dependencies and function prototypes of the on-disk message cache,
+ *              which keeps the recent messages of each server so that the client can show them before anything arrives
+ */
+
+#ifndef MESSAGE_CACHE_H
+#define MESSAGE_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include "../../Common/inc/queue.h"
+#include "../../Common/inc/history.h"
+#include "../../Common/inc/mailbox.h"
+
+#define MESSAGE_CACHE_MAGIC 0x43575443u       // "CWTC"
+#define MESSAGE_CACHE_VERSION 2               // bumped whenever the file layout changes, older files are started over
+#define MESSAGE_CACHE_CAPACITY 256            // messages kept per server, also the most the server is asked to replay
+#define MESSAGE_CACHE_DIRECTORY "chat-client" // under $XDG_CACHE_HOME, or ~/.cache without it
+#define MAX_CACHE_PATH_LENGTH 512
+
+// One cached message, stored as the server serialized it with the time it first arrived
+typedef struct CachedMessage
+{
+	uint64_t sequence;
+	uint64_t receivedNanoseconds;	// 0 for a message that was replayed rather than received live
+	char serialized[MAX_SERIALIZED_LENGTH];
+} CachedMessage;
+
+// Layout of a cache file, which is mapped into memory as a whole
+typedef struct MessageCacheFile
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t capacity;
+	uint32_t count;                                 // messages stored, up to capacity
+	uint32_t head;                                  // record the next message is written to
+	uint64_t epoch;                                 // numbering the sequence numbers belong to, 0 before the first sync
+	uint64_t highWater;                             // sequence number of the newest message seen
+	CachedMessage records[MESSAGE_CACHE_CAPACITY];  // a ring, oldest at head once it is full
+} MessageCacheFile;
+
+bool openMessageCache(const char* directory, const char* server, int port);
+int loadMessageCache(MessageQueue* queue, int newest);
+bool messageCacheOpen(void);
+void buildHistoryRequest(char* body, size_t size);
+void buildMailboxHello(char* body, size_t size, const char* userName);
+void syncMessageCache(uint64_t epoch, uint64_t nextSequence);
+void cacheMessage(uint64_t sequence, const char* serializedMessage, uint64_t receivedNanoseconds);
+void closeMessageCache(void);
+
+#endif
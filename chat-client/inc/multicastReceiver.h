@@ -0,0 +1,43 @@
+/*
+ * Filename:    multicastReceiver.h
+ * Project:     CanWeTalkSystem
+ * By:          Salman Nouman, Minchul Hwang, Md Saiful Islam, Saje-Antoine Rose
+ * Date:        October, 19, 2026
+ * Description: This file contains the defined values, dependencies and function prototypes of the chat-client's
+ *              multicast receiver, which reads broadcasts from the server's multicast group instead of the TCP connection
+ */
+
+#ifndef MULTICAST_RECEIVER_H
+#define MULTICAST_RECEIVER_H
+
+#include "clientThreads.h"
+#include "../../Common/inc/multicast.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <inttypes.h>
+
+#define MULTICAST_REORDER_WINDOW 256              // datagrams held back while an earlier one is missing, power of two
+#define MULTICAST_NACK_INTERVAL_MILLISECONDS 100  // how often missing sequence numbers are asked for again
+#define MULTICAST_RECEIVE_TIMEOUT_MILLISECONDS 100
+
+// State of the one multicast subscription of the client
+typedef struct MulticastReceiver
+{
+	int socket;
+	pthread_t thread;
+	bool running;
+	pthread_mutex_t lock;                           // the receiver thread and repairs from the listener thread meet here
+	uint64_t expected;                              // next sequence number to display
+	uint64_t highestKnown;                          // highest sequence number received or announced
+	char* held[MULTICAST_REORDER_WINDOW];           // serialized messages that arrived ahead of expected
+	uint64_t heldSequence[MULTICAST_REORDER_WINDOW];
+	struct timespec lastNack;
+	ThreadArgs* args;
+} MulticastReceiver;
+
+bool startMulticastReceiver(ThreadArgs* args, const char* offer);
+void repairMulticast(const char* repair);
+void skipLostMulticast(const char* lost);
+void stopMulticastReceiver(void);
+
+#endif
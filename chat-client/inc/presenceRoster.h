@@ -0,0 +1,29 @@
+/*
+ * Filename:    presenceRoster.h
+ * Project:     CanWeTalkSystem
+ * By:          Salman Nouman, Minchul Hwang, Md Saiful Islam, Saje-Antoine Rose
+ * Date:        October, 19, 2026
+ * Description: This file contains the defined values, dependencies and function prototypes of the presence roster,
+ *              the client's copy of the users the server reports online
+ */
+
+#ifndef PRESENCE_ROSTER_H
+#define PRESENCE_ROSTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "../../Common/inc/message.h"
+#include "../../Common/inc/presence.h"
+
+#define ROSTER_MAX_NAMES 4096       // users kept, later ones are not shown
+#define ROSTER_LABEL "Online"
+
+void applyRosterPart(const char* payload);
+bool applyPresenceDelta(const char* payload);
+bool takeRosterLine(char* line, size_t size);
+
+#endif
@@ -10,16 +10,29 @@
 #define SOCKET_SERVICE_H
 
 #include "cmdLineParsing.h"
+#include "../../Common/inc/message.h"
+#include <sys/un.h>
+#include <time.h>
 
-#define MAX_IP_LENGTH 16 // Maximum length of an IPv4 address (including null terminator)
 #define PORT_NUMBER 8989
+#define TLS_PORT_NUMBER 8990
 #define SOCKET_ERROR -1
 #define SOCKET_SUCCESS 0
-#define FIRST_IP_ADDY_IN_LIST 0
+#define MAX_SERVICE_LENGTH 8
+#define MAX_HOST_LENGTH 256
+#define MAX_CONNECT_CANDIDATES 8                 // addresses tried per family
+#define CONNECTION_ATTEMPT_DELAY_MILLISECONDS 250 // head start of each attempt before the next one begins
+#define RESOLUTION_DELAY_MILLISECONDS 50          // wait for IPv6 answers once IPv4 ones are in
+#define LOOKUP_POLL_MILLISECONDS 10               // how often unfinished lookups are checked
+#define CONNECT_TIMEOUT_MILLISECONDS 10000
+#define IPV6_LOOKUP 0
+#define IPV4_LOOKUP 1
+#define LOOKUP_COUNT 2
+#define UNIX_SOCKET_IP "127.0.0.1" // shown as the sender address of messages sent over a unix socket
 
 int initializeConnection(const ClientArgs *clientArgs);
-void resolveServerName(char *serverName, char* ipAddress);
-int connectToServer(char *serverIP);
+int connectToServer(const char *host, int port);
+int connectToUnixSocket(const char *path);
 void getSocketIP(int sockfd, char *ipBuffer, size_t bufferLength);
 
 #endif
\ No newline at end of file
@@ -18,7 +18,7 @@
 #define DEFAULT_STYLE 0
 #define HEADER_STYLE 1
 #define ISTREAM_STYLE 2
-#define LABELS "        IP       USER                      MESSAGE                     TIME     "
+#define LABELS "        IP       USER                      MESSAGE                     TIME     LATENCY"
 #define CLIENT_NAME "C H A T L I T E"
 #define OUTGOING_LABEL "Outgoing Message"
 #define MAX_MESSAGE_HISTORY 11
@@ -30,11 +30,13 @@
 #define ISTREAM_WIN_HEIGHT 3
 #define NEXT_COLUMN 1
 #define NEXT_ROW 1
+#define ROSTER_ROW 3
 
 // Heading printer that is centered and colored
 void refreshUI(WINDOW *staticMessagesHeader, WINDOW *staticOutgoingHeader, WINDOW *messageWindow, WINDOW *outgoingWindow);
 void initializeUI(int *rows, int *cols, WINDOW **staticMessagesHeader, WINDOW **staticOutgoingHeader, WINDOW **messageWindow, WINDOW **outgoingWindow);
 void printHeader(WINDOW *win, int starty, int width, const char *string, int colorScheme);
 void printMessage(WINDOW* messageWindow, const Message* chatMessage, char* clientIp);
+void printRoster(WINDOW* staticMessagesHeader, const char* line);
 
 #endif
@@ -7,8 +7,298 @@
  */
 
 #include "../inc/clientThreads.h"
+#include "../inc/multicastReceiver.h"
+#include "../inc/messageCache.h"
+#include "../inc/latencyHistogram.h"
+#include "../inc/presenceRoster.h"
+#include "../../Common/inc/search.h"
 
 
+/*
+ * Function:    sendControl
+ * Description: This function sends a control request to the server as a typed control frame, which the server acts on
+ *              without deserializing it and answers ahead of queued chat messages.
+ * Parameters:  ThreadArgs *args: The thread arguments holding the socket
+ *              const char* request: The control request
+ * Returns:     int: SEND_SUCCESS or SEND_FAILURE
+ */
+int sendControl(ThreadArgs *args, const char* request)
+{
+	pthread_mutex_lock(&sendMutex);
+	int result = sendControlFrame(request, args->serverSocket);
+	pthread_mutex_unlock(&sendMutex);
+	return result;
+}
+
+/*
+ * Function:    controlBody
+ * Description: This function finds the body of a raw frame, where the server puts its control messages.
+ * Parameters:  const char* serializedMessage: The frame as received
+ * Returns:     const char*: The body, NULL if the frame is malformed
+ */
+static const char* controlBody(const char* serializedMessage)
+{
+	const char* body = strchr(serializedMessage, '|');
+	body = body == NULL ? NULL : strchr(body + 1, '|');
+	return body == NULL ? NULL : body + 1;
+}
+
+/*
+ * Function:    markReceived
+ * Description: This function notes when a message arrived and, if its sender timestamped it, adds how long it took
+ *              to the latency histogram. A sender whose clock is ahead of this one's is not measured.
+ * Parameters:  Message* chatMessage: The message that arrived
+ * Returns:     void
+ */
+static void markReceived(Message* chatMessage)
+{
+	chatMessage->receivedNanoseconds = wallClockNanoseconds();
+	if (chatMessage->sentNanoseconds != 0 && chatMessage->receivedNanoseconds >= chatMessage->sentNanoseconds)
+	{
+		recordLatency(chatMessage->receivedNanoseconds - chatMessage->sentNanoseconds);
+	}
+}
+
+/*
+ * Function:    postNotice
+ * Description: This function shows a line of text from the client itself in the message window.
+ * Parameters:  MessageQueue* queue: The queue the UI thread prints from
+ *              const char* text: The notice
+ * Returns:     void
+ */
+static void postNotice(MessageQueue* queue, const char* text)
+{
+	Message notice;
+	initMessage(&notice, SERVER_CONTROL_IP, NOTICE_USER_NAME);
+	setMessageBody(&notice, text, strlen(text));
+	notice.receivedNanoseconds = wallClockNanoseconds();
+	enqueue(queue, &notice); // the UI thread releases it after printing
+}
+
+/*
+ * Function:    deliverNumbered
+ * Description: This function hands a message the server numbered to the UI thread and keeps it in the message cache.
+ * Parameters:  MessageQueue* queue: The queue the UI thread prints from
+ *              uint64_t sequence: The number the server gave the message
+ *              const char* serializedMessage: The message as the server serialized it
+ *              bool live: false for a replay of an old message, whose delay is not a delivery latency
+ * Returns:     void
+ */
+static void deliverNumbered(MessageQueue* queue, uint64_t sequence, const char* serializedMessage, bool live)
+{
+	Message chatMessage;
+	deserializeMessage(&chatMessage, serializedMessage);
+	if (live)
+	{
+		markReceived(&chatMessage);
+	}
+	cacheMessage(sequence, serializedMessage, chatMessage.receivedNanoseconds);
+	enqueue(queue, &chatMessage); // the UI thread releases it after printing
+}
+
+/*
+ * Function:    deliverSequenced
+ * Description: This function hands a message the server numbered, live or repaired, to the UI thread and keeps it in
+ *              the message cache.
+ * Parameters:  MessageQueue* queue: The queue the UI thread prints from
+ *              uint64_t sequence: The number the server gave the message
+ *              const char* serializedMessage: The message as the server serialized it
+ * Returns:     void
+ */
+void deliverSequenced(MessageQueue* queue, uint64_t sequence, const char* serializedMessage)
+{
+	deliverNumbered(queue, sequence, serializedMessage, true);
+}
+
+/*
+ * Function:    requestHistory
+ * Description: This function asks the server for the messages after the newest one cached. Until the answer is complete
+ *              the listener cannot tell the numbers of live messages and leaves them to the replay.
+ * Parameters:  ThreadArgs *args: The listener arguments
+ *              uint64_t* liveSequence: The number of the next live message, reset to 0
+ * Returns:     void
+ */
+static void requestHistory(ThreadArgs *args, uint64_t* liveSequence)
+{
+	char request[MAX_PARCEL_LENGTH + 64];
+	buildHistoryRequest(request, sizeof(request));
+	*liveSequence = 0;
+	sendControl(args, request);
+}
+
+/*
+ * Function:    handleHistoryControl
+ * Description: This function acts on the server's answer to >>since<<: the replayed messages the cache is missing, then
+ *              the number of the next live message, from which on the listener numbers what it receives itself.
+ * Parameters:  ThreadArgs *args: The listener arguments
+ *              const char* serializedMessage: The frame as received
+ *              uint64_t* liveSequence: The number of the next live message, 0 until the sync arrives
+ * Returns:     bool: true if the frame was a control message and must not be displayed as it is
+ */
+static bool handleHistoryControl(ThreadArgs *args, const char* serializedMessage, uint64_t* liveSequence)
+{
+	const char* body = controlBody(serializedMessage);
+	if (!messageCacheOpen() || body == NULL)
+	{
+		return false;
+	}
+
+	if (strncmp(body, HISTORY_REPLAY_PREFIX, strlen(HISTORY_REPLAY_PREFIX)) == 0)
+	{
+		char* replayed;
+		uint64_t sequence = strtoull(body + strlen(HISTORY_REPLAY_PREFIX), &replayed, 10);
+		if (*replayed == ' ')
+		{
+			deliverNumbered(args->queue, sequence, replayed + 1, false);
+		}
+		return true;
+	}
+	if (strncmp(body, HISTORY_SYNC_PREFIX, strlen(HISTORY_SYNC_PREFIX)) == 0)
+	{
+		uint64_t epoch;
+		uint64_t next;
+		if (sscanf(body + strlen(HISTORY_SYNC_PREFIX), "%" SCNu64 " %" SCNu64, &epoch, &next) == 2 && next > 0)
+		{
+			syncMessageCache(epoch, next);
+			*liveSequence = next;
+		}
+		return true;
+	}
+	return false;
+}
+
+/*
+ * Function:    handleMulticastControl
+ * Description: This function acts on the multicast control messages of the server. They are read from the raw frame
+ *              since a repair carries a whole serialized message and may be longer than a message body.
+ * Parameters:  ThreadArgs *args: The listener arguments
+ *              const char* serializedMessage: The frame as received
+ *              uint64_t* liveSequence: The number of the next live message
+ * Returns:     bool: true if the frame was a control message and must not be displayed
+ */
+static bool handleMulticastControl(ThreadArgs *args, const char* serializedMessage, uint64_t* liveSequence)
+{
+	const char* body = controlBody(serializedMessage);
+	if (!args->multicast || body == NULL)
+	{
+		return false;
+	}
+
+	if (strncmp(body, MULTICAST_OFFER_PREFIX, strlen(MULTICAST_OFFER_PREFIX)) == 0)
+	{
+		if (!startMulticastReceiver(args, body + strlen(MULTICAST_OFFER_PREFIX)))
+		{
+			sendControl(args, MULTICAST_UNSUBSCRIBE); // keep receiving over TCP
+			if (messageCacheOpen())
+			{
+				requestHistory(args, liveSequence); // what was published to the group meanwhile is replayed
+			}
+		}
+		return true;
+	}
+	if (strncmp(body, MULTICAST_REPAIR_PREFIX, strlen(MULTICAST_REPAIR_PREFIX)) == 0)
+	{
+		repairMulticast(body + strlen(MULTICAST_REPAIR_PREFIX));
+		return true;
+	}
+	if (strncmp(body, MULTICAST_LOST_PREFIX, strlen(MULTICAST_LOST_PREFIX)) == 0)
+	{
+		skipLostMulticast(body + strlen(MULTICAST_LOST_PREFIX));
+		return true;
+	}
+	return false;
+}
+
+/*
+ * Function:    handlePresenceControl
+ * Description: This function acts on the roster and its deltas, asking for the roster again if a delta went missing.
+ * Parameters:  ThreadArgs *args: The listener arguments
+ *              const char* serializedMessage: The frame as received
+ * Returns:     bool: true if the frame was a presence message and must not be displayed
+ */
+static bool handlePresenceControl(ThreadArgs *args, const char* serializedMessage)
+{
+	const char* body = controlBody(serializedMessage);
+	if (body == NULL || strncmp(serializedMessage, SERVER_CONTROL_IP, strlen(SERVER_CONTROL_IP)) != 0)
+	{
+		return false;
+	}
+
+	if (strncmp(body, PRESENCE_ROSTER_PREFIX, strlen(PRESENCE_ROSTER_PREFIX)) == 0)
+	{
+		applyRosterPart(body + strlen(PRESENCE_ROSTER_PREFIX));
+		return true;
+	}
+	if (strncmp(body, PRESENCE_DELTA_PREFIX, strlen(PRESENCE_DELTA_PREFIX)) == 0)
+	{
+		if (!applyPresenceDelta(body + strlen(PRESENCE_DELTA_PREFIX)))
+		{
+			sendControl(args, PRESENCE_SUBSCRIBE);
+		}
+		return true;
+	}
+	return false;
+}
+
+/*
+ * Function:    handleSearchControl
+ * Description: This function shows the server's answer to a search: the matching messages of the page, then a line
+ *              telling which page it was.
+ * Parameters:  ThreadArgs *args: The listener arguments
+ *              const char* serializedMessage: The frame as received
+ * Returns:     bool: true if the frame was a search answer and must not be displayed as it is
+ */
+static bool handleSearchControl(ThreadArgs *args, const char* serializedMessage)
+{
+	const char* body = controlBody(serializedMessage);
+	if (body == NULL || strncmp(serializedMessage, SERVER_CONTROL_IP, strlen(SERVER_CONTROL_IP)) != 0)
+	{
+		return false;
+	}
+
+	if (strncmp(body, SEARCH_RESULT_PREFIX, strlen(SEARCH_RESULT_PREFIX)) == 0)
+	{
+		// An old message found again: neither numbered, cached nor measured
+		Message chatMessage;
+		deserializeMessage(&chatMessage, body + strlen(SEARCH_RESULT_PREFIX));
+		chatMessage.sentNanoseconds = 0;
+		chatMessage.receivedNanoseconds = wallClockNanoseconds();
+		enqueue(args->queue, &chatMessage); // the UI thread releases it after printing
+		return true;
+	}
+	if (strncmp(body, SEARCH_SUMMARY_PREFIX, strlen(SEARCH_SUMMARY_PREFIX)) == 0)
+	{
+		unsigned long page;
+		unsigned long pages;
+		unsigned long matches;
+		char notice[MAX_MESSAGE_LENGTH];
+		if (sscanf(body + strlen(SEARCH_SUMMARY_PREFIX), "%lu %lu %lu", &page, &pages, &matches) != 3)
+		{
+			return true;
+		}
+		if (matches == 0)
+		{
+			snprintf(notice, sizeof(notice), "Search: no matches");
+		}
+		else if (page > pages)
+		{
+			snprintf(notice, sizeof(notice), "Search: no page %lu, %lu pages of %lu matches", page, pages, matches);
+		}
+		else
+		{
+			snprintf(notice, sizeof(notice), "Search: page %lu of %lu, %lu matches", page, pages, matches);
+		}
+		postNotice(args->queue, notice);
+		return true;
+	}
+	if (strcmp(body, SEARCH_UNAVAILABLE) == 0)
+	{
+		postNotice(args->queue, "Search: this server keeps no history to search");
+		return true;
+	}
+	return false;
+}
+
 /*
  * Function:    *listenerThread
  * Description: This function listens for incoming messages on a server socket.
@@ -20,7 +310,22 @@ void *listenerThread(void *threadArgs)
     ThreadArgs *args = (ThreadArgs *)threadArgs;
     int serverSocket = args->serverSocket;
 	MessageQueue* queue = args->queue;
-	Message* chatMessage = (Message*)malloc(sizeof(Message));
+	Message chatMessage;
+	uint64_t liveSequence = 0;
+	char hello[MAX_PARCEL_LENGTH + 64];
+
+	// Named first, so that what the server kept for this user arrives before any replay
+	buildMailboxHello(hello, sizeof(hello), args->userName);
+	sendControl(args, hello);
+	if (messageCacheOpen())
+	{
+		requestHistory(args, &liveSequence); // replayed from the newest cached message on, then synced
+	}
+	sendControl(args, PRESENCE_SUBSCRIBE); // the roster once, then only who came and went
+	if (args->multicast)
+	{
+		sendControl(args, MULTICAST_SUBSCRIBE); // answered with an offer if the server publishes to a group
+	}
 
     while(true) 
 	{
@@ -35,7 +340,7 @@ void *listenerThread(void *threadArgs)
 
 		uint32_t msgLength;
 		// Receive the length of the message
-		if (recv(serverSocket, &msgLength, sizeof(msgLength), 0) == 0) 
+		if (transportRecvAll(serverSocket, &msgLength, sizeof(msgLength)) <= 0) 
 		{
 			break;
 		}
@@ -50,24 +355,84 @@ void *listenerThread(void *threadArgs)
 		}
 
 		// Receive the message itself
-		if (recv(serverSocket, buffer, msgLength, 0) == 0) 
+		if (msgLength > 0 && transportRecvAll(serverSocket, buffer, msgLength) <= 0) 
 		{
+			free(buffer);
 			break;
 		}
 
 		buffer[msgLength] = '\0'; // Null-terminate the string	
 
-
-		deserializeMessage(chatMessage, buffer);
-		getCurrentTimestamp(chatMessage->timeStamp, MAX_TIMESTAMP_LENGTH);
-		enqueue(queue, chatMessage);
+		if (handleMulticastControl(args, buffer, &liveSequence) || handleHistoryControl(args, buffer, &liveSequence) ||
+		    handlePresenceControl(args, buffer) || handleSearchControl(args, buffer))
+		{
+			free(buffer);
+			continue;
+		}
+		const char* body = controlBody(buffer);
+		if (strncmp(buffer, SERVER_CONTROL_IP, strlen(SERVER_CONTROL_IP)) == 0 && body != NULL &&
+		    strcmp(body, MAILBOX_NAME_TAKEN) == 0)
+		{
+			free(buffer);
+			args->nameTaken = true; // the server closes the connection, main says why once the UI is gone
+			break;
+		}
+		deserializeMessage(&chatMessage, buffer);
+		if (strcmp(messageBody(&chatMessage), HEARTBEAT_REQUEST) == 0)
+		{
+			free(buffer);
+			releaseMessage(&chatMessage);
+			sendControl(args, HEARTBEAT_REPLY); // Heartbeats are answered, not displayed
+			continue;
+		}
+		if (strcmp(messageIp(&chatMessage), SERVER_CONTROL_IP) == 0 && strcmp(messageBody(&chatMessage), SERVER_BUSY) == 0)
+		{
+			// Not a broadcast, so it is neither numbered nor cached
+			free(buffer);
+			releaseMessage(&chatMessage);
+			postNotice(queue, SERVER_BUSY_NOTICE);
+			continue;
+		}
+		if (strcmp(messageIp(&chatMessage), SERVER_CONTROL_IP) == 0 && body != NULL &&
+		    strncmp(body, PRIVATE_DELIVERY_PREFIX, strlen(PRIVATE_DELIVERY_PREFIX)) == 0)
+		{
+			// Meant for this client alone, so it is neither numbered nor cached
+			releaseMessage(&chatMessage);
+			deserializeMessage(&chatMessage, body + strlen(PRIVATE_DELIVERY_PREFIX));
+			free(buffer);
+			markReceived(&chatMessage);
+			enqueue(queue, &chatMessage); // the UI thread releases it after printing
+			continue;
+		}
+		if (strcmp(messageIp(&chatMessage), SERVER_CONTROL_IP) == 0 && body != NULL &&
+		    strncmp(body, MAILBOX_DELIVERY_PREFIX, strlen(MAILBOX_DELIVERY_PREFIX)) == 0)
+		{
+			// Kept while this user was away: its delay is no delivery latency, and it is not numbered
+			releaseMessage(&chatMessage);
+			deserializeMessage(&chatMessage, body + strlen(MAILBOX_DELIVERY_PREFIX));
+			free(buffer);
+			chatMessage.receivedNanoseconds = wallClockNanoseconds();
+			enqueue(queue, &chatMessage); // the UI thread releases it after printing
+			continue;
+		}
+		if (messageCacheOpen() && liveSequence == 0)
+		{
+			free(buffer);
+			releaseMessage(&chatMessage);
+			continue; // broadcast before the >>since<< was answered, the replay brings it
+		}
+		markReceived(&chatMessage);
+		if (liveSequence != 0)
+		{
+			cacheMessage(liveSequence++, buffer, chatMessage.receivedNanoseconds);
+		}
 		free(buffer);
+		enqueue(queue, &chatMessage); // the UI thread releases it after printing
     }
 	
 	pthread_mutex_lock(&listenerMutex);
     terminateListener = 1; // Acquire lock and Set global condition
     pthread_mutex_unlock(&listenerMutex);
-	free(chatMessage);
     return NULL;
 }
 
@@ -87,6 +452,7 @@ void *senderThread(void *threadArgs)
 
 	char userInput[MAX_MESSAGE_LENGTH];
 	memset(userInput, '\0', sizeof(userInput));// Clear buffer
+	char lastSearch[MAX_MESSAGE_LENGTH] = "";	// words of the last /search, paged through with /page
 
 	while (true) 
 	{
@@ -101,8 +467,8 @@ void *senderThread(void *threadArgs)
 
 		// Turn on character echo
 		echo();
-		// Read the user input upto 79 chars for null terminator
-		wgetnstr(chatWindow, userInput, 79);
+		// Read the user input, leaving room for the null terminator
+		wgetnstr(chatWindow, userInput, MAX_MESSAGE_LENGTH - 1);
 		// Turn off character echo
 		noecho();
 
@@ -117,26 +483,87 @@ void *senderThread(void *threadArgs)
 
 		if (strlen(userInput) > 0)
 		{
-			// Build message struct before sending
-			Message *outMessage = (Message*)malloc(sizeof(Message));
-			strcpy(outMessage->ip, ip);
-			strncpy(outMessage->userName, userName, MAX_USERNAME_LENGTH - 1);
-			outMessage->userName[MAX_USERNAME_LENGTH - 1] = '\0'; // Ensure null-termination
-			strcpy(outMessage->message, userInput);
-			getCurrentTimestamp(outMessage->timeStamp, MAX_TIMESTAMP_LENGTH);
+			int sendResult;
+			if (strcmp(userInput, ">>bye<<") == 0)
+			{
+				sendResult = sendControl(args, userInput); // leaving is a control request, not a chat message
+			}
+			else if (strcmp(userInput, LATENCY_COMMAND) == 0)
+			{
+				// Answered locally, the server never sees it
+				char lines[MAX_LATENCY_LINES][MAX_LATENCY_LINE_LENGTH];
+				int count = describeLatency(lines, MAX_LATENCY_LINES);
+				for (int i = 0; i < count; i++)
+				{
+					postNotice(args->queue, lines[i]);
+				}
+				sendResult = SEND_SUCCESS;
+			}
+			else if (strncmp(userInput, DIRECT_MESSAGE_COMMAND, strlen(DIRECT_MESSAGE_COMMAND)) == 0)
+			{
+				// Sent whole rather than in parcels, the server reroutes it by the name at its start
+				Message outMessage;
+				char serializedMessage[MAX_SERIALIZED_LENGTH];
+				initMessage(&outMessage, ip, userName);
+				setMessageBody(&outMessage, userInput, strlen(userInput));
+				outMessage.sentNanoseconds = wallClockNanoseconds();
+				serializeMessage(&outMessage, userInput, serializedMessage, sizeof(serializedMessage));
 
-			sendParcelledMessage(outMessage, serverSocket);
+				pthread_mutex_lock(&sendMutex);
+				sendResult = sendLengthPrefixedMessage(serializedMessage, serverSocket);
+				pthread_mutex_unlock(&sendMutex);
+				outMessage.receivedNanoseconds = outMessage.sentNanoseconds;
+				outMessage.sentNanoseconds = 0; // no delivery to measure
+				enqueue(args->queue, &outMessage); // only the recipient gets it back, so it is shown here; the UI thread releases it
+			}
+			else if (strncmp(userInput, SEARCH_COMMAND, strlen(SEARCH_COMMAND)) == 0 ||
+			         strncmp(userInput, SEARCH_PAGE_COMMAND, strlen(SEARCH_PAGE_COMMAND)) == 0)
+			{
+				// Answered by the server with the page of matches, shown by the listener
+				long page = 1;
+				if (strncmp(userInput, SEARCH_COMMAND, strlen(SEARCH_COMMAND)) == 0)
+				{
+					snprintf(lastSearch, sizeof(lastSearch), "%s", userInput + strlen(SEARCH_COMMAND));
+				}
+				else
+				{
+					page = strtol(userInput + strlen(SEARCH_PAGE_COMMAND), NULL, 10);
+				}
 
-			if (strcmp(userInput, ">>bye<<") == 0)// in the case of >>bye<<, end client and its threads
+				if (lastSearch[0] == '\0' || page < 1)
+				{
+					postNotice(args->queue, lastSearch[0] == '\0' ? "Search: nothing searched for yet" : "Search: pages start at 1");
+					sendResult = SEND_SUCCESS;
+				}
+				else
+				{
+					char request[MAX_MESSAGE_LENGTH + 32];
+					snprintf(request, sizeof(request), SEARCH_REQUEST_PREFIX "%ld %s", page, lastSearch);
+					sendResult = sendControl(args, request);
+				}
+			}
+			else
+			{
+				// Build message struct before sending
+				Message outMessage;
+				initMessage(&outMessage, ip, userName);
+				setMessageBody(&outMessage, userInput, strlen(userInput));
+				outMessage.sentNanoseconds = wallClockNanoseconds(); // every parcel carries it, receivers measure from it
+
+				pthread_mutex_lock(&sendMutex);
+				sendResult = sendParcelledMessage(&outMessage, serverSocket);
+				pthread_mutex_unlock(&sendMutex);
+				releaseMessage(&outMessage);
+			}
+
+			// in the case of >>bye<< or a lost connection, end client and its threads
+			if (sendResult != SEND_SUCCESS || strcmp(userInput, ">>bye<<") == 0)
 			{
 				pthread_mutex_lock(&listenerMutex);
 				terminateListener = 1;
 				pthread_mutex_unlock(&listenerMutex);
-				free(outMessage);
 				break;
 			}
-
-			free(outMessage);
 		}
 		memset(userInput, '\0', sizeof(userInput));// Reset userInput buffer
 	}
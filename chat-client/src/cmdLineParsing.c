@@ -16,7 +16,10 @@
  */
 void displayUsage() 
 {
-    printf("Usage: chat-client -user<USERNAME> -server<SERVERNAME/IPADDRESS>\n");
+    printf("Usage: chat-client -user<USERNAME> -server<SERVERNAME/IPADDRESS> [-tls] [-tlsca<FILE>] [-tlsnoverify]\n");
+    printf("       chat-client -user<USERNAME> -server<SERVERNAME/IPADDRESS> -multicast [-mcastif<ADDRESS>]\n");
+    printf("       chat-client -user<USERNAME> -server unix:<PATH>\n");
+    printf("       any of the above with [-cache<DIRECTORY>] or [-nocache]\n");
 }
 
 /*
@@ -33,6 +36,14 @@ int parseCommandLineArgs(int argc, char* argv[], ClientArgs* clientArgs)
     clientArgs->userName = NULL;
     clientArgs->serverName = NULL;
     clientArgs->ipAddress = NULL;
+    clientArgs->unixPath = NULL;
+    clientArgs->useTls = false;
+    clientArgs->tlsCaFile = NULL;
+    clientArgs->tlsVerify = true;
+    clientArgs->useMulticast = false;
+    clientArgs->multicastInterface = NULL;
+    clientArgs->useCache = true;
+    clientArgs->cacheDirectory = NULL;
 
     const int kFirstCharacter = 0;
     const int kSecondCharacter = 1;
@@ -40,14 +51,56 @@ int parseCommandLineArgs(int argc, char* argv[], ClientArgs* clientArgs)
 
     for (int counter = kSecondCharacter; counter < argc; counter++) 
     {
-        if (strncmp(argv[counter], "-user", kCmdFlagPlacement) == 0) 
+        // The TLS options share their first two characters, so they are matched in full
+        if (strcmp(argv[counter], "-tls") == 0)
+        {
+            clientArgs->useTls = true;
+        }
+        else if (strncmp(argv[counter], "-tlsca", strlen("-tlsca")) == 0 && strlen(argv[counter]) > strlen("-tlsca"))
+        {
+            clientArgs->useTls = true;
+            clientArgs->tlsCaFile = argv[counter] + strlen("-tlsca");
+        }
+        else if (strcmp(argv[counter], "-tlsnoverify") == 0)
+        {
+            clientArgs->useTls = true;
+            clientArgs->tlsVerify = false;
+        }
+        else if (strcmp(argv[counter], "-multicast") == 0)
+        {
+            clientArgs->useMulticast = true;
+        }
+        else if (strncmp(argv[counter], "-mcastif", strlen("-mcastif")) == 0 && strlen(argv[counter]) > strlen("-mcastif"))
+        {
+            clientArgs->useMulticast = true;
+            clientArgs->multicastInterface = argv[counter] + strlen("-mcastif");
+        }
+        else if (strcmp(argv[counter], "-nocache") == 0)
+        {
+            clientArgs->useCache = false;
+        }
+        else if (strncmp(argv[counter], "-cache", strlen("-cache")) == 0 && strlen(argv[counter]) > strlen("-cache"))
+        {
+            clientArgs->useCache = true;
+            clientArgs->cacheDirectory = argv[counter] + strlen("-cache");
+        }
+        else if (strncmp(argv[counter], "-user", kCmdFlagPlacement) == 0) 
         {
             clientArgs->userName = strchr(argv[counter], 'r') + kSecondCharacter; // removing the flag
         } 
         else if (strncmp(argv[counter], "-server", kCmdFlagPlacement) == 0) 
         {
             char* serverArg = strstr(argv[counter], "server") + strlen("server"); // Get pointer to the substring after "server"
-            if (strlen(serverArg) > 0 && serverArg[kFirstCharacter] >= ASCII_DIGIT_START && serverArg[kFirstCharacter] <= ASCII_DIGIT_END) 
+            if (strlen(serverArg) == 0 && counter + 1 < argc)
+            {
+                serverArg = argv[++counter]; // value given as a separate argument: -server unix:/path
+            }
+            if (strncmp(serverArg, UNIX_SERVER_PREFIX, strlen(UNIX_SERVER_PREFIX)) == 0 && strlen(serverArg) > strlen(UNIX_SERVER_PREFIX))
+            {
+                clientArgs->unixPath = serverArg + strlen(UNIX_SERVER_PREFIX);
+            }
+            else if (strlen(serverArg) > 0 && ((serverArg[kFirstCharacter] >= ASCII_DIGIT_START && serverArg[kFirstCharacter] <= ASCII_DIGIT_END) ||
+                     strchr(serverArg, ':') != NULL)) // IPv6 literals may start with a letter or a colon
             {
                 clientArgs->ipAddress = serverArg;
             } 
@@ -64,13 +117,27 @@ int parseCommandLineArgs(int argc, char* argv[], ClientArgs* clientArgs)
         }
     }
 
-    // Check if both server name and IP address are provided
-    if ((clientArgs->serverName && clientArgs->ipAddress) || (!clientArgs->serverName && !clientArgs->ipAddress)) 
+    // Check that exactly one of server name, IP address and unix socket is provided
+    int serverCount = (clientArgs->serverName != NULL) + (clientArgs->ipAddress != NULL) + (clientArgs->unixPath != NULL);
+    if (serverCount != 1) 
     {
-        printf("Error: Please provide either server name or IP address\n");
+        printf("Error: Please provide either server name, IP address or unix socket\n");
         displayUsage();
         return CMD_PARSING_ERROR; // Error
     }
+    if (clientArgs->unixPath != NULL && clientArgs->useTls)
+    {
+        printf("Error: TLS is only offered over TCP, a unix socket never leaves the host\n");
+        displayUsage();
+        return CMD_PARSING_ERROR;
+    }
+
+    if (clientArgs->useMulticast && clientArgs->useTls)
+    {
+        printf("Error: Multicast datagrams are not encrypted, it cannot be combined with TLS\n");
+        displayUsage();
+        return CMD_PARSING_ERROR;
+    }
 
     return 0; // Success
 }
\ No newline at end of file
@@ -0,0 +1,124 @@
+/*
+ * Filename:    latencyHistogram.c
+ * Project:     CanWeTalkSystem
+ * By:          Salman Nouman, Minchul Hwang, Md Saiful Islam, Saje-Antoine Rose
+ * Date:        October, 19, 2026
+ * Description: This file contains the latency histogram. Every message that arrives with its sender's timestamp adds
+ *              the time it took to a power-of-two bucket, so recording is one atomic increment whatever the rate and
+ *              percentiles are accurate to within a factor of two. The listener and the multicast receiver both record.
+ */
+
+#include "../inc/latencyHistogram.h"
+
+static atomic_uint_fast64_t buckets[LATENCY_BUCKETS];
+static atomic_uint_fast64_t samples;
+static atomic_uint_fast64_t longest;
+
+/*
+ * Function:    bucketOf
+ * Description: This function finds the bucket a latency is counted in.
+ * Parameters:  uint64_t nanoseconds: The latency
+ * Returns:     int: The bucket, the floor of its base 2 logarithm capped at the last bucket
+ */
+static int bucketOf(uint64_t nanoseconds)
+{
+	int bucket = nanoseconds == 0 ? 0 : 63 - __builtin_clzll(nanoseconds);
+	return bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1;
+}
+
+/*
+ * Function:    recordLatency
+ * Description: This function adds one measured latency to the histogram.
+ * Parameters:  uint64_t nanoseconds: The time from the sender's timestamp to the message's arrival
+ * Returns:     void
+ */
+void recordLatency(uint64_t nanoseconds)
+{
+	atomic_fetch_add_explicit(&buckets[bucketOf(nanoseconds)], 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&samples, 1, memory_order_relaxed);
+
+	uint64_t seen = atomic_load_explicit(&longest, memory_order_relaxed);
+	while (nanoseconds > seen &&
+	       !atomic_compare_exchange_weak_explicit(&longest, &seen, nanoseconds, memory_order_relaxed, memory_order_relaxed))
+	{
+		// seen was reloaded, try again while this one is still the longest
+	}
+}
+
+/*
+ * Function:    percentile
+ * Description: This function estimates a percentile from a snapshot of the buckets as the upper bound of the bucket
+ *              it falls in, so it is never understated.
+ * Parameters:  const uint64_t* counts: The bucket counts
+ *              uint64_t total: Their sum
+ *              double share: The percentile as a fraction, such as 0.99
+ * Returns:     uint64_t: The latency in nanoseconds
+ */
+static uint64_t percentile(const uint64_t* counts, uint64_t total, double share)
+{
+	uint64_t rank = (uint64_t)(share * total + 0.5);
+	uint64_t counted = 0;
+	for (int i = 0; i < LATENCY_BUCKETS; i++)
+	{
+		counted += counts[i];
+		if (counted >= rank && counts[i] > 0)
+		{
+			return (2ull << i) - 1;
+		}
+	}
+	return atomic_load_explicit(&longest, memory_order_relaxed);
+}
+
+/*
+ * Function:    describeLatency
+ * Description: This function writes the histogram as short lines that fit a message: a summary with the median,
+ *              99th percentile and maximum, then one line per bucket that has counts.
+ * Parameters:  char lines[][MAX_LATENCY_LINE_LENGTH]: Receives the lines
+ *              int maxLines: How many lines fit, MAX_LATENCY_LINES holds them all
+ * Returns:     int: The number of lines written
+ */
+int describeLatency(char lines[][MAX_LATENCY_LINE_LENGTH], int maxLines)
+{
+	uint64_t counts[LATENCY_BUCKETS];
+	uint64_t total = 0;
+	for (int i = 0; i < LATENCY_BUCKETS; i++)
+	{
+		counts[i] = atomic_load_explicit(&buckets[i], memory_order_relaxed);
+		total += counts[i];
+	}
+
+	int written = 0;
+	if (written < maxLines)
+	{
+		snprintf(lines[written++], MAX_LATENCY_LINE_LENGTH, "Latency of %" PRIu64 " messages", total);
+	}
+	if (total == 0)
+	{
+		return written;
+	}
+
+	char median[MAX_LATENCY_TEXT];
+	char tail[MAX_LATENCY_TEXT];
+	char maximum[MAX_LATENCY_TEXT];
+	formatLatency(percentile(counts, total, 0.5), median, sizeof(median));
+	formatLatency(percentile(counts, total, 0.99), tail, sizeof(tail));
+	formatLatency(atomic_load_explicit(&longest, memory_order_relaxed), maximum, sizeof(maximum));
+	if (written < maxLines)
+	{
+		snprintf(lines[written++], MAX_LATENCY_LINE_LENGTH, "p50 <%s p99 <%s max %s", median, tail, maximum);
+	}
+
+	for (int i = 0; i < LATENCY_BUCKETS && written < maxLines; i++)
+	{
+		if (counts[i] > 0)
+		{
+			// the last bucket has no upper bound and is labelled with its lower one
+			bool last = i == LATENCY_BUCKETS - 1;
+			char bound[MAX_LATENCY_TEXT];
+			formatLatency(last ? 1ull << i : 2ull << i, bound, sizeof(bound));
+			snprintf(lines[written++], MAX_LATENCY_LINE_LENGTH, "%s%-8s %8" PRIu64 " %5.1f%%",
+			         last ? ">" : "<", bound, counts[i], 100.0 * counts[i] / total);
+		}
+	}
+	return written;
+}
@@ -9,9 +9,13 @@
 
 #include"../inc/socketService.h"
 #include "../inc/clientThreads.h"
+#include "../inc/multicastReceiver.h"
+#include "../inc/messageCache.h"
+#include "../inc/presenceRoster.h"
 
 // Initializing global shared resources
 pthread_mutex_t listenerMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t sendMutex = PTHREAD_MUTEX_INITIALIZER;
 int terminateListener = 0;
 
 int main(int argc, char *argv[]) 
@@ -36,6 +40,15 @@ int main(int argc, char *argv[])
 	char clientIp[MAX_IP_LENGTH];
 	getSocketIP(connectionResult, clientIp, MAX_IP_LENGTH);
 
+	// Each server keeps its own cache, a unix socket is told apart by its path
+	if (clientArgs.useCache)
+	{
+		const char* server = clientArgs.unixPath != NULL ? clientArgs.unixPath :
+		                     clientArgs.ipAddress != NULL ? clientArgs.ipAddress : clientArgs.serverName;
+		int port = clientArgs.unixPath != NULL ? 0 : clientArgs.useTls ? TLS_PORT_NUMBER : PORT_NUMBER;
+		openMessageCache(clientArgs.cacheDirectory, server, port); // without it the client starts empty as before
+	}
+
     int rows, cols;
     WINDOW *staticMessagesHeader, *staticOutgoingHeader, *messageWindow, *outgoingWindow;
     initializeUI(&rows, &cols, &staticMessagesHeader, &staticOutgoingHeader, &messageWindow, &outgoingWindow);
@@ -44,14 +57,21 @@ int main(int argc, char *argv[])
 	pthread_t sender;
 	MessageQueue incomingQueue;
 	queueInit(&incomingQueue);
+	loadMessageCache(&incomingQueue, MAX_MESSAGE_HISTORY); // the last screen is painted before the server answers
 	// initialization of listener arguments
 	ThreadArgs listenerArgs;
 	listenerArgs.serverSocket = connectionResult;
 	listenerArgs.queue = &incomingQueue;
+	listenerArgs.ip = clientIp;
+	listenerArgs.userName = clientArgs.userName;
+	listenerArgs.multicast = clientArgs.useMulticast;
+	listenerArgs.multicastInterface = clientArgs.multicastInterface;
+	listenerArgs.nameTaken = false;
 	// initialization of sender arguments 
 	ThreadArgs senderArgs;
 	senderArgs.serverSocket = connectionResult;
 	senderArgs.window = outgoingWindow;
+	senderArgs.queue = &incomingQueue;
 	senderArgs.ip = clientIp;
 	senderArgs.userName = clientArgs.userName;
 
@@ -79,6 +99,12 @@ int main(int argc, char *argv[])
 		while (dequeue(&incomingQueue, &incomingMessage))
 		{
 			printMessage(messageWindow, &incomingMessage, clientIp);
+			releaseMessage(&incomingMessage);
+		}
+		char rosterLine[MAX_BODY_LENGTH];
+		if (takeRosterLine(rosterLine, sizeof(rosterLine)))
+		{
+			printRoster(staticMessagesHeader, rosterLine);
 		}
 
 		pthread_mutex_lock(&listenerMutex);
@@ -94,10 +120,17 @@ int main(int argc, char *argv[])
 	// Clean up resources, threads, and ncurses UI
 	pthread_join(listener, NULL);
 	pthread_join(sender, NULL);
+	stopMulticastReceiver();
+	closeMessageCache();
 	close(connectionResult);
 	pthread_mutex_destroy(&listenerMutex);
 	freeQueue(&incomingQueue);
     endwin();
 
+	if (listenerArgs.nameTaken)
+	{
+		fprintf(stderr, "The user name %s is already connected to this server\n", clientArgs.userName);
+		return 1;
+	}
     return 0;
 }
\ No newline at end of file
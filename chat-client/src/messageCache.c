@@ -0,0 +1,263 @@
+/*
+ * Filename:    messageCache.c
+ * Project:     CanWeTalkSystem
+ * By:          Salman Nouman, Minchul Hwang, Md Saiful Islam, Saje-Antoine Rose
+ * Date:        October, 19, 2026
+ * Description: This file contains the on-disk message cache. Each server gets a file holding a ring of its most recent
+ *              messages, mapped into memory so that a message is cached with a copy and startup reads nothing but the
+ *              pages it shows. The file also remembers the sequence number of the newest message seen, so after
+ *              painting the cached messages the client only asks the server for the ones that came after it.
+ *              The file is locked while a client uses it; a second client of the same server runs without a cache.
+ */
+
+#include "../inc/messageCache.h"
+#include <inttypes.h>
+
+static MessageCacheFile* cache = NULL;
+static int cacheDescriptor = -1;
+static pthread_mutex_t cacheMutex = PTHREAD_MUTEX_INITIALIZER; // the listener and the multicast receiver both add messages
+
+/*
+ * Function:    cacheFilePath
+ * Description: This function builds the path of the cache file of a server, creating the default directory if needed.
+ *              Characters of the server name that do not belong in a file name are replaced.
+ * Parameters:  const char* directory: The cache directory, NULL for the default one
+ *              const char* server: The server name, address or unix socket path as given on the command line
+ *              int port: The port connected to, 0 for a unix socket
+ *              char* path: Receives the path
+ *              size_t size: Size of that buffer
+ * Returns:     bool: false if there is no directory to keep the cache in
+ */
+static bool cacheFilePath(const char* directory, const char* server, int port, char* path, size_t size)
+{
+	char defaultDirectory[MAX_CACHE_PATH_LENGTH];
+	char fileName[MAX_CACHE_PATH_LENGTH];
+
+	if (directory == NULL)
+	{
+		const char* base = getenv("XDG_CACHE_HOME");
+		if (base != NULL && base[0] != '\0')
+		{
+			snprintf(defaultDirectory, sizeof(defaultDirectory), "%s", base);
+		}
+		else if (getenv("HOME") != NULL)
+		{
+			snprintf(defaultDirectory, sizeof(defaultDirectory), "%s/.cache", getenv("HOME"));
+		}
+		else
+		{
+			return false;
+		}
+		mkdir(defaultDirectory, 0700);
+		size_t length = strlen(defaultDirectory);
+		snprintf(defaultDirectory + length, sizeof(defaultDirectory) - length, "/%s", MESSAGE_CACHE_DIRECTORY);
+		if (mkdir(defaultDirectory, 0700) != 0 && errno != EEXIST)
+		{
+			return false;
+		}
+		directory = defaultDirectory;
+	}
+
+	size_t length = 0;
+	for (const char* c = server; *c != '\0' && length < sizeof(fileName) - 1; c++)
+	{
+		bool safe = (*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') || (*c >= '0' && *c <= '9') || *c == '.' || *c == '-';
+		fileName[length++] = safe ? *c : '_';
+	}
+	fileName[length] = '\0';
+
+	return snprintf(path, size, "%s/%s-%d.cache", directory, fileName, port) < (int)size;
+}
+
+/*
+ * Function:    openMessageCache
+ * Description: This function maps the cache file of a server, creating it or starting it over when it is missing, of
+ *              another layout or damaged.
+ * Parameters:  const char* directory: The cache directory, NULL for the default one
+ *              const char* server: The server as given on the command line
+ *              int port: The port connected to, 0 for a unix socket
+ * Returns:     bool: false if the client has to run without a cache
+ */
+bool openMessageCache(const char* directory, const char* server, int port)
+{
+	char path[MAX_CACHE_PATH_LENGTH];
+
+	if (!cacheFilePath(directory, server, port, path, sizeof(path)))
+	{
+		return false;
+	}
+	int descriptor = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if (descriptor < 0)
+	{
+		return false;
+	}
+	if (flock(descriptor, LOCK_EX | LOCK_NB) != 0 || ftruncate(descriptor, sizeof(MessageCacheFile)) != 0)
+	{
+		close(descriptor); // another client of this server owns the file
+		return false;
+	}
+
+	MessageCacheFile* mapped = mmap(NULL, sizeof(MessageCacheFile), PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+	if (mapped == MAP_FAILED)
+	{
+		close(descriptor);
+		return false;
+	}
+	if (mapped->magic != MESSAGE_CACHE_MAGIC || mapped->version != MESSAGE_CACHE_VERSION ||
+		mapped->capacity != MESSAGE_CACHE_CAPACITY || mapped->count > MESSAGE_CACHE_CAPACITY || mapped->head >= MESSAGE_CACHE_CAPACITY)
+	{
+		memset(mapped, 0, sizeof(MessageCacheFile));
+		mapped->magic = MESSAGE_CACHE_MAGIC;
+		mapped->version = MESSAGE_CACHE_VERSION;
+		mapped->capacity = MESSAGE_CACHE_CAPACITY;
+	}
+
+	cache = mapped;
+	cacheDescriptor = descriptor;
+	return true;
+}
+
+/*
+ * Function:    messageCacheOpen
+ * Description: This function tells whether messages are being cached.
+ * Parameters:  void
+ * Returns:     bool: true once openMessageCache succeeded
+ */
+bool messageCacheOpen(void)
+{
+	return cache != NULL;
+}
+
+/*
+ * Function:    loadMessageCache
+ * Description: This function hands the newest cached messages, oldest first, to the UI thread with the time they
+ *              first arrived.
+ * Parameters:  MessageQueue* queue: The queue the UI thread prints from
+ *              int newest: How many messages to show at most
+ * Returns:     int: The number of messages queued
+ */
+int loadMessageCache(MessageQueue* queue, int newest)
+{
+	if (cache == NULL)
+	{
+		return 0;
+	}
+
+	pthread_mutex_lock(&cacheMutex);
+	int shown = (int)cache->count < newest ? (int)cache->count : newest;
+	for (int i = 0; i < shown; i++)
+	{
+		CachedMessage* record = &cache->records[(cache->head + MESSAGE_CACHE_CAPACITY - shown + i) % MESSAGE_CACHE_CAPACITY];
+		Message chatMessage;
+		record->serialized[MAX_SERIALIZED_LENGTH - 1] = '\0'; // the file may have been damaged
+		deserializeMessage(&chatMessage, record->serialized);
+		chatMessage.receivedNanoseconds = record->receivedNanoseconds;
+		enqueue(queue, &chatMessage); // the UI thread releases it after printing
+	}
+	pthread_mutex_unlock(&cacheMutex);
+	return shown;
+}
+
+/*
+ * Function:    buildHistoryRequest
+ * Description: This function builds the >>since<< asking the server for the messages after the newest one cached.
+ * Parameters:  char* body: Receives the message body
+ *              size_t size: Size of that buffer
+ * Returns:     void
+ */
+void buildHistoryRequest(char* body, size_t size)
+{
+	pthread_mutex_lock(&cacheMutex);
+	snprintf(body, size, HISTORY_REQUEST_PREFIX "%" PRIu64 " %" PRIu64 " %d", cache->epoch, cache->highWater, MESSAGE_CACHE_CAPACITY);
+	pthread_mutex_unlock(&cacheMutex);
+}
+
+/*
+ * Function:    buildMailboxHello
+ * Description: This function builds the >>hello<< naming the user to the server. It carries the same position as the
+ *              >>since<< that follows it, so that the server leaves out of the user's mailbox what the replay brings;
+ *              without a cache it carries zeros.
+ * Parameters:  char* body: Receives the message body
+ *              size_t size: Size of that buffer
+ *              const char* userName: The user
+ * Returns:     void
+ */
+void buildMailboxHello(char* body, size_t size, const char* userName)
+{
+	if (cache == NULL)
+	{
+		snprintf(body, size, MAILBOX_HELLO_PREFIX "0 0 0 %s", userName);
+		return;
+	}
+	pthread_mutex_lock(&cacheMutex);
+	snprintf(body, size, MAILBOX_HELLO_PREFIX "%" PRIu64 " %" PRIu64 " %d %s", cache->epoch, cache->highWater, MESSAGE_CACHE_CAPACITY, userName);
+	pthread_mutex_unlock(&cacheMutex);
+}
+
+/*
+ * Function:    syncMessageCache
+ * Description: This function records the numbering the server answered a >>since<< with, once the replay is over.
+ * Parameters:  uint64_t epoch: The server's epoch
+ *              uint64_t nextSequence: The sequence number of the next live message
+ * Returns:     void
+ */
+void syncMessageCache(uint64_t epoch, uint64_t nextSequence)
+{
+	if (cache == NULL)
+	{
+		return;
+	}
+	pthread_mutex_lock(&cacheMutex);
+	cache->epoch = epoch;
+	cache->highWater = nextSequence - 1;
+	pthread_mutex_unlock(&cacheMutex);
+}
+
+/*
+ * Function:    cacheMessage
+ * Description: This function adds a message to the cache, overwriting the oldest one once the cache is full.
+ * Parameters:  uint64_t sequence: The sequence number the server gave it
+ *              const char* serializedMessage: The message as the server serialized it
+ *              uint64_t receivedNanoseconds: When it arrived, 0 if it was replayed
+ * Returns:     void
+ */
+void cacheMessage(uint64_t sequence, const char* serializedMessage, uint64_t receivedNanoseconds)
+{
+	if (cache == NULL)
+	{
+		return;
+	}
+	pthread_mutex_lock(&cacheMutex);
+	CachedMessage* record = &cache->records[cache->head];
+	record->sequence = sequence;
+	record->receivedNanoseconds = receivedNanoseconds;
+	snprintf(record->serialized, sizeof(record->serialized), "%s", serializedMessage);
+	cache->head = (cache->head + 1) % MESSAGE_CACHE_CAPACITY;
+	if (cache->count < MESSAGE_CACHE_CAPACITY)
+	{
+		cache->count++;
+	}
+	if (sequence > cache->highWater)
+	{
+		cache->highWater = sequence;
+	}
+	pthread_mutex_unlock(&cacheMutex);
+}
+
+/*
+ * Function:    closeMessageCache
+ * Description: This function unmaps the cache file and releases its lock. The kernel writes the pages back on its own.
+ * Parameters:  void
+ * Returns:     void
+ */
+void closeMessageCache(void)
+{
+	if (cache == NULL)
+	{
+		return;
+	}
+	munmap(cache, sizeof(MessageCacheFile));
+	close(cacheDescriptor);
+	cache = NULL;
+	cacheDescriptor = -1;
+}
@@ -0,0 +1,302 @@
+/*
+ * Filename:    multicastReceiver.c
+ * Project:     CanWeTalkSystem
+ * By:          Salman Nouman, Minchul Hwang, Md Saiful Islam, Saje-Antoine Rose
+ * Date:        October, 19, 2026
+ * Description: This file contains the chat-client's multicast receiver. Once the server accepted a >>mcast<< request
+ *              it stops sending broadcasts over the TCP connection and this thread reads them from the multicast group.
+ *              Every datagram carries a sequence number: messages are displayed strictly in that order, those that
+ *              arrive early are held back, and missing ones are asked for with >>nack<< and come back over TCP.
+ */
+
+#include "../inc/multicastReceiver.h"
+
+static MulticastReceiver receiver;
+
+/*
+ * Function:    advanceTo
+ * Description: This function moves the expected sequence number forward, displaying the held messages it passes and
+ *              giving up on the missing ones. The caller holds the receiver lock.
+ * Parameters:  uint64_t sequence: The new expected sequence number
+ * Returns:     void
+ */
+static void advanceTo(uint64_t sequence)
+{
+	while (receiver.expected < sequence)
+	{
+		int slot = receiver.expected & (MULTICAST_REORDER_WINDOW - 1);
+		if (receiver.held[slot] != NULL && receiver.heldSequence[slot] == receiver.expected)
+		{
+			deliverSequenced(receiver.args->queue, receiver.expected, receiver.held[slot]);
+		}
+		free(receiver.held[slot]);
+		receiver.held[slot] = NULL;
+		receiver.expected++;
+	}
+}
+
+/*
+ * Function:    drainHeld
+ * Description: This function displays the held messages that directly follow the last one displayed. The caller holds
+ *              the receiver lock.
+ * Parameters:  void
+ * Returns:     void
+ */
+static void drainHeld(void)
+{
+	int slot = receiver.expected & (MULTICAST_REORDER_WINDOW - 1);
+	while (receiver.held[slot] != NULL && receiver.heldSequence[slot] == receiver.expected)
+	{
+		advanceTo(receiver.expected + 1);
+		slot = receiver.expected & (MULTICAST_REORDER_WINDOW - 1);
+	}
+}
+
+/*
+ * Function:    acceptSequenced
+ * Description: This function takes a message with its sequence number, from a datagram or a repair. It is displayed at
+ *              once if it is the next one, held back if an earlier one is still missing, and dropped if it was shown
+ *              already. A message too far ahead to hold gives up on the gap. The caller holds the receiver lock.
+ * Parameters:  uint64_t sequence: Its sequence number
+ *              const char* serializedMessage: The message
+ * Returns:     void
+ */
+static void acceptSequenced(uint64_t sequence, const char* serializedMessage)
+{
+	if (sequence < receiver.expected)
+	{
+		return; // a duplicate or a late repair
+	}
+	if (sequence > receiver.highestKnown)
+	{
+		receiver.highestKnown = sequence;
+	}
+	if (sequence >= receiver.expected + MULTICAST_REORDER_WINDOW)
+	{
+		advanceTo(sequence - MULTICAST_REORDER_WINDOW + 1);
+	}
+
+	if (sequence == receiver.expected)
+	{
+		deliverSequenced(receiver.args->queue, sequence, serializedMessage);
+		receiver.expected++;
+	}
+	else
+	{
+		int slot = sequence & (MULTICAST_REORDER_WINDOW - 1);
+		if (receiver.held[slot] == NULL)
+		{
+			receiver.held[slot] = strdup(serializedMessage);
+			receiver.heldSequence[slot] = sequence;
+		}
+	}
+	drainHeld();
+}
+
+/*
+ * Function:    requestMissing
+ * Description: This function asks the server for the sequence numbers between the last one displayed and the highest
+ *              one known, at most once per MULTICAST_NACK_INTERVAL_MILLISECONDS so that a repair in flight is not
+ *              asked for again straight away.
+ * Parameters:  void
+ * Returns:     void
+ */
+static void requestMissing(void)
+{
+	uint64_t first = 0;
+	uint64_t last = 0;
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	pthread_mutex_lock(&receiver.lock);
+	long sinceNack = (now.tv_sec - receiver.lastNack.tv_sec) * 1000 + (now.tv_nsec - receiver.lastNack.tv_nsec) / 1000000;
+	if (receiver.highestKnown >= receiver.expected && sinceNack >= MULTICAST_NACK_INTERVAL_MILLISECONDS)
+	{
+		first = receiver.expected;
+		last = receiver.highestKnown < first + MULTICAST_REORDER_WINDOW ? receiver.highestKnown : first + MULTICAST_REORDER_WINDOW - 1;
+		receiver.lastNack = now;
+	}
+	pthread_mutex_unlock(&receiver.lock);
+	if (first == 0)
+	{
+		return;
+	}
+
+	char body[MAX_PARCEL_LENGTH + MAX_PARCEL_LENGTH];
+	snprintf(body, sizeof(body), MULTICAST_NACK_PREFIX "%" PRIu64 " %" PRIu64, first, last);
+	sendControl(receiver.args, body);
+}
+
+/*
+ * Function:    multicastReceiverThread
+ * Description: This function reads datagrams from the group until the client terminates. The receive timeout lets it
+ *              notice termination and ask again for repairs that did not arrive.
+ * Parameters:  void* arg: Unused
+ * Returns:     void*: NULL
+ */
+static void* multicastReceiverThread(void* arg)
+{
+	(void)arg;
+	char datagram[MAX_DATAGRAM_LENGTH + 1];
+
+	while (true)
+	{
+		pthread_mutex_lock(&listenerMutex);
+		int terminate = terminateListener;
+		pthread_mutex_unlock(&listenerMutex);
+		if (terminate)
+		{
+			break;
+		}
+
+		char type;
+		uint64_t sequence;
+		const char* payload;
+		ssize_t received = recv(receiver.socket, datagram, MAX_DATAGRAM_LENGTH, 0);
+		if (received > 0 && decodeDatagram(datagram, received, &type, &sequence, &payload))
+		{
+			pthread_mutex_lock(&receiver.lock);
+			if (type == MULTICAST_DATA)
+			{
+				acceptSequenced(sequence, payload);
+			}
+			else if (sequence > receiver.highestKnown)
+			{
+				receiver.highestKnown = sequence;
+			}
+			pthread_mutex_unlock(&receiver.lock);
+		}
+		requestMissing();
+	}
+	return NULL;
+}
+
+/*
+ * Function:    startMulticastReceiver
+ * Description: This function joins the group the server offered and starts reading from it.
+ * Parameters:  ThreadArgs* args: The listener arguments holding the queue, socket, ip and user name
+ *              const char* offer: The offer after its prefix: "<group> <port> <first sequence number>"
+ * Returns:     bool: false if the offer is malformed or the group cannot be joined
+ */
+bool startMulticastReceiver(ThreadArgs* args, const char* offer)
+{
+	char group[INET_ADDRSTRLEN];
+	int port;
+	uint64_t first;
+	struct sockaddr_in groupAddress;
+	struct ip_mreq membership;
+	struct timeval timeout = { 0, MULTICAST_RECEIVE_TIMEOUT_MILLISECONDS * 1000 };
+	int reuse = 1;
+
+	if (receiver.running || sscanf(offer, "%15s %d %" SCNu64, group, &port, &first) != 3 || first == 0)
+	{
+		return false;
+	}
+	memset(&groupAddress, 0, sizeof(groupAddress));
+	groupAddress.sin_family = AF_INET;
+	groupAddress.sin_port = htons(port);
+	membership.imr_interface.s_addr = htonl(INADDR_ANY);
+	if (inet_pton(AF_INET, group, &groupAddress.sin_addr) != 1 ||
+		(args->multicastInterface != NULL && inet_pton(AF_INET, args->multicastInterface, &membership.imr_interface) != 1))
+	{
+		return false;
+	}
+	membership.imr_multiaddr = groupAddress.sin_addr;
+
+	// Bound to the group address, so that other traffic to the port is not received
+	int multicastSocket = socket(AF_INET, SOCK_DGRAM, 0);
+	if (multicastSocket < 0 ||
+		setsockopt(multicastSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) < 0 ||
+		bind(multicastSocket, (struct sockaddr*)&groupAddress, sizeof(groupAddress)) < 0 ||
+		setsockopt(multicastSocket, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) < 0 ||
+		setsockopt(multicastSocket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0)
+	{
+		if (multicastSocket >= 0)
+		{
+			close(multicastSocket);
+		}
+		return false;
+	}
+
+	pthread_mutex_init(&receiver.lock, NULL);
+	receiver.socket = multicastSocket;
+	receiver.expected = first;
+	receiver.highestKnown = first - 1;
+	receiver.args = args;
+	if (pthread_create(&receiver.thread, NULL, multicastReceiverThread, NULL) != 0)
+	{
+		close(multicastSocket);
+		pthread_mutex_destroy(&receiver.lock);
+		return false;
+	}
+	receiver.running = true;
+	return true;
+}
+
+/*
+ * Function:    repairMulticast
+ * Description: This function takes a message the server resent over TCP after a >>nack<<.
+ * Parameters:  const char* repair: The repair after its prefix: "<sequence number> <serialized message>"
+ * Returns:     void
+ */
+void repairMulticast(const char* repair)
+{
+	uint64_t sequence;
+	int consumed = 0;
+
+	if (!receiver.running || sscanf(repair, "%" SCNu64 " %n", &sequence, &consumed) != 1 || consumed == 0)
+	{
+		return;
+	}
+	pthread_mutex_lock(&receiver.lock);
+	acceptSequenced(sequence, repair + consumed);
+	pthread_mutex_unlock(&receiver.lock);
+}
+
+/*
+ * Function:    skipLostMulticast
+ * Description: This function stops waiting for messages the server can no longer resend.
+ * Parameters:  const char* lost: The notice after its prefix: "<first> <last>"
+ * Returns:     void
+ */
+void skipLostMulticast(const char* lost)
+{
+	uint64_t first;
+	uint64_t last;
+
+	if (!receiver.running || sscanf(lost, "%" SCNu64 " %" SCNu64, &first, &last) != 2)
+	{
+		return;
+	}
+	pthread_mutex_lock(&receiver.lock);
+	if (first <= receiver.expected && last >= receiver.expected)
+	{
+		advanceTo(last + 1);
+		drainHeld();
+	}
+	pthread_mutex_unlock(&receiver.lock);
+}
+
+/*
+ * Function:    stopMulticastReceiver
+ * Description: This function waits for the receiver thread, which ends once terminateListener is set, and leaves the
+ *              group.
+ * Parameters:  void
+ * Returns:     void
+ */
+void stopMulticastReceiver(void)
+{
+	if (!receiver.running)
+	{
+		return;
+	}
+	pthread_join(receiver.thread, NULL);
+	close(receiver.socket);
+	for (int i = 0; i < MULTICAST_REORDER_WINDOW; i++)
+	{
+		free(receiver.held[i]);
+		receiver.held[i] = NULL;
+	}
+	pthread_mutex_destroy(&receiver.lock);
+	receiver.running = false;
+}
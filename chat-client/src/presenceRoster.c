@@ -0,0 +1,177 @@
+/*
+ * Filename:    presenceRoster.c
+ * Project:     CanWeTalkSystem
+ * By:          Salman Nouman, Minchul Hwang, Md Saiful Islam, Saje-Antoine Rose
+ * Date:        October, 19, 2026
+ * Description: This file contains the presence roster. The listener fills it from the roster the server sends once and
+ *              then applies every delta that leads on from the version it holds; one it has already seen is ignored,
+ *              and after a gap the roster is asked for again. The UI thread redraws the line of names when it changed.
+ */
+
+#include "../inc/presenceRoster.h"
+
+static pthread_mutex_t rosterMutex = PTHREAD_MUTEX_INITIALIZER;
+static char names[ROSTER_MAX_NAMES][MAX_USERNAME_LENGTH];	// under rosterMutex, like everything below
+static int nameCount = 0;
+static uint64_t version = 0;
+static bool synced = false;		// a whole roster arrived and no delta went missing since
+static bool receiving = false;	// between the first and the last part of a roster
+static bool changed = false;	// not drawn yet
+
+/*
+ * Function:    findName
+ * Description: This function looks a user up on the roster. Caller holds rosterMutex.
+ * Parameters:  const char* name: The username
+ * Returns:     int: Its index, -1 if it is not listed
+ */
+static int findName(const char* name)
+{
+	for (int i = 0; i < nameCount; i++)
+	{
+		if (strcmp(names[i], name) == 0)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+/*
+ * Function:    addName
+ * Description: This function lists a user, unless it already is. Caller holds rosterMutex.
+ * Parameters:  const char* name: The username
+ * Returns:     void
+ */
+static void addName(const char* name)
+{
+	if (findName(name) < 0 && nameCount < ROSTER_MAX_NAMES)
+	{
+		snprintf(names[nameCount++], MAX_USERNAME_LENGTH, "%s", name);
+	}
+}
+
+/*
+ * Function:    removeName
+ * Description: This function takes a user off the roster. Caller holds rosterMutex.
+ * Parameters:  const char* name: The username
+ * Returns:     void
+ */
+static void removeName(const char* name)
+{
+	int index = findName(name);
+	if (index >= 0)
+	{
+		memcpy(names[index], names[--nameCount], MAX_USERNAME_LENGTH);
+	}
+}
+
+/*
+ * Function:    applyRosterPart
+ * Description: This function takes one part of the roster the server answered >>roster?<< with. The first part
+ *              replaces whatever was listed, the last one makes its version the current one.
+ * Parameters:  const char* payload: The part after its prefix
+ * Returns:     void
+ */
+void applyRosterPart(const char* payload)
+{
+	uint64_t partVersion;
+	char flag;
+	int offset = 0;
+
+	if (sscanf(payload, "%" SCNu64 " %c%n", &partVersion, &flag, &offset) != 2)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&rosterMutex);
+	if (!receiving)
+	{
+		nameCount = 0;
+		receiving = true;
+	}
+	char name[MAX_USERNAME_LENGTH];
+	int used = 0;
+	for (const char* cursor = payload + offset; sscanf(cursor, "%5s%n", name, &used) == 1; cursor += used) // MAX_USERNAME_LENGTH - 1
+	{
+		addName(name);
+	}
+	if (flag == PRESENCE_LAST_PART)
+	{
+		receiving = false;
+		version = partVersion;
+		synced = true;
+		changed = true;
+	}
+	pthread_mutex_unlock(&rosterMutex);
+}
+
+/*
+ * Function:    applyPresenceDelta
+ * Description: This function applies a delta that leads on from the version held. One that is not newer is ignored,
+ *              as is everything while a roster is awaited.
+ * Parameters:  const char* payload: The delta after its prefix
+ * Returns:     bool: false if a delta went missing and the roster must be asked for again
+ */
+bool applyPresenceDelta(const char* payload)
+{
+	uint64_t from;
+	uint64_t to;
+	int offset = 0;
+
+	if (sscanf(payload, "%" SCNu64 " %" SCNu64 "%n", &from, &to, &offset) != 2)
+	{
+		return true;
+	}
+
+	pthread_mutex_lock(&rosterMutex);
+	bool inOrder = true;
+	if (synced && from == version)
+	{
+		char entry[MAX_USERNAME_LENGTH + 1];
+		int used = 0;
+		for (const char* cursor = payload + offset; sscanf(cursor, "%6s%n", entry, &used) == 1; cursor += used) // a sign and a name
+		{
+			if (entry[0] == PRESENCE_JOINED)
+			{
+				addName(entry + 1);
+			}
+			else if (entry[0] == PRESENCE_LEFT)
+			{
+				removeName(entry + 1);
+			}
+		}
+		version = to;
+		changed = true;
+	}
+	else if (synced && to > version)
+	{
+		synced = false; // nothing more is applied until the roster came again
+		inOrder = false;
+	}
+	pthread_mutex_unlock(&rosterMutex);
+	return inOrder;
+}
+
+/*
+ * Function:    takeRosterLine
+ * Description: This function writes the line of names to show, if the roster changed since it was last taken.
+ * Parameters:  char* line: Receives the line
+ *              size_t size: Its size
+ * Returns:     bool: true if the line was written and has to be drawn
+ */
+bool takeRosterLine(char* line, size_t size)
+{
+	pthread_mutex_lock(&rosterMutex);
+	bool redraw = changed;
+	if (redraw)
+	{
+		size_t length = snprintf(line, size, "%s (%d):", ROSTER_LABEL, nameCount);
+		for (int i = 0; i < nameCount && length < size; i++)
+		{
+			length += snprintf(line + length, size - length, " %s", names[i]);
+		}
+		changed = false;
+	}
+	pthread_mutex_unlock(&rosterMutex);
+	return redraw;
+}
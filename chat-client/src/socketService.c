@@ -6,79 +6,291 @@
  * Description: This file contains functionality to handle the socket opertations with the server on the client end.
  */
 
+#define _GNU_SOURCE // getaddrinfo_a
 #include "../inc/socketService.h"
 
+// The two asynchronous lookups of one connect, kept together on the heap
+typedef struct LookupRequests
+{
+    char host[MAX_HOST_LENGTH];
+    char service[MAX_SERVICE_LENGTH];
+    struct addrinfo hints[LOOKUP_COUNT];
+    struct gaicb requests[LOOKUP_COUNT];
+    struct gaicb* list[LOOKUP_COUNT];
+} LookupRequests;
+
+// Resolved addresses of one family in the order the resolver returned them
+typedef struct ConnectCandidates
+{
+    struct sockaddr_storage addresses[MAX_CONNECT_CANDIDATES];
+    socklen_t lengths[MAX_CONNECT_CANDIDATES];
+    int count;
+} ConnectCandidates;
+
+
+/*
+ * Function:    monotonicMilliseconds
+ * Description: Returns a monotonic clock reading used to pace connection attempts
+ * Parameters:  void
+ * Returns:     long long: Milliseconds since an arbitrary point
+ */
+static long long monotonicMilliseconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
 
 /*
- * Function:    resolveServerName
- * Description: Resolves the given name of the server to an actual ip address
- * Parameters:  char* serverName: The given name of a server
- *              char* ipAddress: The buffer to contain the ip address
+ * Function:    collectAddresses
+ * Description: Moves the addresses of a finished lookup into the candidate list of its family
+ * Parameters:  struct gaicb* request: The finished lookup
+ *              ConnectCandidates* candidates: The candidate list of that family
  * Returns:     void
  */
-void resolveServerName(char *serverName, char* ipAddress) 
+static void collectAddresses(struct gaicb* request, ConnectCandidates* candidates)
 {
-    struct hostent *hostEntry;
-    struct in_addr **addrList;
-    
-    if ((hostEntry = gethostbyname(serverName)) == NULL) 
+    if (gai_error(request) != 0)
     {
-        herror("gethostbyname");
-        exit(EXIT_FAILURE);
+        return; // no addresses of this family, the other one may still have some
     }
-
-    addrList = (struct in_addr **)hostEntry->h_addr_list;
-    if (addrList[FIRST_IP_ADDY_IN_LIST] == NULL) 
+    for (struct addrinfo* entry = request->ar_result; entry != NULL && candidates->count < MAX_CONNECT_CANDIDATES; entry = entry->ai_next)
     {
-        fprintf(stderr, "No IP address found for server name: %s\n", serverName);
-        exit(EXIT_FAILURE);
+        memcpy(&candidates->addresses[candidates->count], entry->ai_addr, entry->ai_addrlen);
+        candidates->lengths[candidates->count] = entry->ai_addrlen;
+        candidates->count++;
     }
+    freeaddrinfo(request->ar_result);
+    request->ar_result = NULL;
+}
 
-    // Copy IP address to buffer
-    const char* ipAddressStr = inet_ntoa(*addrList[FIRST_IP_ADDY_IN_LIST]);
-    size_t ipAddressLength = strlen(ipAddressStr);
-    if (ipAddressLength >= MAX_IP_LENGTH) 
+/*
+ * Function:    startAttempt
+ * Description: Starts a non-blocking connect to one candidate address
+ * Parameters:  const struct sockaddr_storage* address: The address to connect to
+ *              socklen_t length: Its length
+ * Returns:     int: The connecting socket descriptor or an error value
+ */
+static int startAttempt(const struct sockaddr_storage* address, socklen_t length)
+{
+    int socketDescriptor = socket(address->ss_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (socketDescriptor < 0)
     {
-        fprintf(stderr, "IP address exceeds maximum length: %s\n", ipAddressStr);
-        exit(EXIT_FAILURE);
+        return SOCKET_ERROR;
     }
-
-    strcpy(ipAddress, ipAddressStr);
+    if (connect(socketDescriptor, (const struct sockaddr *)address, length) < 0 && errno != EINPROGRESS)
+    {
+        close(socketDescriptor);
+        return SOCKET_ERROR;
+    }
+    return socketDescriptor;
 }
 
-
 /*
  * Function:    connectToServer
- * Description: This function connects the client to the server via the use of sockets
- * Parameters:  char* serverIp: The IP address of the server.
+ * Description: This function connects the client to the server by name or address literal. The IPv6 and IPv4 lookups run
+ *              asynchronously side by side, and connection attempts start as soon as the first addresses are known. The
+ *              attempts alternate between the families and a new one starts every CONNECTION_ATTEMPT_DELAY_MILLISECONDS
+ *              (or as soon as one fails) while the earlier ones keep running; the first to complete wins (Happy Eyeballs,
+ *              RFC 8305). A slow lookup or an unreachable address therefore only costs the delay, not a full timeout.
+ * Parameters:  const char* host: The name or IP address of the server.
+ *              int port: The port of the server
  * Returns:     int: The socket descriptor or an error value
  */
-int connectToServer(char *serverIP) 
+int connectToServer(const char *host, int port) 
 {
-    int socketDescriptor;
+    char service[MAX_SERVICE_LENGTH];
+    snprintf(service, sizeof(service), "%d", port);
 
-    // Create a socket for communication
-    if ((socketDescriptor = socket(AF_INET, SOCK_STREAM, 0)) < 0) 
+    // The lookups may outlive this function if they are still running when a connection wins; see the clean up below
+    LookupRequests* lookups = calloc(1, sizeof(LookupRequests));
+    if (lookups == NULL)
     {
-        perror("Socket creation failed");
+        perror("malloc failed");
+        return SOCKET_ERROR;
+    }
+    lookups->hints[IPV6_LOOKUP].ai_family = AF_INET6;
+    lookups->hints[IPV4_LOOKUP].ai_family = AF_INET;
+    for (int i = 0; i < LOOKUP_COUNT; i++)
+    {
+        lookups->hints[i].ai_socktype = SOCK_STREAM;
+        lookups->hints[i].ai_flags = AI_ADDRCONFIG;
+        lookups->requests[i].ar_name = lookups->host;
+        lookups->requests[i].ar_service = lookups->service;
+        lookups->requests[i].ar_request = &lookups->hints[i];
+        lookups->list[i] = &lookups->requests[i];
+    }
+    strncpy(lookups->host, host, sizeof(lookups->host) - 1);
+    strcpy(lookups->service, service);
+    if (getaddrinfo_a(GAI_NOWAIT, lookups->list, LOOKUP_COUNT, NULL) != 0)
+    {
+        fprintf(stderr, "Unable to start resolving %s\n", host);
+        free(lookups);
         return SOCKET_ERROR;
     }
 
-    // Initialize server address structure
-    struct sockaddr_in serverAddress;
-    memset(&serverAddress, 0, sizeof(serverAddress));
-    serverAddress.sin_family = AF_INET;
-    serverAddress.sin_port = htons(PORT_NUMBER);
+    ConnectCandidates candidates[LOOKUP_COUNT];
+    int nextCandidate[LOOKUP_COUNT] = { 0, 0 };
+    bool resolved[LOOKUP_COUNT] = { false, false };
+    int attempts[MAX_CONNECT_CANDIDATES * LOOKUP_COUNT];
+    int attemptCount = 0;
+    int inFlight = 0;
+    int lastFamily = IPV4_LOOKUP; // so that IPv6 goes first
+    int winner = SOCKET_ERROR;
+    long long started = monotonicMilliseconds();
+    long long ipv4ResolvedAt = -1;
+    long long nextAttemptAt = 0;
+    memset(candidates, 0, sizeof(candidates));
 
-    // Convert IP address from string to network byte order
-    if (inet_pton(AF_INET, serverIP, &serverAddress.sin_addr) <= 0) 
+    while (winner == SOCKET_ERROR)
     {
-        perror("Invalid address/ Address not supported");
-        close(socketDescriptor);
+        long long now = monotonicMilliseconds();
+        for (int i = 0; i < LOOKUP_COUNT; i++)
+        {
+            if (!resolved[i] && gai_error(&lookups->requests[i]) != EAI_INPROGRESS)
+            {
+                resolved[i] = true;
+                collectAddresses(&lookups->requests[i], &candidates[i]);
+                if (i == IPV4_LOOKUP)
+                {
+                    ipv4ResolvedAt = now;
+                }
+            }
+        }
+
+        bool remaining = nextCandidate[IPV6_LOOKUP] < candidates[IPV6_LOOKUP].count || nextCandidate[IPV4_LOOKUP] < candidates[IPV4_LOOKUP].count;
+        bool lookupsDone = resolved[IPV6_LOOKUP] && resolved[IPV4_LOOKUP];
+        if ((!remaining && lookupsDone && inFlight == 0) || now - started > CONNECT_TIMEOUT_MILLISECONDS)
+        {
+            break;
+        }
+
+        // IPv4 answers alone are held back briefly in case IPv6 ones are about to arrive
+        bool mayStart = resolved[IPV6_LOOKUP] || (ipv4ResolvedAt >= 0 && now - ipv4ResolvedAt >= RESOLUTION_DELAY_MILLISECONDS);
+        if (remaining && mayStart && (inFlight == 0 || now >= nextAttemptAt))
+        {
+            int family = 1 - lastFamily;
+            if (nextCandidate[family] >= candidates[family].count)
+            {
+                family = lastFamily;
+            }
+            int index = nextCandidate[family]++;
+            int attempt = startAttempt(&candidates[family].addresses[index], candidates[family].lengths[index]);
+            lastFamily = family;
+            if (attempt != SOCKET_ERROR)
+            {
+                attempts[attemptCount++] = attempt;
+                inFlight++;
+                nextAttemptAt = now + CONNECTION_ATTEMPT_DELAY_MILLISECONDS;
+            }
+            continue;
+        }
+
+        // Wait for an attempt to finish, the next attempt to be due, or a lookup to complete
+        long long wait = CONNECT_TIMEOUT_MILLISECONDS - (now - started);
+        if (remaining && inFlight > 0 && nextAttemptAt - now < wait)
+        {
+            wait = nextAttemptAt - now;
+        }
+        if ((!lookupsDone || (remaining && !mayStart)) && wait > LOOKUP_POLL_MILLISECONDS)
+        {
+            wait = LOOKUP_POLL_MILLISECONDS;
+        }
+        struct pollfd pollAttempts[MAX_CONNECT_CANDIDATES * LOOKUP_COUNT];
+        for (int i = 0; i < attemptCount; i++)
+        {
+            pollAttempts[i].fd = attempts[i];
+            pollAttempts[i].events = POLLOUT;
+            pollAttempts[i].revents = 0;
+        }
+        if (poll(pollAttempts, attemptCount, wait < 0 ? 0 : (int)wait) <= 0)
+        {
+            continue;
+        }
+        for (int i = 0; i < attemptCount && winner == SOCKET_ERROR; i++)
+        {
+            if (attempts[i] < 0 || pollAttempts[i].revents == 0)
+            {
+                continue;
+            }
+            int error = 0;
+            socklen_t errorLength = sizeof(error);
+            getsockopt(attempts[i], SOL_SOCKET, SO_ERROR, &error, &errorLength);
+            if (error == 0)
+            {
+                winner = attempts[i];
+            }
+            else
+            {
+                close(attempts[i]);
+                nextAttemptAt = 0; // a failed attempt makes room for the next one right away
+            }
+            attempts[i] = -1;
+            inFlight--;
+        }
+    }
+
+    // Losing attempts are abandoned, the server sees them as connections that closed before saying anything
+    for (int i = 0; i < attemptCount; i++)
+    {
+        if (attempts[i] >= 0)
+        {
+            close(attempts[i]);
+        }
+    }
+    bool lookupsRunning = false;
+    for (int i = 0; i < LOOKUP_COUNT; i++)
+    {
+        if (!resolved[i] && gai_cancel(&lookups->requests[i]) == EAI_NOTCANCELED)
+        {
+            lookupsRunning = true;
+        }
+        else if (!resolved[i] && gai_error(&lookups->requests[i]) == 0)
+        {
+            freeaddrinfo(lookups->requests[i].ar_result);
+        }
+    }
+    if (!lookupsRunning)
+    {
+        free(lookups); // a lookup that cannot be cancelled still writes into it, so it is left behind in that case
+    }
+
+    if (winner == SOCKET_ERROR)
+    {
+        fprintf(stderr, "Connection failed: no address of %s accepted a connection\n", host);
         return SOCKET_ERROR;
     }
+    // The rest of the client uses blocking sockets
+    int flags = fcntl(winner, F_GETFL);
+    fcntl(winner, F_SETFL, flags & ~O_NONBLOCK);
+    return winner;
+}
 
-    // Connect to the server
+/*
+ * Function:    connectToUnixSocket
+ * Description: This function connects the client to a server on the same host through its unix domain socket
+ * Parameters:  const char* path: The filesystem path of the server's socket
+ * Returns:     int: The socket descriptor or an error value
+ */
+int connectToUnixSocket(const char *path) 
+{
+    struct sockaddr_un serverAddress;
+    if (strlen(path) >= sizeof(serverAddress.sun_path))
+    {
+        fprintf(stderr, "Unix socket path too long: %s\n", path);
+        return SOCKET_ERROR;
+    }
+
+    int socketDescriptor = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (socketDescriptor < 0) 
+    {
+        perror("Socket creation failed");
+        return SOCKET_ERROR;
+    }
+
+    memset(&serverAddress, 0, sizeof(serverAddress));
+    serverAddress.sun_family = AF_UNIX;
+    strcpy(serverAddress.sun_path, path);
     if (connect(socketDescriptor, (struct sockaddr *)&serverAddress, sizeof(serverAddress)) < 0) 
     {
         perror("Connection failed");
@@ -91,22 +303,36 @@ int connectToServer(char *serverIP)
 
 /*
  * Function:    initializeConnection
- * Description: This function can be used to start a connection to a server
+ * Description: This function can be used to start a connection to a server. With -tls it connects to the TLS port
+ *              and completes the handshake, checking the certificate against the name or address that was given.
  * Parameters:  const ClientArgs *clientArgs: The related information about a server that the client wishes to connect to
  * Returns:     int: The socket descriptor or an error value which is retrived from connectToServer
  */
 int initializeConnection(const ClientArgs *clientArgs) 
 {
-    char resolvedIPAddress[MAX_IP_LENGTH] = {0};
-    if (clientArgs->serverName != NULL) 
-	{
-        resolveServerName(clientArgs->serverName, resolvedIPAddress);
-    } 
-	else 
-	{
-        strncpy(resolvedIPAddress, clientArgs->ipAddress, MAX_IP_LENGTH - 1);
+    if (transportInit() != TRANSPORT_SUCCESS ||
+        (clientArgs->useTls && transportClientContext(clientArgs->tlsCaFile, clientArgs->tlsVerify) != TRANSPORT_SUCCESS))
+    {
+        fprintf(stderr, "Unable to set up the transport\n");
+        return SOCKET_ERROR;
+    }
+    if (clientArgs->unixPath != NULL)
+    {
+        return connectToUnixSocket(clientArgs->unixPath);
     }
-    return connectToServer(resolvedIPAddress);
+
+    const char* host = clientArgs->serverName != NULL ? clientArgs->serverName : clientArgs->ipAddress;
+    int socketDescriptor = connectToServer(host, clientArgs->useTls ? TLS_PORT_NUMBER : PORT_NUMBER);
+    if (socketDescriptor != SOCKET_ERROR && clientArgs->useTls)
+    {
+        if (transportConnect(socketDescriptor, host) != TRANSPORT_SUCCESS)
+        {
+            fprintf(stderr, "TLS handshake with the server failed\n");
+            close(socketDescriptor);
+            return SOCKET_ERROR;
+        }
+    }
+    return socketDescriptor;
 }
 
 /*
@@ -119,8 +345,9 @@ int initializeConnection(const ClientArgs *clientArgs)
  */
 void getSocketIP(int sockfd, char *ipBuffer, size_t bufferLength) 
 {
-    struct sockaddr_in localAddress;
+    struct sockaddr_storage localAddress;
     socklen_t addressLength = sizeof(localAddress);
+    char ip[INET6_ADDRSTRLEN] = UNIX_SOCKET_IP;
 
     if (getsockname(sockfd, (struct sockaddr*)&localAddress, &addressLength) == -1) 
 	{
@@ -128,8 +355,15 @@ void getSocketIP(int sockfd, char *ipBuffer, size_t bufferLength)
         exit(EXIT_FAILURE);
     }
 
-    // Convert IP to string
-    const char *ip = inet_ntoa(localAddress.sin_addr);
+    // Convert IP to string, a unix socket keeps the placeholder address
+    if (localAddress.ss_family == AF_INET)
+    {
+        inet_ntop(AF_INET, &((struct sockaddr_in*)&localAddress)->sin_addr, ip, sizeof(ip));
+    }
+    else if (localAddress.ss_family == AF_INET6)
+    {
+        inet_ntop(AF_INET6, &((struct sockaddr_in6*)&localAddress)->sin6_addr, ip, sizeof(ip));
+    }
 
     // Copy to provided buffer
     strncpy(ipBuffer, ip, bufferLength);
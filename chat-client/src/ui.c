@@ -54,7 +54,8 @@ void printHeader(WINDOW *win, int yBegin, int width, const char *string, int col
 
 /*
  * Function:    printMessage
- * Description: This function displayes a centered header text in an ncurses window
+ * Description: This function displays a message with the time the server stamped it and, when its sender stamped it
+ *              too, how long it took to arrive
  * Parameters:  WINDOW *messageWindow: A pointer to an ncurses window where the header will be printed.
  *              const Message* chatMessage: A pointer to a Message structure containing information about the chat message to be displayed
  *              char* clientIp: The buffer to contain the ip address
@@ -70,21 +71,45 @@ void printMessage(WINDOW* messageWindow, const Message* chatMessage, char* clien
     int x, y;
     getyx(messageWindow, y, x); // Get the current cursor position
 	wmove(messageWindow, y, x);
-	if (strcmp(chatMessage->ip, clientIp) == 0)
+	const char* body = messageBody(chatMessage);
+	const char* direction = strcmp(messageIp(chatMessage), clientIp) == 0 ? ">>" : "<<";
+
+	// The server's time is shown when it stamped the message, so every client shows the same one
+	char timeStamp[MAX_TIMESTAMP_LENGTH];
+	formatTimestamp(chatMessage->stampedNanoseconds != 0 ? chatMessage->stampedNanoseconds : chatMessage->receivedNanoseconds,
+	                timeStamp, sizeof(timeStamp));
+	char latency[MAX_TIMESTAMP_LENGTH + 8] = "";
+	if (chatMessage->sentNanoseconds != 0 && chatMessage->receivedNanoseconds >= chatMessage->sentNanoseconds)
 	{
-		wprintw(messageWindow, "%-15s [%-5s] >> %-40s (%s)\n", chatMessage->ip, chatMessage->userName, 
-		chatMessage->message, chatMessage->timeStamp);
+		formatLatency(chatMessage->receivedNanoseconds - chatMessage->sentNanoseconds, latency, sizeof(latency));
 	}
-	else
+	wprintw(messageWindow, "%-15s [%-5s] %s %-40.40s (%s) %s\n", messageIp(chatMessage), messageUserName(chatMessage), 
+	direction, body, timeStamp, latency);
+
+	// A body longer than one parcel continues on the following lines under the message column
+	for (int shown = MAX_PARCEL_LENGTH - 1; shown < chatMessage->bodyLength; shown += MAX_PARCEL_LENGTH - 1)
 	{
-		wprintw(messageWindow, "%-15s [%-5s] << %-40s (%s)\n", chatMessage->ip, chatMessage->userName, 
-		chatMessage->message, chatMessage->timeStamp);
+		wprintw(messageWindow, "%-15s  %-5s  %s %-40.40s\n", "", "", direction, body + shown);
 	}
 
     wrefresh(messageWindow);
 }
 
 
+/*
+ * Function:    printRoster
+ * Description: This function shows the users online in the header, cut to the width of the window.
+ * Parameters:  WINDOW* staticMessagesHeader: The header window
+ *              const char* line: The line of names
+ * Returns:     void
+ */
+void printRoster(WINDOW* staticMessagesHeader, const char* line)
+{
+	int width = getmaxx(staticMessagesHeader) - NEXT_COLUMN;
+	mvwprintw(staticMessagesHeader, ROSTER_ROW, NEXT_COLUMN, "%-*.*s", width, width, line);
+	wrefresh(staticMessagesHeader);
+}
+
 /*
  * Function:    refreshUI
  * Description: This function updates the values displayed on the UI
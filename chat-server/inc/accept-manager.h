@@ -0,0 +1,52 @@
+/*
+* FILE              :   accept-manager.h
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This header file contains the admission control definitions and the function
+                        declarations for accept-manager.c file.
+*/
+
+#ifndef ACCEPT_MANAGER_H
+#define ACCEPT_MANAGER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "server-config.h"
+
+#define ACCEPT_BATCH_LIMIT 256          // connections taken per readiness event before yielding to other events
+#define ADMISSION_TABLE_SIZE 4096       // token buckets, must be a power of two
+#define ADMISSION_PROBE_LIMIT 8         // buckets inspected before the stalest one is recycled
+#define MILLITOKENS_PER_TOKEN 1000
+#define MAX_LISTENERS 4
+
+// Kinds of listening socket; the kind decides how accepted connections are set up
+#define LISTENER_TCP 0
+#define LISTENER_TLS 1
+#define LISTENER_UNIX 2
+
+// One token bucket per recently seen source address
+typedef struct AdmissionBucket
+{
+    unsigned char address[16];          // IPv4 addresses are stored IPv4-mapped
+    uint64_t milliTokens;               // up to -acceptburst tokens, more than 32 bits hold once counted in thousandths
+    uint64_t lastRefillMs;
+    bool used;
+} AdmissionBucket;
+
+typedef struct ServerListener
+{
+    int fd;
+    int kind;
+} ServerListener;
+
+extern ServerListener serverListeners[MAX_LISTENERS];
+extern int listenerCount;
+
+void init_accept_manager(const ServerConfig* config);
+bool add_listener(int listener, int kind);
+const ServerListener* find_listener(int fd);
+void close_listeners(void);
+void drain_accept_queue(const ServerListener* listener);
+
+#endif
@@ -0,0 +1,23 @@
+/*
+* FILE              :   broadcast-tap.h
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This header file contains the function declarations for broadcast-tap.c file.
+*/
+
+#ifndef BROADCAST_TAP_H
+#define BROADCAST_TAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "server-config.h"
+#include "../../Common/inc/tap.h"
+
+bool tap_init(const ServerConfig* config);
+bool tap_enabled(void);
+void tap_publish(uint64_t sequence, const char* serializedMessage);
+void tap_flush(void);
+void tap_stop(void);
+
+#endif
@@ -14,19 +14,27 @@
 #include <stdbool.h>
 #include <string.h>
 #include <unistd.h>
+#include "../../Common/inc/message.h"
 #define MAX_CLIENTS 10
 #define SOCKET_ERROR -1
-#define ONE_HUNDRED_MILLISECONDS 100000
+#define BROADCASTER_PARK_MILLISECONDS 100 // longest a waiting broadcaster goes without checking stopWorkers
 #define STRING_EQUALITY 0
 #define READING_ERROR 0
 #define PORT_NUMBER 8989
-extern int client_sockets[MAX_CLIENTS];
-extern pthread_mutex_t clientsMutex;
+extern int* client_sockets;
+extern char (*client_names)[MAX_USERNAME_LENGTH];
+extern bool* client_multicast;      // receives broadcasts from the multicast group instead of over its socket
+extern int maxClients;
+extern pthread_mutex_t clientsMutex;        // guards the registry, every change to it publishes a new snapshot
+extern pthread_mutex_t clientWritesMutex;   // keeps frames that different threads write to client sockets whole
 extern pthread_mutex_t numClientsMutex;
 extern int clientCount;
-void init_client_manager();
-bool add_client(int client_socket);
+void init_client_manager(int capacity);
+int add_client(int client_socket);
 void remove_client(int client_socket);
+bool restore_client(int slot, int client_socket, const char* userName);
+void set_client_name(int client_socket, const char* userName);
+int find_client_slot(int client_socket);
 void cleanup_clients();
 
 #endif
@@ -0,0 +1,44 @@
+/*
+* FILE              :   client-snapshot.h
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This header file contains the snapshot of the client registry read by the fan-out
+                        and the function declarations for client-snapshot.c file.
+*/
+
+#ifndef CLIENT_SNAPSHOT_H
+#define CLIENT_SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SNAPSHOT_READERS 64                 // threads inside a snapshot at the same time, more wait for a free place
+#define SNAPSHOT_GRACE_POLL_MILLISECONDS 1  // how often a thread waiting for readers to move on looks again
+
+// One registered client as of a snapshot
+typedef struct SnapshotClient
+{
+    int sock;
+    int slot;
+    bool multicast;             // served by the multicast group instead of its socket
+} SnapshotClient;
+
+// An immutable copy of the registry. A new one is published on every change and the old one is freed once no
+// reader can still be inside it.
+typedef struct ClientSnapshot
+{
+    int count;
+    int* slotSockets;           // socket of every slot, -1 if free
+    uint64_t retiredEpoch;      // epoch it was replaced in, for the reclamation
+    struct ClientSnapshot* nextRetired;
+    SnapshotClient clients[];   // the registered clients, count of them
+} ClientSnapshot;
+
+void client_snapshot_publish(void);
+const ClientSnapshot* client_snapshot_enter(int* reader);
+void client_snapshot_exit(int reader);
+bool client_snapshot_contains(const ClientSnapshot* snapshot, int slot, int sock);
+void client_snapshot_synchronize(void);
+
+#endif
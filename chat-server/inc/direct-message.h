@@ -0,0 +1,30 @@
+/*
+* FILE              :   direct-message.h
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This header file contains the function declarations for direct-message.c file.
+*/
+
+#ifndef DIRECT_MESSAGE_H
+#define DIRECT_MESSAGE_H
+
+#include <stdbool.h>
+#include "../../Common/inc/intern.h"
+
+#define DIRECT_NOT_ONLINE " is not online"  // told to the sender after the recipient's name
+#define DIRECT_NAME_TOO_LONG "No user name is that long"  // told to the sender of a /msg to a longer name than any
+
+// Results of direct_claim_name
+#define DIRECT_CLAIMED 0
+#define DIRECT_TAKEN 1                      // another connection holds the name
+#define DIRECT_NO_ROOM 2                    // the intern table has no room for the name
+
+bool direct_init(int slots);
+bool direct_claim(int slot, InternId user);
+int direct_claim_name(int slot, const char* userName);
+InternId direct_name(int slot);
+void direct_release(int slot);
+int direct_lookup(InternId user);
+
+#endif
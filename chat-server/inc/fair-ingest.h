@@ -0,0 +1,27 @@
+/*
+* FILE              :   fair-ingest.h
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This header file contains the sender weights of the fair ingest and the function
+                        declarations for fair-ingest.c file.
+*/
+
+#ifndef FAIR_INGEST_H
+#define FAIR_INGEST_H
+
+#include <stdbool.h>
+#include "server-config.h"
+#include "../../Common/inc/message.h"
+
+#define DEFAULT_SENDER_WEIGHT 1         // share of a sender not named in -weights
+#define MAX_SENDER_WEIGHT 64            // keeps a turn's grant far from overflowing the deficit
+#define MAX_WEIGHTED_USERS 64           // names -weights may list
+#define FAIR_REPORT_SENDERS 5           // senders with the longest queueing delay listed per report
+
+bool fair_ingest_init(const ServerConfig* config, int slots);
+void fair_ingest_join(int slot);
+void fair_ingest_enqueue(int slot, const Message* message);
+void fair_ingest_report(void);
+
+#endif
@@ -0,0 +1,29 @@
+/*
+* FILE              :   hibernation.h
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This header file contains the idle connection hibernation definitions and the
+                        function declarations for hibernation.c file.
+*/
+
+#ifndef HIBERNATION_H
+#define HIBERNATION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "server-config.h"
+
+#define DEFAULT_HIBERNATE_SECONDS 20    // time without a message before a connection gives up its thread
+#define HIBERNATION_WAKE_BATCH 64       // connections woken per pass of the main loop
+
+bool hibernation_init(const ServerConfig* config, int slots);
+int hibernation_fd(void);
+void hibernation_touch(int slot);
+int hibernation_timeout(int slot);
+bool hibernation_enter(int sock, int slot, uint64_t joinedSequence);
+uint64_t hibernation_joined_sequence(int slot);
+void hibernation_wake(void);
+void hibernation_forget_all(void);
+
+#endif
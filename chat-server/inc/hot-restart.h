@@ -0,0 +1,51 @@
+/*
+* FILE              :   hot-restart.h
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This header file contains the handoff protocol definitions and the function
+                        declarations for hot-restart.c file.
+*/
+
+#ifndef HOT_RESTART_H
+#define HOT_RESTART_H
+
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Bumped whenever the records below or their payloads change meaning
+#define HANDOFF_PROTOCOL_VERSION 8
+
+// Record types exchanged over the handoff socket
+#define HANDOFF_HELLO 1     // successor -> predecessor, slot carries the protocol version
+#define HANDOFF_LISTENER 2  // listening socket, fd attached, slot carries the listener kind
+#define HANDOFF_CLIENT 3    // client socket, fd attached, payload is the username
+#define HANDOFF_PENDING 4   // queued message not yet broadcast, payload is the serialized message
+#define HANDOFF_END 5       // no more records
+#define HANDOFF_ACK 6       // successor -> predecessor, everything was taken over
+#define HANDOFF_SUBSCRIBER 7 // the client in slot receives broadcasts by multicast
+#define HANDOFF_SEQUENCE 8  // payload is the history epoch and the next broadcast sequence number in decimal
+#define HANDOFF_HISTORY 9   // kept broadcast, payload is its sequence number in decimal, a space and the serialized message
+#define HANDOFF_ROSTER 10   // the client in slot follows the roster
+#define HANDOFF_ACKS 11     // the client in slot is told when its messages are durable
+
+#define HANDOFF_MAX_PAYLOAD 2048      // holds the longest serialized message
+#define HANDOFF_TIMEOUT_SECONDS 5
+
+#define HANDOFF_COMPLETE 0
+#define HANDOFF_FAILED -1
+
+typedef struct HandoffRecord
+{
+    uint32_t type;
+    int32_t slot;               // registry slot of a client, the version for HANDOFF_HELLO, the kind for HANDOFF_LISTENER
+    uint32_t payloadLength;
+    char payload[HANDOFF_MAX_PAYLOAD];
+} HandoffRecord;
+
+int init_handoff_listener(const char* path);
+int handoff_to_successor(int handoffListener);
+int takeover_from_predecessor(const char* path);
+
+#endif
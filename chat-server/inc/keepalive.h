@@ -0,0 +1,32 @@
+/*
+* FILE              :   keepalive.h
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This header file contains the heartbeat and idle timeout definitions and the
+                        function declarations for keepalive.c file.
+*/
+
+#ifndef KEEPALIVE_H
+#define KEEPALIVE_H
+
+#include <stdint.h>
+#include "timer-wheel.h"
+
+#define DEFAULT_HEARTBEAT_SECONDS 30
+#define DEFAULT_IDLE_TIMEOUT_SECONDS 90
+#define HEARTBEAT_REQUEST ">>ping<<"
+#define HEARTBEAT_REPLY ">>pong<<"
+#define HEARTBEAT_SENDER_IP "0.0.0.0"
+#define HEARTBEAT_SENDER_NAME "*"
+#define MAX_EXPIRED_PER_PASS 256
+#define TICKS_PER_SECOND (1000 / TIMER_TICK_MILLISECONDS)
+
+void keepalive_init(int capacity, int heartbeatSeconds, int idleTimeoutSeconds);
+void keepalive_track(int slot);
+void keepalive_untrack(int slot);
+void keepalive_touch(int slot);
+void keepalive_tick(void);
+void keepalive_send_heartbeat(int sock);
+
+#endif
@@ -0,0 +1,30 @@
+/*
+* FILE              :   latency-profile.h
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This header file contains the low latency profile definitions and the function
+                        declarations for latency-profile.c file.
+*/
+
+#ifndef LATENCY_PROFILE_H
+#define LATENCY_PROFILE_H
+
+#include <stdbool.h>
+#include <poll.h>
+#include "server-config.h"
+
+#define MAX_PINNED_CPUS 64
+
+// Roles of the threads that can be pinned, each role gets its own share of the -cpus list
+#define PIN_REACTOR 0       // the main thread running the accept loop
+#define PIN_BROADCASTER 1
+#define PIN_HANDLER 2       // connection handlers, spread round robin
+
+bool init_latency_profile(const ServerConfig* config);
+void pin_current_thread(int role);
+void tune_client_socket(int sock, int kind);
+int wait_for_input(struct pollfd* fds, nfds_t count, int timeout);
+long latency_spin_microseconds(void);
+
+#endif
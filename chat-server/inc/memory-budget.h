@@ -0,0 +1,31 @@
+/*
+* FILE              :   memory-budget.h
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This header file contains the memory limits and the function declarations for
+                        memory-budget.c file.
+*/
+
+#ifndef MEMORY_BUDGET_H
+#define MEMORY_BUDGET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "server-config.h"
+#include "../../Common/inc/message.h"
+
+#define DEFAULT_CONNECTION_SOFT_KILOBYTES 256   // a connection holding more has its reads paused
+#define DEFAULT_CONNECTION_HARD_KILOBYTES 1024  // a connection is never charged more
+#define DEFAULT_MEMORY_SOFT_MEGABYTES 64        // above this in total connections holding more than their share pause
+#define DEFAULT_MEMORY_HARD_MEGABYTES 256       // all connections together are never charged more
+#define MEMORY_PAUSE_MILLISECONDS 10            // wait before a paused connection's budget is checked again
+#define MAX_TRACKED_DESCRIPTORS (1 << 20)       // sockets above this are only charged to the global budget
+
+void memory_budget_init(const ServerConfig* config, int slots);
+bool memory_charge(int sock, size_t bytes);
+void memory_release(int sock, size_t bytes);
+bool memory_over_soft(int sock);
+size_t message_footprint(const Message* message);
+
+#endif
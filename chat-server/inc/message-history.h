@@ -0,0 +1,29 @@
+/*
+* FILE              :   message-history.h
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This header file contains the broadcast history definitions and the function
+                        declarations for message-history.c file.
+*/
+
+#ifndef MESSAGE_HISTORY_H
+#define MESSAGE_HISTORY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "../../Common/inc/history.h"
+
+#define MESSAGE_HISTORY 4096            // broadcasts kept for replays and repairs, must be a power of two
+
+void history_init(void);
+uint64_t history_append(const char* serializedMessage);
+bool history_lookup(uint64_t sequence, char* serializedMessage, size_t size);
+uint64_t history_next_sequence(void);
+uint64_t history_epoch(void);
+void history_resume(uint64_t epoch, uint64_t nextSequence);
+void history_restore(uint64_t sequence, const char* serializedMessage);
+void history_replay(int sock, int slot, const char* request);
+
+#endif
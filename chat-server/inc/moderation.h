@@ -0,0 +1,21 @@
+/*
+* FILE              :   moderation.h
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This header file contains the word filter definitions and the function declarations
+                        for moderation.c file.
+*/
+
+#ifndef MODERATION_H
+#define MODERATION_H
+
+#include <stdbool.h>
+#include "server-config.h"
+
+#define MAX_BLOCKED_WORDS 1024
+#define MAX_BLOCKED_WORD_LENGTH 32
+
+bool moderation_init(const ServerConfig* config);
+
+#endif
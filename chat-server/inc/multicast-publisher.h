@@ -0,0 +1,29 @@
+/*
+* FILE              :   multicast-publisher.h
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This header file contains the multicast fan-out definitions and the function
+                        declarations for multicast-publisher.c file.
+*/
+
+#ifndef MULTICAST_PUBLISHER_H
+#define MULTICAST_PUBLISHER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "server-config.h"
+#include "../../Common/inc/multicast.h"
+
+#define MULTICAST_ANNOUNCE_MILLISECONDS 1000    // how often the latest sequence number is announced
+#define DEFAULT_MULTICAST_TTL 1                 // stay on the local subnet
+
+bool multicast_init(const ServerConfig* config);
+bool multicast_enabled(void);
+void multicast_publish(uint64_t sequence, const char* serializedMessage);
+void multicast_subscribe(int sock, int slot);
+void multicast_unsubscribe(int sock, int slot);
+void multicast_repair(int sock, const char* request);
+void multicast_tick(void);
+
+#endif
@@ -0,0 +1,63 @@
+/*
+* FILE              :   offline-mailbox.h
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This header file contains the mailbox limits, the on-disk record layout and the
+                        function declarations for offline-mailbox.c file.
+*/
+
+#ifndef OFFLINE_MAILBOX_H
+#define OFFLINE_MAILBOX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "server-config.h"
+#include "../../Common/inc/mailbox.h"
+
+#define DEFAULT_MAILBOX_QUOTA_KILOBYTES 256     // disk one user's mailbox may take before its oldest messages go
+#define DEFAULT_MAILBOX_EXPIRY_HOURS 168        // age at which a kept message is no longer delivered
+#define MAILBOX_MAX_USERS 4096                  // users known at once, the one away longest is forgotten for a new one
+#define MAILBOX_MIN_SESSION_SECONDS 10          // a user gets a mailbox once one of its clients stayed connected this long
+#define MAILBOX_MAX_PENDING 65536               // broadcasts waiting to be written before new ones are dropped
+#define MAILBOX_DRAIN_CHUNK 64                  // messages delivered per hold of clientWritesMutex
+#define MAILBOX_SEGMENT_BYTES (1024 * 1024)     // size at which the log moves on to a new file
+#define MAILBOX_MAX_SEGMENTS 1024               // log files kept at most, the oldest goes when one more is needed
+#define MAILBOX_NOTHING_OWED UINT64_MAX         // cursor of a user whose mailbox is empty
+#define MAILBOX_RECORD_MAGIC 0x4d424f58u        // "MBOX", tells a record from the torn tail of a crashed write
+#define MAILBOX_CURSOR_MAGIC 0x4d435552u        // "MCUR"
+#define MAILBOX_FILE_SUFFIX ".mbox"             // a user's cursor, named after the user
+#define MAILBOX_LOG_SUFFIX ".mlog"              // a log file, named after the log position it starts at
+
+// Header of every record in the log, followed by the serialized message without its terminator
+typedef struct MailboxRecord
+{
+    uint32_t magic;
+    uint32_t length;                // bytes of serialized message after the header
+    uint64_t storedNanoseconds;     // wall clock time it was kept, for the expiry
+    uint64_t epoch;                 // numbering it was broadcast under
+    uint64_t sequence;
+} MailboxRecord;
+
+// Content of a user's cursor file: where in the log its mailbox starts and what its last client was sent
+typedef struct MailboxCursor
+{
+    uint32_t magic;
+    uint32_t reserved;
+    uint64_t owedFrom;              // log position of the first record that may be for the user
+    uint64_t leftEpoch;             // epoch and sequence number of the first broadcast its last client missed
+    uint64_t leftSequence;
+} MailboxCursor;
+
+bool mailbox_init(const ServerConfig* config, int slots);
+bool mailbox_start(void);
+bool mailbox_enabled(void);
+void mailbox_store(uint64_t sequence, const char* serializedMessage);
+void mailbox_hello(int sock, int slot, uint64_t joinedSequence, const char* request);
+void mailbox_join(int slot, const char* userName);
+void mailbox_leave(int slot);
+uint64_t mailbox_replay_floor(int slot);
+void mailbox_flush(void);
+void mailbox_stop(void);
+
+#endif
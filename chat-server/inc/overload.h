@@ -0,0 +1,34 @@
+/*
+* FILE              :   overload.h
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This header file contains the overload protection definitions and the function
+                        declarations for overload.c file.
+*/
+
+#ifndef OVERLOAD_H
+#define OVERLOAD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "server-config.h"
+
+#define DEFAULT_CODEL_TARGET_MILLISECONDS 5
+#define DEFAULT_CODEL_INTERVAL_MILLISECONDS 100
+#define DEFAULT_MAX_QUEUE 65536
+#define THROTTLE_DELAY_MILLISECONDS 10      // pause before a heavy sender's next frame is read while overloaded
+
+// Escalation steps, each taken once queueing delay stayed above target for another interval
+#define OVERLOAD_NONE 0
+#define OVERLOAD_THROTTLE 1                 // reads from the heaviest senders are slowed down
+#define OVERLOAD_SHED 2                     // the broadcaster also drops messages by the CoDel control law
+
+void overload_init(const ServerConfig* config, int capacity);
+bool overload_admit(int sock, int slot);
+bool overload_throttled(int slot);
+bool overload_shed(uint64_t sojournNanoseconds, unsigned int queued);
+void overload_notify_busy(int sock, int slot);
+void overload_tick(void);
+
+#endif
@@ -0,0 +1,44 @@
+/*
+* FILE              :   pipeline.h
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This header file contains the message pipeline definitions and the function
+                        declarations for pipeline.c file.
+*/
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "../../Common/inc/message.h"
+
+#define PIPELINE_BATCH 32           // messages the broadcaster takes off the queue and runs through the stages at once
+#define PIPELINE_MAX_STAGES 16
+#define PIPELINE_EVERYONE -1        // recipient of a message that is broadcast as usual
+
+// Kinds of stage
+#define PIPELINE_INSPECT 0          // only reads messages and may drop them; runs in parallel with the inspect stages next to it
+#define PIPELINE_TRANSFORM 1        // may rewrite, drop or reroute messages; runs alone
+
+// Messages on their way from the queue to the clients. Inspect stages running in parallel only read the messages
+// and mark drops through pipeline_drop; transform stages may also rewrite bodies and set recipients.
+typedef struct PipelineBatch
+{
+    int count;
+    Message messages[PIPELINE_BATCH];
+    atomic_bool dropped[PIPELINE_BATCH];
+    int recipients[PIPELINE_BATCH];     // PIPELINE_EVERYONE, or the only socket the message is delivered to
+    int recipientSlots[PIPELINE_BATCH]; // registry slot of that socket, so that delivery finds it without a search
+} PipelineBatch;
+
+typedef void (*PipelineStage)(PipelineBatch* batch, void* context);
+
+bool pipeline_register(const char* name, int kind, PipelineStage stage, void* context);
+void pipeline_start(void);
+void pipeline_run(PipelineBatch* batch);
+void pipeline_drop(PipelineBatch* batch, int index);
+
+#endif
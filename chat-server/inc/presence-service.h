@@ -0,0 +1,38 @@
+/*
+* FILE              :   presence-service.h
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This header file contains the presence limits and the function declarations for
+                        presence-service.c file.
+*/
+
+#ifndef PRESENCE_SERVICE_H
+#define PRESENCE_SERVICE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "../../Common/inc/intern.h"
+#include "../../Common/inc/presence.h"
+
+#define PRESENCE_MAX_USERS 4096                 // users on the roster, later ones are not listed
+#define DEFAULT_PRESENCE_WINDOW_MILLISECONDS 250 // changes collected into one delta while clients come and go
+
+// A user on the roster
+typedef struct PresenceUser
+{
+    InternId user;          // held while the user is listed
+    int clients;            // connections naming this user
+    bool announced;         // online as of the current roster version
+    bool dirty;             // clients went to or from 0 since the last delta
+} PresenceUser;
+
+void presence_init(int slots, int window);
+void presence_join(int slot, InternId user);
+void presence_leave(int slot);
+void presence_subscribe(int sock, int slot);
+bool presence_subscribed(int slot);
+void presence_deliver(const char* delta);
+void presence_tick(void);
+
+#endif
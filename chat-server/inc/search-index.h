@@ -0,0 +1,39 @@
+/*
+* FILE              :   search-index.h
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This header file contains the search index limits, the on-disk record layout and
+                        the function declarations for search-index.c file.
+*/
+
+#ifndef SEARCH_INDEX_H
+#define SEARCH_INDEX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "server-config.h"
+#include "../../Common/inc/search.h"
+
+#define SEARCH_MAX_TERM_LENGTH 32               // longer words are indexed by their beginning
+#define SEARCH_MAX_QUERY_TERMS 8                // words of a query after which the rest are ignored
+#define SEARCH_SEGMENT_DOCUMENTS 65536          // messages the open segment takes before it is sealed
+#define SEARCH_MERGE_FACTOR 4                   // sealed segments of one size that are merged into one
+#define SEARCH_MAX_PENDING 65536                // broadcasts waiting to be indexed before new ones are dropped
+#define SEARCH_DOCUMENT_CHUNK 65536             // document offsets allocated at a time
+#define SEARCH_MAX_DOCUMENT_CHUNKS 65536        // so that document numbers fit 32 bits
+#define SEARCH_RECORD_MAGIC 0x53524348u         // "SRCH", tells a record from the torn tail of a crashed write
+
+// Header of every record in the search log, followed by the serialized message without its terminator
+typedef struct SearchRecord
+{
+    uint32_t magic;
+    uint32_t length;
+} SearchRecord;
+
+bool search_init(const ServerConfig* config);
+void search_store(const char* serializedMessage);
+void search_answer(int sock, int slot, const char* request);
+void search_stop(void);
+
+#endif
@@ -0,0 +1,82 @@
+/*
+* FILE              :   server-config.h
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This header file contains the runtime configuration of the chat-server and the
+                        function declarations for server-config.c file.
+*/
+
+#ifndef SERVER_CONFIG_H
+#define SERVER_CONFIG_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#define CONFIG_PARSING_ERROR -1
+#define CONFIG_PARSING_SUCCESS 0
+#define DEFAULT_HANDOFF_PATH "/tmp/chat-server-handoff.sock"
+#define DEFAULT_LISTEN_BACKLOG 4096
+#define DEFAULT_ACCEPT_RATE 100     // connections per second admitted from one source address
+#define DEFAULT_ACCEPT_BURST 200    // connections one source address may open back to back
+#define DEFAULT_TLS_PORT 8990
+#define DEFAULT_UNIX_PATH "/tmp/chat-server.sock"
+#define DEFAULT_SPIN_MICROSECONDS 200       // latency profile: how long a thread spins before it blocks
+#define DEFAULT_BUSY_POLL_MICROSECONDS 50   // latency profile: SO_BUSY_POLL of client sockets
+
+// Structure to store parsed command-line arguments of the server
+typedef struct ServerConfig
+{
+    bool takeover;              // start by inheriting the sockets of a running server
+    const char* handoffPath;    // unix socket used to hand sockets over to a new binary
+    int listenBacklog;          // pending connection queue length passed to listen
+    int maxClients;             // size of the client registry
+    int acceptRate;             // per-source token bucket refill rate, 0 disables admission control
+    int acceptBurst;            // per-source token bucket depth
+    int heartbeatSeconds;       // quiet time before the server pings a client, 0 disables
+    int idleTimeoutSeconds;     // quiet time before a client is disconnected, 0 disables
+    const char* tlsCertFile;    // PEM certificate chain, TLS is offered when both files are set
+    const char* tlsKeyFile;     // PEM private key
+    int tlsPort;                // port of the TLS listener
+    const char* unixPath;       // unix stream socket for clients on this host, NULL disables it
+    bool latencyProfile;        // spend CPU on spinning and busy polling to cut wake-up latency
+    int spinMicroseconds;       // latency profile: spin time before a waiting thread blocks
+    int busyPollMicroseconds;   // latency profile: SO_BUSY_POLL of client sockets, 0 leaves it off
+    const char* cpuList;        // comma separated CPUs the I/O threads are pinned to, NULL leaves them unpinned
+    const char* multicastGroup; // IPv4 group broadcasts are published to, NULL sends every copy over TCP
+    int multicastPort;
+    const char* multicastInterface; // address of the interface datagrams leave through, NULL lets routing decide
+    int multicastTtl;
+    int codelTargetMilliseconds;    // queueing delay the broadcaster tolerates before it treats the server as overloaded
+    int codelIntervalMilliseconds;  // how long the delay must stay above target before each escalation
+    int maxQueue;                   // messages queued before new ones are refused outright, 0 = no limit
+    int connectionSoftKilobytes;    // memory a connection may hold before it stops being read, 0 = no limit
+    int connectionHardKilobytes;    // memory a connection may never exceed, 0 = no limit
+    int memorySoftMegabytes;        // memory of all connections before the largest ones stop being read, 0 = no limit
+    int memoryHardMegabytes;        // memory all connections together may never exceed, 0 = no limit
+    const char* blocklistPath;      // words whose messages are dropped, one per line, NULL filters nothing
+    const char* mailboxDirectory;   // where broadcasts are kept for offline users, NULL keeps none
+    int mailboxQuotaKilobytes;      // disk one user's mailbox may take, 0 = no limit
+    int mailboxExpiryHours;         // age at which kept messages are no longer delivered, 0 = never
+    int senderWeight;               // share of a round of the fair ingest a sender gets by default
+    const char* senderWeights;      // NAME=WEIGHT pairs, comma separated, for users with another share, NULL for none
+    int hibernateSeconds;           // time without a message before a connection gives up its thread, 0 = never
+    int presenceWindowMilliseconds; // roster changes collected into one delta
+    const char* searchPath;         // log of every broadcast, indexed for >>search<<, NULL keeps none
+    const char* walPath;            // write-ahead log of accepted messages, NULL logs none
+    bool walSync;                   // acknowledge once fdatasync returned rather than once written
+    int commitIntervalMicroseconds; // how long a logged message waits for others to share its commit
+    const char* tapName;            // shared memory ring every broadcast is copied into, NULL keeps none
+    int tapSlots;                   // messages the ring holds before it overwrites the oldest
+    int spamRepeats;                // copies of one line a sender may send per window, 0 = unlimited
+    int spamWindowSeconds;          // how long copies of a line are remembered
+} ServerConfig;
+
+extern ServerConfig serverConfig;
+
+int parse_server_args(int argc, char* argv[], ServerConfig* config);
+
+#endif
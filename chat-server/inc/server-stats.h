@@ -0,0 +1,67 @@
+/*
+* FILE              :   server-stats.h
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This header file contains the server counters and the function declarations
+                        for server-stats.c file.
+*/
+
+#ifndef SERVER_STATS_H
+#define SERVER_STATS_H
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#define STATS_INTERVAL_MILLISECONDS 10000
+
+// Counters are bumped from any thread and summarized periodically by the main loop
+typedef struct ServerStats
+{
+    atomic_ulong connectionsAccepted;
+    atomic_ulong rejectedAtCapacity;
+    atomic_ulong rejectedByRate;
+    atomic_ulong acceptErrors;
+    atomic_ulong heartbeatsSent;
+    atomic_ulong connectionsReaped;
+    atomic_ulong tlsHandshakes;
+    atomic_ulong tlsKernelOffloaded;
+    atomic_ulong tlsHandshakeFailures;
+    atomic_ulong multicastPublished;
+    atomic_ulong multicastRepaired;
+    atomic_ulong controlFrames;         // requests served from the control lane
+    atomic_ulong overloadEpisodes;      // times queueing delay stayed above target long enough to throttle
+    atomic_ulong readsThrottled;        // reads a heavy sender had to wait for
+    atomic_ulong messagesShed;          // messages dropped by the broadcaster
+    atomic_ulong refusedBusy;           // messages refused because the queue was full
+    atomic_ulong memoryPaused;          // reads a connection over its soft memory limit had to wait for
+    atomic_ulong memoryRefused;         // allocations refused at a hard memory limit
+    atomic_ulong memoryDisconnects;     // connections closed because a frame did not fit their budget
+    atomic_ulong messagesFiltered;      // messages a pipeline stage dropped
+    atomic_ulong mailStored;            // broadcasts written to the mailbox log for offline users
+    atomic_ulong mailDelivered;         // kept messages sent to a user that came back
+    atomic_ulong mailExpired;           // kept messages too old to be delivered
+    atomic_ulong mailTrimmed;           // kept messages dropped from a mailbox over its quota
+    atomic_ulong mailDropped;           // broadcasts not kept because the disk fell behind
+    atomic_ulong connectionsHibernated; // idle connections whose handler returned
+    atomic_ulong connectionsWoken;      // hibernating connections that got a handler again
+    atomic_ulong searchesAnswered;      // >>search<< requests answered
+    atomic_ulong searchDropped;         // broadcasts not indexed because the indexer fell behind
+    atomic_ulong walLogged;             // accepted messages written to the write-ahead log
+    atomic_ulong walCommits;            // group commits of the write-ahead log
+    atomic_ulong tapPublished;          // broadcasts copied into the shared memory tap
+    atomic_ulong spamSuppressed;        // repeated lines dropped before they were deserialized
+    atomic_ulong namesRefused;          // usernames the intern table had no room for
+    // Levels rather than counters, reported as they are
+    atomic_ulong memoryInUse;           // bytes charged to connections
+    atomic_ulong memoryPeak;            // most bytes ever charged at once
+} ServerStats;
+
+extern ServerStats serverStats;
+
+void report_server_stats(void);
+
+#endif
@@ -0,0 +1,29 @@
+/*
+* FILE              :   spam-filter.h
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This header file contains the repeat filter limits and the function declarations
+                        for spam-filter.c file.
+*/
+
+#ifndef SPAM_FILTER_H
+#define SPAM_FILTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "server-config.h"
+
+#define DEFAULT_SPAM_REPEATS 0              // copies of one line a sender may send per window, 0 lets every copy through
+#define DEFAULT_SPAM_WINDOW_SECONDS 10
+#define SPAM_MAX_REPEATS 254                // counters are single bytes that stop at 255
+#define SPAM_SKETCH_DEPTH 4                 // counters a line is counted in, the smallest is its estimate
+#define SPAM_SKETCH_WIDTH 65536             // counters per row, a power of two
+#define SPAM_PENALTY_MILLISECONDS 10        // pause before the next frame of a sender whose copy was suppressed
+#define SPAM_HASH_MULTIPLIER 0x9e3779b97f4a7c15ull  // odd, 2^64 divided by the golden ratio
+
+void spam_init(const ServerConfig* config);
+bool spam_suppress(int slot, const char* serializedMessage);
+void spam_tick(void);
+
+#endif
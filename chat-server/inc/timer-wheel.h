@@ -0,0 +1,43 @@
+/*
+* FILE              :   timer-wheel.h
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This header file contains the hashed timer wheel definitions and the function
+                        declarations for timer-wheel.c file.
+*/
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#define TIMER_TICK_MILLISECONDS 100
+#define TIMER_WHEEL_SLOTS 1024      // one revolution is 102.4 seconds, longer timers wait extra rounds
+#define TIMER_NONE -1                // end of a bucket list
+#define TIMER_UNLINKED -2            // prev value of a timer that is not armed
+
+// Timers are identified by the registry slot of their connection, so a node is all they cost
+typedef struct TimerNode
+{
+    int32_t next;
+    int32_t prev;
+    uint32_t expiryTick;            // absolute tick; only meaningful while linked
+} TimerNode;
+
+typedef struct TimerWheel
+{
+    int32_t buckets[TIMER_WHEEL_SLOTS];
+    TimerNode* nodes;
+    int capacity;
+    uint32_t currentTick;
+    pthread_mutex_t lock;
+} TimerWheel;
+
+void timer_wheel_init(TimerWheel* wheel, int capacity, uint32_t startTick);
+void timer_arm(TimerWheel* wheel, int id, uint32_t delayTicks);
+void timer_cancel(TimerWheel* wheel, int id);
+int timer_advance(TimerWheel* wheel, uint32_t nowTick, int* expired, int maxExpired);
+
+#endif
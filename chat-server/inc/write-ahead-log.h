@@ -0,0 +1,46 @@
+/*
+* FILE              :   write-ahead-log.h
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This header file contains the write-ahead log limits, its on-disk record layout and
+                        the function declarations for write-ahead-log.c file.
+*/
+
+#ifndef WRITE_AHEAD_LOG_H
+#define WRITE_AHEAD_LOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "server-config.h"
+#include "../../Common/inc/message.h"
+#include "../../Common/inc/durability.h"
+
+#define DEFAULT_COMMIT_INTERVAL_MICROSECONDS 1000   // how long the first message of a group waits for others to share its flush
+#define WAL_GROUP_BYTES (1 << 20)                   // records collected for one commit before handlers wait for it
+#define WAL_COMPACT_BYTES (64 << 20)                // log size past which it is emptied once nothing in it is still queued
+#define WAL_IDLE_MILLISECONDS 100                   // how often an idle writer looks whether the queue drained
+#define WAL_RECORD_MAGIC 0x57414c52u                // "WALR", tells a record from the torn tail of a crashed write
+
+// Header of every record in the log. A message record is followed by the serialized message without its
+// terminator; a checkpoint record has no payload and says every message up to its sequence left the queue.
+typedef struct WalRecord
+{
+    uint32_t magic;
+    uint32_t length;        // bytes of serialized message after the header, 0 for a checkpoint
+    uint64_t sequence;      // log sequence number of the message, or the newest one a checkpoint covers
+} WalRecord;
+
+void wal_init(const ServerConfig* config, int slots);
+bool wal_start(bool takenOver);
+bool wal_enabled(void);
+void wal_append(int sock, int slot, const Message* message);
+void wal_adopt(void);
+void wal_done(int count);
+void wal_subscribe(int sock, int slot);
+bool wal_acking(int slot);
+void wal_resume_acking(int slot);
+void wal_leave(int slot);
+void wal_stop(void);
+
+#endif
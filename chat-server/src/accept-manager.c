@@ -0,0 +1,333 @@
+/*
+* FILE              :   accept-manager.c
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This file contains the accept path of the chat-server. Every time a listening
+                        socket becomes readable its whole pending queue is drained with accept4, each
+                        new connection passes a per-source-address token bucket and the capacity check,
+                        and connections that do not are reset immediately instead of being left queued.
+                        Only the main thread runs this code, so the bucket table needs no locking.
+*/
+
+#define _GNU_SOURCE // accept4
+#include "server-utility.h"
+#include "../inc/accept-manager.h"
+#include "../inc/server-stats.h"
+#include "../inc/keepalive.h"
+#include "../inc/latency-profile.h"
+#include "../inc/client-snapshot.h"
+#include <time.h>
+
+ServerListener serverListeners[MAX_LISTENERS];
+int listenerCount = 0;
+
+static AdmissionBucket admissionTable[ADMISSION_TABLE_SIZE];
+static uint32_t acceptRate;
+static uint32_t acceptBurst;
+static int reserveFd = -1;
+
+/*
+    FUNCTION    :   monotonic_milliseconds
+    DESCRIPTION :   Returns a monotonic clock reading used for token refills.
+    PARAMETERS  :   none
+    RETURNS     :   uint64_t - Milliseconds since an arbitrary point
+*/
+static uint64_t monotonic_milliseconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*
+    FUNCTION    :   source_address_key
+    DESCRIPTION :   Converts a peer address into the 16 byte key of the bucket table.
+    PARAMETERS  :   const struct sockaddr_storage* peer - Address returned by accept4
+                    unsigned char* key - Receives 16 bytes
+    RETURNS     :   bool - false for address families that are not rate limited
+*/
+static bool source_address_key(const struct sockaddr_storage* peer, unsigned char* key)
+{
+    if (peer->ss_family == AF_INET)
+    {
+        const struct sockaddr_in* address = (const struct sockaddr_in*)peer;
+        memset(key, 0, 10);
+        key[10] = 0xff;
+        key[11] = 0xff;
+        memcpy(key + 12, &address->sin_addr, 4);
+        return true;
+    }
+    if (peer->ss_family == AF_INET6)
+    {
+        memcpy(key, &((const struct sockaddr_in6*)peer)->sin6_addr, 16);
+        return true;
+    }
+    return false;
+}
+
+/*
+    FUNCTION    :   take_admission_token
+    DESCRIPTION :   Refills the bucket of the peer's address and takes one token from it. The table
+                    is open addressed; when no matching bucket is found within the probe window the
+                    stalest bucket in it is recycled, so memory stays fixed whatever the source mix.
+    PARAMETERS  :   const struct sockaddr_storage* peer - Address returned by accept4
+    RETURNS     :   bool - true if the connection may be admitted
+*/
+static bool take_admission_token(const struct sockaddr_storage* peer)
+{
+    unsigned char key[16];
+    uint32_t hash = 2166136261u;
+
+    if (acceptRate == 0 || !source_address_key(peer, key))
+    {
+        return true;
+    }
+
+    for (int i = 0; i < 16; i++) // FNV-1a
+    {
+        hash = (hash ^ key[i]) * 16777619u;
+    }
+
+    uint64_t now = monotonic_milliseconds();
+    AdmissionBucket* bucket = NULL;
+    AdmissionBucket* stalest = NULL;
+    for (int probe = 0; probe < ADMISSION_PROBE_LIMIT; probe++)
+    {
+        AdmissionBucket* candidate = &admissionTable[(hash + probe) & (ADMISSION_TABLE_SIZE - 1)];
+        if (candidate->used && memcmp(candidate->address, key, sizeof(key)) == 0)
+        {
+            bucket = candidate;
+            break;
+        }
+        if (stalest == NULL || !candidate->used || (stalest->used && candidate->lastRefillMs < stalest->lastRefillMs))
+        {
+            stalest = candidate;
+        }
+    }
+
+    if (bucket == NULL)
+    {
+        bucket = stalest;
+        memcpy(bucket->address, key, sizeof(key));
+        bucket->milliTokens = (uint64_t)acceptBurst * MILLITOKENS_PER_TOKEN;
+        bucket->lastRefillMs = now;
+        bucket->used = true;
+    }
+
+    // rate tokens per second is rate millitokens per millisecond
+    uint64_t refilled = bucket->milliTokens + (now - bucket->lastRefillMs) * acceptRate;
+    uint64_t capacity = (uint64_t)acceptBurst * MILLITOKENS_PER_TOKEN;
+    bucket->milliTokens = refilled > capacity ? capacity : refilled;
+    bucket->lastRefillMs = now;
+
+    if (bucket->milliTokens < MILLITOKENS_PER_TOKEN)
+    {
+        return false;
+    }
+    bucket->milliTokens -= MILLITOKENS_PER_TOKEN;
+    return true;
+}
+
+/*
+    FUNCTION    :   reject_connection
+    DESCRIPTION :   Closes a connection with a reset so that neither side keeps it in TIME_WAIT.
+    PARAMETERS  :   int client - The accepted socket
+    RETURNS     :   void
+*/
+static void reject_connection(int client)
+{
+    struct linger abortive = { 1, 0 };
+    setsockopt(client, SOL_SOCKET, SO_LINGER, &abortive, sizeof(abortive));
+    close(client);
+}
+
+/*
+    FUNCTION    :   shed_without_descriptor
+    DESCRIPTION :   Handles EMFILE/ENFILE. The pending connection would otherwise keep the listener
+                    readable forever, so a descriptor kept in reserve is released, the connection
+                    accepted and reset, and the reserve taken again.
+    PARAMETERS  :   int listener - The listening socket
+    RETURNS     :   void
+*/
+static void shed_without_descriptor(int listener)
+{
+    if (reserveFd >= 0)
+    {
+        close(reserveFd);
+        int client = accept(listener, NULL, NULL);
+        if (client >= 0)
+        {
+            reject_connection(client);
+            atomic_fetch_add(&serverStats.rejectedAtCapacity, 1);
+        }
+        reserveFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    }
+}
+
+/*
+    FUNCTION    :   admit_connection
+    DESCRIPTION :   Applies admission control to a freshly accepted socket and registers it.
+    PARAMETERS  :   int client - The accepted socket
+                    const struct sockaddr_storage* peer - Its source address
+                    int kind - The kind of listener it arrived on
+    RETURNS     :   void
+*/
+static void admit_connection(int client, const struct sockaddr_storage* peer, int kind)
+{
+    if (!take_admission_token(peer))
+    {
+        reject_connection(client);
+        atomic_fetch_add(&serverStats.rejectedByRate, 1);
+        return;
+    }
+
+    tune_client_socket(client, kind);
+
+    // A TLS client must not be sent anything before its handshake, which its handler performs
+    if (kind == LISTENER_TLS)
+    {
+        transportExpectTls(client);
+    }
+
+    pthread_mutex_lock(&numClientsMutex);
+    bool full = clientCount >= maxClients;
+    pthread_mutex_unlock(&numClientsMutex);
+    int slot = full ? SOCKET_ERROR : add_client(client);
+    if (slot == SOCKET_ERROR)
+    {
+        transportClose(client);
+        reject_connection(client);
+        atomic_fetch_add(&serverStats.rejectedAtCapacity, 1);
+        return;
+    }
+
+    pthread_mutex_lock(&numClientsMutex);
+    clientCount++;
+    pthread_mutex_unlock(&numClientsMutex);
+
+    // Create a thread for each connection
+    keepalive_track(slot);
+    if (!spawn_connection_handler(client, slot, false))
+    {
+        keepalive_untrack(slot);
+        remove_client(client);
+        pthread_mutex_lock(&numClientsMutex);
+        clientCount--;
+        pthread_mutex_unlock(&numClientsMutex);
+        client_snapshot_synchronize(); // the broadcaster may have picked it up already
+        transportClose(client);
+        reject_connection(client);
+        atomic_fetch_add(&serverStats.acceptErrors, 1);
+        return;
+    }
+    atomic_fetch_add(&serverStats.connectionsAccepted, 1);
+}
+
+/*
+    FUNCTION    :   init_accept_manager
+    DESCRIPTION :   Stores the admission settings and takes the reserve descriptor.
+    PARAMETERS  :   const ServerConfig* config - The parsed server configuration
+    RETURNS     :   void
+*/
+void init_accept_manager(const ServerConfig* config)
+{
+    acceptRate = config->acceptRate;
+    acceptBurst = config->acceptBurst > 0 ? config->acceptBurst : 1;
+    memset(admissionTable, 0, sizeof(admissionTable));
+    reserveFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+}
+
+/*
+    FUNCTION    :   add_listener
+    DESCRIPTION :   Registers a listening socket and makes it non-blocking so that its queue can be
+                    drained until empty.
+    PARAMETERS  :   int listener - The listening socket
+                    int kind - LISTENER_TCP or LISTENER_TLS
+    RETURNS     :   bool - false if the socket is invalid or the table is full
+*/
+bool add_listener(int listener, int kind)
+{
+    if (listener < 0 || listenerCount >= MAX_LISTENERS)
+    {
+        return false;
+    }
+    int flags = fcntl(listener, F_GETFL);
+    fcntl(listener, F_SETFL, flags | O_NONBLOCK);
+    serverListeners[listenerCount].fd = listener;
+    serverListeners[listenerCount].kind = kind;
+    listenerCount++;
+    return true;
+}
+
+/*
+    FUNCTION    :   find_listener
+    DESCRIPTION :   Looks up a registered listening socket by descriptor.
+    PARAMETERS  :   int fd - A descriptor reported ready by epoll
+    RETURNS     :   const ServerListener* - The listener, or NULL if fd is not one
+*/
+const ServerListener* find_listener(int fd)
+{
+    for (int i = 0; i < listenerCount; i++)
+    {
+        if (serverListeners[i].fd == fd)
+        {
+            return &serverListeners[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+    FUNCTION    :   close_listeners
+    DESCRIPTION :   Closes every registered listening socket.
+    PARAMETERS  :   none
+    RETURNS     :   void
+*/
+void close_listeners(void)
+{
+    for (int i = 0; i < listenerCount; i++)
+    {
+        close_socket(serverListeners[i].fd);
+    }
+    listenerCount = 0;
+}
+
+/*
+    FUNCTION    :   drain_accept_queue
+    DESCRIPTION :   Accepts connections until the listen queue is empty or a batch has been taken.
+                    The listener stays level-triggered, so a cut-off batch is resumed on the next
+                    wakeup after the other events have been served.
+    PARAMETERS  :   const ServerListener* listener - The readable listening socket
+    RETURNS     :   void
+*/
+void drain_accept_queue(const ServerListener* listener)
+{
+    for (int accepted = 0; accepted < ACCEPT_BATCH_LIMIT; accepted++)
+    {
+        struct sockaddr_storage peer;
+        socklen_t peerLength = sizeof(peer);
+
+        int client = accept4(listener->fd, (struct sockaddr*)&peer, &peerLength, SOCK_CLOEXEC);
+        if (client < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                return;
+            }
+            if (errno == EINTR || errno == ECONNABORTED)
+            {
+                continue;
+            }
+            atomic_fetch_add(&serverStats.acceptErrors, 1);
+            if (errno == EMFILE || errno == ENFILE)
+            {
+                shed_without_descriptor(listener->fd);
+                continue;
+            }
+            perror("Error on accept");
+            return;
+        }
+        admit_connection(client, &peer, listener->kind);
+    }
+}
@@ -0,0 +1,164 @@
+/*
+* FILE              :   broadcast-tap.c
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This file contains the broadcast tap. With -tap<NAME> the broadcaster also copies
+                        every broadcast once into a ring in POSIX shared memory under that name, where
+                        archivers and other tools on this host read it in place with the functions of
+                        Common/src/tap.c instead of each connecting as a client. Readers keep their own
+                        positions in their own memory and the server never looks at them, so a reader
+                        more or less adds nothing to the broadcast; a reader that sleeps on the ring's
+                        futex is woken once per batch. A successor taking over creates a fresh ring under
+                        the same name, and the predecessor closes its own so that readers move over.
+*/
+
+#include "server-utility.h"
+#include "../inc/broadcast-tap.h"
+#include "../inc/server-stats.h"
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+static TapHeader* ring = NULL;
+static size_t ringLength = 0;
+static TapSlot* slots = NULL;       // the slots and their mask are kept here rather than read back from the
+static uint64_t slotMask = 0;       // header, which any reader can map and scribble over
+static uint64_t lastPosition = 0;   // only the broadcaster touches it
+
+/*
+    FUNCTION    :   tap_init
+    DESCRIPTION :   Creates the ring when -tap<NAME> was given. Whatever is under the name already is
+                    unlinked first: the ring of a crashed server, or that of the predecessor this one
+                    took over from, whose readers keep their mapping until it is closed. Called after
+                    the listeners are set up, so that a second server started by mistake fails on the
+                    port before it can take the ring from the running one.
+    PARAMETERS  :   const ServerConfig* config - The parsed command line
+    RETURNS     :   bool - false if the tap was asked for but cannot be created
+*/
+bool tap_init(const ServerConfig* config)
+{
+    if (config->tapName == NULL)
+    {
+        return true;
+    }
+
+    uint32_t slotCount = 2;
+    while (slotCount < (uint32_t)config->tapSlots)
+    {
+        slotCount <<= 1;
+    }
+    size_t length = tapMappingLength(slotCount);
+
+    shm_unlink(config->tapName);
+    int fd = shm_open(config->tapName, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd < 0 || ftruncate(fd, length) < 0)
+    {
+        perror("broadcast tap");
+        if (fd >= 0)
+        {
+            close(fd);
+            shm_unlink(config->tapName);
+        }
+        return false;
+    }
+    TapHeader* header = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (header == MAP_FAILED)
+    {
+        perror("broadcast tap");
+        shm_unlink(config->tapName);
+        return false;
+    }
+
+    // A fresh object is zero-filled, so every slot is empty and nothing is published yet
+    header->version = TAP_VERSION;
+    header->slotCount = slotCount;
+    header->slotSize = sizeof(TapSlot);
+    atomic_store_explicit((_Atomic uint32_t*)&header->magic, TAP_MAGIC, memory_order_release);
+    ring = header;
+    ringLength = length;
+    slots = (TapSlot*)(header + 1);
+    slotMask = slotCount - 1;
+    return true;
+}
+
+/*
+    FUNCTION    :   tap_enabled
+    DESCRIPTION :   Tells whether broadcasts are copied into a ring.
+    PARAMETERS  :   none
+    RETURNS     :   bool - true once tap_init created the ring
+*/
+bool tap_enabled(void)
+{
+    return ring != NULL;
+}
+
+/*
+    FUNCTION    :   tap_publish
+    DESCRIPTION :   Copies a broadcast into the next slot, overwriting the message a ring before it
+                    whether or not every reader got to it. The slot's position is cleared before and
+                    set after the copy, so that a reader in the middle of it notices. Called by the
+                    broadcaster only.
+    PARAMETERS  :   uint64_t sequence - The sequence number the history gave it
+                    const char* serializedMessage - The message as broadcast over TCP
+    RETURNS     :   void
+*/
+void tap_publish(uint64_t sequence, const char* serializedMessage)
+{
+    uint64_t position = ++lastPosition;
+    TapSlot* slot = &slots[position & slotMask];
+    size_t length = strnlen(serializedMessage, MAX_SERIALIZED_LENGTH - 1);
+
+    atomic_store_explicit(&slot->position, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot->sequence = sequence;
+    slot->length = (uint32_t)length;
+    memcpy(slot->message, serializedMessage, length);
+    slot->message[length] = '\0';
+    atomic_store_explicit(&slot->position, position, memory_order_release);
+    // Sequentially consistent, like the waiters count tap_flush reads after it, see tapWait
+    atomic_store(&ring->published, position);
+    atomic_fetch_add(&serverStats.tapPublished, 1);
+}
+
+/*
+    FUNCTION    :   tap_flush
+    DESCRIPTION :   Wakes the readers sleeping on the ring, once for a whole batch. Costs a single load
+                    while none sleeps, however many readers there are.
+    PARAMETERS  :   none
+    RETURNS     :   void
+*/
+void tap_flush(void)
+{
+    if (ring == NULL || atomic_load(&ring->waiters) == 0)
+    {
+        return;
+    }
+    atomic_fetch_add(&ring->wakeups, 1);
+    syscall(SYS_futex, (uint32_t*)&ring->wakeups, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+/*
+    FUNCTION    :   tap_stop
+    DESCRIPTION :   Closes the ring and wakes its readers, which then read what is left and attach
+                    again by name. The name itself is unlinked by main on a shutdown only, after a
+                    handoff it already belongs to the successor's ring.
+    PARAMETERS  :   none
+    RETURNS     :   void
+*/
+void tap_stop(void)
+{
+    if (ring == NULL)
+    {
+        return;
+    }
+    atomic_store(&ring->closed, 1);
+    atomic_fetch_add(&ring->wakeups, 1);
+    syscall(SYS_futex, (uint32_t*)&ring->wakeups, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+    munmap(ring, ringLength);
+    ring = NULL;
+    slots = NULL;
+}
@@ -7,18 +7,29 @@
 */
 
 #include "../inc/client-manager.h"
+#include "../inc/client-snapshot.h"
 
 /* 
     FUNCTION    :   init_client_manager
-    DESCRIPTION :   This function initializes all elements of client_sockets array to -1
-                    which indicates that the spot for the client socket is not taken.
-    PARAMETERS  :   none
+    DESCRIPTION :   This function allocates the client_sockets array for the configured number of
+                    clients and initializes all of its elements to -1 which indicates that the spot
+                    for the client socket is not taken.
+    PARAMETERS  :   int capacity - The maximum number of simultaneously connected clients
     RETURNS     :   void
 */
-void init_client_manager() 
+void init_client_manager(int capacity) 
 {
     pthread_mutex_lock(&clientsMutex);
-    memset(client_sockets, -1, sizeof(client_sockets)); // Initialize all client sockets to -1
+    maxClients = capacity;
+    client_sockets = malloc(sizeof(int) * capacity);
+    client_names = calloc(capacity, MAX_USERNAME_LENGTH);
+    client_multicast = calloc(capacity, sizeof(bool));
+    if (client_sockets == NULL || client_names == NULL || client_multicast == NULL)
+    {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    memset(client_sockets, -1, sizeof(int) * capacity); // Initialize all client sockets to -1
     pthread_mutex_unlock(&clientsMutex);
 }
 
@@ -31,22 +42,23 @@ void init_client_manager()
                     thread safety during the operation, making it safe to call in a multi-threaded 
                     environment like a server handling multiple client connections simultaneously.
     PARAMETERS  :   int client_socket
-    RETURNS     :   bool
+    RETURNS     :   int - The slot the client was placed in, or SOCKET_ERROR if there is none
 */
-bool add_client(int client_socket) 
+int add_client(int client_socket) 
 {
     pthread_mutex_lock(&clientsMutex); // Lock the mutex to ensure thread-safe access to client_sockets array
-    for (int i = 0; i < MAX_CLIENTS; i++) 
+    for (int i = 0; i < maxClients; i++) 
     {
         if (client_sockets[i] == -1) // Look for an empty slot
         { 
             client_sockets[i] = client_socket; // Add client socket to the array
+            client_snapshot_publish();
             pthread_mutex_unlock(&clientsMutex); // Unlock the mutex before returning
-            return true;
+            return i;
         }
     }
     pthread_mutex_unlock(&clientsMutex); // Unlock the mutex before returning
-    return false; // No empty slot was found
+    return SOCKET_ERROR; // No empty slot was found
 }
 
 /*
@@ -55,6 +67,8 @@ bool add_client(int client_socket)
                     This function iterates through the client_sockets array to find the matching
                     client socket descriptor. Upon finding the descriptor, it sets its value in the
                     array to -1, indicating that the slot is now available for a new connection.
+                    The fan-out may still be writing to the socket from an older snapshot, so it is
+                    closed only after client_snapshot_synchronize.
     PARAMETERS  :   int client_socket - The socket descriptor of the client to be removed. This
                     descriptor is used to identify the client in the array of connected clients.
     RETURNS     :   void - This function does not return a value.
@@ -62,17 +76,90 @@ bool add_client(int client_socket)
 void remove_client(int client_socket) 
 {
     pthread_mutex_lock(&clientsMutex); // Lock the mutex to ensure thread-safe access to client_sockets array
-    for (int i = 0; i < MAX_CLIENTS; i++) 
+    for (int i = 0; i < maxClients; i++) 
     {
         if (client_sockets[i] == client_socket) 
         {
             client_sockets[i] = -1; // Remove client socket from the array and reset it to -1
+            client_names[i][0] = '\0';
+            client_multicast[i] = false;
+            client_snapshot_publish();
             break; // Exit the loop once the client socket is found and handled
         }
     }
     pthread_mutex_unlock(&clientsMutex); // Unlock the mutex after operation
 }
 
+/*
+    FUNCTION    :   restore_client
+    DESCRIPTION :   Places a client socket inherited from a previous server process back into the
+                    exact slot it occupied there, together with the last username seen on it.
+    PARAMETERS  :   int slot - The registry slot the client occupied in the previous process
+                    int client_socket - The inherited socket descriptor
+                    const char* userName - The username last seen on the connection
+    RETURNS     :   bool - false if the slot is out of range or already taken
+*/
+bool restore_client(int slot, int client_socket, const char* userName)
+{
+    if (slot < 0 || slot >= maxClients)
+    {
+        return false;
+    }
+
+    pthread_mutex_lock(&clientsMutex);
+    if (client_sockets[slot] != -1)
+    {
+        pthread_mutex_unlock(&clientsMutex);
+        return false;
+    }
+    client_sockets[slot] = client_socket;
+    strncpy(client_names[slot], userName, MAX_USERNAME_LENGTH - 1);
+    client_names[slot][MAX_USERNAME_LENGTH - 1] = '\0';
+    client_snapshot_publish();
+    pthread_mutex_unlock(&clientsMutex);
+    return true;
+}
+
+/*
+    FUNCTION    :   set_client_name
+    DESCRIPTION :   Records the username last seen on a client socket so it survives a hot restart.
+    PARAMETERS  :   int client_socket - The socket descriptor of the client
+                    const char* userName - The username carried by its latest message
+    RETURNS     :   void
+*/
+void set_client_name(int client_socket, const char* userName)
+{
+    pthread_mutex_lock(&clientsMutex);
+    for (int i = 0; i < maxClients; i++)
+    {
+        if (client_sockets[i] == client_socket)
+        {
+            strncpy(client_names[i], userName, MAX_USERNAME_LENGTH - 1);
+            client_names[i][MAX_USERNAME_LENGTH - 1] = '\0';
+            break;
+        }
+    }
+    pthread_mutex_unlock(&clientsMutex);
+}
+
+/*
+    FUNCTION    :   find_client_slot
+    DESCRIPTION :   Looks up the registry slot of a client socket. Caller holds clientsMutex.
+    PARAMETERS  :   int client_socket - The socket descriptor of the client
+    RETURNS     :   int - The slot, or -1 if the socket is not registered (any more)
+*/
+int find_client_slot(int client_socket)
+{
+    for (int i = 0; i < maxClients; i++)
+    {
+        if (client_sockets[i] == client_socket)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
 /*
     FUNCTION    :   cleanup_clients
     DESCRIPTION :   Iterates through the server's array of client sockets, closing any open socket
@@ -83,12 +170,16 @@ void remove_client(int client_socket)
 void cleanup_clients() 
 {
     pthread_mutex_lock(&clientsMutex);
-    for (int i = 0; i < MAX_CLIENTS; i++) 
+    for (int i = 0; i < maxClients; i++) 
     {
         if (client_sockets[i] != -1) {
+            transportClose(client_sockets[i]);
             close(client_sockets[i]); // Close the socket
             client_sockets[i] = -1; // Mark as available
+            client_names[i][0] = '\0';
+            client_multicast[i] = false;
         }
     }
+    client_snapshot_publish();
     pthread_mutex_unlock(&clientsMutex);
 }
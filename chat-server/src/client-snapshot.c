@@ -0,0 +1,166 @@
+/*
+* FILE              :   client-snapshot.c
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This file contains the read-copy-update snapshot of the client registry. Every
+                        change to the registry, made under clientsMutex, publishes a fresh immutable
+                        copy. The fan-out reads the copy current when it started without taking any
+                        lock, so joins and leaves never wait for a slow broadcast and a broadcast never
+                        waits for them. Replaced copies are freed with epoch-based reclamation: a reader
+                        announces the global epoch it entered in, and a copy retired in an epoch is freed
+                        once every reader inside announced a later one. A leaving client's socket is only
+                        closed after client_snapshot_synchronize, so that no reader can still write to
+                        its descriptor once it is reused.
+*/
+
+#include "../inc/client-snapshot.h"
+#include "../inc/client-manager.h"
+#include <stdatomic.h>
+#include <poll.h>
+
+static _Atomic(ClientSnapshot*) currentSnapshot = NULL;
+static ClientSnapshot emptySnapshot;                            // read until the first publish
+static atomic_uint_fast64_t globalEpoch = 1;
+static atomic_uint_fast64_t readerEpochs[SNAPSHOT_READERS];     // epoch each reader entered in, 0 for a free place
+static ClientSnapshot* retiredSnapshots = NULL;                 // replaced copies not freed yet, under clientsMutex
+
+/*
+    FUNCTION    :   oldest_reader_epoch
+    DESCRIPTION :   Finds the earliest epoch a reader inside a snapshot entered in.
+    PARAMETERS  :   none
+    RETURNS     :   uint64_t - That epoch, UINT64_MAX if no reader is inside
+*/
+static uint64_t oldest_reader_epoch(void)
+{
+    uint64_t oldest = UINT64_MAX;
+    for (int i = 0; i < SNAPSHOT_READERS; i++)
+    {
+        uint64_t epoch = atomic_load(&readerEpochs[i]);
+        if (epoch != 0 && epoch < oldest)
+        {
+            oldest = epoch;
+        }
+    }
+    return oldest;
+}
+
+/*
+    FUNCTION    :   client_snapshot_publish
+    DESCRIPTION :   Copies the registry into a new snapshot, makes it the current one and frees the
+                    replaced copies no reader can still be inside. Called after every change to the
+                    registry, with clientsMutex held, which also serializes the publishers.
+    PARAMETERS  :   none
+    RETURNS     :   void
+*/
+void client_snapshot_publish(void)
+{
+    ClientSnapshot* snapshot = malloc(sizeof(*snapshot) + maxClients * (sizeof(SnapshotClient) + sizeof(int)));
+    if (snapshot == NULL)
+    {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    snapshot->count = 0;
+    snapshot->slotSockets = (int*)&snapshot->clients[maxClients];
+    snapshot->nextRetired = NULL;
+    for (int i = 0; i < maxClients; i++)
+    {
+        snapshot->slotSockets[i] = client_sockets[i];
+        if (client_sockets[i] != -1)
+        {
+            SnapshotClient* client = &snapshot->clients[snapshot->count++];
+            client->sock = client_sockets[i];
+            client->slot = i;
+            client->multicast = client_multicast[i];
+        }
+    }
+
+    ClientSnapshot* replaced = atomic_exchange(&currentSnapshot, snapshot);
+    if (replaced != NULL)
+    {
+        // Readers that announce a later epoch are sure to load the new copy
+        replaced->retiredEpoch = atomic_fetch_add(&globalEpoch, 1);
+        replaced->nextRetired = retiredSnapshots;
+        retiredSnapshots = replaced;
+    }
+
+    uint64_t oldest = oldest_reader_epoch();
+    ClientSnapshot** link = &retiredSnapshots;
+    while (*link != NULL)
+    {
+        ClientSnapshot* retired = *link;
+        if (retired->retiredEpoch < oldest)
+        {
+            *link = retired->nextRetired;
+            free(retired);
+        }
+        else
+        {
+            link = &retired->nextRetired;
+        }
+    }
+}
+
+/*
+    FUNCTION    :   client_snapshot_enter
+    DESCRIPTION :   Takes a place among the readers and returns the current snapshot, which stays
+                    valid until client_snapshot_exit. Readers never wait for publishers.
+    PARAMETERS  :   int* reader - Receives the place, to be passed to client_snapshot_exit
+    RETURNS     :   const ClientSnapshot* - The snapshot
+*/
+const ClientSnapshot* client_snapshot_enter(int* reader)
+{
+    for (int i = 0; ; i = (i + 1) % SNAPSHOT_READERS)
+    {
+        uint_fast64_t vacant = 0;
+        if (atomic_compare_exchange_strong(&readerEpochs[i], &vacant, atomic_load(&globalEpoch)))
+        {
+            *reader = i;
+            break;
+        }
+    }
+    ClientSnapshot* snapshot = atomic_load(&currentSnapshot);
+    return snapshot == NULL ? &emptySnapshot : snapshot;
+}
+
+/*
+    FUNCTION    :   client_snapshot_exit
+    DESCRIPTION :   Leaves a snapshot; the reader must not touch it afterwards.
+    PARAMETERS  :   int reader - The place client_snapshot_enter returned
+    RETURNS     :   void
+*/
+void client_snapshot_exit(int reader)
+{
+    atomic_store(&readerEpochs[reader], 0);
+}
+
+/*
+    FUNCTION    :   client_snapshot_contains
+    DESCRIPTION :   Tells whether a client was registered in a slot as of a snapshot.
+    PARAMETERS  :   const ClientSnapshot* snapshot - The snapshot
+                    int slot - The registry slot
+                    int sock - The client socket
+    RETURNS     :   bool - true if the slot held that socket
+*/
+bool client_snapshot_contains(const ClientSnapshot* snapshot, int slot, int sock)
+{
+    return snapshot->slotSockets != NULL && slot >= 0 && slot < maxClients && snapshot->slotSockets[slot] == sock;
+}
+
+/*
+    FUNCTION    :   client_snapshot_synchronize
+    DESCRIPTION :   Waits until every reader that might still see a snapshot published before the call
+                    has left it. Called after a client left the registry and before its socket is
+                    closed; only the leaving thread waits, and for one broadcast at most.
+    PARAMETERS  :   none
+    RETURNS     :   void
+*/
+void client_snapshot_synchronize(void)
+{
+    uint64_t epoch = atomic_fetch_add(&globalEpoch, 1);
+    while (oldest_reader_epoch() <= epoch)
+    {
+        poll(NULL, 0, SNAPSHOT_GRACE_POLL_MILLISECONDS);
+    }
+}
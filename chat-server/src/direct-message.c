@@ -0,0 +1,239 @@
+/*
+* FILE              :   direct-message.c
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This file contains direct messages. A connection claims its username when it says
+                        >>hello<<, or with its first message if it never does, and the index from username
+                        to registry slot is what the intern table already is: an interned name's identifier
+                        is a stable index while anybody holds it, and a connection holds its own, so the
+                        owner of every name is one atomic word, claimed and freed with compare-and-swap and
+                        read without any lock. A >>hello<< naming a user another
+                        connection holds is turned away. A message starting with /msg <user> is rerouted by
+                        a transform stage of the message pipeline to that user's connection alone.
+*/
+
+#include "server-utility.h"
+#include "../inc/direct-message.h"
+#include "../inc/pipeline.h"
+#include "../inc/keepalive.h"
+#include "../inc/server-stats.h"
+#include <ctype.h>
+
+static atomic_int nameOwners[INTERN_TABLE_SIZE + 1];   // slot + 1 of the connection holding each interned name, 0 for none
+static InternId* slotNames;                            // name each slot holds, INTERN_NONE for none; only its own handler writes it
+
+/*
+    FUNCTION    :   direct_claim
+    DESCRIPTION :   Makes a connection the owner of a username, giving up the one it held before, and
+                    keeps a reference to the name for as long as it holds it. The common case of a
+                    connection naming the user it already holds takes no atomic write.
+    PARAMETERS  :   int slot - The registry slot
+                    InternId user - The interned username, INTERN_NONE is ignored
+    RETURNS     :   bool - false if another connection holds the name
+*/
+bool direct_claim(int slot, InternId user)
+{
+    if (user == INTERN_NONE || slotNames[slot] == user)
+    {
+        return true;
+    }
+    int vacant = 0;
+    if (!atomic_compare_exchange_strong(&nameOwners[user], &vacant, slot + 1))
+    {
+        return false;
+    }
+    internRetain(user);
+    direct_release(slot);
+    slotNames[slot] = user;
+    return true;
+}
+
+/*
+    FUNCTION    :   direct_claim_name
+    DESCRIPTION :   direct_claim for a name given as text, cut to the length a message carries.
+    PARAMETERS  :   int slot - The registry slot
+                    const char* userName - The username, the empty one leaves the name held as it is
+    RETURNS     :   int - DIRECT_CLAIMED, DIRECT_TAKEN, or DIRECT_NO_ROOM if the name could not be interned
+*/
+int direct_claim_name(int slot, const char* userName)
+{
+    char name[MAX_USERNAME_LENGTH];
+    strncpy(name, userName, MAX_USERNAME_LENGTH - 1);
+    name[MAX_USERNAME_LENGTH - 1] = '\0';
+
+    InternId user = internString(name);
+    if (user == INTERN_FAILED)
+    {
+        atomic_fetch_add(&serverStats.namesRefused, 1);
+        return DIRECT_NO_ROOM;
+    }
+    bool claimed = direct_claim(slot, user);
+    internRelease(user);
+    return claimed ? DIRECT_CLAIMED : DIRECT_TAKEN;
+}
+
+/*
+    FUNCTION    :   direct_name
+    DESCRIPTION :   Tells which username a connection holds. Called by the slot's handler, or by
+                    whoever else runs it before the handler starts.
+    PARAMETERS  :   int slot - The registry slot
+    RETURNS     :   InternId - The name, INTERN_NONE for none; valid while the connection holds it
+*/
+InternId direct_name(int slot)
+{
+    return slotNames[slot];
+}
+
+/*
+    FUNCTION    :   direct_release
+    DESCRIPTION :   Frees the username a connection holds, if any.
+    PARAMETERS  :   int slot - The registry slot
+    RETURNS     :   void
+*/
+void direct_release(int slot)
+{
+    if (slotNames[slot] != INTERN_NONE)
+    {
+        int owner = slot + 1;
+        atomic_compare_exchange_strong(&nameOwners[slotNames[slot]], &owner, 0);
+        internRelease(slotNames[slot]);
+        slotNames[slot] = INTERN_NONE;
+    }
+}
+
+/*
+    FUNCTION    :   direct_lookup
+    DESCRIPTION :   Finds the connection that holds a username.
+    PARAMETERS  :   InternId user - The interned username
+    RETURNS     :   int - Its registry slot, -1 if nobody holds the name
+*/
+int direct_lookup(InternId user)
+{
+    return user == INTERN_NONE ? -1 : atomic_load(&nameOwners[user]) - 1;
+}
+
+/*
+    FUNCTION    :   reroute_to_sender
+    DESCRIPTION :   Turns a direct message that cannot be delivered into a notice from the server for
+                    its sender alone.
+    PARAMETERS  :   PipelineBatch* batch - The batch
+                    int index - The message
+                    const char* notice - What the sender is told
+    RETURNS     :   void
+*/
+static void reroute_to_sender(PipelineBatch* batch, int index, const char* notice)
+{
+    Message* message = &batch->messages[index];
+    int sock = message->senderSock;
+
+    pthread_mutex_lock(&clientsMutex);
+    int slot = sock < 0 ? -1 : find_client_slot(sock);
+    pthread_mutex_unlock(&clientsMutex);
+    if (slot < 0)
+    {
+        pipeline_drop(batch, index);
+        return;
+    }
+
+    releaseMessage(message);
+    initMessage(message, HEARTBEAT_SENDER_IP, HEARTBEAT_SENDER_NAME);
+    setMessageBody(message, notice, strlen(notice));
+    message->senderSock = sock;
+    batch->recipients[index] = sock;
+    batch->recipientSlots[index] = slot;
+}
+
+/*
+    FUNCTION    :   route_direct_messages
+    DESCRIPTION :   Pipeline stage that sends every message of a batch starting with /msg <user> to the
+                    connection holding that username only, without the command.
+    PARAMETERS  :   PipelineBatch* batch - The batch
+                    void* context - Unused
+    RETURNS     :   void
+*/
+static void route_direct_messages(PipelineBatch* batch, void* context)
+{
+    (void)context;
+    for (int i = 0; i < batch->count; i++)
+    {
+        const char* body = messageBody(&batch->messages[i]);
+        if (batch->recipients[i] != PIPELINE_EVERYONE ||
+            strncmp(body, DIRECT_MESSAGE_COMMAND, strlen(DIRECT_MESSAGE_COMMAND)) != STRING_EQUALITY)
+        {
+            continue;
+        }
+
+        // The recipient is the first word after the command, the text whatever follows the blanks after it
+        const char* name = body + strlen(DIRECT_MESSAGE_COMMAND);
+        while (isspace((unsigned char)*name))
+        {
+            name++;
+        }
+        size_t nameLength = 0;
+        while (name[nameLength] != '\0' && !isspace((unsigned char)name[nameLength]))
+        {
+            nameLength++;
+        }
+        if (nameLength == 0)
+        {
+            continue; // "/msg" alone is an ordinary message
+        }
+        if (nameLength >= MAX_USERNAME_LENGTH)
+        {
+            // Nobody can hold it, and a prefix of it could be somebody else
+            reroute_to_sender(batch, i, DIRECT_NAME_TOO_LONG);
+            continue;
+        }
+        char recipient[MAX_USERNAME_LENGTH];
+        memcpy(recipient, name, nameLength);
+        recipient[nameLength] = '\0';
+        const char* text = name + nameLength;
+        while (isspace((unsigned char)*text))
+        {
+            text++;
+        }
+
+        // A name nobody holds is not interned just to find out that it is not online
+        InternId user = internFind(recipient);
+        int slot = direct_lookup(user);
+        internRelease(user);
+        int sock = -1;
+        if (slot >= 0)
+        {
+            pthread_mutex_lock(&clientsMutex);
+            sock = client_sockets[slot];
+            pthread_mutex_unlock(&clientsMutex);
+        }
+        if (sock < 0)
+        {
+            char notice[MAX_USERNAME_LENGTH + sizeof(DIRECT_NOT_ONLINE)];
+            snprintf(notice, sizeof(notice), "%s%s", recipient, DIRECT_NOT_ONLINE);
+            reroute_to_sender(batch, i, notice);
+            continue;
+        }
+
+        char delivered[MAX_BODY_LENGTH + 1];
+        snprintf(delivered, sizeof(delivered), "%s", text);
+        setMessageBody(&batch->messages[i], delivered, strlen(delivered));
+        batch->recipients[i] = sock;
+        batch->recipientSlots[i] = slot;
+    }
+}
+
+/*
+    FUNCTION    :   direct_init
+    DESCRIPTION :   Allocates the per slot state and registers the routing stage.
+    PARAMETERS  :   int slots - Size of the client registry
+    RETURNS     :   bool - false if the stage could not be registered
+*/
+bool direct_init(int slots)
+{
+    slotNames = calloc(slots, sizeof(*slotNames));
+    if (slotNames == NULL)
+    {
+        perror("calloc failed");
+        exit(EXIT_FAILURE);
+    }
+    return pipeline_register("direct-messages", PIPELINE_TRANSFORM, route_direct_messages, NULL);
+}
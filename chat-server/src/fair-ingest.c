@@ -0,0 +1,220 @@
+/*
+* FILE              :   fair-ingest.c
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This file contains the fair ingest. Every connection queues its messages in its own
+                        flow of messageQueue, the flow of its registry slot plus one, and the broadcaster
+                        serves the flows in deficit round robin order. A client sending as fast as it can
+                        then only lengthens its own queue, everyone else's messages still go out within a
+                        round. Users named in -weights get a larger share of each round. Flow 0 holds the
+                        messages inherited from a hot restart. How long each sender's messages waited is
+                        reported with the server counters.
+*/
+
+#include "server-utility.h"
+#include "../inc/fair-ingest.h"
+#include "../inc/server-stats.h"
+#include <stdatomic.h>
+#include <time.h>
+
+static InternId weightedUsers[MAX_WEIGHTED_USERS];
+static int userWeights[MAX_WEIGHTED_USERS];
+static int weightedCount = 0;
+static int defaultWeight = DEFAULT_SENDER_WEIGHT;
+static _Atomic InternId* slotUsers;     // user whose weight the slot's flow has, written by the slot's handler; only
+                                        // compared, a weighted name is held by weightedUsers and never reused
+static QueueFlowDelay* flowDelays;      // scratch of the report, flows 0 to flowCount - 1
+static int flowCount;
+
+/*
+    FUNCTION    :   parse_weights
+    DESCRIPTION :   Parses a list such as "alice=4,bob=2" into the weighted users.
+    PARAMETERS  :   const char* list - The -weights value
+    RETURNS     :   bool - false if the list is malformed, too long or a weight is out of range
+*/
+static bool parse_weights(const char* list)
+{
+    const char* cursor = list;
+
+    while (*cursor != '\0')
+    {
+        const char* equals = strchr(cursor, '=');
+        size_t nameLength = equals == NULL ? 0 : (size_t)(equals - cursor);
+        if (nameLength == 0 || nameLength >= MAX_USERNAME_LENGTH || weightedCount == MAX_WEIGHTED_USERS)
+        {
+            return false;
+        }
+        char* end;
+        long weight = strtol(equals + 1, &end, 10);
+        if (end == equals + 1 || weight < 1 || weight > MAX_SENDER_WEIGHT || (*end != ',' && *end != '\0'))
+        {
+            return false;
+        }
+
+        char name[MAX_USERNAME_LENGTH];
+        memcpy(name, cursor, nameLength);
+        name[nameLength] = '\0';
+        weightedUsers[weightedCount] = internString(name);
+        userWeights[weightedCount] = (int)weight;
+        weightedCount++;
+        cursor = *end == ',' ? end + 1 : end;
+    }
+    return true;
+}
+
+/*
+    FUNCTION    :   weight_of
+    DESCRIPTION :   Looks up the share of a user.
+    PARAMETERS  :   InternId user - The interned username
+    RETURNS     :   int - Its weight from -weights, otherwise the default weight
+*/
+static int weight_of(InternId user)
+{
+    for (int i = 0; i < weightedCount; i++)
+    {
+        if (weightedUsers[i] == user)
+        {
+            return userWeights[i];
+        }
+    }
+    return defaultWeight;
+}
+
+/*
+    FUNCTION    :   fair_ingest_init
+    DESCRIPTION :   Reads the weights and splits messageQueue into one flow per registry slot plus
+                    the flow of inherited messages. Called after queueInit and before any message is
+                    queued.
+    PARAMETERS  :   const ServerConfig* config - The parsed command line
+                    int slots - Size of the client registry
+    RETURNS     :   bool - false if -weights is malformed
+*/
+bool fair_ingest_init(const ServerConfig* config, int slots)
+{
+    defaultWeight = config->senderWeight;
+    if (config->senderWeights != NULL && !parse_weights(config->senderWeights))
+    {
+        fprintf(stderr, "Invalid weights: %s\n", config->senderWeights);
+        return false;
+    }
+
+    flowCount = slots + 1;
+    slotUsers = calloc(slots, sizeof(*slotUsers));
+    flowDelays = calloc(flowCount, sizeof(*flowDelays));
+    if (slotUsers == NULL || flowDelays == NULL || !queueEnableFairness(&messageQueue, flowCount))
+    {
+        perror("calloc failed");
+        exit(EXIT_FAILURE);
+    }
+    for (int flow = 0; flow < flowCount; flow++)
+    {
+        queueSetFlowWeight(&messageQueue, flow, defaultWeight);
+    }
+    return true;
+}
+
+/*
+    FUNCTION    :   fair_ingest_join
+    DESCRIPTION :   Gives the flow of a slot taken by a new connection the default weight until its
+                    first message names the user.
+    PARAMETERS  :   int slot - The registry slot
+    RETURNS     :   void
+*/
+void fair_ingest_join(int slot)
+{
+    atomic_store(&slotUsers[slot], INTERN_NONE);
+    queueSetFlowWeight(&messageQueue, slot + 1, defaultWeight);
+}
+
+/*
+    FUNCTION    :   fair_ingest_enqueue
+    DESCRIPTION :   Queues a message in its sender's flow, first giving the flow the weight of the
+                    user the message is from if that changed. Called by the slot's handler only.
+    PARAMETERS  :   int slot - The sender's registry slot
+                    const Message* message - The message, the queue owns its body afterwards
+    RETURNS     :   void
+*/
+void fair_ingest_enqueue(int slot, const Message* message)
+{
+    if (atomic_load_explicit(&slotUsers[slot], memory_order_relaxed) != message->userId)
+    {
+        atomic_store(&slotUsers[slot], message->userId);
+        queueSetFlowWeight(&messageQueue, slot + 1, weight_of(message->userId));
+    }
+    enqueueFlow(&messageQueue, message, slot + 1);
+}
+
+/*
+    FUNCTION    :   fair_ingest_report
+    DESCRIPTION :   Prints, once per reporting interval in which messages were sent, how many senders
+                    were served and the queueing delay of those whose messages waited longest. Only
+                    called from the main thread.
+    PARAMETERS  :   none
+    RETURNS     :   void
+*/
+void fair_ingest_report(void)
+{
+    static uint64_t lastReportMs = 0;
+    struct timespec now;
+    int worst[FAIR_REPORT_SENDERS];
+    int worstCount = 0;
+    int senders = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t nowMs = (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+    if (nowMs - lastReportMs < STATS_INTERVAL_MILLISECONDS)
+    {
+        return;
+    }
+    lastReportMs = nowMs;
+
+    queueTakeFlowDelays(&messageQueue, flowDelays, flowCount);
+    for (int flow = 0; flow < flowCount; flow++)
+    {
+        if (flowDelays[flow].served == 0)
+        {
+            continue;
+        }
+        senders++;
+        // Insertion into the few longest delays seen so far
+        int place = worstCount < FAIR_REPORT_SENDERS ? worstCount++ : FAIR_REPORT_SENDERS;
+        while (place > 0 && flowDelays[worst[place - 1]].maxNanoseconds < flowDelays[flow].maxNanoseconds)
+        {
+            if (place < FAIR_REPORT_SENDERS)
+            {
+                worst[place] = worst[place - 1];
+            }
+            place--;
+        }
+        if (place < FAIR_REPORT_SENDERS)
+        {
+            worst[place] = flow;
+        }
+    }
+    if (senders == 0)
+    {
+        return;
+    }
+
+    printf("ingest delay of %d senders:", senders);
+    for (int i = 0; i < worstCount; i++)
+    {
+        const QueueFlowDelay* delay = &flowDelays[worst[i]];
+        // The slot holds no reference to the name, it is copied rather than read in place
+        char held[MAX_USERNAME_LENGTH];
+        const char* name = "inherited";
+        if (worst[i] != QUEUE_DEFAULT_FLOW)
+        {
+            internCopy(atomic_load(&slotUsers[worst[i] - 1]), held, sizeof(held));
+            name = held;
+        }
+        char average[16];
+        char longest[16];
+        formatLatency(delay->totalNanoseconds / delay->served, average, sizeof(average));
+        formatLatency(delay->maxNanoseconds, longest, sizeof(longest));
+        printf("%s %s avg %s max %s (%" PRIu64 " sent, %u waiting)", i == 0 ? "" : ",", name, average, longest, delay->served, delay->queued);
+    }
+    printf("\n");
+    fflush(stdout);
+}
@@ -0,0 +1,215 @@
+/*
+* FILE              :   hibernation.c
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This file contains the hibernation of idle connections. Most clients sit idle for
+                        hours, and each of them would hold a handler thread with its stack for nothing.
+                        A handler that read no message for -hibernate<S> seconds hands its socket to an
+                        epoll set watched by the main loop and returns. All that is left of the connection
+                        is its registry slot and the few bytes kept here. When the socket becomes readable
+                        again the main loop starts a new handler for it, which carries on where the old
+                        one stopped. Heartbeat replies do not count as messages, so a client that only
+                        answers pings wakes up for each of them and goes back to sleep straight away.
+                        Broadcasts, heartbeats and other writes to a hibernating client need no handler.
+*/
+
+#include "server-utility.h"
+#include "../inc/hibernation.h"
+#include "../inc/server-stats.h"
+#include <sys/epoll.h>
+#include <time.h>
+
+static int hibernateEpoll = -1;
+static uint64_t hibernateNanoseconds;          // 0 disables hibernation
+static _Atomic uint64_t* lastActiveNanoseconds; // when each slot last sent a message, written by its handler
+static uint64_t* joinedSequences;               // what each hibernating handler needs to carry on
+static bool* hibernating;                       // under clientsMutex
+
+/*
+    FUNCTION    :   coarse_nanoseconds
+    DESCRIPTION :   Reads the coarse monotonic clock, which costs next to nothing and is precise enough
+                    for idle times counted in seconds.
+    PARAMETERS  :   none
+    RETURNS     :   uint64_t - The current time in nanoseconds
+*/
+static uint64_t coarse_nanoseconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+/*
+    FUNCTION    :   hibernation_init
+    DESCRIPTION :   Stores the idle time and creates the epoll set of hibernating connections.
+    PARAMETERS  :   const ServerConfig* config - The parsed command line
+                    int slots - Size of the client registry
+    RETURNS     :   bool - false if the epoll set could not be created
+*/
+bool hibernation_init(const ServerConfig* config, int slots)
+{
+    hibernateNanoseconds = (uint64_t)config->hibernateSeconds * 1000000000ull;
+    lastActiveNanoseconds = calloc(slots, sizeof(*lastActiveNanoseconds));
+    joinedSequences = calloc(slots, sizeof(*joinedSequences));
+    hibernating = calloc(slots, sizeof(*hibernating));
+    if (lastActiveNanoseconds == NULL || joinedSequences == NULL || hibernating == NULL)
+    {
+        perror("calloc failed");
+        exit(EXIT_FAILURE);
+    }
+    if (hibernateNanoseconds == 0)
+    {
+        return true;
+    }
+
+    hibernateEpoll = epoll_create1(EPOLL_CLOEXEC);
+    if (hibernateEpoll < 0)
+    {
+        perror("epoll_create1");
+        return false;
+    }
+    return true;
+}
+
+/*
+    FUNCTION    :   hibernation_fd
+    DESCRIPTION :   Returns the epoll set of hibernating connections, which the main loop watches
+                    for readiness like a listening socket.
+    PARAMETERS  :   none
+    RETURNS     :   int - The descriptor, -1 if hibernation is off
+*/
+int hibernation_fd(void)
+{
+    return hibernateEpoll;
+}
+
+/*
+    FUNCTION    :   hibernation_touch
+    DESCRIPTION :   Restarts the idle time of a connection. Called by its handler for every frame
+                    other than a heartbeat reply.
+    PARAMETERS  :   int slot - The registry slot
+    RETURNS     :   void
+*/
+void hibernation_touch(int slot)
+{
+    if (hibernateNanoseconds > 0)
+    {
+        atomic_store_explicit(&lastActiveNanoseconds[slot], coarse_nanoseconds(), memory_order_relaxed);
+    }
+}
+
+/*
+    FUNCTION    :   hibernation_timeout
+    DESCRIPTION :   Tells a handler how long it may wait for input before its connection hibernates.
+    PARAMETERS  :   int slot - The registry slot
+    RETURNS     :   int - Milliseconds, 0 if the connection is idle already, -1 to wait forever
+*/
+int hibernation_timeout(int slot)
+{
+    if (hibernateNanoseconds == 0)
+    {
+        return -1;
+    }
+    uint64_t idle = coarse_nanoseconds() - atomic_load_explicit(&lastActiveNanoseconds[slot], memory_order_relaxed);
+    return idle >= hibernateNanoseconds ? 0 : (int)((hibernateNanoseconds - idle + 999999) / 1000000);
+}
+
+/*
+    FUNCTION    :   hibernation_enter
+    DESCRIPTION :   Hands an idle connection over to the main loop. On success the calling handler
+                    must return without touching the socket again, since the main loop may start its
+                    successor at once.
+    PARAMETERS  :   int sock - The client socket, with no input waiting
+                    int slot - The registry slot
+                    uint64_t joinedSequence - Sequence number of the first broadcast it received live
+    RETURNS     :   bool - false if the socket could not be watched, the handler then keeps it and
+                    tries again after another idle period
+*/
+bool hibernation_enter(int sock, int slot, uint64_t joinedSequence)
+{
+    struct epoll_event event = { .events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT, .data.u32 = (uint32_t)slot };
+
+    joinedSequences[slot] = joinedSequence;
+    pthread_mutex_lock(&clientsMutex);
+    hibernating[slot] = true;
+    pthread_mutex_unlock(&clientsMutex);
+    if (epoll_ctl(hibernateEpoll, EPOLL_CTL_ADD, sock, &event) < 0)
+    {
+        perror("epoll_ctl");
+        pthread_mutex_lock(&clientsMutex);
+        hibernating[slot] = false;
+        pthread_mutex_unlock(&clientsMutex);
+        atomic_store_explicit(&lastActiveNanoseconds[slot], coarse_nanoseconds(), memory_order_relaxed);
+        return false;
+    }
+    atomic_fetch_add(&serverStats.connectionsHibernated, 1);
+    return true;
+}
+
+/*
+    FUNCTION    :   hibernation_joined_sequence
+    DESCRIPTION :   Returns what the handler that hibernated a connection passed to hibernation_enter.
+    PARAMETERS  :   int slot - The registry slot
+    RETURNS     :   uint64_t - Sequence number of the first broadcast it received live
+*/
+uint64_t hibernation_joined_sequence(int slot)
+{
+    return joinedSequences[slot];
+}
+
+/*
+    FUNCTION    :   hibernation_wake
+    DESCRIPTION :   Starts a handler for every hibernating connection that became readable, because
+                    it sent something, was shut down by the idle reaper or went away. A connection
+                    whose handler cannot be started is disconnected. Called by the main loop when the
+                    epoll set is readable.
+    PARAMETERS  :   none
+    RETURNS     :   void
+*/
+void hibernation_wake(void)
+{
+    struct epoll_event events[HIBERNATION_WAKE_BATCH];
+    int ready = epoll_wait(hibernateEpoll, events, HIBERNATION_WAKE_BATCH, 0);
+
+    for (int i = 0; i < ready; i++)
+    {
+        int slot = (int)events[i].data.u32;
+        pthread_mutex_lock(&clientsMutex);
+        int sock = hibernating[slot] ? client_sockets[slot] : -1;
+        hibernating[slot] = false;
+        pthread_mutex_unlock(&clientsMutex);
+        if (sock == -1)
+        {
+            continue;
+        }
+
+        epoll_ctl(hibernateEpoll, EPOLL_CTL_DEL, sock, NULL);
+        atomic_fetch_add(&serverStats.connectionsWoken, 1);
+        if (!spawn_connection_handler(sock, slot, true))
+        {
+            disconnect_client(sock, slot);
+        }
+    }
+}
+
+/*
+    FUNCTION    :   hibernation_forget_all
+    DESCRIPTION :   Stops watching every hibernating connection. Called before start_workers gives
+                    each registered client a fresh handler, after a failed handoff.
+    PARAMETERS  :   none
+    RETURNS     :   void
+*/
+void hibernation_forget_all(void)
+{
+    pthread_mutex_lock(&clientsMutex);
+    for (int i = 0; i < maxClients; i++)
+    {
+        if (hibernating[i])
+        {
+            epoll_ctl(hibernateEpoll, EPOLL_CTL_DEL, client_sockets[i], NULL);
+            hibernating[i] = false;
+        }
+    }
+    pthread_mutex_unlock(&clientsMutex);
+}
@@ -0,0 +1,417 @@
+/*
+* FILE              :   hot-restart.c
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This file contains the hot restart support of the chat-server. A running server
+                        listens on a unix socket; a newly started binary run with -takeover connects to it
+                        and receives the listening sockets, every client socket (SCM_RIGHTS) with its
+                        registry slot and username, and the messages still waiting to be broadcast.
+                        The old process then exits while the clients stay connected.
+*/
+
+#include "server-utility.h"
+#include "../inc/hot-restart.h"
+#include "../inc/accept-manager.h"
+#include "../inc/multicast-publisher.h"
+#include "../inc/message-history.h"
+#include "../inc/offline-mailbox.h"
+#include "../inc/presence-service.h"
+#include "../inc/direct-message.h"
+#include "../inc/write-ahead-log.h"
+#include <inttypes.h>
+#include <stddef.h>
+
+#define HANDOFF_HEADER_SIZE offsetof(HandoffRecord, payload)
+
+/*
+    FUNCTION    :   send_record
+    DESCRIPTION :   Sends one handoff record, optionally passing a file descriptor along with it.
+    PARAMETERS  :   int channel - The connected handoff socket
+                    uint32_t type - The record type
+                    int32_t slot - The registry slot (or version)
+                    const char* payload - Payload bytes, may be NULL
+                    uint32_t payloadLength - Number of payload bytes
+                    int fd - Descriptor to pass, or -1
+    RETURNS     :   int - 0 on success, -1 on failure
+*/
+static int send_record(int channel, uint32_t type, int32_t slot, const char* payload, uint32_t payloadLength, int fd)
+{
+    HandoffRecord record;
+    struct msghdr msg;
+    struct iovec iov;
+    char control[CMSG_SPACE(sizeof(int))];
+
+    if (payloadLength >= HANDOFF_MAX_PAYLOAD)
+    {
+        return -1;
+    }
+    record.type = type;
+    record.slot = slot;
+    record.payloadLength = payloadLength;
+    if (payloadLength > 0)
+    {
+        memcpy(record.payload, payload, payloadLength);
+    }
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = &record;
+    iov.iov_len = HANDOFF_HEADER_SIZE + payloadLength;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    if (fd >= 0)
+    {
+        memset(control, 0, sizeof(control));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    }
+
+    if (sendmsg(channel, &msg, MSG_NOSIGNAL) != (ssize_t)iov.iov_len)
+    {
+        perror("handoff send");
+        return -1;
+    }
+    return 0;
+}
+
+/*
+    FUNCTION    :   receive_record
+    DESCRIPTION :   Receives one handoff record and the file descriptor passed with it, if any.
+    PARAMETERS  :   int channel - The connected handoff socket
+                    HandoffRecord* record - Receives the record
+                    int* fd - Receives the passed descriptor or -1
+    RETURNS     :   int - 0 on success, -1 on failure
+*/
+static int receive_record(int channel, HandoffRecord* record, int* fd)
+{
+    struct msghdr msg;
+    struct iovec iov;
+    char control[CMSG_SPACE(sizeof(int))];
+
+    *fd = -1;
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = record;
+    iov.iov_len = sizeof(*record);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t received = recvmsg(channel, &msg, MSG_CMSG_CLOEXEC);
+    if (received < (ssize_t)HANDOFF_HEADER_SIZE)
+    {
+        return -1;
+    }
+
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+        {
+            memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+        }
+    }
+
+    if (record->payloadLength >= HANDOFF_MAX_PAYLOAD || received != (ssize_t)(HANDOFF_HEADER_SIZE + record->payloadLength))
+    {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+    FUNCTION    :   init_handoff_listener
+    DESCRIPTION :   Creates the unix socket a future server binary connects to in order to take over.
+                    A stale path left by a previous process is replaced.
+    PARAMETERS  :   const char* path - Filesystem path of the socket
+    RETURNS     :   int - The listening descriptor or SOCKET_ERROR
+*/
+int init_handoff_listener(const char* path)
+{
+    struct sockaddr_un address;
+    int listener = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (listener < 0)
+    {
+        perror("Error creating handoff socket");
+        return SOCKET_ERROR;
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+    unlink(path);
+
+    if (bind(listener, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(listener, 1) < 0)
+    {
+        perror("Error binding handoff socket");
+        close(listener);
+        return SOCKET_ERROR;
+    }
+    return listener;
+}
+
+/*
+    FUNCTION    :   send_server_state
+    DESCRIPTION :   Sends the listening sockets, every registered client and every queued message.
+                    Must only be called while the workers are stopped. A TLS client whose session
+                    still lives in user space cannot be described by its descriptor alone; it is
+                    left behind and disconnected when this process exits.
+    PARAMETERS  :   int channel - The connected handoff socket
+    RETURNS     :   int - 0 on success, -1 on failure
+*/
+static int send_server_state(int channel)
+{
+    int result = 0;
+
+    for (int i = 0; i < listenerCount && result == 0; i++)
+    {
+        result = send_record(channel, HANDOFF_LISTENER, serverListeners[i].kind, NULL, 0, serverListeners[i].fd);
+    }
+
+    pthread_mutex_lock(&clientsMutex);
+    for (int i = 0; i < maxClients && result == 0; i++)
+    {
+        if (client_sockets[i] != -1 && transportHandoffSafe(client_sockets[i]))
+        {
+            result = send_record(channel, HANDOFF_CLIENT, i, client_names[i], strlen(client_names[i]), client_sockets[i]);
+            if (result == 0 && client_multicast[i])
+            {
+                result = send_record(channel, HANDOFF_SUBSCRIBER, i, NULL, 0, -1);
+            }
+            if (result == 0 && presence_subscribed(i))
+            {
+                result = send_record(channel, HANDOFF_ROSTER, i, NULL, 0, -1);
+            }
+            if (result == 0 && wal_acking(i))
+            {
+                result = send_record(channel, HANDOFF_ACKS, i, NULL, 0, -1);
+            }
+        }
+    }
+    pthread_mutex_unlock(&clientsMutex);
+
+    // Clients keep counting from where this process stopped, and can still catch up on what it broadcast
+    if (result == 0)
+    {
+        char sequence[48];
+        snprintf(sequence, sizeof(sequence), "%" PRIu64 " %" PRIu64, history_epoch(), history_next_sequence());
+        result = send_record(channel, HANDOFF_SEQUENCE, -1, sequence, strlen(sequence), -1);
+    }
+    uint64_t next = history_next_sequence();
+    for (uint64_t kept = next > MESSAGE_HISTORY ? next - MESSAGE_HISTORY : 1; kept < next && result == 0; kept++)
+    {
+        char serializedMessage[MAX_SERIALIZED_LENGTH];
+        char payload[HANDOFF_MAX_PAYLOAD];
+        if (history_lookup(kept, serializedMessage, sizeof(serializedMessage)))
+        {
+            snprintf(payload, sizeof(payload), "%" PRIu64 " %s", kept, serializedMessage);
+            result = send_record(channel, HANDOFF_HISTORY, -1, payload, strlen(payload), -1);
+        }
+    }
+
+    // Pending output: whatever the broadcaster had not sent yet, sender by sender once the ingest is fair
+    pthread_mutex_lock(&messageQueue.lock);
+    for (int flow = -1; flow < messageQueue.flowCount && result == 0; flow++)
+    {
+        QueueNode* node = flow < 0 ? messageQueue.front : messageQueue.flows[flow].front;
+        for (; node != NULL && result == 0; node = node->next)
+        {
+            char serializedMessage[MAX_SERIALIZED_LENGTH];
+            serializeMessage(&node->message, messageBody(&node->message), serializedMessage, sizeof(serializedMessage));
+            result = send_record(channel, HANDOFF_PENDING, -1, serializedMessage, strlen(serializedMessage), -1);
+        }
+    }
+    pthread_mutex_unlock(&messageQueue.lock);
+
+    if (result == 0)
+    {
+        result = send_record(channel, HANDOFF_END, -1, NULL, 0, -1);
+    }
+    return result;
+}
+
+/*
+    FUNCTION    :   handoff_to_successor
+    DESCRIPTION :   Accepts a new server process on the handoff socket and transfers everything to it.
+                    The workers are only stopped once the successor has proven it speaks the same
+                    protocol version, and they are restarted if the transfer fails part way.
+    PARAMETERS  :   int handoffListener - The listening handoff socket
+    RETURNS     :   int - HANDOFF_COMPLETE if this process should now exit, otherwise HANDOFF_FAILED
+*/
+int handoff_to_successor(int handoffListener)
+{
+    HandoffRecord record;
+    int passedFd;
+    struct timeval timeout = { HANDOFF_TIMEOUT_SECONDS, 0 };
+
+    int channel = accept(handoffListener, NULL, NULL);
+    if (channel < 0)
+    {
+        perror("Error on handoff accept");
+        return HANDOFF_FAILED;
+    }
+    setsockopt(channel, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(channel, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    if (receive_record(channel, &record, &passedFd) < 0 || record.type != HANDOFF_HELLO || record.slot != HANDOFF_PROTOCOL_VERSION)
+    {
+        printf("Hot restart refused: successor speaks a different handoff protocol\n");
+        if (passedFd >= 0)
+        {
+            close(passedFd);
+        }
+        close(channel);
+        return HANDOFF_FAILED;
+    }
+
+    printf("Hot restart: handing sockets over to the new server\n");
+    stop_workers();
+    // The successor reads the mailbox log once it took over, nothing may be appended to it after that
+    mailbox_flush();
+
+    if (send_server_state(channel) == 0 && receive_record(channel, &record, &passedFd) == 0 && record.type == HANDOFF_ACK)
+    {
+        close(channel);
+        return HANDOFF_COMPLETE;
+    }
+
+    printf("Hot restart failed, resuming service\n");
+    close(channel);
+    start_workers();
+    return HANDOFF_FAILED;
+}
+
+/*
+    FUNCTION    :   takeover_from_predecessor
+    DESCRIPTION :   Connects to the running server, inherits its listening sockets, clients and queued
+                    messages, and acknowledges so that the old process can exit. The listeners are
+                    registered with the accept manager. The workers are not started here, main does
+                    that once the rest of the server is initialized.
+    PARAMETERS  :   const char* path - The handoff socket of the running server
+    RETURNS     :   int - HANDOFF_COMPLETE or HANDOFF_FAILED
+*/
+int takeover_from_predecessor(const char* path)
+{
+    struct sockaddr_un address;
+    HandoffRecord record;
+    int passedFd;
+    bool complete = false;
+
+    int channel = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (channel < 0)
+    {
+        perror("Error creating handoff socket");
+        return HANDOFF_FAILED;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+    if (connect(channel, (struct sockaddr*)&address, sizeof(address)) < 0)
+    {
+        perror("No running server to take over");
+        close(channel);
+        return HANDOFF_FAILED;
+    }
+
+    if (send_record(channel, HANDOFF_HELLO, HANDOFF_PROTOCOL_VERSION, NULL, 0, -1) < 0)
+    {
+        close(channel);
+        return HANDOFF_FAILED;
+    }
+
+    while (!complete && receive_record(channel, &record, &passedFd) == 0)
+    {
+        if (record.type == HANDOFF_LISTENER)
+        {
+            if (!add_listener(passedFd, record.slot))
+            {
+                if (passedFd >= 0)
+                {
+                    close(passedFd);
+                }
+                break;
+            }
+        }
+        else if (record.type == HANDOFF_CLIENT)
+        {
+            record.payload[record.payloadLength] = '\0';
+            if (passedFd < 0 || !restore_client(record.slot, passedFd, record.payload))
+            {
+                break;
+            }
+            mailbox_join(record.slot, record.payload);
+            direct_claim_name(record.slot, record.payload);
+            presence_join(record.slot, direct_name(record.slot));
+            pthread_mutex_lock(&numClientsMutex);
+            clientCount++;
+            pthread_mutex_unlock(&numClientsMutex);
+        }
+        else if (record.type == HANDOFF_SUBSCRIBER && record.slot >= 0 && record.slot < maxClients)
+        {
+            // Without a multicast group of our own the client simply gets its broadcasts over TCP again
+            client_multicast[record.slot] = multicast_enabled();
+        }
+        else if (record.type == HANDOFF_ROSTER && record.slot >= 0 && record.slot < maxClients && client_sockets[record.slot] != -1)
+        {
+            // Our versions do not follow on from the predecessor's, so the client is sent the whole roster again
+            post_control(client_sockets[record.slot], PRESENCE_SUBSCRIBE);
+        }
+        else if (record.type == HANDOFF_ACKS && record.slot >= 0 && record.slot < maxClients)
+        {
+            wal_resume_acking(record.slot);
+        }
+        else if (record.type == HANDOFF_SEQUENCE)
+        {
+            uint64_t epoch;
+            uint64_t next;
+            record.payload[record.payloadLength] = '\0';
+            if (sscanf(record.payload, "%" SCNu64 " %" SCNu64, &epoch, &next) == 2)
+            {
+                history_resume(epoch, next);
+            }
+        }
+        else if (record.type == HANDOFF_HISTORY)
+        {
+            char* serializedMessage;
+            record.payload[record.payloadLength] = '\0';
+            uint64_t sequence = strtoull(record.payload, &serializedMessage, 10);
+            if (*serializedMessage == ' ')
+            {
+                history_restore(sequence, serializedMessage + 1);
+            }
+        }
+        else if (record.type == HANDOFF_PENDING)
+        {
+            Message pending;
+            record.payload[record.payloadLength] = '\0';
+            deserializeMessage(&pending, record.payload);
+            pending.senderSock = -1;
+            wal_adopt(); // our log holds it already, written by the predecessor
+            enqueue(&messageQueue, &pending);
+        }
+        else if (record.type == HANDOFF_END)
+        {
+            complete = listenerCount > 0;
+            break;
+        }
+    }
+
+    if (!complete || send_record(channel, HANDOFF_ACK, -1, NULL, 0, -1) < 0)
+    {
+        // The old server keeps running and still owns the sockets, drop our copies
+        fprintf(stderr, "Takeover failed\n");
+        cleanup_clients();
+        close_listeners();
+        close(channel);
+        return HANDOFF_FAILED;
+    }
+
+    close(channel);
+    printf("Took over %d listener(s) and %d client(s) from the previous server\n", listenerCount, clientCount);
+    return HANDOFF_COMPLETE;
+}
@@ -0,0 +1,220 @@
+/*
+* FILE              :   keepalive.c
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This file contains the application level heartbeats and idle connection reaping.
+                        Every connection owns one timer in a hashed wheel that the main loop advances.
+                        Handlers only record the tick of the last frame they received; when the timer
+                        fires the main thread decides whether the peer is active (re-arm), quiet (send a
+                        >>ping<< the client answers with >>pong<<) or dead (shut the socket down, which
+                        makes its handler free the slot and close it).
+*/
+
+#include "server-utility.h"
+#include "../inc/keepalive.h"
+#include "../inc/timer-wheel.h"
+#include "../inc/server-stats.h"
+#include <stdatomic.h>
+#include <time.h>
+
+static TimerWheel keepaliveWheel;
+static _Atomic uint32_t* lastActivityTick;  // written by handlers, read by the main thread
+static uint32_t* lastHeartbeatTick;         // main thread only
+static uint32_t heartbeatTicks;
+static uint32_t idleTimeoutTicks;
+
+/*
+    FUNCTION    :   current_tick
+    DESCRIPTION :   Converts the monotonic clock to timer wheel ticks.
+    PARAMETERS  :   none
+    RETURNS     :   uint32_t - The current tick
+*/
+static uint32_t current_tick(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)(now.tv_sec * TICKS_PER_SECOND + now.tv_nsec / (TIMER_TICK_MILLISECONDS * 1000000L));
+}
+
+/*
+    FUNCTION    :   keepalive_init
+    DESCRIPTION :   Sets up the timer wheel and the per-slot activity ticks. A zero interval disables
+                    that part; with both disabled connections carry no timer at all.
+    PARAMETERS  :   int capacity - Number of registry slots
+                    int heartbeatSeconds - Quiet time before a >>ping<< is sent
+                    int idleTimeoutSeconds - Quiet time before the connection is reaped
+    RETURNS     :   void
+*/
+void keepalive_init(int capacity, int heartbeatSeconds, int idleTimeoutSeconds)
+{
+    heartbeatTicks = (uint32_t)heartbeatSeconds * TICKS_PER_SECOND;
+    idleTimeoutTicks = (uint32_t)idleTimeoutSeconds * TICKS_PER_SECOND;
+    lastActivityTick = calloc(capacity, sizeof(*lastActivityTick));
+    lastHeartbeatTick = calloc(capacity, sizeof(*lastHeartbeatTick));
+    if (lastActivityTick == NULL || lastHeartbeatTick == NULL)
+    {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    timer_wheel_init(&keepaliveWheel, capacity, current_tick());
+}
+
+/*
+    FUNCTION    :   first_deadline
+    DESCRIPTION :   Returns the number of quiet ticks after which a connection needs attention.
+    PARAMETERS  :   none
+    RETURNS     :   uint32_t - Ticks, or 0 when keepalive is disabled
+*/
+static uint32_t first_deadline(void)
+{
+    if (heartbeatTicks > 0 && (idleTimeoutTicks == 0 || heartbeatTicks < idleTimeoutTicks))
+    {
+        return heartbeatTicks;
+    }
+    return idleTimeoutTicks;
+}
+
+/*
+    FUNCTION    :   keepalive_track
+    DESCRIPTION :   Starts watching a connection that was just placed in a registry slot.
+    PARAMETERS  :   int slot - The registry slot
+    RETURNS     :   void
+*/
+void keepalive_track(int slot)
+{
+    uint32_t now = current_tick();
+    atomic_store_explicit(&lastActivityTick[slot], now, memory_order_relaxed);
+    lastHeartbeatTick[slot] = now;
+    if (first_deadline() > 0)
+    {
+        timer_arm(&keepaliveWheel, slot, first_deadline());
+    }
+}
+
+/*
+    FUNCTION    :   keepalive_untrack
+    DESCRIPTION :   Stops watching a connection that is leaving its slot.
+    PARAMETERS  :   int slot - The registry slot
+    RETURNS     :   void
+*/
+void keepalive_untrack(int slot)
+{
+    timer_cancel(&keepaliveWheel, slot);
+}
+
+/*
+    FUNCTION    :   keepalive_touch
+    DESCRIPTION :   Records that a frame arrived. This is all a handler does per frame; the timer
+                    itself is only moved when it fires.
+    PARAMETERS  :   int slot - The registry slot
+    RETURNS     :   void
+*/
+void keepalive_touch(int slot)
+{
+    atomic_store_explicit(&lastActivityTick[slot], current_tick(), memory_order_relaxed);
+}
+
+/*
+    FUNCTION    :   keepalive_send_heartbeat
+    DESCRIPTION :   Sends a >>ping<< frame without blocking the broadcaster. The frame is written
+                    with a single send, so a peer whose buffer is full gets a partial frame at most,
+                    and such a peer is shut down since its stream can no longer be parsed. A TLS
+                    peer that cannot take the record at once is treated the same way.
+                    Caller holds clientWritesMutex, which keeps the frame from interleaving with a broadcast.
+    PARAMETERS  :   int sock - The client socket
+    RETURNS     :   void
+*/
+void keepalive_send_heartbeat(int sock)
+{
+    Message ping;
+    char frame[sizeof(uint32_t) + MAX_SERIALIZED_LENGTH];
+
+    initMessage(&ping, HEARTBEAT_SENDER_IP, HEARTBEAT_SENDER_NAME);
+    serializeMessage(&ping, HEARTBEAT_REQUEST, frame + sizeof(uint32_t), MAX_SERIALIZED_LENGTH);
+    releaseMessage(&ping);
+
+    uint32_t length = strlen(frame + sizeof(uint32_t));
+    uint32_t wireLength = htonl(length);
+    memcpy(frame, &wireLength, sizeof(wireLength));
+
+    ssize_t sent = transportSend(sock, frame, sizeof(uint32_t) + length, MSG_DONTWAIT);
+    if (sent != 0 && sent != (ssize_t)(sizeof(uint32_t) + length))
+    {
+        shutdown(sock, SHUT_RDWR);
+    }
+    atomic_fetch_add(&serverStats.heartbeatsSent, 1);
+}
+
+/*
+    FUNCTION    :   handle_expiry
+    DESCRIPTION :   Decides what to do with a connection whose timer fired and re-arms the timer
+                    for the next deadline.
+    PARAMETERS  :   int slot - The registry slot
+                    uint32_t now - The current tick
+    RETURNS     :   void
+*/
+static void handle_expiry(int slot, uint32_t now)
+{
+    uint32_t idle = now - atomic_load_explicit(&lastActivityTick[slot], memory_order_relaxed);
+    uint32_t nextDelay;
+
+    pthread_mutex_lock(&clientsMutex);
+    int sock = client_sockets[slot];
+    if (sock == -1)
+    {
+        // the client left after the timer fired, its slot is free
+        pthread_mutex_unlock(&clientsMutex);
+        return;
+    }
+
+    if (idleTimeoutTicks > 0 && idle >= idleTimeoutTicks)
+    {
+        // The handler sees end of stream, then frees the slot and closes the socket
+        shutdown(sock, SHUT_RDWR);
+        pthread_mutex_unlock(&clientsMutex);
+        atomic_fetch_add(&serverStats.connectionsReaped, 1);
+        return;
+    }
+
+    if (heartbeatTicks > 0 && idle >= heartbeatTicks)
+    {
+        // Ping once per quiet period, then wait for the reply until the idle deadline
+        if ((int32_t)(lastHeartbeatTick[slot] - (now - idle)) <= 0)
+        {
+            post_control(sock, HEARTBEAT_REQUEST); // overtakes queued chat, sent by the broadcaster
+            lastHeartbeatTick[slot] = now;
+        }
+        nextDelay = idleTimeoutTicks > 0 ? idleTimeoutTicks - idle : heartbeatTicks;
+    }
+    else
+    {
+        nextDelay = first_deadline() - idle;
+    }
+    pthread_mutex_unlock(&clientsMutex);
+
+    timer_arm(&keepaliveWheel, slot, nextDelay);
+}
+
+/*
+    FUNCTION    :   keepalive_tick
+    DESCRIPTION :   Advances the timer wheel to the current time and handles every expired timer.
+                    Called by the main loop on every wakeup.
+    PARAMETERS  :   none
+    RETURNS     :   void
+*/
+void keepalive_tick(void)
+{
+    int expired[MAX_EXPIRED_PER_PASS];
+    int count;
+    uint32_t now = current_tick();
+
+    do
+    {
+        count = timer_advance(&keepaliveWheel, now, expired, MAX_EXPIRED_PER_PASS);
+        for (int i = 0; i < count; i++)
+        {
+            handle_expiry(expired[i], now);
+        }
+    } while (count == MAX_EXPIRED_PER_PASS);
+}
@@ -0,0 +1,230 @@
+/*
+* FILE              :   latency-profile.c
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This file contains the low latency profile. With -latency a thread that runs out
+                        of work spins for a while before it blocks, so the next message does not pay for
+                        a wake-up, client sockets busy poll the device queue and have Nagle disabled.
+                        With -cpus the accept loop, the broadcaster and the connection handlers are
+                        pinned to the listed CPUs. Threads are pinned before they allocate anything, so
+                        the kernel's default first-touch policy keeps their memory on their NUMA node.
+*/
+
+#define _GNU_SOURCE // pthread_setaffinity_np
+#include "../inc/latency-profile.h"
+#include "../inc/accept-manager.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+static bool latencyProfile = false;
+static long spinMicroseconds = 0;
+static int busyPollMicroseconds = 0;
+static int pinnedCpus[MAX_PINNED_CPUS];
+static int pinnedCpuCount = 0;
+static atomic_uint nextHandlerCpu;
+
+/*
+    FUNCTION    :   parse_cpu_list
+    DESCRIPTION :   Parses a list such as "2,3,6-8" into pinnedCpus.
+    PARAMETERS  :   const char* list - The -cpus value
+    RETURNS     :   bool - false if the list is malformed or too long
+*/
+static bool parse_cpu_list(const char* list)
+{
+    const char* cursor = list;
+
+    while (*cursor != '\0')
+    {
+        char* end;
+        long first = strtol(cursor, &end, 10);
+        long last = first;
+        if (end == cursor || first < 0)
+        {
+            return false;
+        }
+        if (*end == '-')
+        {
+            cursor = end + 1;
+            last = strtol(cursor, &end, 10);
+            if (end == cursor || last < first)
+            {
+                return false;
+            }
+        }
+        for (long cpu = first; cpu <= last; cpu++)
+        {
+            if (cpu >= CPU_SETSIZE || pinnedCpuCount == MAX_PINNED_CPUS)
+            {
+                return false;
+            }
+            pinnedCpus[pinnedCpuCount++] = (int)cpu;
+        }
+        if (*end == ',')
+        {
+            end++;
+        }
+        else if (*end != '\0')
+        {
+            return false;
+        }
+        cursor = end;
+    }
+    return pinnedCpuCount > 0;
+}
+
+/*
+    FUNCTION    :   init_latency_profile
+    DESCRIPTION :   Takes the latency settings from the configuration and checks that every CPU of
+                    the -cpus list is one this process may run on.
+    PARAMETERS  :   const ServerConfig* config - The parsed command line
+    RETURNS     :   bool - false if the -cpus list cannot be parsed or names an unavailable CPU
+*/
+bool init_latency_profile(const ServerConfig* config)
+{
+    latencyProfile = config->latencyProfile;
+    spinMicroseconds = latencyProfile ? config->spinMicroseconds : 0;
+    busyPollMicroseconds = latencyProfile ? config->busyPollMicroseconds : 0;
+    if (config->cpuList == NULL)
+    {
+        return true;
+    }
+    if (!parse_cpu_list(config->cpuList))
+    {
+        return false;
+    }
+
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0)
+    {
+        perror("sched_getaffinity");
+        return false;
+    }
+    for (int i = 0; i < pinnedCpuCount; i++)
+    {
+        if (!CPU_ISSET(pinnedCpus[i], &allowed))
+        {
+            fprintf(stderr, "CPU %d is not available to this process\n", pinnedCpus[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+    FUNCTION    :   pin_current_thread
+    DESCRIPTION :   Pins the calling thread to the CPU of its role. The accept loop gets the first CPU
+                    of the list and the broadcaster the second; connection handlers share the rest,
+                    or the whole list when it is too short to leave them CPUs of their own.
+    PARAMETERS  :   int role - PIN_REACTOR, PIN_BROADCASTER or PIN_HANDLER
+    RETURNS     :   void
+*/
+void pin_current_thread(int role)
+{
+    if (pinnedCpuCount == 0)
+    {
+        return;
+    }
+
+    int cpu;
+    if (role == PIN_REACTOR)
+    {
+        cpu = pinnedCpus[0];
+    }
+    else if (role == PIN_BROADCASTER)
+    {
+        cpu = pinnedCpus[1 % pinnedCpuCount];
+    }
+    else if (pinnedCpuCount > 2)
+    {
+        cpu = pinnedCpus[2 + atomic_fetch_add(&nextHandlerCpu, 1) % (pinnedCpuCount - 2)];
+    }
+    else
+    {
+        cpu = pinnedCpus[atomic_fetch_add(&nextHandlerCpu, 1) % pinnedCpuCount];
+    }
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    int result = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    if (result != 0)
+    {
+        fprintf(stderr, "Could not pin a thread to CPU %d: %s\n", cpu, strerror(result));
+    }
+}
+
+/*
+    FUNCTION    :   tune_client_socket
+    DESCRIPTION :   Applies the latency profile to an accepted socket. Nagle is disabled so a frame
+                    queued behind an unacknowledged one goes out at once, and SO_BUSY_POLL lets a
+                    blocking read poll the device queue instead of waiting for an interrupt. Unix
+                    sockets have neither. Raising SO_BUSY_POLL needs CAP_NET_ADMIN; without it the
+                    spinning in wait_for_input still applies.
+    PARAMETERS  :   int sock - The accepted socket
+                    int kind - The kind of listener it arrived on
+    RETURNS     :   void
+*/
+void tune_client_socket(int sock, int kind)
+{
+    static atomic_bool busyPollWarned;
+    int enable = 1;
+
+    if (!latencyProfile || kind == LISTENER_UNIX)
+    {
+        return;
+    }
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    if (busyPollMicroseconds > 0 &&
+        setsockopt(sock, SOL_SOCKET, SO_BUSY_POLL, &busyPollMicroseconds, sizeof(busyPollMicroseconds)) < 0 &&
+        !atomic_exchange(&busyPollWarned, true))
+    {
+        fprintf(stderr, "SO_BUSY_POLL unavailable (%s), relying on spinning alone\n", strerror(errno));
+    }
+}
+
+/*
+    FUNCTION    :   wait_for_input
+    DESCRIPTION :   Waits like poll(fds, count, timeout). In the latency profile the descriptors are
+                    first polled without blocking until the spin time has passed.
+    PARAMETERS  :   struct pollfd* fds - The descriptors to wait for
+                    nfds_t count - Their number
+                    int timeout - Milliseconds to wait at most, -1 to wait forever
+    RETURNS     :   int - The result of poll
+*/
+int wait_for_input(struct pollfd* fds, nfds_t count, int timeout)
+{
+    if (spinMicroseconds > 0 && timeout != 0)
+    {
+        struct timespec start;
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        do
+        {
+            int ready = poll(fds, count, 0);
+            if (ready != 0)
+            {
+                return ready;
+            }
+            clock_gettime(CLOCK_MONOTONIC, &now);
+        } while ((now.tv_sec - start.tv_sec) * 1000000L + (now.tv_nsec - start.tv_nsec) / 1000 < spinMicroseconds);
+    }
+    return poll(fds, count, timeout);
+}
+
+/*
+    FUNCTION    :   latency_spin_microseconds
+    DESCRIPTION :   Returns how long an idle thread spins before it blocks.
+    PARAMETERS  :   none
+    RETURNS     :   long - Microseconds, 0 outside the latency profile
+*/
+long latency_spin_microseconds(void)
+{
+    return spinMicroseconds;
+}
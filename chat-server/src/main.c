@@ -29,120 +29,442 @@
 	makes sure that the spot taken up by the client is also vacated for other clients to connect. The data structure of the array is specified
 	below. A 'Message' struct ensures the right data is broadcast to all the clients including the ip address of the sending client.
 
+	TRANSPORT:
+
+	Besides plain TCP on port 8989 the server accepts TLS on a second port (-tlsport<N>, 8990 by default) when it is given a
+	certificate and key (-tlscert<PATH> -tlskey<PATH>). The handshake runs on the connection's handler thread, never on the main
+	thread. OpenSSL is asked to hand the record layer to the kernel (kTLS); when the kernel accepts, the broadcaster keeps using a
+	plain send() on the descriptor and the kernel encrypts it, otherwise the connection falls back to OpenSSL in user space. The
+	message protocol is the same on both ports. The per-interval statistics show how many handshakes got kernel offload.
+
+	Clients and bots on the same host can instead connect to a unix domain stream socket (-unix<PATH>, /tmp/chat-server.sock by
+	default, -nounix turns it off). It speaks the same protocol and skips the TCP/IP stack and the per-address admission limit.
+
 	DATA STRUCTURE:
 
-	The server uses a simple array that is initialzied to -1 for all the values, it stores upto 10 client sockets that are setup when a client
-	successfully connects. The server spawns a broadcaster thread to handle any messages that are being sent by any client that is connected.
+	The server uses a simple array that is initialzied to -1 for all the values, it stores upto 10 client sockets (-maxclients<N>) that are
+	setup when a client successfully connects. The main thread waits on epoll for its listening sockets; every wakeup drains the accept queue
+	with accept4, and each new connection must pass a per-source-address token bucket and the capacity check or it is reset at once. The server spawns a broadcaster thread to handle any messages that are being sent by any client that is connected.
 	Similar to the client, the server also spawns a handler thread to ensure communication is not blocked when the client connects. A shared queue
 	is used to ensure the messages are being processed while the connection handler threads receive the messages.
+	Every change to the array publishes an immutable copy of it (client-snapshot.c) and the broadcaster sends each batch to the
+	clients of the copy current at the time, without holding the lock that joins and leaves take. A leaving client's socket is
+	closed only once no broadcast can still be using the copy it was in.
+
+    HEARTBEATS AND IDLE CONNECTIONS:
+    Each registry slot owns one timer in a hashed timer wheel (100 ms ticks) that the main loop advances on every wakeup. Handlers only
+    note the tick of the last frame they received. When a timer fires and the client has been quiet for -heartbeat<S> seconds the server
+    sends it a >>ping<< message, which the client answers with >>pong<<; once it has been quiet for -idletimeout<S> seconds its socket
+    is shut down so that its handler frees the slot and closes the connection.
+
+    LATENCY PROFILE:
+    The broadcaster parks on the queue's condition variable and is woken by every enqueue. With -latency an idle broadcaster
+    or connection handler first spins for -spin<US> microseconds before it blocks, TCP client sockets get TCP_NODELAY and
+    SO_BUSY_POLL (-busypoll<US>), and the relay of a message needs no wake-up while traffic keeps coming. -cpus<LIST> pins the
+    main thread to the first listed CPU, the broadcaster to the second and the handlers round robin to the rest. chat-bench
+    -latency measures the round trip a client sees.
+
+    MULTICAST FAN-OUT:
+    With -multicast<GROUP> (UDP port -mcastport<N>, 8991 by default) every message is also sent once to an IPv4 multicast
+    group with a sequence number. A client that sends >>mcast<< is answered with the group and the first sequence number it
+    must read from there, and from then on the broadcaster skips its TCP copy, so egress per message no longer grows with
+    the audience. Clients put datagrams back in order, ask for missing sequence numbers with >>nack<<, and get them resent
+    over their TCP connection from the last 4096 messages; older ones are reported as >>lost<<. The latest sequence number
+    is announced every second so that a lost final message is noticed. TLS connections are never switched to multicast.
+    For a test on one machine publish on the loopback interface with -mcastif127.0.0.1.
+
+    CATCHING UP:
+    The broadcaster numbers every message and keeps the last 4096. A client that caches messages sends >>since<< with the
+    last number it saw and is replayed only the newer ones (>>replay<<), then told the number of the next live broadcast
+    (>>sync<<). Numbers belong to an epoch that starts with the server and is carried over by -takeover together with the
+    kept messages, so a client of an older server process is simply sent the newest messages.
+
+    OVERLOAD:
+    The broadcaster measures how long each message waited in the queue. When the delay stays above -codeltarget<MS> (5) for
+    -codelinterval<MS> (100), handlers of the senders that queued at least their fair share in the last interval pause
+    before each read, so TCP flow control slows those senders down. If the delay stays high for another interval the
+    broadcaster drops messages at CoDel's interval / sqrt(drops) rate until it falls under target again. Handlers refuse
+    messages outright once -maxqueue<N> (65536) are queued. Senders whose messages were dropped or refused get >>busy<<.
+
+    MEMORY LIMITS:
+    Each frame a handler receives and each message or request it queues is charged to its connection and to the server
+    until it is freed. A connection holding more than -connsoft<KB> (256), or more than its share of -memsoft<MB> (64)
+    while all connections together hold more than that, is not read until the broadcaster caught up. Nothing is charged
+    beyond -connhard<KB> (1024) or -memhard<MB> (256): such messages are refused with >>busy<< and a client announcing a
+    frame that does not fit is disconnected. The statistics line shows the memory in use and its peak.
+
+    MESSAGE PIPELINE:
+    Between the queue and the fan-out the broadcaster runs chat messages through a pipeline of stages, up to 32 messages at
+    a time, which it takes off the queue under a single lock. Stages register at startup (pipeline.h): inspect stages only
+    read messages and may drop them, and consecutive inspect stages run in parallel; transform stages run alone and may
+    also rewrite messages or reroute them to a single client, which receives them wrapped in >>private<<. Two stages are
+    shipped: the -blocklist<PATH> word filter (moderation.c) and the /msg router (direct-message.c).
+
+    OFFLINE DELIVERY:
+    With -mailbox<DIR> a client names its user with >>hello<< when it connects, and a user one of whose clients stayed
+    connected for 10 seconds gets a mailbox. While none of its clients is connected the broadcasts it misses are kept:
+    a writer thread appends whatever the broadcaster handed it since its last round to a log in the directory shared by
+    all mailboxes, with one write and one flush, and a mailbox is a cursor into that log kept in a file of the user's.
+    Log files are deleted once no mailbox reaches back into them. The next
+    >>hello<< of the user is answered from its handler thread with the kept messages, wrapped in >>mail<< and sent 64 at a
+    time between broadcasts; messages the client already cached, receives live or will be replayed are left out, and a
+    replay that follows starts where the mailbox stopped. A mailbox over -mailboxquota<KB> (256) loses its oldest
+    messages, and messages older than -mailboxexpiry<H> hours (168) are not delivered.
+
+    FAIR INGEST:
+    Every connection queues its chat messages in its own flow of the message queue and the broadcaster serves the flows
+    in deficit round robin order: the flow whose turn it is gets -weight<N> (1) quanta of the longest message's size and
+    sends while it can pay for its next message, then the next flow with messages follows. A flow that runs empty loses
+    what was left, so an idle sender cannot save up a burst. Picking the next message takes constant time. -weights<LIST>
+    gives named users another weight. The queueing delay of the senders that waited longest is printed with the stats.
+
+    HIBERNATION:
+    A handler that read no message for -hibernate<S> (20) seconds adds its socket to an epoll set the main loop watches
+    and returns, freeing its thread and stack; the connection keeps only its registry slot and a few bytes of state.
+    When the socket becomes readable the main loop starts a new handler that carries on without setting the connection
+    up again. Heartbeat replies do not count as messages, so a client that only answers pings goes straight back to
+    sleep. Broadcasts and heartbeats are written by the broadcaster and do not wake a connection.
+
+    PRESENCE:
+    A user is online while at least one connection named it in a >>hello<< or a message. A client that sends >>roster?<<
+    gets the users online at the current roster version and from then on only deltas, each leading from one version to
+    the next. The main loop opens a window of -presencewindow<MS> (250) at the first change after a quiet spell and sends
+    its changes as one delta when it ends, so a disconnect followed by a reconnect within it is never announced. Deltas
+    go through the control lane, so the broadcaster writes them in order with the roster answers.
+
+    DIRECT MESSAGES:
+    A connection owns the username of its >>hello<<, or of its first message if it sends none, and of every name it
+    changes to. Names are interned while held, and the interned identifier indexes an array of owners that is claimed
+    with compare-and-swap and read without a lock, so a >>hello<< or a message naming a user another connection holds is
+    answered with >>taken<< and closed. Messages are shown with the address the connection comes from, whatever address
+    the client wrote into them. A message "/msg <user> <text>" is rerouted
+    by the pipeline to the owner's socket alone, found in one lookup; if nobody owns the name the sender is told instead.
+
+    SEARCH:
+    With -search<PATH> every broadcast is appended to a log file by an indexer thread, which also adds its words to an
+    inverted index. The newest documents go into an open segment; every 65536 documents it is sealed into sorted terms
+    with delta-encoded postings, and a merger thread merges four sealed segments of a size into one of the next. A query
+    ">>search <page> <words>" intersects the postings of its words, rarest first, and the page of matches is read back
+    from the log. The index lives in memory and is rebuilt from the log on start; a torn record at its end is cut off.
+
+    WRITE-AHEAD LOG:
+    With -wal<PATH> a handler appends every chat message it accepts to an in-memory group before it queues it. A writer
+    thread commits the group -commitinterval<US> after its first message arrived, with one write and, at -durabilitysync,
+    one fdatasync, while the handlers fill the second group. Clients that sent >>acks<< then get >>durable<< <n>. The
+    broadcaster counts the messages it finished with; whenever none is left over, the next commit carries a checkpoint.
+    On start the messages after the last checkpoint are queued again. A successor taking over waits for the log's flock,
+    which its predecessor releases after its last commit, and counts the handed over messages as unfinished.
+
+    BROADCAST TAP:
+    With -tap<NAME> the broadcaster copies every broadcast once into a ring of -tapslots<N> slots in POSIX shared memory,
+    for archivers and other tools on this host to read in place with Common/src/tap.c rather than over a connection of
+    their own. Each reader keeps its position in its own memory and checks that a slot was not rewritten while it read
+    it; one that falls a ring behind loses the oldest messages, the broadcaster never waits. Readers that caught up sleep
+    on a futex in the ring, woken once per batch and only while one of them sleeps. On a takeover the successor creates
+    a new ring under the name and the predecessor closes its own, which sends the readers to attach again.
+
+    REPEATED LINES:
+    With -spamrepeats<N> a handler counts every chat frame, before it deserializes it, in a count-min sketch of byte
+    counters keyed on the sender's slot and the line, and drops the copies beyond N of the same line within the last
+    -spamwindow<S> seconds or two windows at most. The sender's next frame is then read 10 ms later. Two sketches take
+    turns, the main loop emptying the older one whenever a window ends, so the filter's memory never grows.
 
     CLEAN UP PROCEDURE: 
     The server employs a comprehensive cleanup procedure to ensure graceful shutdown and resource management. This process is 
     triggered by either the SIGINT or SIGTERM signals, allowing the server to shutdown gracefully in response to external 
     interrupts or requests.
 
-    1. Joining Client Handler Threads:
-       The server maintains a list of threads, each corresponding to a connected client. Upon shutdown, the server joins all these 
-       threads, ensuring that they have completed their execution. 
+    1. Stopping Client Handler Threads:
+       Every connection handler waits on its client socket and on a shared wake pipe. The signal handler only raises the
+       shutdown flag and writes into that pipe; the main thread then waits until every handler has returned.
     2. Terminating the Broadcaster Thread:
        A dedicated broadcaster thread is responsible for relaying messages from the shared message queue to all connected clients. 
-       During the cleanup, this thread is signaled to terminate (using pthread_cancel), and then joined to ensure it has ceased execution.
+       During the cleanup it notices the same flag after its current message and is joined to ensure it has ceased execution.
     3. Client Cleanup:
        All active client connections are gracefully closed. The server iterates through the array of client sockets, closing each 
        socket and marking the slot as available. This step ensures that all network resources are properly released and clients 
        are informed of the server shutdown.
-    4. Closing the Server Socket:
-       The main server socket, which listens for incoming connections, is closed. This prevents any new client connections from 
+    4. Closing the Server Sockets:
+       The listening sockets, plain and TLS, are closed. This prevents any new client connections from 
        being accepted during the shutdown process.
     5. Clearing the Message Queue:
        The server maintains a queue of messages to be broadcasted. During shutdown, this queue is emptied and freed, 
        ensuring that no memory leaks occur from leftover messages.
 
+    HOT RESTART:
+    A running server listens on a unix socket (-handoff<PATH>, /tmp/chat-server-handoff.sock by default). Starting a new
+    binary with -takeover connects to it. Once both sides agree on the handoff protocol version the old server stops its
+    workers between frames and passes the listening sockets and every client socket over SCM_RIGHTS, together with the
+    registry slot and username of each client and the messages still waiting in the queue. TLS clients are only carried
+    over when the kernel handles both directions of their session; the others are disconnected and have to reconnect. When the new server
+    acknowledges, the old one exits; the clients never see their connection drop. If the transfer fails the old server
+    restarts its workers and carries on.
+
 */
 ////////////////////////////////////
 
 #include "../../Common/inc/queue.h"
 #include "../inc/client-manager.h"
+#include "../inc/server-config.h"
+#include "../inc/hot-restart.h"
+#include "../inc/accept-manager.h"
+#include "../inc/server-stats.h"
+#include "../inc/keepalive.h"
+#include "../inc/latency-profile.h"
+#include "../inc/multicast-publisher.h"
+#include "../inc/message-history.h"
+#include "../inc/overload.h"
+#include "../inc/memory-budget.h"
+#include "../inc/pipeline.h"
+#include "../inc/moderation.h"
+#include "../inc/offline-mailbox.h"
+#include "../inc/fair-ingest.h"
+#include "../inc/hibernation.h"
+#include "../inc/presence-service.h"
+#include "../inc/direct-message.h"
+#include "../inc/search-index.h"
+#include "../inc/write-ahead-log.h"
+#include "../inc/broadcast-tap.h"
+#include "../inc/spam-filter.h"
 #include "server-utility.h"
+#include <sys/epoll.h>
+#include <sys/mman.h>
+
+#define MAX_SERVER_EVENTS 16
 
 // global variables, flags and other shared resources initialized here
 MessageQueue messageQueue;
 volatile sig_atomic_t runServer = 1;
+volatile sig_atomic_t stopWorkers = 0;
+int workerWakePipe[2];
 pthread_mutex_t clientsMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t clientWritesMutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t numClientsMutex = PTHREAD_MUTEX_INITIALIZER;
 int clientCount = 0;
-pthread_t thread_id[MAX_CLIENTS];
-int client_sockets[MAX_CLIENTS];
+int* client_sockets;
+char (*client_names)[MAX_USERNAME_LENGTH];
+bool* client_multicast;
+int maxClients;
 pthread_t broadcaster_tid;
-int sockfd;
+ServerConfig serverConfig;
 void serverShutdown(void);
 
 int main(int argc, char** argv)
 {
-    init_client_manager();
+    if (parse_server_args(argc, argv, &serverConfig) != CONFIG_PARSING_SUCCESS)
+    {
+        return EXIT_FAILURE;
+    }
+    if (!init_latency_profile(&serverConfig))
+    {
+        fprintf(stderr, "Invalid CPU list: %s\n", serverConfig.cpuList);
+        return EXIT_FAILURE;
+    }
+    // Pinned before anything is allocated, so that the registry and timer wheel are placed on this CPU's NUMA node
+    pin_current_thread(PIN_REACTOR);
+
+    init_client_manager(serverConfig.maxClients);
+    init_accept_manager(&serverConfig);
+    keepalive_init(serverConfig.maxClients, serverConfig.heartbeatSeconds, serverConfig.idleTimeoutSeconds);
+    overload_init(&serverConfig, serverConfig.maxClients);
+    spam_init(&serverConfig);
+    memory_budget_init(&serverConfig, serverConfig.maxClients);
+    // Pipeline stages register in the order they run
+    if (!moderation_init(&serverConfig) || !direct_init(serverConfig.maxClients))
+    {
+        exit(EXIT_FAILURE);
+    }
+    pipeline_start();
+    // Before a takeover, which counts the inherited clients' users as online; mailbox_start reads the directory after it
+    if (!mailbox_init(&serverConfig, serverConfig.maxClients))
+    {
+        exit(EXIT_FAILURE);
+    }
+    if (!search_init(&serverConfig))
+    {
+        exit(EXIT_FAILURE);
+    }
+    presence_init(serverConfig.maxClients, serverConfig.presenceWindowMilliseconds);
+    wal_init(&serverConfig, serverConfig.maxClients);
+    if (!hibernation_init(&serverConfig, serverConfig.maxClients))
+    {
+        exit(EXIT_FAILURE);
+    }
+    init_worker_control();
     signal(SIGINT, signalHandler);
     signal(SIGTERM, signalHandler);
-    sockfd = init_server_socket(PORT_NUMBER);
-    
-    int client_index = 0;
     queueInit(&messageQueue);
+    // Before a takeover, whose inherited messages are queued
+    if (!fair_ingest_init(&serverConfig, serverConfig.maxClients))
+    {
+        exit(EXIT_FAILURE);
+    }
 
-    
+    bool tlsEnabled = serverConfig.tlsCertFile != NULL;
+    if (transportInit() != TRANSPORT_SUCCESS ||
+        (tlsEnabled && transportServerContext(serverConfig.tlsCertFile, serverConfig.tlsKeyFile) != TRANSPORT_SUCCESS))
+    {
+        fprintf(stderr, "Error setting up the transport\n");
+        exit(EXIT_FAILURE);
+    }
+
+    history_init();
+    if (!multicast_init(&serverConfig))
+    {
+        fprintf(stderr, "Multicast unavailable, broadcasting over TCP only\n");
+    }
 
-    // Start the broadcaster thread
-    if (pthread_create(&broadcaster_tid, NULL, broadcasterThread, NULL) != 0) 
+    if (serverConfig.takeover)
+    {
+        // Inherit the listening sockets, the clients and the pending messages of the running server
+        if (takeover_from_predecessor(serverConfig.handoffPath) != HANDOFF_COMPLETE)
+        {
+            exit(EXIT_FAILURE);
+        }
+    }
+    else if (!add_listener(init_server_socket(PORT_NUMBER, serverConfig.listenBacklog), LISTENER_TCP))
+    {
+        exit(EXIT_FAILURE);
+    }
+
+    // After a takeover, whose inherited messages are queued and in the log already
+    if (!wal_start(serverConfig.takeover))
     {
-        perror("Failed to create broadcaster thread");
-        close(sockfd);
         exit(EXIT_FAILURE);
     }
+    // After a takeover too, whose predecessor wrote the last of its mailbox log before handing over
+    if (!mailbox_start())
+    {
+        exit(EXIT_FAILURE);
+    }
+    // After the listeners too, a server that cannot have the port leaves the running one's ring alone
+    if (!tap_init(&serverConfig))
+    {
+        fprintf(stderr, "Broadcast tap unavailable, local readers have to connect as clients\n");
+    }
+
+    bool tlsListening = false;
+    bool unixListening = false;
+    for (int i = 0; i < listenerCount; i++)
+    {
+        tlsListening = tlsListening || serverListeners[i].kind == LISTENER_TLS;
+        unixListening = unixListening || serverListeners[i].kind == LISTENER_UNIX;
+    }
+    if (tlsEnabled && !tlsListening &&
+        !add_listener(init_server_socket(serverConfig.tlsPort, serverConfig.listenBacklog), LISTENER_TLS))
+    {
+        fprintf(stderr, "TLS listener unavailable, serving plain connections only\n");
+    }
+    else if (!tlsEnabled && tlsListening)
+    {
+        fprintf(stderr, "Inherited a TLS listener but no -tlscert/-tlskey were given, its connections will fail\n");
+    }
+    // Co-located clients and bots connect here without going through TCP loopback
+    if (serverConfig.unixPath != NULL && !unixListening &&
+        !add_listener(init_unix_socket(serverConfig.unixPath, serverConfig.listenBacklog), LISTENER_UNIX))
+    {
+        fprintf(stderr, "Unix socket unavailable, serving TCP connections only\n");
+    }
+
+    // Listen for the next binary wanting to take over from this one
+    int handoffListener = init_handoff_listener(serverConfig.handoffPath);
+    bool handedOff = false;
+
+    // The main loop only waits for readiness: new connections, hibernating clients waking up, a takeover request or a shutdown
+    int serverEpoll = epoll_create1(EPOLL_CLOEXEC);
+    int watched[MAX_LISTENERS + 3] = { handoffListener, workerWakePipe[0], hibernation_fd() };
+    int watchedCount = 3;
+    for (int i = 0; i < listenerCount; i++)
+    {
+        watched[watchedCount++] = serverListeners[i].fd;
+    }
+    for (int i = 0; i < watchedCount; i++)
+    {
+        struct epoll_event event = { .events = EPOLLIN, .data.fd = watched[i] };
+        if (watched[i] >= 0 && epoll_ctl(serverEpoll, EPOLL_CTL_ADD, watched[i], &event) < 0)
+        {
+            perror("epoll_ctl");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Start the connection handlers of inherited clients and the broadcaster thread
+    start_workers();
     
     while (runServer) 
     {	
-        int newsockfd;
-        pthread_mutex_lock(&numClientsMutex);	
-        int client_count =  clientCount;
-        pthread_mutex_unlock(&numClientsMutex);
-        if (client_count < MAX_CLIENTS)
+        struct epoll_event events[MAX_SERVER_EVENTS];
+        int ready = epoll_wait(serverEpoll, events, MAX_SERVER_EVENTS, TIMER_TICK_MILLISECONDS);
+        if (ready < 0)
         {
-            if ((newsockfd = accept_client_connection(sockfd)) == SOCKET_ERROR)
+            if (errno == EINTR)
             {
-                break;
+                continue;
             }
-            if (!add_client(newsockfd)) 
+            perror("epoll_wait");
+            break;
+        }
+
+        bool stopping = false;
+        for (int i = 0; i < ready && !stopping; i++)
+        {
+            int fd = events[i].data.fd;
+            if (fd == workerWakePipe[0])
             {
-                printf("Maximum number of clients reached. Rejecting new connection.\n");
-                close(newsockfd);
+                stopping = true; // shutdown requested by signalHandler
             }
-            else
+            else if (fd == handoffListener)
             {
-                pthread_mutex_lock(&numClientsMutex);
-                clientCount++;
-                pthread_mutex_unlock(&numClientsMutex);
-                // Allocate memory for a new socket descriptor
-                int* new_sock = malloc(sizeof(int));
-                if (!new_sock) 
+                if (handoff_to_successor(handoffListener) == HANDOFF_COMPLETE)
                 {
-                    perror("malloc failed");
-                    continue;
+                    handedOff = true;
+                    stopping = true;
                 }
-
-                *new_sock = newsockfd;
-
-                // Create a thread for each connection
-                if (pthread_create(&thread_id[client_index], NULL, connection_handler, (void*)new_sock) < 0) 
+                else if (!runServer)
                 {
-                    perror("could not create thread");
-                    close(newsockfd);
-                    free(new_sock);
-                    continue;
+                    stopping = true;
                 }
             }
+            else if (fd == hibernation_fd())
+            {
+                hibernation_wake();
+            }
+            else if (find_listener(fd) != NULL)
+            {
+                drain_accept_queue(find_listener(fd));
+            }
+        }
+        keepalive_tick();
+        multicast_tick();
+        overload_tick();
+        presence_tick();
+        spam_tick();
+        report_server_stats();
+        fair_ingest_report();
+        if (stopping)
+        {
+            break;
+        }
+    }
+
+    close(serverEpoll);
+    // After a handoff the new process owns the handoff path, so leave it in place
+    close_socket(handoffListener);
+    if (!handedOff)
+    {
+        unlink(serverConfig.handoffPath);
+        if (serverConfig.unixPath != NULL)
+        {
+            unlink(serverConfig.unixPath);
+        }
+        if (tap_enabled())
+        {
+            shm_unlink(serverConfig.tapName);
         }
     }
 
+    // Closing our copies of the sockets does not disconnect clients that were handed off
     serverShutdown();
 
     return 0;
 }
-
@@ -0,0 +1,163 @@
+/*
+* FILE              :   memory-budget.c
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This file contains the memory accounting of the connections. Every buffer the server
+                        holds on behalf of a connection is charged to it and to a global budget before it
+                        is allocated: the frame being received, and each message or control request queued
+                        for the broadcaster until the broadcaster is done with it. Charges are kept per
+                        socket descriptor, so the broadcaster can release them from the sender socket a
+                        message carries without looking up the client. A socket number reused before the
+                        broadcaster drained its previous owner's messages briefly inherits their charge,
+                        which keeps the books balanced. A connection over its soft limit, or
+                        over its share while the server is over its soft limit, stops being read until the
+                        broadcaster caught up; a charge that would cross a hard limit is refused.
+*/
+
+#include "../inc/memory-budget.h"
+#include "../inc/server-stats.h"
+#include "../../Common/inc/queue.h"
+#include <stdatomic.h>
+#include <sys/resource.h>
+
+static size_t connectionSoftBytes;      // 0 = no limit, as for the three below
+static size_t connectionHardBytes;
+static size_t globalSoftBytes;
+static size_t globalHardBytes;
+static size_t fairShareBytes;           // what one connection may hold while the server is over its soft limit
+static atomic_size_t* charged;          // bytes held per socket descriptor
+static int trackedDescriptors;
+
+/*
+    FUNCTION    :   memory_budget_init
+    DESCRIPTION :   Takes the limits from the command line and sizes the per-socket table to the
+                    descriptor limit of the process.
+    PARAMETERS  :   const ServerConfig* config - The parsed command line
+                    int slots - Number of registry slots, the global soft limit is shared among them
+    RETURNS     :   void
+*/
+void memory_budget_init(const ServerConfig* config, int slots)
+{
+    connectionSoftBytes = (size_t)config->connectionSoftKilobytes * 1024;
+    connectionHardBytes = (size_t)config->connectionHardKilobytes * 1024;
+    globalSoftBytes = (size_t)config->memorySoftMegabytes * 1024 * 1024;
+    globalHardBytes = (size_t)config->memoryHardMegabytes * 1024 * 1024;
+    fairShareBytes = globalSoftBytes / slots;
+
+    struct rlimit descriptors;
+    trackedDescriptors = MAX_TRACKED_DESCRIPTORS;
+    if (getrlimit(RLIMIT_NOFILE, &descriptors) == 0 && descriptors.rlim_cur < (rlim_t)trackedDescriptors)
+    {
+        trackedDescriptors = (int)descriptors.rlim_cur;
+    }
+    charged = calloc(trackedDescriptors, sizeof(*charged));
+    if (charged == NULL)
+    {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*
+    FUNCTION    :   message_footprint
+    DESCRIPTION :   Works out how much memory a queued message holds: its queue node and, for a body
+                    too long to be stored inline, the body's own allocation.
+    PARAMETERS  :   const Message* message - The message
+    RETURNS     :   size_t - Its size in bytes
+*/
+size_t message_footprint(const Message* message)
+{
+    size_t bytes = sizeof(QueueNode);
+    if (message->bodyLength >= MESSAGE_INLINE_LENGTH)
+    {
+        bytes += message->bodyLength + 1;
+    }
+    return bytes;
+}
+
+/*
+    FUNCTION    :   memory_charge
+    DESCRIPTION :   Charges memory about to be allocated for a connection. A charge that would take the
+                    connection or the server over its hard limit is not made.
+    PARAMETERS  :   int sock - The connection, negative for memory nobody is charged for
+                    size_t bytes - The size of the allocation
+    RETURNS     :   bool - false if the allocation must not be made
+*/
+bool memory_charge(int sock, size_t bytes)
+{
+    if (sock < 0)
+    {
+        return true;
+    }
+
+    // The total lives in the stats so that it is reported as it is
+    size_t before = atomic_fetch_add(&serverStats.memoryInUse, bytes);
+    if (globalHardBytes > 0 && before + bytes > globalHardBytes)
+    {
+        atomic_fetch_sub(&serverStats.memoryInUse, bytes);
+        atomic_fetch_add(&serverStats.memoryRefused, 1);
+        return false;
+    }
+    if (sock < trackedDescriptors)
+    {
+        size_t held = atomic_fetch_add(&charged[sock], bytes);
+        if (connectionHardBytes > 0 && held + bytes > connectionHardBytes)
+        {
+            atomic_fetch_sub(&charged[sock], bytes);
+            atomic_fetch_sub(&serverStats.memoryInUse, bytes);
+            atomic_fetch_add(&serverStats.memoryRefused, 1);
+            return false;
+        }
+    }
+
+    unsigned long peak = atomic_load(&serverStats.memoryPeak);
+    while (before + bytes > peak && !atomic_compare_exchange_weak(&serverStats.memoryPeak, &peak, before + bytes))
+    {
+        // peak was reloaded, try again while this total is still higher
+    }
+    return true;
+}
+
+/*
+    FUNCTION    :   memory_release
+    DESCRIPTION :   Gives back memory charged with memory_charge, once it has been freed.
+    PARAMETERS  :   int sock - The connection it was charged to
+                    size_t bytes - The size charged
+    RETURNS     :   void
+*/
+void memory_release(int sock, size_t bytes)
+{
+    if (sock < 0)
+    {
+        return;
+    }
+    if (sock < trackedDescriptors)
+    {
+        atomic_fetch_sub(&charged[sock], bytes);
+    }
+    atomic_fetch_sub(&serverStats.memoryInUse, bytes);
+}
+
+/*
+    FUNCTION    :   memory_over_soft
+    DESCRIPTION :   Tells a handler whether to leave its connection unread for a while: when the
+                    connection holds more than its soft limit, or while the server as a whole is over
+                    its soft limit and the connection holds more than its share of it.
+    PARAMETERS  :   int sock - The connection
+    RETURNS     :   bool - true if the read should wait MEMORY_PAUSE_MILLISECONDS
+*/
+bool memory_over_soft(int sock)
+{
+    if (sock < 0 || sock >= trackedDescriptors)
+    {
+        return false;
+    }
+    size_t held = atomic_load_explicit(&charged[sock], memory_order_relaxed);
+    if (connectionSoftBytes > 0 && held > connectionSoftBytes)
+    {
+        return true;
+    }
+    return globalSoftBytes > 0 && atomic_load_explicit(&serverStats.memoryInUse, memory_order_relaxed) > globalSoftBytes &&
+           held > fairShareBytes;
+}
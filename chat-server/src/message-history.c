@@ -0,0 +1,194 @@
+/*
+* FILE              :   message-history.c
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This file contains the broadcast history. The broadcaster numbers every message it
+                        sends and keeps the most recent MESSAGE_HISTORY of them. A client that caches
+                        messages on disk sends >>since<< with the last number it saw and is replayed only
+                        the newer ones, followed by >>sync<< naming the number of the next broadcast it
+                        will receive live. Numbers are only meaningful within one epoch, which starts
+                        with a fresh server and survives a hot restart, so a client never mistakes the
+                        numbering of an unrelated server process for its own.
+*/
+
+#include "server-utility.h"
+#include "../inc/message-history.h"
+#include "../inc/offline-mailbox.h"
+#include "../inc/client-snapshot.h"
+#include <stdatomic.h>
+#include <inttypes.h>
+#include <time.h>
+
+static atomic_uint_fast64_t nextSequence = 1;        // assigned by the broadcaster
+static uint64_t epoch;
+static char* history[MESSAGE_HISTORY];               // serialized messages, indexed by sequence number
+static uint64_t historySequence[MESSAGE_HISTORY];
+static pthread_mutex_t historyMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+    FUNCTION    :   history_init
+    DESCRIPTION :   Starts a new epoch. A successor taking over replaces it with its predecessor's.
+    PARAMETERS  :   none
+    RETURNS     :   void
+*/
+void history_init(void)
+{
+    epoch = (uint64_t)time(NULL);
+}
+
+/*
+    FUNCTION    :   history_append
+    DESCRIPTION :   Gives a message the next sequence number and keeps it, pushing out the oldest one.
+                    Called by the broadcaster as it sends them, so numbers follow the order in which
+                    clients receive the messages.
+    PARAMETERS  :   const char* serializedMessage - The message as broadcast
+    RETURNS     :   uint64_t - Its sequence number
+*/
+uint64_t history_append(const char* serializedMessage)
+{
+    uint64_t sequence = atomic_fetch_add(&nextSequence, 1);
+    history_restore(sequence, serializedMessage);
+    return sequence;
+}
+
+/*
+    FUNCTION    :   history_restore
+    DESCRIPTION :   Keeps a message under a given sequence number, for history_append and for the
+                    messages handed over by a predecessor during a hot restart.
+    PARAMETERS  :   uint64_t sequence - Its sequence number
+                    const char* serializedMessage - The message as broadcast
+    RETURNS     :   void
+*/
+void history_restore(uint64_t sequence, const char* serializedMessage)
+{
+    char* kept = strdup(serializedMessage);
+
+    pthread_mutex_lock(&historyMutex);
+    free(history[sequence & (MESSAGE_HISTORY - 1)]);
+    history[sequence & (MESSAGE_HISTORY - 1)] = kept;
+    historySequence[sequence & (MESSAGE_HISTORY - 1)] = sequence;
+    pthread_mutex_unlock(&historyMutex);
+}
+
+/*
+    FUNCTION    :   history_lookup
+    DESCRIPTION :   Copies a kept message.
+    PARAMETERS  :   uint64_t sequence - Its sequence number
+                    char* serializedMessage - Receives the message
+                    size_t size - Size of that buffer
+    RETURNS     :   bool - false if the message fell out of the history or was never published
+*/
+bool history_lookup(uint64_t sequence, char* serializedMessage, size_t size)
+{
+    bool kept = false;
+
+    pthread_mutex_lock(&historyMutex);
+    if (historySequence[sequence & (MESSAGE_HISTORY - 1)] == sequence && history[sequence & (MESSAGE_HISTORY - 1)] != NULL)
+    {
+        snprintf(serializedMessage, size, "%s", history[sequence & (MESSAGE_HISTORY - 1)]);
+        kept = true;
+    }
+    pthread_mutex_unlock(&historyMutex);
+    return kept;
+}
+
+/*
+    FUNCTION    :   history_next_sequence
+    DESCRIPTION :   Returns the sequence number the next broadcast gets.
+    PARAMETERS  :   none
+    RETURNS     :   uint64_t - The next sequence number
+*/
+uint64_t history_next_sequence(void)
+{
+    return atomic_load(&nextSequence);
+}
+
+/*
+    FUNCTION    :   history_epoch
+    DESCRIPTION :   Returns the epoch the sequence numbers belong to, for a hot restart.
+    PARAMETERS  :   none
+    RETURNS     :   uint64_t - The epoch
+*/
+uint64_t history_epoch(void)
+{
+    return epoch;
+}
+
+/*
+    FUNCTION    :   history_resume
+    DESCRIPTION :   Continues the numbering of the previous server process so that its clients see
+                    no jump.
+    PARAMETERS  :   uint64_t previousEpoch - The epoch of the previous process
+                    uint64_t sequence - The next sequence number of the previous process
+    RETURNS     :   void
+*/
+void history_resume(uint64_t previousEpoch, uint64_t sequence)
+{
+    epoch = previousEpoch;
+    atomic_store(&nextSequence, sequence);
+}
+
+/*
+    FUNCTION    :   history_replay
+    DESCRIPTION :   Answers a >>since<< by sending the kept messages after the one the client saw
+                    last, at most as many as it asked for and the newest ones if there are more,
+                    then >>sync<<. A client of another epoch is sent the newest messages as if it
+                    had seen none. A client whose mailbox was just delivered is replayed from where
+                    the mailbox stopped. It runs on the broadcaster, so no broadcast falls between the
+                    replay and the sync, and holds clientWritesMutex throughout so that nothing else does.
+    PARAMETERS  :   int sock - The client socket
+                    int slot - Its registry slot
+                    const char* request - The body after the >>since<< prefix: "<epoch> <last> <limit>"
+    RETURNS     :   void
+*/
+void history_replay(int sock, int slot, const char* request)
+{
+    uint64_t clientEpoch;
+    uint64_t last;
+    uint64_t limit;
+    char serializedMessage[MAX_SERIALIZED_LENGTH];
+    char body[MAX_SERIALIZED_LENGTH + 64];
+
+    if (sscanf(request, "%" SCNu64 " %" SCNu64 " %" SCNu64, &clientEpoch, &last, &limit) != 3)
+    {
+        return;
+    }
+    if (limit > MESSAGE_HISTORY)
+    {
+        limit = MESSAGE_HISTORY;
+    }
+
+    int reader;
+    const ClientSnapshot* snapshot = client_snapshot_enter(&reader);
+    uint64_t next = atomic_load(&nextSequence);
+    if (!client_snapshot_contains(snapshot, slot, sock))
+    {
+        client_snapshot_exit(reader);
+        return;
+    }
+    if (clientEpoch != epoch || last >= next)
+    {
+        last = 0;
+    }
+    uint64_t first = next - last - 1 > limit ? next - limit : last + 1;
+    // Whatever came after the client's mailbox is replayed, even beyond its limit
+    uint64_t floor = mailbox_replay_floor(slot);
+    if (floor != 0 && floor < first)
+    {
+        first = floor;
+    }
+    pthread_mutex_lock(&clientWritesMutex);
+    for (uint64_t sequence = first; sequence < next; sequence++)
+    {
+        if (history_lookup(sequence, serializedMessage, sizeof(serializedMessage)))
+        {
+            snprintf(body, sizeof(body), HISTORY_REPLAY_PREFIX "%" PRIu64 " %s", sequence, serializedMessage);
+            write_server_control(sock, body);
+        }
+    }
+    snprintf(body, sizeof(body), HISTORY_SYNC_PREFIX "%" PRIu64 " %" PRIu64, epoch, next);
+    write_server_control(sock, body);
+    pthread_mutex_unlock(&clientWritesMutex);
+    client_snapshot_exit(reader);
+}
@@ -0,0 +1,129 @@
+/*
+* FILE              :   moderation.c
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This file contains the word filter, the first stage of the message pipeline. It
+                        reads a list of words given with -blocklist, one per line, and drops every message
+                        that contains one of them as a whole word, ignoring case. It only inspects messages,
+                        so it runs in parallel with any other inspect stage.
+*/
+
+#include "../inc/moderation.h"
+#include "../inc/pipeline.h"
+#include <ctype.h>
+
+static char blockedWords[MAX_BLOCKED_WORDS][MAX_BLOCKED_WORD_LENGTH];
+static int blockedCount = 0;
+
+/*
+    FUNCTION    :   is_blocked
+    DESCRIPTION :   Looks a word up in the list.
+    PARAMETERS  :   const char* word - The word, in lower case
+    RETURNS     :   bool - true if it is blocked
+*/
+static bool is_blocked(const char* word)
+{
+    for (int i = 0; i < blockedCount; i++)
+    {
+        if (strcmp(blockedWords[i], word) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+    FUNCTION    :   filter_words
+    DESCRIPTION :   Pipeline stage that drops the messages of a batch containing a blocked word.
+    PARAMETERS  :   PipelineBatch* batch - The batch
+                    void* context - Unused
+    RETURNS     :   void
+*/
+static void filter_words(PipelineBatch* batch, void* context)
+{
+    (void)context;
+    for (int i = 0; i < batch->count; i++)
+    {
+        const char* body = messageBody(&batch->messages[i]);
+        char word[MAX_BLOCKED_WORD_LENGTH];
+        size_t length = 0;
+        for (const char* c = body; ; c++)
+        {
+            if (isalnum((unsigned char)*c))
+            {
+                if (length < sizeof(word) - 1)
+                {
+                    word[length] = tolower((unsigned char)*c);
+                }
+                length++;
+                continue;
+            }
+            // Words longer than any blocked one are not looked up
+            if (length > 0 && length < sizeof(word))
+            {
+                word[length] = '\0';
+                if (is_blocked(word))
+                {
+                    pipeline_drop(batch, i);
+                    break;
+                }
+            }
+            length = 0;
+            if (*c == '\0')
+            {
+                break;
+            }
+        }
+    }
+}
+
+/*
+    FUNCTION    :   moderation_init
+    DESCRIPTION :   Loads the word list given with -blocklist and registers the filter stage.
+                    Without -blocklist nothing is registered.
+    PARAMETERS  :   const ServerConfig* config - The parsed command line
+    RETURNS     :   bool - false if the list could not be read or holds a word too long to match
+*/
+bool moderation_init(const ServerConfig* config)
+{
+    if (config->blocklistPath == NULL)
+    {
+        return true;
+    }
+    FILE* list = fopen(config->blocklistPath, "r");
+    if (list == NULL)
+    {
+        perror("blocklist");
+        return false;
+    }
+
+    char line[MAX_BLOCKED_WORD_LENGTH * 2];
+    while (blockedCount < MAX_BLOCKED_WORDS && fgets(line, sizeof(line), list) != NULL)
+    {
+        size_t length = 0;
+        while (isalnum((unsigned char)line[length]))
+        {
+            length++;
+        }
+        // Words this long are never compared, an entry cut down to fit would block something else
+        if (length >= MAX_BLOCKED_WORD_LENGTH)
+        {
+            fprintf(stderr, "Invalid blocklist entry, longer than %d characters: %.*s\n",
+                    MAX_BLOCKED_WORD_LENGTH - 1, (int)length, line);
+            fclose(list);
+            return false;
+        }
+        for (size_t i = 0; i < length; i++)
+        {
+            blockedWords[blockedCount][i] = tolower((unsigned char)line[i]);
+        }
+        if (length > 0)
+        {
+            blockedWords[blockedCount++][length] = '\0';
+        }
+    }
+    fclose(list);
+    return pipeline_register("blocklist", PIPELINE_INSPECT, filter_words, NULL);
+}
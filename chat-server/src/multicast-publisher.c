@@ -0,0 +1,263 @@
+/*
+* FILE              :   multicast-publisher.c
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This file contains the multicast fan-out. With -multicast<GROUP> the broadcaster
+                        sends every message once to a UDP multicast group, tagged with a sequence number,
+                        and skips the TCP copy for clients that subscribed by sending >>mcast<<. Such a
+                        client learns the group and the first sequence number it is responsible for in
+                        the reply, notices gaps itself and asks for them again with >>nack<<; the repairs
+                        travel over its TCP connection from the broadcast history. The main loop
+                        announces the latest sequence number every second so a lost tail is noticed too.
+*/
+
+#include "server-utility.h"
+#include "../inc/multicast-publisher.h"
+#include "../inc/message-history.h"
+#include "../inc/keepalive.h"
+#include "../inc/server-stats.h"
+#include "../inc/client-snapshot.h"
+#include <stdatomic.h>
+#include <inttypes.h>
+#include <time.h>
+
+static int multicastSocket = -1;
+static struct sockaddr_in multicastGroup;
+
+/*
+    FUNCTION    :   multicast_init
+    DESCRIPTION :   Opens the publishing socket when -multicast<GROUP> was given. Datagrams leave
+                    through -mcastif<ADDR> if set, and are looped back so that clients on this host,
+                    or a test on the loopback interface, receive them as well.
+    PARAMETERS  :   const ServerConfig* config - The parsed command line
+    RETURNS     :   bool - false if multicast was asked for but cannot be set up
+*/
+bool multicast_init(const ServerConfig* config)
+{
+    if (config->multicastGroup == NULL)
+    {
+        return true;
+    }
+
+    memset(&multicastGroup, 0, sizeof(multicastGroup));
+    multicastGroup.sin_family = AF_INET;
+    multicastGroup.sin_port = htons(config->multicastPort);
+    if (inet_pton(AF_INET, config->multicastGroup, &multicastGroup.sin_addr) != 1 ||
+        !IN_MULTICAST(ntohl(multicastGroup.sin_addr.s_addr)))
+    {
+        fprintf(stderr, "%s is not an IPv4 multicast group\n", config->multicastGroup);
+        return false;
+    }
+
+    int sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (sock < 0)
+    {
+        perror("multicast socket");
+        return false;
+    }
+    unsigned char ttl = config->multicastTtl;
+    unsigned char loop = 1;
+    struct in_addr interfaceAddress = { htonl(INADDR_ANY) };
+    if (config->multicastInterface != NULL && inet_pton(AF_INET, config->multicastInterface, &interfaceAddress) != 1)
+    {
+        fprintf(stderr, "Invalid multicast interface address: %s\n", config->multicastInterface);
+        close_socket(sock);
+        return false;
+    }
+    if (setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) < 0 ||
+        setsockopt(sock, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop)) < 0 ||
+        setsockopt(sock, IPPROTO_IP, IP_MULTICAST_IF, &interfaceAddress, sizeof(interfaceAddress)) < 0)
+    {
+        perror("multicast socket");
+        close_socket(sock);
+        return false;
+    }
+    multicastSocket = sock;
+    return true;
+}
+
+/*
+    FUNCTION    :   multicast_enabled
+    DESCRIPTION :   Tells whether messages are published to a multicast group.
+    PARAMETERS  :   none
+    RETURNS     :   bool - true once multicast_init opened the publishing socket
+*/
+bool multicast_enabled(void)
+{
+    return multicastSocket >= 0;
+}
+
+/*
+    FUNCTION    :   multicast_publish
+    DESCRIPTION :   Sends a message to the group under the sequence number the history gave it. A
+                    datagram lost here is repaired like one lost on the network. Called by the
+                    broadcaster, which also serves the subscriptions, so that a client subscribing
+                    is either sent this message over TCP or told to expect it by multicast.
+    PARAMETERS  :   uint64_t sequence - Its sequence number
+                    const char* serializedMessage - The message as broadcast over TCP
+    RETURNS     :   void
+*/
+void multicast_publish(uint64_t sequence, const char* serializedMessage)
+{
+    char datagram[MAX_DATAGRAM_LENGTH];
+
+    size_t length = encodeDatagram(MULTICAST_DATA, sequence, serializedMessage, datagram, sizeof(datagram));
+    if (sendto(multicastSocket, datagram, length, 0, (struct sockaddr*)&multicastGroup, sizeof(multicastGroup)) >= 0)
+    {
+        atomic_fetch_add(&serverStats.multicastPublished, 1);
+    }
+}
+
+/*
+    FUNCTION    :   multicast_subscribe
+    DESCRIPTION :   Switches a client from TCP broadcasts to the multicast group and tells it the group
+                    and the first sequence number it will not get over TCP. Without multicast, or on
+                    a TLS connection whose messages must stay encrypted, the request is ignored and
+                    the client keeps receiving over TCP.
+    PARAMETERS  :   int sock - The client socket
+                    int slot - Its registry slot
+    RETURNS     :   void
+*/
+void multicast_subscribe(int sock, int slot)
+{
+    char offer[MAX_PARCEL_LENGTH + INET_ADDRSTRLEN];
+    char group[INET_ADDRSTRLEN];
+
+    if (!multicast_enabled() || strcmp(transportDescribe(sock), "plain") != STRING_EQUALITY)
+    {
+        return;
+    }
+    inet_ntop(AF_INET, &multicastGroup.sin_addr, group, sizeof(group));
+
+    pthread_mutex_lock(&clientsMutex);
+    if (client_sockets[slot] == sock && !client_multicast[slot])
+    {
+        client_multicast[slot] = true;
+        client_snapshot_publish();
+        snprintf(offer, sizeof(offer), MULTICAST_OFFER_PREFIX "%s %d %" PRIu64, group, ntohs(multicastGroup.sin_port),
+                 history_next_sequence());
+        send_server_control(sock, offer);
+    }
+    pthread_mutex_unlock(&clientsMutex);
+}
+
+/*
+    FUNCTION    :   multicast_unsubscribe
+    DESCRIPTION :   Returns a client that could not join the group to TCP broadcasts. What was
+                    published in between is not resent.
+    PARAMETERS  :   int sock - The client socket
+                    int slot - Its registry slot
+    RETURNS     :   void
+*/
+void multicast_unsubscribe(int sock, int slot)
+{
+    pthread_mutex_lock(&clientsMutex);
+    if (client_sockets[slot] == sock)
+    {
+        client_multicast[slot] = false;
+        client_snapshot_publish();
+    }
+    pthread_mutex_unlock(&clientsMutex);
+}
+
+/*
+    FUNCTION    :   multicast_repair
+    DESCRIPTION :   Answers a >>nack<< by resending the named messages over the client's socket. Those
+                    that fell out of the history are reported with one >>lost<< so that the client
+                    stops waiting for them. At most MESSAGE_HISTORY messages are resent per request.
+    PARAMETERS  :   int sock - The client socket
+                    const char* request - The body after the >>nack<< prefix: "<first> <last>"
+    RETURNS     :   void
+*/
+void multicast_repair(int sock, const char* request)
+{
+    uint64_t first;
+    uint64_t last;
+    uint64_t published = history_next_sequence() - 1;
+    char serializedMessage[MAX_SERIALIZED_LENGTH];
+    char body[MAX_SERIALIZED_LENGTH + 64];
+
+    if (!multicast_enabled() || sscanf(request, "%" SCNu64 " %" SCNu64, &first, &last) != 2 || first > last || first > published)
+    {
+        return;
+    }
+    if (last > published)
+    {
+        last = published;
+    }
+    if (last - first >= MESSAGE_HISTORY)
+    {
+        first = last - MESSAGE_HISTORY + 1; // everything older is gone anyway
+    }
+
+    uint64_t lostFrom = 0;
+    uint64_t lostTo = 0;
+    // Only sent while the client is registered, its socket cannot be closed before the snapshot is left
+    int reader;
+    const ClientSnapshot* snapshot = client_snapshot_enter(&reader);
+    bool registered = false;
+    for (int i = 0; i < snapshot->count && !registered; i++)
+    {
+        registered = snapshot->clients[i].sock == sock;
+    }
+    if (!registered)
+    {
+        client_snapshot_exit(reader);
+        return;
+    }
+    pthread_mutex_lock(&clientWritesMutex);
+    for (uint64_t sequence = first; sequence <= last; sequence++)
+    {
+        if (history_lookup(sequence, serializedMessage, sizeof(serializedMessage)))
+        {
+            snprintf(body, sizeof(body), MULTICAST_REPAIR_PREFIX "%" PRIu64 " %s", sequence, serializedMessage);
+            write_server_control(sock, body);
+            atomic_fetch_add(&serverStats.multicastRepaired, 1);
+            continue;
+        }
+        if (lostFrom == 0)
+        {
+            lostFrom = sequence;
+        }
+        lostTo = sequence;
+    }
+    if (lostFrom != 0)
+    {
+        snprintf(body, sizeof(body), MULTICAST_LOST_PREFIX "%" PRIu64 " %" PRIu64, lostFrom, lostTo);
+        write_server_control(sock, body);
+    }
+    pthread_mutex_unlock(&clientWritesMutex);
+    client_snapshot_exit(reader);
+}
+
+/*
+    FUNCTION    :   multicast_tick
+    DESCRIPTION :   Announces the latest sequence number once per MULTICAST_ANNOUNCE_MILLISECONDS, so
+                    that a subscriber who lost the most recent datagrams asks for them even when no
+                    further message follows. Called from the main loop.
+    PARAMETERS  :   none
+    RETURNS     :   void
+*/
+void multicast_tick(void)
+{
+    static uint64_t lastAnnounceMs = 0;
+    struct timespec now;
+    char datagram[MULTICAST_HEADER_LENGTH];
+
+    uint64_t published = history_next_sequence() - 1;
+    if (!multicast_enabled() || published == 0)
+    {
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t nowMs = (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+    if (nowMs - lastAnnounceMs < MULTICAST_ANNOUNCE_MILLISECONDS)
+    {
+        return;
+    }
+    lastAnnounceMs = nowMs;
+
+    size_t length = encodeDatagram(MULTICAST_ANNOUNCE, published, NULL, datagram, sizeof(datagram));
+    sendto(multicastSocket, datagram, length, 0, (struct sockaddr*)&multicastGroup, sizeof(multicastGroup));
+}
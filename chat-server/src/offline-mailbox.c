@@ -0,0 +1,1206 @@
+/*
+* FILE              :   offline-mailbox.c
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This file contains the offline mailboxes. A client names its user with >>hello<<
+                        when it connects, and a user one of whose clients stayed connected for a while
+                        gets a mailbox. While none of its clients is connected, the broadcasts it misses
+                        are kept in the -mailbox directory and the next >>hello<< of that user is
+                        answered with them, wrapped in >>mail<<. Every broadcast is kept once however
+                        many users are away: a writer thread appends whatever the broadcaster handed it
+                        to a log shared by all mailboxes, with one write and one flush per batch, and a
+                        mailbox is only a cursor into that log, written to a small file of the user's
+                        when its last client leaves. The log is split into files, which are deleted once
+                        no mailbox reaches back into them. A mailbox only delivers the newest part of the
+                        log its quota allows, and messages older than the expiry are not delivered.
+*/
+
+#include "server-utility.h"
+#include "../inc/offline-mailbox.h"
+#include "../inc/message-history.h"
+#include "../inc/server-stats.h"
+#include "../inc/client-snapshot.h"
+#include <dirent.h>
+#include <sys/stat.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdatomic.h>
+
+// A user with a client connected, or with a mailbox. Everything but the lock is guarded by usersMutex.
+typedef struct MailboxUser
+{
+    char name[MAX_USERNAME_LENGTH];     // empty while the entry is free
+    pthread_mutex_t lock;               // held while its mailbox is drained or its cursor file written
+    int online;                         // its clients connected right now
+    bool settled;                       // one of its clients stayed MAILBOX_MIN_SESSION_SECONDS, it keeps a mailbox
+    uint64_t owedFrom;                  // log position its mailbox starts at, MAILBOX_NOTHING_OWED for none
+    uint64_t leftEpoch;                 // epoch and sequence number of the first broadcast its last client missed
+    uint64_t leftSequence;
+} MailboxUser;
+
+// A file of the log
+typedef struct MailboxSegment
+{
+    uint64_t start;                     // log position of its first byte, which names it
+    uint64_t records;
+    uint64_t lastStoredNanoseconds;     // when its newest record was kept
+} MailboxSegment;
+
+// A broadcast waiting for the writer thread
+typedef struct PendingMail
+{
+    MailboxRecord record;
+    struct PendingMail* next;
+    char serialized[];
+} PendingMail;
+
+static const char* mailboxDirectory = NULL;
+static uint64_t quotaBytes;
+static uint64_t expiryNanoseconds;
+
+static MailboxUser users[MAILBOX_MAX_USERS];
+static int userCount = 0;               // entries ever used, free ones among them are reused first
+static pthread_mutex_t usersMutex = PTHREAD_MUTEX_INITIALIZER;
+static atomic_int offlineUsers = 0;     // users with a mailbox and no client, the broadcaster skips the log without any
+static int* slotUser;                   // user of each registry slot, -1 until its client said >>hello<<
+static uint64_t* slotJoinedNanoseconds; // when that client said it
+static uint64_t* slotReplayFloor;       // first sequence number the slot's >>since<< must replay, 0 for none
+
+static MailboxSegment segments[MAILBOX_MAX_SEGMENTS];   // oldest first, records are appended to the last
+static int segmentCount = 0;
+static uint64_t logEnd = 0;             // log position after the last record written and flushed
+static int logFile = -1;                // the last segment, only the writer thread writes to it
+static pthread_mutex_t logMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static PendingMail* pendingFront = NULL;
+static PendingMail* pendingRear = NULL;
+static int pendingCount = 0;
+static uint64_t writingFirst = 0;       // first sequence number of the batch being written, 0 while idle
+static bool writerStopping = false;
+static pthread_mutex_t pendingMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pendingArrived = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t batchWritten = PTHREAD_COND_INITIALIZER;
+static pthread_t writerThread;
+
+/*
+    FUNCTION    :   mailbox_path
+    DESCRIPTION :   Builds the path of a user's cursor file. The name is hex encoded so that any
+                    username makes a valid file name.
+    PARAMETERS  :   const char* name - The username
+                    const char* suffix - Appended after MAILBOX_FILE_SUFFIX, "" for the cursor itself
+                    char* path - Receives the path
+                    size_t size - Size of that buffer
+    RETURNS     :   void
+*/
+static void mailbox_path(const char* name, const char* suffix, char* path, size_t size)
+{
+    char encoded[2 * MAX_USERNAME_LENGTH + 1] = "";
+    for (size_t i = 0; name[i] != '\0' && i < MAX_USERNAME_LENGTH; i++)
+    {
+        snprintf(encoded + 2 * i, 3, "%02x", (unsigned char)name[i]);
+    }
+    snprintf(path, size, "%s/%s%s%s", mailboxDirectory, encoded, MAILBOX_FILE_SUFFIX, suffix);
+}
+
+/*
+    FUNCTION    :   segment_path
+    DESCRIPTION :   Builds the path of a log file.
+    PARAMETERS  :   uint64_t start - The log position it starts at
+                    char* path - Receives the path
+                    size_t size - Size of that buffer
+    RETURNS     :   void
+*/
+static void segment_path(uint64_t start, char* path, size_t size)
+{
+    snprintf(path, size, "%s/%016" PRIx64 "%s", mailboxDirectory, start, MAILBOX_LOG_SUFFIX);
+}
+
+/*
+    FUNCTION    :   decode_name
+    DESCRIPTION :   Turns the name of a cursor file back into the username it belongs to.
+    PARAMETERS  :   const char* fileName - The directory entry
+                    char* name - Receives the username, MAX_USERNAME_LENGTH bytes
+    RETURNS     :   bool - false if the entry is not a cursor file
+*/
+static bool decode_name(const char* fileName, char* name)
+{
+    const char* suffix = strstr(fileName, MAILBOX_FILE_SUFFIX);
+    size_t length = suffix == NULL ? 0 : (size_t)(suffix - fileName);
+    if (length == 0 || length % 2 != 0 || length / 2 >= MAX_USERNAME_LENGTH || strcmp(suffix, MAILBOX_FILE_SUFFIX) != 0)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < length / 2; i++)
+    {
+        unsigned int byte;
+        if (sscanf(fileName + 2 * i, "%2x", &byte) != 1 || byte == 0)
+        {
+            return false;
+        }
+        name[i] = (char)byte;
+    }
+    name[length / 2] = '\0';
+    return true;
+}
+
+/*
+    FUNCTION    :   decode_segment
+    DESCRIPTION :   Turns the name of a log file back into the log position it starts at.
+    PARAMETERS  :   const char* fileName - The directory entry
+                    uint64_t* start - Receives the position
+    RETURNS     :   bool - false if the entry is not a log file
+*/
+static bool decode_segment(const char* fileName, uint64_t* start)
+{
+    int consumed = 0;
+    return strlen(fileName) == 16 + strlen(MAILBOX_LOG_SUFFIX) && strcmp(fileName + 16, MAILBOX_LOG_SUFFIX) == 0 &&
+           sscanf(fileName, "%16" SCNx64 "%n", start, &consumed) == 1 && consumed == 16;
+}
+
+/*
+    FUNCTION    :   read_record
+    DESCRIPTION :   Reads the next record of a log file.
+    PARAMETERS  :   FILE* file - The log file, opened for reading
+                    MailboxRecord* record - Receives the header
+                    char* serialized - Receives the message, MAX_SERIALIZED_LENGTH bytes
+    RETURNS     :   bool - false at the end of the file or at a record torn by a crash
+*/
+static bool read_record(FILE* file, MailboxRecord* record, char* serialized)
+{
+    if (fread(record, sizeof(*record), 1, file) != 1 || record->magic != MAILBOX_RECORD_MAGIC ||
+        record->length >= MAX_SERIALIZED_LENGTH || fread(serialized, 1, record->length, file) != record->length)
+    {
+        return false;
+    }
+    serialized[record->length] = '\0';
+    return true;
+}
+
+/*
+    FUNCTION    :   expired
+    DESCRIPTION :   Tells whether a kept message is too old to be delivered.
+    PARAMETERS  :   uint64_t storedNanoseconds - When it was kept
+                    uint64_t now - The wall clock time in nanoseconds
+    RETURNS     :   bool - true if it expired
+*/
+static bool expired(uint64_t storedNanoseconds, uint64_t now)
+{
+    return expiryNanoseconds != 0 && now > storedNanoseconds && now - storedNanoseconds > expiryNanoseconds;
+}
+
+/*
+    FUNCTION    :   write_cursor
+    DESCRIPTION :   Brings a user's cursor file in line with its mailbox: writes it while the user has
+                    one and removes it otherwise. The file is replaced by a rename but not flushed, a
+                    crash of the host may lose it while one of the server does not.
+    PARAMETERS  :   int index - The user
+    RETURNS     :   void
+*/
+static void write_cursor(int index)
+{
+    MailboxUser* user = &users[index];
+    char name[MAX_USERNAME_LENGTH];
+    MailboxCursor cursor = { MAILBOX_CURSOR_MAGIC, 0, 0, 0, 0 };
+
+    pthread_mutex_lock(&user->lock);
+    pthread_mutex_lock(&usersMutex);
+    // The entry may have been given to another user since, whose state is written then
+    strcpy(name, user->name);
+    cursor.owedFrom = user->owedFrom;
+    cursor.leftEpoch = user->leftEpoch;
+    cursor.leftSequence = user->leftSequence;
+    pthread_mutex_unlock(&usersMutex);
+
+    char path[PATH_MAX];
+    char writtenPath[PATH_MAX];
+    mailbox_path(name, "", path, sizeof(path));
+    mailbox_path(name, ".tmp", writtenPath, sizeof(writtenPath));
+    if (name[0] != '\0' && cursor.owedFrom == MAILBOX_NOTHING_OWED)
+    {
+        unlink(path);
+    }
+    else if (name[0] != '\0')
+    {
+        int file = open(writtenPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        bool written = file >= 0 && write(file, &cursor, sizeof(cursor)) == (ssize_t)sizeof(cursor);
+        if (file >= 0)
+        {
+            close(file);
+        }
+        if (!written || rename(writtenPath, path) != 0)
+        {
+            perror("mailbox");
+            unlink(writtenPath);
+        }
+    }
+    pthread_mutex_unlock(&user->lock);
+}
+
+/*
+    FUNCTION    :   find_free_user
+    DESCRIPTION :   Finds an entry for a new user. When all are taken, the user that has been away
+                    longest is forgotten along with its mailbox; one whose mailbox is being written or
+                    delivered right now is passed over. The caller holds usersMutex.
+    PARAMETERS  :   none
+    RETURNS     :   int - The entry, -1 if none can be had
+*/
+static int find_free_user(void)
+{
+    for (int i = 0; i < userCount; i++)
+    {
+        if (users[i].name[0] == '\0')
+        {
+            return i;
+        }
+    }
+    if (userCount < MAILBOX_MAX_USERS)
+    {
+        return userCount++;
+    }
+
+    int stalest = -1;
+    for (int i = 0; i < userCount; i++)
+    {
+        if (users[i].online == 0 && (stalest < 0 || users[i].owedFrom < users[stalest].owedFrom))
+        {
+            stalest = i;
+        }
+    }
+    // Its lock ranks before usersMutex, so it is only tried
+    if (stalest < 0 || pthread_mutex_trylock(&users[stalest].lock) != 0)
+    {
+        return -1;
+    }
+    char path[PATH_MAX];
+    mailbox_path(users[stalest].name, "", path, sizeof(path));
+    unlink(path);
+    pthread_mutex_unlock(&users[stalest].lock);
+    if (users[stalest].owedFrom != MAILBOX_NOTHING_OWED)
+    {
+        atomic_fetch_sub(&offlineUsers, 1);
+    }
+    users[stalest].name[0] = '\0';
+    return stalest;
+}
+
+/*
+    FUNCTION    :   claim_user
+    DESCRIPTION :   Counts one more client of a user as connected, adding the user if it is new.
+    PARAMETERS  :   const char* name - The username
+                    bool settled - The client has been connected for long already
+                    MailboxUser* owed - Receives a copy of the user's entry as it was, NULL if not needed
+    RETURNS     :   int - The user's entry, -1 if there is no room for it
+*/
+static int claim_user(const char* name, bool settled, MailboxUser* owed)
+{
+    pthread_mutex_lock(&usersMutex);
+    int found = -1;
+    for (int i = 0; i < userCount && found < 0; i++)
+    {
+        if (strcmp(users[i].name, name) == 0)
+        {
+            found = i;
+        }
+    }
+    if (found < 0 && (found = find_free_user()) >= 0)
+    {
+        MailboxUser* user = &users[found];
+        strncpy(user->name, name, MAX_USERNAME_LENGTH - 1);
+        user->name[MAX_USERNAME_LENGTH - 1] = '\0';
+        user->online = 0;
+        user->settled = false;
+        user->owedFrom = MAILBOX_NOTHING_OWED;
+        user->leftEpoch = 0;
+        user->leftSequence = 0;
+    }
+    if (found >= 0)
+    {
+        MailboxUser* user = &users[found];
+        if (user->online++ == 0 && user->owedFrom != MAILBOX_NOTHING_OWED)
+        {
+            atomic_fetch_sub(&offlineUsers, 1);
+        }
+        user->settled = user->settled || settled;
+        if (owed != NULL)
+        {
+            owed->owedFrom = user->owedFrom;
+            owed->leftEpoch = user->leftEpoch;
+            owed->leftSequence = user->leftSequence;
+        }
+    }
+    pthread_mutex_unlock(&usersMutex);
+    return found;
+}
+
+/*
+    FUNCTION    :   compare_positions
+    DESCRIPTION :   Orders log positions for qsort.
+    PARAMETERS  :   const void* left - A uint64_t
+                    const void* right - Another one
+    RETURNS     :   int - Negative, zero or positive as left is before, at or after right
+*/
+static int compare_positions(const void* left, const void* right)
+{
+    uint64_t a = *(const uint64_t*)left;
+    uint64_t b = *(const uint64_t*)right;
+    return (a > b) - (a < b);
+}
+
+/*
+    FUNCTION    :   owed_cursors
+    DESCRIPTION :   Collects the cursors of all mailboxes, to tell how far back into the log they reach.
+    PARAMETERS  :   uint64_t* cursors - Receives them in ascending order, MAILBOX_MAX_USERS of them at most
+    RETURNS     :   int - How many there are
+*/
+static int owed_cursors(uint64_t* cursors)
+{
+    int count = 0;
+    pthread_mutex_lock(&usersMutex);
+    for (int i = 0; i < userCount; i++)
+    {
+        if (users[i].name[0] != '\0' && users[i].owedFrom != MAILBOX_NOTHING_OWED)
+        {
+            cursors[count++] = users[i].owedFrom;
+        }
+    }
+    pthread_mutex_unlock(&usersMutex);
+    qsort(cursors, count, sizeof(*cursors), compare_positions);
+    return count;
+}
+
+/*
+    FUNCTION    :   remove_segments
+    DESCRIPTION :   Deletes the log files nobody can be delivered anything from any more: those before
+                    every mailbox's cursor, before the part of the log the quota lets a mailbox have,
+                    or holding only expired messages. Their messages are counted as trimmed or expired
+                    once for every mailbox that reached back into them. The last file is kept, it is
+                    being written. A drain that has one of them open reads on; one that did not open
+                    it yet skips it.
+    PARAMETERS  :   uint64_t now - The wall clock time in nanoseconds
+    RETURNS     :   void
+*/
+static void remove_segments(uint64_t now)
+{
+    uint64_t* cursors = malloc(MAILBOX_MAX_USERS * sizeof(*cursors));
+    if (cursors == NULL)
+    {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    int owedCount = owed_cursors(cursors);
+    uint64_t needed = owedCount > 0 ? cursors[0] : MAILBOX_NOTHING_OWED;
+
+    pthread_mutex_lock(&logMutex);
+    if (quotaBytes > 0 && logEnd > quotaBytes && logEnd - quotaBytes > needed)
+    {
+        needed = logEnd - quotaBytes;
+    }
+    int kept = 0;
+    int reaching = 0;
+    for (int i = 0; i < segmentCount; i++)
+    {
+        bool stale = i < segmentCount - 1 && expired(segments[i].lastStoredNanoseconds, now);
+        if (i < segmentCount - 1 && (stale || segments[i + 1].start <= needed))
+        {
+            while (reaching < owedCount && cursors[reaching] < segments[i + 1].start)
+            {
+                reaching++;
+            }
+            atomic_fetch_add(stale ? &serverStats.mailExpired : &serverStats.mailTrimmed, reaching * segments[i].records);
+            char path[PATH_MAX];
+            segment_path(segments[i].start, path, sizeof(path));
+            unlink(path);
+            continue;
+        }
+        segments[kept++] = segments[i];
+    }
+    segmentCount = kept;
+    pthread_mutex_unlock(&logMutex);
+    free(cursors);
+}
+
+/*
+    FUNCTION    :   open_segment
+    DESCRIPTION :   Starts a new log file at the end of the log and makes it the one written to. When
+                    MAILBOX_MAX_SEGMENTS are kept already the oldest goes, whoever still needed it.
+                    Called by the writer thread, or before it starts.
+    PARAMETERS  :   none
+    RETURNS     :   bool - false if the file cannot be created
+*/
+static bool open_segment(void)
+{
+    char path[PATH_MAX];
+    segment_path(logEnd, path, sizeof(path));
+    int file = open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    if (file < 0)
+    {
+        perror("mailbox");
+        return false;
+    }
+
+    pthread_mutex_lock(&logMutex);
+    if (segmentCount == MAILBOX_MAX_SEGMENTS)
+    {
+        char oldestPath[PATH_MAX];
+        segment_path(segments[0].start, oldestPath, sizeof(oldestPath));
+        unlink(oldestPath);
+        memmove(&segments[0], &segments[1], (MAILBOX_MAX_SEGMENTS - 1) * sizeof(segments[0]));
+        segmentCount--;
+    }
+    segments[segmentCount].start = logEnd;
+    segments[segmentCount].records = 0;
+    segments[segmentCount].lastStoredNanoseconds = 0;
+    segmentCount++;
+    int previous = logFile;
+    logFile = file;
+    pthread_mutex_unlock(&logMutex);
+    if (previous >= 0)
+    {
+        close(previous);
+    }
+    return true;
+}
+
+/*
+    FUNCTION    :   append_batch
+    DESCRIPTION :   Appends a batch to the log in one write and one flush, and publishes the new end
+                    of the log once the records are on disk. A write that fails is cut off again, so
+                    that the records after it stay where the log positions say they are.
+    PARAMETERS  :   const char* records - The broadcasts laid out as log records
+                    size_t length - Bytes in records
+                    unsigned long count - Records in it
+                    uint64_t now - The wall clock time in nanoseconds
+    RETURNS     :   void
+*/
+static void append_batch(const char* records, size_t length, unsigned long count, uint64_t now)
+{
+    if (segments[segmentCount - 1].start + MAILBOX_SEGMENT_BYTES <= logEnd && open_segment())
+    {
+        remove_segments(now);
+    }
+    uint64_t segmentLength = logEnd - segments[segmentCount - 1].start;
+    ssize_t written = write(logFile, records, length);
+    if (written != (ssize_t)length || fdatasync(logFile) != 0)
+    {
+        perror("mailbox");
+        if (ftruncate(logFile, segmentLength) != 0)
+        {
+            perror("mailbox");
+        }
+        atomic_fetch_add(&serverStats.mailDropped, count);
+        return;
+    }
+
+    pthread_mutex_lock(&logMutex);
+    logEnd += length;
+    segments[segmentCount - 1].records += count;
+    segments[segmentCount - 1].lastStoredNanoseconds = now;
+    pthread_mutex_unlock(&logMutex);
+    atomic_fetch_add(&serverStats.mailStored, count);
+}
+
+/*
+    FUNCTION    :   mailbox_writer
+    DESCRIPTION :   Thread that takes all broadcasts waiting at once, lays them out as log records
+                    and appends them to the log. When asked to stop it writes what is still waiting
+                    first.
+    PARAMETERS  :   void* arg - Unused
+    RETURNS     :   void* - NULL
+*/
+static void* mailbox_writer(void* arg)
+{
+    (void)arg;
+    while (true)
+    {
+        pthread_mutex_lock(&pendingMutex);
+        while (pendingFront == NULL && !writerStopping)
+        {
+            pthread_cond_wait(&pendingArrived, &pendingMutex);
+        }
+        PendingMail* batch = pendingFront;
+        if (batch == NULL)
+        {
+            pthread_mutex_unlock(&pendingMutex);
+            break;
+        }
+        pendingFront = pendingRear = NULL;
+        pendingCount = 0;
+        writingFirst = batch->record.sequence;
+        pthread_mutex_unlock(&pendingMutex);
+
+        size_t length = 0;
+        unsigned long count = 0;
+        for (PendingMail* mail = batch; mail != NULL; mail = mail->next)
+        {
+            length += sizeof(mail->record) + mail->record.length;
+            count++;
+        }
+        char* records = malloc(length);
+        if (records == NULL)
+        {
+            perror("malloc failed");
+            exit(EXIT_FAILURE);
+        }
+        size_t offset = 0;
+        for (PendingMail* mail = batch; mail != NULL; mail = mail->next)
+        {
+            memcpy(records + offset, &mail->record, sizeof(mail->record));
+            memcpy(records + offset + sizeof(mail->record), mail->serialized, mail->record.length);
+            offset += sizeof(mail->record) + mail->record.length;
+        }
+        append_batch(records, length, count, wallClockNanoseconds());
+
+        free(records);
+        while (batch != NULL)
+        {
+            PendingMail* next = batch->next;
+            free(batch);
+            batch = next;
+        }
+        pthread_mutex_lock(&pendingMutex);
+        writingFirst = 0;
+        pthread_cond_broadcast(&batchWritten);
+        pthread_mutex_unlock(&pendingMutex);
+    }
+    return NULL;
+}
+
+/*
+    FUNCTION    :   mailbox_init
+    DESCRIPTION :   Creates the -mailbox directory if needed. What is in it is only read by
+                    mailbox_start, a predecessor being taken over may still be writing to it. Without
+                    -mailbox nothing is kept.
+    PARAMETERS  :   const ServerConfig* config - The parsed command line
+                    int slots - Size of the client registry
+    RETURNS     :   bool - false if the directory cannot be used
+*/
+bool mailbox_init(const ServerConfig* config, int slots)
+{
+    if (config->mailboxDirectory == NULL)
+    {
+        return true;
+    }
+    if (mkdir(config->mailboxDirectory, 0700) != 0 && errno != EEXIST)
+    {
+        perror("mailbox");
+        return false;
+    }
+    mailboxDirectory = config->mailboxDirectory;
+    quotaBytes = (uint64_t)config->mailboxQuotaKilobytes * 1024;
+    expiryNanoseconds = (uint64_t)config->mailboxExpiryHours * 3600 * NANOSECONDS_PER_SECOND;
+
+    for (int i = 0; i < MAILBOX_MAX_USERS; i++)
+    {
+        pthread_mutex_init(&users[i].lock, NULL);
+    }
+    slotUser = malloc(slots * sizeof(*slotUser));
+    slotJoinedNanoseconds = calloc(slots, sizeof(*slotJoinedNanoseconds));
+    slotReplayFloor = calloc(slots, sizeof(*slotReplayFloor));
+    if (slotUser == NULL || slotJoinedNanoseconds == NULL || slotReplayFloor == NULL)
+    {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < slots; i++)
+    {
+        slotUser[i] = -1;
+    }
+    return true;
+}
+
+/*
+    FUNCTION    :   load_cursor
+    DESCRIPTION :   Gives a user found in the directory its mailbox back. A user already counted
+                    online was handed over with a mailbox it had not received in full, which it keeps.
+    PARAMETERS  :   const char* name - The username
+    RETURNS     :   void
+*/
+static void load_cursor(const char* name)
+{
+    char path[PATH_MAX];
+    MailboxCursor cursor;
+    mailbox_path(name, "", path, sizeof(path));
+    int file = open(path, O_RDONLY | O_CLOEXEC);
+    if (file < 0)
+    {
+        return;
+    }
+    bool valid = read(file, &cursor, sizeof(cursor)) == (ssize_t)sizeof(cursor) && cursor.magic == MAILBOX_CURSOR_MAGIC &&
+                 cursor.owedFrom != MAILBOX_NOTHING_OWED;
+    close(file);
+    if (!valid)
+    {
+        unlink(path);
+        return;
+    }
+
+    pthread_mutex_lock(&usersMutex);
+    int found = -1;
+    for (int i = 0; i < userCount && found < 0; i++)
+    {
+        if (strcmp(users[i].name, name) == 0)
+        {
+            found = i;
+        }
+    }
+    if (found < 0 && (found = find_free_user()) >= 0)
+    {
+        strcpy(users[found].name, name);
+        users[found].online = 0;
+    }
+    if (found >= 0)
+    {
+        MailboxUser* user = &users[found];
+        if (user->online == 0)
+        {
+            atomic_fetch_add(&offlineUsers, 1);
+        }
+        user->settled = true;
+        user->owedFrom = cursor.owedFrom;
+        user->leftEpoch = cursor.leftEpoch;
+        user->leftSequence = cursor.leftSequence;
+    }
+    pthread_mutex_unlock(&usersMutex);
+}
+
+/*
+    FUNCTION    :   load_segment
+    DESCRIPTION :   Counts the records of a log file found in the directory and adds it to the log.
+                    The torn tail of the last one is cut off, appends go right after its last record.
+    PARAMETERS  :   uint64_t start - The log position it starts at
+                    bool last - It is the newest one
+    RETURNS     :   bool - false if it cannot be read
+*/
+static bool load_segment(uint64_t start, bool last)
+{
+    char path[PATH_MAX];
+    segment_path(start, path, sizeof(path));
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        perror("mailbox");
+        return false;
+    }
+
+    MailboxSegment* segment = &segments[segmentCount++];
+    segment->start = start;
+    segment->records = 0;
+    segment->lastStoredNanoseconds = 0;
+    MailboxRecord record;
+    char serialized[MAX_SERIALIZED_LENGTH];
+    uint64_t length = 0;
+    while (read_record(file, &record, serialized))
+    {
+        segment->records++;
+        segment->lastStoredNanoseconds = record.storedNanoseconds;
+        length += sizeof(record) + record.length;
+    }
+    fclose(file);
+    if (last)
+    {
+        if (truncate(path, length) != 0)
+        {
+            perror("mailbox");
+        }
+        logEnd = start + length;
+    }
+    return true;
+}
+
+/*
+    FUNCTION    :   mailbox_start
+    DESCRIPTION :   Reads the log and the cursors in the -mailbox directory and starts the writer
+                    thread. Called after a takeover, whose predecessor wrote what it had before it
+                    handed over. The log goes on at least where the furthest cursor points, so that
+                    a cursor never points at records written after it.
+    PARAMETERS  :   none
+    RETURNS     :   bool - false if the directory cannot be read or the log written
+*/
+bool mailbox_start(void)
+{
+    if (!mailbox_enabled())
+    {
+        return true;
+    }
+    DIR* directory = opendir(mailboxDirectory);
+    if (directory == NULL)
+    {
+        perror("mailbox");
+        return false;
+    }
+    uint64_t* starts = malloc(MAILBOX_MAX_SEGMENTS * sizeof(*starts));
+    if (starts == NULL)
+    {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    int found = 0;
+    struct dirent* entry;
+    while ((entry = readdir(directory)) != NULL)
+    {
+        char name[MAX_USERNAME_LENGTH];
+        uint64_t start;
+        if (decode_name(entry->d_name, name))
+        {
+            load_cursor(name);
+        }
+        else if (decode_segment(entry->d_name, &start) && found < MAILBOX_MAX_SEGMENTS)
+        {
+            starts[found++] = start;
+        }
+    }
+    closedir(directory);
+
+    qsort(starts, found, sizeof(*starts), compare_positions);
+    bool resumed = false;
+    for (int i = 0; i < found; i++)
+    {
+        resumed = load_segment(starts[i], i == found - 1);
+    }
+    // A newest file that cannot be read is not written to either, the log goes on after it
+    logEnd = found > 0 && !resumed ? starts[found - 1] + MAILBOX_SEGMENT_BYTES : logEnd;
+    free(starts);
+
+    uint64_t furthest = 0;
+    pthread_mutex_lock(&usersMutex);
+    for (int i = 0; i < userCount; i++)
+    {
+        if (users[i].owedFrom != MAILBOX_NOTHING_OWED && users[i].owedFrom > furthest)
+        {
+            furthest = users[i].owedFrom;
+        }
+    }
+    pthread_mutex_unlock(&usersMutex);
+
+    char path[PATH_MAX];
+    if (resumed && logEnd >= furthest)
+    {
+        segment_path(segments[segmentCount - 1].start, path, sizeof(path));
+        logFile = open(path, O_WRONLY | O_APPEND | O_CLOEXEC);
+    }
+    if (logFile < 0)
+    {
+        logEnd = logEnd > furthest ? logEnd : furthest;
+        if (!open_segment())
+        {
+            return false;
+        }
+    }
+    remove_segments(wallClockNanoseconds());
+
+    if (pthread_create(&writerThread, NULL, mailbox_writer, NULL) != 0)
+    {
+        perror("pthread_create");
+        mailboxDirectory = NULL;
+        return false;
+    }
+    return true;
+}
+
+/*
+    FUNCTION    :   mailbox_enabled
+    DESCRIPTION :   Tells whether the server keeps mailboxes.
+    PARAMETERS  :   none
+    RETURNS     :   bool - true if -mailbox was given
+*/
+bool mailbox_enabled(void)
+{
+    return mailboxDirectory != NULL;
+}
+
+/*
+    FUNCTION    :   mailbox_store
+    DESCRIPTION :   Hands a broadcast to the writer thread if a user with a mailbox is offline.
+                    Called by the broadcaster right after it numbered the message, so it only copies
+                    it. When the disk cannot keep up the message is dropped rather than held in
+                    memory.
+    PARAMETERS  :   uint64_t sequence - Its sequence number
+                    const char* serializedMessage - The message as broadcast
+    RETURNS     :   void
+*/
+void mailbox_store(uint64_t sequence, const char* serializedMessage)
+{
+    if (!mailbox_enabled() || atomic_load(&offlineUsers) == 0)
+    {
+        return;
+    }
+    size_t length = strlen(serializedMessage);
+    PendingMail* mail = malloc(sizeof(*mail) + length);
+    if (mail == NULL)
+    {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    mail->record.magic = MAILBOX_RECORD_MAGIC;
+    mail->record.length = (uint32_t)length;
+    mail->record.storedNanoseconds = wallClockNanoseconds();
+    mail->record.epoch = history_epoch();
+    mail->record.sequence = sequence;
+    mail->next = NULL;
+    memcpy(mail->serialized, serializedMessage, length);
+
+    pthread_mutex_lock(&pendingMutex);
+    if (pendingCount >= MAILBOX_MAX_PENDING)
+    {
+        pthread_mutex_unlock(&pendingMutex);
+        free(mail);
+        atomic_fetch_add(&serverStats.mailDropped, 1);
+        return;
+    }
+    if (pendingRear == NULL)
+    {
+        pendingFront = mail;
+    }
+    else
+    {
+        pendingRear->next = mail;
+    }
+    pendingRear = mail;
+    pendingCount++;
+    pthread_cond_signal(&pendingArrived);
+    pthread_mutex_unlock(&pendingMutex);
+}
+
+/*
+    FUNCTION    :   send_mail
+    DESCRIPTION :   Sends a chunk of kept messages to a client under one hold of clientWritesMutex,
+                    so that broadcasts go out in between chunks.
+    PARAMETERS  :   int sock - The client socket
+                    int slot - Its registry slot
+                    char (*chunk)[MAX_SERIALIZED_LENGTH + sizeof(MAILBOX_DELIVERY_PREFIX)] - The messages, wrapped in >>mail<<
+                    int count - How many there are
+    RETURNS     :   bool - false if the client left meanwhile
+*/
+static bool send_mail(int sock, int slot, char (*chunk)[MAX_SERIALIZED_LENGTH + sizeof(MAILBOX_DELIVERY_PREFIX)], int count)
+{
+    int reader;
+    const ClientSnapshot* snapshot = client_snapshot_enter(&reader);
+    bool present = client_snapshot_contains(snapshot, slot, sock);
+    pthread_mutex_lock(&clientWritesMutex);
+    for (int i = 0; present && i < count; i++)
+    {
+        write_server_control(sock, chunk[i]);
+    }
+    pthread_mutex_unlock(&clientWritesMutex);
+    client_snapshot_exit(reader);
+    if (present)
+    {
+        atomic_fetch_add(&serverStats.mailDelivered, count);
+    }
+    return present;
+}
+
+/*
+    FUNCTION    :   drain_mailbox
+    DESCRIPTION :   Delivers a user's mailbox to the client that just said >>hello<<: the records of
+                    the log from its cursor on, or from where its quota starts if that is later.
+                    Each log file is read through a large buffer and sent MAILBOX_DRAIN_CHUNK
+                    messages at a time. Messages its last client was sent, the client already has,
+                    receives live or will be replayed are left out. The caller holds the user's lock.
+    PARAMETERS  :   const MailboxUser* owed - The user's cursor as the client claimed it
+                    int sock - The client socket
+                    int slot - Its registry slot
+                    uint64_t coveredFrom - First sequence number of the current epoch the client gets otherwise
+                    uint64_t cachedEpoch - Epoch of the client's cache
+                    uint64_t cachedLast - Last sequence number in it
+    RETURNS     :   bool - false if the client left before it got everything
+*/
+static bool drain_mailbox(const MailboxUser* owed, int sock, int slot, uint64_t coveredFrom, uint64_t cachedEpoch, uint64_t cachedLast)
+{
+    MailboxSegment* kept = malloc(MAILBOX_MAX_SEGMENTS * sizeof(*kept));
+    char (*chunk)[MAX_SERIALIZED_LENGTH + sizeof(MAILBOX_DELIVERY_PREFIX)] = malloc(MAILBOX_DRAIN_CHUNK * sizeof(*chunk));
+    char* buffer = malloc(MAILBOX_DRAIN_CHUNK * MAX_SERIALIZED_LENGTH);
+    if (kept == NULL || chunk == NULL || buffer == NULL)
+    {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    pthread_mutex_lock(&logMutex);
+    int keptCount = segmentCount;
+    memcpy(kept, segments, keptCount * sizeof(*kept));
+    uint64_t end = logEnd;
+    pthread_mutex_unlock(&logMutex);
+    uint64_t quotaStart = quotaBytes > 0 && end > quotaBytes ? end - quotaBytes : 0;
+
+    uint64_t epoch = history_epoch();
+    uint64_t now = wallClockNanoseconds();
+    MailboxRecord record;
+    char serialized[MAX_SERIALIZED_LENGTH];
+    int count = 0;
+    bool present = true;
+    for (int i = 0; present && i < keptCount; i++)
+    {
+        uint64_t segmentEnd = i < keptCount - 1 ? kept[i + 1].start : end;
+        if (segmentEnd <= owed->owedFrom)
+        {
+            continue;
+        }
+        if (segmentEnd <= quotaStart)
+        {
+            atomic_fetch_add(&serverStats.mailTrimmed, kept[i].records);
+            continue;
+        }
+        char path[PATH_MAX];
+        segment_path(kept[i].start, path, sizeof(path));
+        FILE* file = fopen(path, "rb");
+        if (file == NULL)
+        {
+            continue;
+        }
+        setvbuf(file, buffer, _IOFBF, MAILBOX_DRAIN_CHUNK * MAX_SERIALIZED_LENGTH);
+        uint64_t position = kept[i].start;
+        if (owed->owedFrom > position && fseeko(file, owed->owedFrom - position, SEEK_SET) == 0)
+        {
+            position = owed->owedFrom;
+        }
+
+        while (present && position < segmentEnd && read_record(file, &record, serialized))
+        {
+            uint64_t at = position;
+            position += sizeof(record) + record.length;
+            // Broadcasts numbered before its last client left were still sent to that client
+            if (record.epoch == owed->leftEpoch && record.sequence < owed->leftSequence)
+            {
+                continue;
+            }
+            if (at < quotaStart)
+            {
+                atomic_fetch_add(&serverStats.mailTrimmed, 1);
+                continue;
+            }
+            if (expired(record.storedNanoseconds, now))
+            {
+                atomic_fetch_add(&serverStats.mailExpired, 1);
+                continue;
+            }
+            if (record.epoch == epoch && (record.sequence >= coveredFrom || (cachedEpoch == epoch && record.sequence <= cachedLast)))
+            {
+                continue;
+            }
+            snprintf(chunk[count++], sizeof(*chunk), MAILBOX_DELIVERY_PREFIX "%s", serialized);
+            if (count == MAILBOX_DRAIN_CHUNK)
+            {
+                present = send_mail(sock, slot, chunk, count);
+                count = 0;
+            }
+        }
+        fclose(file);
+    }
+    present = present && send_mail(sock, slot, chunk, count);
+    free(buffer);
+    free(chunk);
+    free(kept);
+    return present;
+}
+
+/*
+    FUNCTION    :   mailbox_hello
+    DESCRIPTION :   Answers a >>hello<<: records the client's username and, the first time it is said
+                    on this connection, delivers the user's mailbox. It runs on the client's handler
+                    thread. Broadcasts numbered from joinedSequence on were sent to the client live; a
+                    client that caches messages has also announced its >>since<<, which is made to
+                    replay from where the mailbox stops, so that each message arrives once. If the
+                    client leaves before it got everything the mailbox is kept whole.
+    PARAMETERS  :   int sock - The client socket
+                    int slot - Its registry slot
+                    uint64_t joinedSequence - Next sequence number when the handler started
+                    const char* request - The body after the >>hello<< prefix
+    RETURNS     :   void
+*/
+void mailbox_hello(int sock, int slot, uint64_t joinedSequence, const char* request)
+{
+    uint64_t cachedEpoch;
+    uint64_t cachedLast;
+    uint64_t limit;
+    int nameOffset = 0;
+    if (sscanf(request, "%" SCNu64 " %" SCNu64 " %" SCNu64 " %n", &cachedEpoch, &cachedLast, &limit, &nameOffset) != 3 ||
+        nameOffset == 0 || request[nameOffset] == '\0')
+    {
+        return;
+    }
+    const char* name = request + nameOffset;
+    set_client_name(sock, name);
+    if (!mailbox_enabled() || slotUser[slot] >= 0)
+    {
+        return;
+    }
+    MailboxUser owed;
+    int index = claim_user(name, false, &owed);
+    if (index < 0)
+    {
+        return;
+    }
+    slotUser[slot] = index;
+    slotJoinedNanoseconds[slot] = wallClockNanoseconds();
+
+    // The same first message history_replay would pick; a later >>since<< starts no later than this
+    uint64_t coveredFrom = joinedSequence;
+    if (limit > 0)
+    {
+        uint64_t last = cachedEpoch != history_epoch() || cachedLast >= joinedSequence ? 0 : cachedLast;
+        coveredFrom = joinedSequence - last - 1 > limit ? joinedSequence - limit : last + 1;
+        slotReplayFloor[slot] = coveredFrom;
+    }
+    if (owed.owedFrom == MAILBOX_NOTHING_OWED)
+    {
+        return;
+    }
+
+    // Broadcasts still on their way to the disk are written before the log is read
+    uint64_t target = history_next_sequence();
+    pthread_mutex_lock(&pendingMutex);
+    while ((pendingFront != NULL && pendingFront->record.sequence < target) || (writingFirst != 0 && writingFirst < target))
+    {
+        pthread_cond_wait(&batchWritten, &pendingMutex);
+    }
+    pthread_mutex_unlock(&pendingMutex);
+
+    MailboxUser* user = &users[index];
+    pthread_mutex_lock(&user->lock);
+    if (drain_mailbox(&owed, sock, slot, coveredFrom, cachedEpoch, cachedLast))
+    {
+        // Still online through this client, so nobody moved the cursor meanwhile
+        pthread_mutex_lock(&usersMutex);
+        user->owedFrom = MAILBOX_NOTHING_OWED;
+        pthread_mutex_unlock(&usersMutex);
+        char path[PATH_MAX];
+        mailbox_path(user->name, "", path, sizeof(path));
+        unlink(path);
+    }
+    pthread_mutex_unlock(&user->lock);
+}
+
+/*
+    FUNCTION    :   mailbox_join
+    DESCRIPTION :   Counts a client handed over by a predecessor as online under the username it had,
+                    without delivering anything: it never went away, and has been connected for long
+                    enough to keep a mailbox.
+    PARAMETERS  :   int slot - Its registry slot
+                    const char* userName - Its username, empty if it never sent a message
+    RETURNS     :   void
+*/
+void mailbox_join(int slot, const char* userName)
+{
+    if (!mailbox_enabled() || userName[0] == '\0' || slotUser[slot] >= 0)
+    {
+        return;
+    }
+    int index = claim_user(userName, true, NULL);
+    if (index >= 0)
+    {
+        slotUser[slot] = index;
+    }
+}
+
+/*
+    FUNCTION    :   mailbox_leave
+    DESCRIPTION :   Notes that a client is leaving. Called before it leaves the registry: when it was
+                    its user's last client, the broadcasts numbered from now on go to the mailbox,
+                    whose cursor is the end of the log as it is now. A user none of whose clients
+                    stayed MAILBOX_MIN_SESSION_SECONDS is forgotten instead. A mailbox the client had
+                    not received in full keeps its cursor, its messages are delivered again.
+    PARAMETERS  :   int slot - Its registry slot
+    RETURNS     :   void
+*/
+void mailbox_leave(int slot)
+{
+    if (!mailbox_enabled() || slotUser[slot] < 0)
+    {
+        return;
+    }
+    int index = slotUser[slot];
+    MailboxUser* user = &users[index];
+    bool lasted = wallClockNanoseconds() - slotJoinedNanoseconds[slot] >= MAILBOX_MIN_SESSION_SECONDS * NANOSECONDS_PER_SECOND;
+    slotUser[slot] = -1;
+    slotReplayFloor[slot] = 0;
+
+    pthread_mutex_lock(&usersMutex);
+    user->settled = user->settled || lasted;
+    bool owed = --user->online == 0 && user->settled;
+    if (user->online == 0 && !user->settled)
+    {
+        user->name[0] = '\0';
+    }
+    else if (owed)
+    {
+        // Counted first, so that the broadcaster keeps whatever it numbers after the sequence is read
+        atomic_fetch_add(&offlineUsers, 1);
+        if (user->owedFrom == MAILBOX_NOTHING_OWED)
+        {
+            pthread_mutex_lock(&logMutex);
+            user->owedFrom = logEnd;
+            pthread_mutex_unlock(&logMutex);
+            user->leftEpoch = history_epoch();
+            user->leftSequence = history_next_sequence();
+        }
+    }
+    pthread_mutex_unlock(&usersMutex);
+    if (owed)
+    {
+        write_cursor(index);
+    }
+}
+
+/*
+    FUNCTION    :   mailbox_replay_floor
+    DESCRIPTION :   Tells history_replay where the mailbox of a slot's user stopped, once.
+    PARAMETERS  :   int slot - The registry slot
+    RETURNS     :   uint64_t - The first sequence number to replay at the latest, 0 if there is none
+*/
+uint64_t mailbox_replay_floor(int slot)
+{
+    if (!mailbox_enabled())
+    {
+        return 0;
+    }
+    uint64_t floor = slotReplayFloor[slot];
+    slotReplayFloor[slot] = 0;
+    return floor;
+}
+
+/*
+    FUNCTION    :   mailbox_flush
+    DESCRIPTION :   Waits until the writer thread wrote everything the broadcaster handed it. Called
+                    once the broadcaster stopped for a handoff, so that the successor finds the whole
+                    log when it reads it.
+    PARAMETERS  :   none
+    RETURNS     :   void
+*/
+void mailbox_flush(void)
+{
+    if (!mailbox_enabled())
+    {
+        return;
+    }
+    pthread_mutex_lock(&pendingMutex);
+    while (pendingFront != NULL || writingFirst != 0)
+    {
+        pthread_cond_wait(&batchWritten, &pendingMutex);
+    }
+    pthread_mutex_unlock(&pendingMutex);
+}
+
+/*
+    FUNCTION    :   mailbox_stop
+    DESCRIPTION :   Waits for the writer thread to write what the broadcaster left it and return.
+                    Called once the broadcaster stopped.
+    PARAMETERS  :   none
+    RETURNS     :   void
+*/
+void mailbox_stop(void)
+{
+    if (!mailbox_enabled())
+    {
+        return;
+    }
+    pthread_mutex_lock(&pendingMutex);
+    writerStopping = true;
+    pthread_cond_signal(&pendingArrived);
+    pthread_mutex_unlock(&pendingMutex);
+    pthread_join(writerThread, NULL);
+    if (logFile >= 0)
+    {
+        close(logFile);
+    }
+}
@@ -0,0 +1,244 @@
+/*
+* FILE              :   overload.c
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This file contains the overload protection of the message queue. Queue length says
+                        little about overload on its own, a burst that drains quickly is harmless, so the
+                        broadcaster watches how long each message waited instead, as CoDel does. Once the
+                        delay stayed above target for an interval the heaviest senders have their reads
+                        slowed, which lets TCP flow control push back on them. If the delay still stays
+                        above target for another interval the broadcaster starts dropping messages at the
+                        rate of the CoDel control law, interval / sqrt(drops), until the delay falls back
+                        under target. Independently a hard cap on the queue length refuses new messages
+                        outright. Senders of refused or dropped messages are told with >>busy<<.
+*/
+
+#include "server-utility.h"
+#include "../inc/overload.h"
+#include "../inc/server-stats.h"
+#include <stdatomic.h>
+#include <time.h>
+
+static uint64_t targetNanoseconds;
+static uint64_t intervalNanoseconds;
+static unsigned int maxQueue;
+static int capacity;
+static atomic_int level = OVERLOAD_NONE;
+
+// Per sender accounting, in registry slots
+static atomic_uint* windowMessages;            // admitted in the current window, counted by the handlers
+static atomic_uint* previousWindowMessages;    // admitted in the last complete window
+static atomic_uint heavyThreshold = UINT_MAX;  // a sender with at least this many in the last window is heavy
+static _Atomic uint64_t* lastBusyNanoseconds;  // when the sender was last told >>busy<<
+
+// CoDel state, only touched by the broadcaster
+static uint64_t firstAboveNanoseconds;         // when the delay will have been above target for an interval, 0 below target
+static uint64_t escalateNanoseconds;           // when throttling turns into dropping
+static uint64_t dropNextNanoseconds;
+static uint32_t dropCount;
+static bool dropping;
+
+/*
+    FUNCTION    :   now_nanoseconds
+    DESCRIPTION :   Reads the monotonic clock.
+    PARAMETERS  :   none
+    RETURNS     :   uint64_t - The current time in nanoseconds
+*/
+static uint64_t now_nanoseconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+/*
+    FUNCTION    :   integer_sqrt
+    DESCRIPTION :   Integer square root for the control law, which keeps the server free of libm.
+    PARAMETERS  :   uint32_t value - The radicand
+    RETURNS     :   uint32_t - floor(sqrt(value)), at least 1
+*/
+static uint32_t integer_sqrt(uint32_t value)
+{
+    uint32_t root = value;
+    uint32_t next = (root + 1) / 2;
+    while (next < root)
+    {
+        root = next;
+        next = (root + value / root) / 2;
+    }
+    return root == 0 ? 1 : root;
+}
+
+/*
+    FUNCTION    :   overload_init
+    DESCRIPTION :   Takes the CoDel parameters and the queue cap from the command line and sets up the
+                    per-slot accounting.
+    PARAMETERS  :   const ServerConfig* config - The parsed command line
+                    int slots - Number of registry slots
+    RETURNS     :   void
+*/
+void overload_init(const ServerConfig* config, int slots)
+{
+    targetNanoseconds = (uint64_t)config->codelTargetMilliseconds * 1000000ull;
+    intervalNanoseconds = (uint64_t)config->codelIntervalMilliseconds * 1000000ull;
+    maxQueue = config->maxQueue;
+    capacity = slots;
+    windowMessages = calloc(slots, sizeof(*windowMessages));
+    previousWindowMessages = calloc(slots, sizeof(*previousWindowMessages));
+    lastBusyNanoseconds = calloc(slots, sizeof(*lastBusyNanoseconds));
+    if (windowMessages == NULL || previousWindowMessages == NULL || lastBusyNanoseconds == NULL)
+    {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*
+    FUNCTION    :   overload_notify_busy
+    DESCRIPTION :   Tells a sender that its message was refused or dropped, at most once per interval
+                    so that a flood of refusals does not become a flood of notices. The notice goes
+                    through the control lane like every other write to a client.
+    PARAMETERS  :   int sock - The sender's socket
+                    int slot - Its registry slot
+    RETURNS     :   void
+*/
+void overload_notify_busy(int sock, int slot)
+{
+    uint64_t now = now_nanoseconds();
+    uint64_t last = atomic_load(&lastBusyNanoseconds[slot]);
+    if (now - last >= intervalNanoseconds && atomic_compare_exchange_strong(&lastBusyNanoseconds[slot], &last, now))
+    {
+        post_control(sock, SERVER_BUSY);
+    }
+}
+
+/*
+    FUNCTION    :   overload_admit
+    DESCRIPTION :   Counts a message a handler is about to queue and refuses it when the queue is at
+                    its cap. Called by the handler of the sender.
+    PARAMETERS  :   int sock - The sender's socket
+                    int slot - Its registry slot
+    RETURNS     :   bool - false if the message must be dropped, the sender has been told
+*/
+bool overload_admit(int sock, int slot)
+{
+    atomic_fetch_add_explicit(&windowMessages[slot], 1, memory_order_relaxed);
+    if (maxQueue > 0 && atomic_load_explicit(&messageQueue.length, memory_order_relaxed) >= maxQueue)
+    {
+        atomic_fetch_add(&serverStats.refusedBusy, 1);
+        overload_notify_busy(sock, slot);
+        return false;
+    }
+    return true;
+}
+
+/*
+    FUNCTION    :   overload_throttled
+    DESCRIPTION :   Tells a handler whether to pause before reading its next frame: only while the
+                    server is overloaded, and only for a sender that queued at least its fair share
+                    of the messages in the last window.
+    PARAMETERS  :   int slot - The registry slot of the sender
+    RETURNS     :   bool - true if the read should wait THROTTLE_DELAY_MILLISECONDS
+*/
+bool overload_throttled(int slot)
+{
+    if (atomic_load_explicit(&level, memory_order_relaxed) == OVERLOAD_NONE)
+    {
+        return false;
+    }
+    unsigned int sent = atomic_load_explicit(&previousWindowMessages[slot], memory_order_relaxed);
+    return sent > 0 && sent >= atomic_load_explicit(&heavyThreshold, memory_order_relaxed);
+}
+
+/*
+    FUNCTION    :   overload_shed
+    DESCRIPTION :   Runs the CoDel state machine for a message the broadcaster just dequeued and decides
+                    whether to drop it. Called by the broadcaster only.
+    PARAMETERS  :   uint64_t sojournNanoseconds - How long the message waited in the queue
+                    unsigned int queued - Messages still queued behind it
+    RETURNS     :   bool - true if the message must be dropped instead of broadcast
+*/
+bool overload_shed(uint64_t sojournNanoseconds, unsigned int queued)
+{
+    uint64_t now = now_nanoseconds();
+
+    if (sojournNanoseconds < targetNanoseconds || queued == 0)
+    {
+        // The standing queue is gone, back to normal
+        firstAboveNanoseconds = 0;
+        dropping = false;
+        atomic_store(&level, OVERLOAD_NONE);
+        return false;
+    }
+    if (firstAboveNanoseconds == 0)
+    {
+        firstAboveNanoseconds = now + intervalNanoseconds;
+        return false;
+    }
+    if (now < firstAboveNanoseconds)
+    {
+        return false;
+    }
+
+    if (atomic_load(&level) == OVERLOAD_NONE)
+    {
+        atomic_store(&level, OVERLOAD_THROTTLE);
+        escalateNanoseconds = now + intervalNanoseconds;
+        atomic_fetch_add(&serverStats.overloadEpisodes, 1);
+        return false;
+    }
+    if (!dropping)
+    {
+        if (now < escalateNanoseconds)
+        {
+            return false;
+        }
+        // Start near the last drop rate if the previous dropping period ended recently
+        dropping = true;
+        atomic_store(&level, OVERLOAD_SHED);
+        dropCount = dropCount > 2 && now - dropNextNanoseconds < 16 * intervalNanoseconds ? dropCount - 2 : 1;
+        dropNextNanoseconds = now + intervalNanoseconds / integer_sqrt(dropCount);
+        return true;
+    }
+    if (now >= dropNextNanoseconds)
+    {
+        dropCount++;
+        dropNextNanoseconds += intervalNanoseconds / integer_sqrt(dropCount);
+        return true;
+    }
+    return false;
+}
+
+/*
+    FUNCTION    :   overload_tick
+    DESCRIPTION :   Closes the accounting window once per interval and works out the fair share a
+                    heavy sender is measured against: the mean of the senders that sent anything.
+                    Called from the main loop.
+    PARAMETERS  :   none
+    RETURNS     :   void
+*/
+void overload_tick(void)
+{
+    static uint64_t windowStart = 0;
+    uint64_t now = now_nanoseconds();
+    if (now - windowStart < intervalNanoseconds)
+    {
+        return;
+    }
+    windowStart = now;
+
+    uint64_t total = 0;
+    unsigned int senders = 0;
+    for (int slot = 0; slot < capacity; slot++)
+    {
+        unsigned int sent = atomic_exchange_explicit(&windowMessages[slot], 0, memory_order_relaxed);
+        atomic_store_explicit(&previousWindowMessages[slot], sent, memory_order_relaxed);
+        if (sent > 0)
+        {
+            total += sent;
+            senders++;
+        }
+    }
+    atomic_store(&heavyThreshold, senders > 0 ? (unsigned int)(total / senders) : UINT_MAX);
+}
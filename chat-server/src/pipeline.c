@@ -0,0 +1,196 @@
+/*
+* FILE              :   pipeline.c
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This file contains the message pipeline between the queue and the fan-out. Policy
+                        such as moderation registers a stage at startup instead of being written into the
+                        handlers or the broadcaster. The broadcaster takes up to PIPELINE_BATCH messages off
+                        the queue at a time and passes the whole batch through the stages in the order they
+                        were registered, so a stage costs one call per batch rather than per message.
+                        Consecutive inspect stages do not depend on each other and form a phase whose stages
+                        run at the same time, the broadcaster running the first one itself and a small pool
+                        of threads the others. Without stages a batch passes straight through.
+*/
+
+#include "../inc/pipeline.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct RegisteredStage
+{
+    const char* name;
+    int kind;
+    PipelineStage run;
+    void* context;
+} RegisteredStage;
+
+static RegisteredStage stages[PIPELINE_MAX_STAGES];
+static int stageCount = 0;
+
+// Work handed to the pool for one phase; the pool is as large as the widest phase minus the broadcaster
+static pthread_mutex_t poolMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t poolWork = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t poolDone = PTHREAD_COND_INITIALIZER;
+static unsigned long poolGeneration = 0;    // bumped for every phase handed out
+static PipelineBatch* poolBatch;
+static int poolFirstStage;                  // the broadcaster runs this one, worker i runs poolFirstStage + 1 + i
+static int poolWidth;
+static int poolPending;                     // workers still running a stage of the current phase
+
+/*
+    FUNCTION    :   phase_width
+    DESCRIPTION :   Counts the stages that run together starting at a given stage: a run of inspect
+                    stages, or a single transform stage.
+    PARAMETERS  :   int first - Index of the first stage of the phase
+    RETURNS     :   int - The number of stages in the phase
+*/
+static int phase_width(int first)
+{
+    if (stages[first].kind != PIPELINE_INSPECT)
+    {
+        return 1;
+    }
+    int width = 1;
+    while (first + width < stageCount && stages[first + width].kind == PIPELINE_INSPECT)
+    {
+        width++;
+    }
+    return width;
+}
+
+/*
+    FUNCTION    :   pipeline_worker
+    DESCRIPTION :   Runs the stages of the pool slot it was started for, one phase after another.
+    PARAMETERS  :   void* arg - The pool slot, cast from an integer
+    RETURNS     :   void* - Never returns
+*/
+static void* pipeline_worker(void* arg)
+{
+    int slot = (int)(intptr_t)arg;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&poolMutex);
+    while (true)
+    {
+        while (poolGeneration == seen)
+        {
+            pthread_cond_wait(&poolWork, &poolMutex);
+        }
+        seen = poolGeneration;
+        if (slot + 1 >= poolWidth)
+        {
+            continue; // a narrower phase, nothing for this slot
+        }
+        RegisteredStage* stage = &stages[poolFirstStage + 1 + slot];
+        PipelineBatch* batch = poolBatch;
+        pthread_mutex_unlock(&poolMutex);
+
+        stage->run(batch, stage->context);
+
+        pthread_mutex_lock(&poolMutex);
+        if (--poolPending == 0)
+        {
+            pthread_cond_signal(&poolDone);
+        }
+    }
+    return NULL;
+}
+
+/*
+    FUNCTION    :   pipeline_register
+    DESCRIPTION :   Adds a stage to the end of the pipeline. Only called during startup, before
+                    pipeline_start.
+    PARAMETERS  :   const char* name - Name of the stage, for messages
+                    int kind - PIPELINE_INSPECT or PIPELINE_TRANSFORM
+                    PipelineStage stage - Called with every batch
+                    void* context - Passed to the stage unchanged
+    RETURNS     :   bool - false if PIPELINE_MAX_STAGES are already registered
+*/
+bool pipeline_register(const char* name, int kind, PipelineStage stage, void* context)
+{
+    if (stageCount == PIPELINE_MAX_STAGES)
+    {
+        fprintf(stderr, "Pipeline full, stage %s not registered\n", name);
+        return false;
+    }
+    stages[stageCount++] = (RegisteredStage){ name, kind, stage, context };
+    return true;
+}
+
+/*
+    FUNCTION    :   pipeline_start
+    DESCRIPTION :   Starts the threads that run inspect stages alongside the broadcaster, as many as
+                    the widest phase needs. A pipeline without parallel phases starts none.
+    PARAMETERS  :   none
+    RETURNS     :   void
+*/
+void pipeline_start(void)
+{
+    int widest = 1;
+    for (int first = 0; first < stageCount; first += phase_width(first))
+    {
+        widest = phase_width(first) > widest ? phase_width(first) : widest;
+    }
+    for (int slot = 0; slot < widest - 1; slot++)
+    {
+        pthread_t worker;
+        if (pthread_create(&worker, NULL, pipeline_worker, (void*)(intptr_t)slot) != 0)
+        {
+            perror("Failed to create pipeline thread");
+            exit(EXIT_FAILURE);
+        }
+        pthread_detach(worker);
+    }
+}
+
+/*
+    FUNCTION    :   pipeline_run
+    DESCRIPTION :   Passes a batch through every stage, phase by phase. Called by the broadcaster only.
+    PARAMETERS  :   PipelineBatch* batch - The batch, with nothing dropped and everyone as recipient
+    RETURNS     :   void
+*/
+void pipeline_run(PipelineBatch* batch)
+{
+    for (int first = 0; first < stageCount; )
+    {
+        int width = phase_width(first);
+        if (width > 1)
+        {
+            pthread_mutex_lock(&poolMutex);
+            poolBatch = batch;
+            poolFirstStage = first;
+            poolWidth = width;
+            poolPending = width - 1;
+            poolGeneration++;
+            pthread_cond_broadcast(&poolWork);
+            pthread_mutex_unlock(&poolMutex);
+        }
+
+        stages[first].run(batch, stages[first].context);
+
+        if (width > 1)
+        {
+            pthread_mutex_lock(&poolMutex);
+            while (poolPending > 0)
+            {
+                pthread_cond_wait(&poolDone, &poolMutex);
+            }
+            pthread_mutex_unlock(&poolMutex);
+        }
+        first += width;
+    }
+}
+
+/*
+    FUNCTION    :   pipeline_drop
+    DESCRIPTION :   Marks a message of a batch as not to be delivered. Safe to call from stages
+                    running in parallel.
+    PARAMETERS  :   PipelineBatch* batch - The batch
+                    int index - The message
+    RETURNS     :   void
+*/
+void pipeline_drop(PipelineBatch* batch, int index)
+{
+    atomic_store_explicit(&batch->dropped[index], true, memory_order_relaxed);
+}
@@ -0,0 +1,332 @@
+/*
+* FILE              :   presence-service.c
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This file contains the presence service. It counts the connections of every user
+                        named in a >>hello<< or a message and keeps the roster of users with at least one.
+                        A client that asks with >>roster?<< gets the roster once, at its current version;
+                        after that it is only sent deltas, each leading from one version to the next. The
+                        main loop collects the changes of a short window into one delta, so a user who
+                        reconnects within it is not announced at all, and the traffic grows with the rate
+                        of change rather than with the size of the roster. Deltas travel on the control
+                        lane, so the broadcaster writes them in order with the roster answers.
+*/
+
+#include "server-utility.h"
+#include "../inc/presence-service.h"
+#include "../inc/client-snapshot.h"
+#include "../inc/keepalive.h"
+#include <stdatomic.h>
+#include <time.h>
+
+static pthread_mutex_t presenceMutex = PTHREAD_MUTEX_INITIALIZER;
+static PresenceUser users[PRESENCE_MAX_USERS];  // under presenceMutex, like everything below but subscribed
+static int userCount = 0;
+static int dirtyCount = 0;
+static uint64_t version = 0;
+static InternId* slotUsers;                     // user each slot counts for and holds, INTERN_NONE before it named one
+static atomic_bool* subscribed;                 // slots that asked for the roster and are sent the deltas
+static uint64_t windowMilliseconds;
+
+/*
+    FUNCTION    :   find_user
+    DESCRIPTION :   Looks a user up on the roster. Caller holds presenceMutex.
+    PARAMETERS  :   InternId user - The interned username
+    RETURNS     :   int - Its index, -1 if it is not listed
+*/
+static int find_user(InternId user)
+{
+    for (int i = 0; i < userCount; i++)
+    {
+        if (users[i].user == user)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+    FUNCTION    :   count_connection
+    DESCRIPTION :   Adds or removes a connection of a user and marks the user for the next delta when
+                    it came online or went offline. Caller holds presenceMutex.
+    PARAMETERS  :   InternId user - The interned username
+                    int change - 1 for a connection that named it, -1 for one that stopped
+    RETURNS     :   void
+*/
+static void count_connection(InternId user, int change)
+{
+    int index = find_user(user);
+    if (index < 0)
+    {
+        if (change < 0 || userCount == PRESENCE_MAX_USERS)
+        {
+            return;
+        }
+        index = userCount++;
+        users[index] = (PresenceUser){ .user = user };
+        internRetain(user); // kept until the user is dropped from the roster
+    }
+
+    PresenceUser* entry = &users[index];
+    entry->clients += change;
+    if ((entry->clients > 0) != entry->announced && !entry->dirty)
+    {
+        entry->dirty = true;
+        dirtyCount++;
+    }
+}
+
+/*
+    FUNCTION    :   presence_init
+    DESCRIPTION :   Allocates the per slot state.
+    PARAMETERS  :   int slots - Size of the client registry
+                    int window - Milliseconds of changes collected into one delta
+    RETURNS     :   void
+*/
+void presence_init(int slots, int window)
+{
+    slotUsers = calloc(slots, sizeof(*slotUsers));
+    subscribed = calloc(slots, sizeof(*subscribed));
+    if (slotUsers == NULL || subscribed == NULL)
+    {
+        perror("calloc failed");
+        exit(EXIT_FAILURE);
+    }
+    windowMilliseconds = window;
+}
+
+/*
+    FUNCTION    :   presence_join
+    DESCRIPTION :   Counts a connection for the user it names, moving it from the user it named before
+                    if that changed, and keeps a reference to the name while it counts. Called by the
+                    slot's handler whenever the connection claims a name, the common case of the same
+                    name again takes no lock.
+    PARAMETERS  :   int slot - The registry slot
+                    InternId user - The interned username, the caller holds a reference; INTERN_NONE is ignored
+    RETURNS     :   void
+*/
+void presence_join(int slot, InternId user)
+{
+    if (slotUsers[slot] == user || user == INTERN_NONE)
+    {
+        return;
+    }
+    pthread_mutex_lock(&presenceMutex);
+    if (slotUsers[slot] != INTERN_NONE)
+    {
+        count_connection(slotUsers[slot], -1);
+        internRelease(slotUsers[slot]);
+    }
+    count_connection(user, 1);
+    internRetain(user);
+    slotUsers[slot] = user;
+    pthread_mutex_unlock(&presenceMutex);
+}
+
+/*
+    FUNCTION    :   presence_leave
+    DESCRIPTION :   Stops counting a connection that is going away and stops sending it deltas.
+    PARAMETERS  :   int slot - The registry slot
+    RETURNS     :   void
+*/
+void presence_leave(int slot)
+{
+    atomic_store(&subscribed[slot], false);
+    pthread_mutex_lock(&presenceMutex);
+    if (slotUsers[slot] != INTERN_NONE)
+    {
+        count_connection(slotUsers[slot], -1);
+        internRelease(slotUsers[slot]);
+        slotUsers[slot] = INTERN_NONE;
+    }
+    pthread_mutex_unlock(&presenceMutex);
+}
+
+/*
+    FUNCTION    :   presence_subscribe
+    DESCRIPTION :   Answers a >>roster?<< with the users online at the current version, in parts that
+                    fit a control frame, and sends the client every delta from then on. Called by the
+                    broadcaster, which also writes the deltas, so none of them can overtake the roster.
+    PARAMETERS  :   int sock - The client socket
+                    int slot - Its registry slot
+    RETURNS     :   void
+*/
+void presence_subscribe(int sock, int slot)
+{
+    char (*parts)[PRESENCE_MAX_PART_LENGTH + 64] = NULL;
+    int partCount = 0;
+    int reader;
+
+    pthread_mutex_lock(&presenceMutex);
+    // Every part has room for this many names at least, after its header
+    int partsNeeded = userCount / ((PRESENCE_MAX_PART_LENGTH - 64) / MAX_USERNAME_LENGTH) + 1;
+    parts = malloc(partsNeeded * sizeof(*parts));
+    if (parts == NULL)
+    {
+        pthread_mutex_unlock(&presenceMutex);
+        return;
+    }
+    char header[64];
+    int flagOffset = snprintf(header, sizeof(header), "%s%" PRIu64 " ", PRESENCE_ROSTER_PREFIX, version);
+    size_t length = 0;
+    for (int i = 0; i < userCount; i++)
+    {
+        if (!users[i].announced)
+        {
+            continue;
+        }
+        const char* name = internedString(users[i].user);
+        if (partCount == 0 || length + strlen(name) + 1 > PRESENCE_MAX_PART_LENGTH)
+        {
+            length = snprintf(parts[partCount], sizeof(parts[partCount]), "%s%c", header, PRESENCE_MORE_PARTS);
+            partCount++;
+        }
+        length += snprintf(parts[partCount - 1] + length, sizeof(parts[partCount - 1]) - length, " %s", name);
+    }
+    if (partCount == 0)
+    {
+        snprintf(parts[partCount++], sizeof(parts[0]), "%s%c", header, PRESENCE_MORE_PARTS); // nobody online
+    }
+    parts[partCount - 1][flagOffset] = PRESENCE_LAST_PART;
+    atomic_store(&subscribed[slot], true);
+    pthread_mutex_unlock(&presenceMutex);
+
+    const ClientSnapshot* snapshot = client_snapshot_enter(&reader);
+    if (client_snapshot_contains(snapshot, slot, sock))
+    {
+        pthread_mutex_lock(&clientWritesMutex);
+        for (int i = 0; i < partCount; i++)
+        {
+            write_server_control(sock, parts[i]);
+        }
+        pthread_mutex_unlock(&clientWritesMutex);
+    }
+    client_snapshot_exit(reader);
+    free(parts);
+}
+
+/*
+    FUNCTION    :   presence_subscribed
+    DESCRIPTION :   Tells whether a client asked for the roster, so that a hot restart can renew it.
+    PARAMETERS  :   int slot - The registry slot
+    RETURNS     :   bool - true if it is sent the deltas
+*/
+bool presence_subscribed(int slot)
+{
+    return atomic_load(&subscribed[slot]);
+}
+
+/*
+    FUNCTION    :   presence_deliver
+    DESCRIPTION :   Sends a delta to every client that asked for the roster. Called by the broadcaster.
+    PARAMETERS  :   const char* delta - The delta, the body of the control message flush_deltas queued
+    RETURNS     :   void
+*/
+void presence_deliver(const char* delta)
+{
+    int reader;
+    const ClientSnapshot* snapshot = client_snapshot_enter(&reader);
+    pthread_mutex_lock(&clientWritesMutex);
+    for (int i = 0; i < snapshot->count; i++)
+    {
+        if (atomic_load_explicit(&subscribed[snapshot->clients[i].slot], memory_order_relaxed))
+        {
+            write_server_control(snapshot->clients[i].sock, delta);
+        }
+    }
+    pthread_mutex_unlock(&clientWritesMutex);
+    client_snapshot_exit(reader);
+}
+
+/*
+    FUNCTION    :   queue_delta
+    DESCRIPTION :   Gives a finished delta to the broadcaster through the control lane. It is not
+                    charged to any client. Caller holds presenceMutex.
+    PARAMETERS  :   const char* delta - The delta
+    RETURNS     :   void
+*/
+static void queue_delta(const char* delta)
+{
+    Message control;
+    initMessage(&control, HEARTBEAT_SENDER_IP, HEARTBEAT_SENDER_NAME);
+    setMessageBody(&control, delta, strlen(delta));
+    control.senderSock = -1;
+    enqueueControl(&messageQueue, &control); // the queue owns the body from here on
+}
+
+/*
+    FUNCTION    :   flush_deltas
+    DESCRIPTION :   Turns the changes collected since the last delta into one delta, or several if
+                    they do not fit a control frame, each advancing the version by one. A user who
+                    went offline and came back meanwhile is left out, and one no longer online is
+                    dropped from the roster. Caller holds presenceMutex.
+    PARAMETERS  :   none
+    RETURNS     :   void
+*/
+static void flush_deltas(void)
+{
+    char delta[PRESENCE_MAX_PART_LENGTH + 64];
+    size_t length = 0;
+
+    for (int i = userCount - 1; i >= 0; i--)
+    {
+        PresenceUser* entry = &users[i];
+        if (entry->dirty && (entry->clients > 0) != entry->announced)
+        {
+            const char* name = internedString(entry->user);
+            if (length > 0 && length + strlen(name) + 2 > PRESENCE_MAX_PART_LENGTH)
+            {
+                queue_delta(delta);
+                length = 0;
+            }
+            if (length == 0)
+            {
+                length = snprintf(delta, sizeof(delta), "%s%" PRIu64 " %" PRIu64, PRESENCE_DELTA_PREFIX, version, version + 1);
+                version++;
+            }
+            length += snprintf(delta + length, sizeof(delta) - length, " %c%s",
+                               entry->clients > 0 ? PRESENCE_JOINED : PRESENCE_LEFT, name);
+            entry->announced = entry->clients > 0;
+        }
+        entry->dirty = false;
+        if (entry->clients == 0 && !entry->announced)
+        {
+            internRelease(entry->user);
+            users[i] = users[--userCount];
+        }
+    }
+    if (length > 0)
+    {
+        queue_delta(delta);
+    }
+    dirtyCount = 0;
+}
+
+/*
+    FUNCTION    :   presence_tick
+    DESCRIPTION :   Opens a window at the first change after a quiet spell and sends the changes
+                    collected in it once it ended. Called by the main loop on every wakeup.
+    PARAMETERS  :   none
+    RETURNS     :   void
+*/
+void presence_tick(void)
+{
+    static uint64_t windowStartMs = 0;  // 0 while no window is open
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t nowMs = (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+    pthread_mutex_lock(&presenceMutex);
+    if (dirtyCount > 0 && windowStartMs == 0)
+    {
+        windowStartMs = nowMs;
+    }
+    else if (windowStartMs != 0 && nowMs - windowStartMs >= windowMilliseconds)
+    {
+        flush_deltas();
+        windowStartMs = 0;
+    }
+    pthread_mutex_unlock(&presenceMutex);
+}
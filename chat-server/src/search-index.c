@@ -0,0 +1,1187 @@
+/*
+* FILE              :   search-index.c
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This file contains the full-text search over every broadcast. The broadcaster only
+                        copies a message for the indexer thread, which appends it to the -search log and
+                        adds its words to the open segment, an in-memory inverted index with uncompressed
+                        posting lists. Every SEARCH_SEGMENT_DOCUMENTS messages the open segment is sealed:
+                        its terms are sorted and each posting list is stored as varint encoded gaps between
+                        document numbers, typically a byte or two per posting. A merger thread combines
+                        SEARCH_MERGE_FACTOR sealed segments of one size into a larger one in the background,
+                        so a query looks at a few segments whatever the history's length. Queries run in the
+                        asking client's handler: they intersect the posting lists of their words, shortest
+                        first, and read only the page of matches they return from the log. On startup the
+                        log is indexed again. During a hot restart both processes append to it under flock
+                        and each indexes what the other appended before its own records.
+*/
+
+#include "server-utility.h"
+#include "../inc/search-index.h"
+#include "../inc/client-snapshot.h"
+#include "../inc/server-stats.h"
+#include <ctype.h>
+#include <sys/file.h>
+#include <netinet/tcp.h>
+
+// A term of the open segment, its postings uncompressed and in document order
+typedef struct OpenTerm
+{
+    char text[SEARCH_MAX_TERM_LENGTH];
+    uint32_t* documents;
+    uint32_t count;
+    uint32_t capacity;
+} OpenTerm;
+
+// A term of a sealed segment, its postings varint encoded gaps in the segment's posting bytes
+typedef struct SealedTerm
+{
+    char text[SEARCH_MAX_TERM_LENGTH];
+    uint32_t count;
+    uint32_t bytes;
+    uint64_t offset;
+} SealedTerm;
+
+// An immutable sealed segment, its terms sorted; freed once no segment list holds it
+typedef struct Segment
+{
+    atomic_int references;
+    int level;                      // merges it went through, only segments of one level are merged
+    uint32_t termCount;
+    SealedTerm* terms;
+    uint8_t* postings;
+} Segment;
+
+// The sealed segments as of one moment, oldest first; freed once the last query using it is done
+typedef struct SegmentList
+{
+    atomic_int references;
+    int count;
+    Segment* segments[];
+} SegmentList;
+
+typedef struct ByteBuffer
+{
+    uint8_t* data;
+    size_t length;
+    size_t capacity;
+} ByteBuffer;
+
+typedef struct DocumentList
+{
+    uint32_t* documents;
+    size_t count;
+    size_t capacity;
+} DocumentList;
+
+// A broadcast waiting for the indexer
+typedef struct PendingSearch
+{
+    struct PendingSearch* next;
+    uint32_t length;
+    char serialized[];
+} PendingSearch;
+
+static const char* searchPath = NULL;
+static int logFile = -1;
+static uint64_t indexedBytes = 0;                                   // log bytes indexed, only the indexer touches it
+static uint64_t* documentOffsets[SEARCH_MAX_DOCUMENT_CHUNKS];       // log offset of every document, allocated a chunk at a time
+static uint32_t documentCount = 0;                                  // only the indexer touches it
+
+static pthread_mutex_t openMutex = PTHREAD_MUTEX_INITIALIZER;
+static OpenTerm* openTerms = NULL;                                  // open addressed, under openMutex like the two below
+static uint32_t openCapacity = 0;                                   // a power of two
+static uint32_t openTermCount = 0;
+static uint32_t openDocuments = 0;
+
+static pthread_mutex_t listMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t mergeWanted = PTHREAD_COND_INITIALIZER;
+static SegmentList* currentList = NULL;                             // under listMutex, which also serializes its publishers
+static bool mergerStopping = false;
+
+static PendingSearch* pendingFront = NULL;
+static PendingSearch* pendingRear = NULL;
+static int pendingCount = 0;
+static bool indexerStopping = false;
+static pthread_mutex_t pendingMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pendingArrived = PTHREAD_COND_INITIALIZER;
+static pthread_t indexerThread;
+static pthread_t mergerThread;
+
+/*
+    FUNCTION    :   next_term
+    DESCRIPTION :   Finds the next word of a text, the same way for messages and queries: a run of
+                    letters and digits, in lower case and cut to SEARCH_MAX_TERM_LENGTH - 1 characters.
+    PARAMETERS  :   const char** cursor - Where to look from, moved past the word
+                    char* term - Receives the word, SEARCH_MAX_TERM_LENGTH bytes
+    RETURNS     :   bool - false once there is no word left
+*/
+static bool next_term(const char** cursor, char* term)
+{
+    const char* c = *cursor;
+    while (*c != '\0' && !isalnum((unsigned char)*c))
+    {
+        c++;
+    }
+    size_t length = 0;
+    for (; isalnum((unsigned char)*c); c++)
+    {
+        if (length < SEARCH_MAX_TERM_LENGTH - 1)
+        {
+            term[length++] = tolower((unsigned char)*c);
+        }
+    }
+    term[length] = '\0';
+    *cursor = c;
+    return length > 0;
+}
+
+/*
+    FUNCTION    :   grow
+    DESCRIPTION :   Makes room in a growable array, doubling it.
+    PARAMETERS  :   void** items - The array
+                    size_t* capacity - Its capacity in items
+                    size_t needed - Items it must hold
+                    size_t size - Size of one item
+    RETURNS     :   void
+*/
+static void grow(void** items, size_t* capacity, size_t needed, size_t size)
+{
+    if (needed <= *capacity)
+    {
+        return;
+    }
+    size_t larger = *capacity == 0 ? 16 : *capacity;
+    while (larger < needed)
+    {
+        larger *= 2;
+    }
+    void* moved = realloc(*items, larger * size);
+    if (moved == NULL)
+    {
+        perror("realloc failed");
+        exit(EXIT_FAILURE);
+    }
+    *items = moved;
+    *capacity = larger;
+}
+
+/*
+    FUNCTION    :   put_varint
+    DESCRIPTION :   Appends a number seven bits a byte, the high bit set on every byte but the last.
+    PARAMETERS  :   ByteBuffer* buffer - The buffer
+                    uint32_t value - The number
+    RETURNS     :   void
+*/
+static void put_varint(ByteBuffer* buffer, uint32_t value)
+{
+    grow((void**)&buffer->data, &buffer->capacity, buffer->length + 5, 1);
+    while (value >= 0x80)
+    {
+        buffer->data[buffer->length++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    buffer->data[buffer->length++] = (uint8_t)value;
+}
+
+/*
+    FUNCTION    :   encode_postings
+    DESCRIPTION :   Appends a posting list as the gaps between its document numbers.
+    PARAMETERS  :   ByteBuffer* buffer - The buffer
+                    const uint32_t* documents - The documents, ascending
+                    uint32_t count - How many
+    RETURNS     :   void
+*/
+static void encode_postings(ByteBuffer* buffer, const uint32_t* documents, uint32_t count)
+{
+    uint32_t previous = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        put_varint(buffer, documents[i] - previous);
+        previous = documents[i];
+    }
+}
+
+/*
+    FUNCTION    :   decode_postings
+    DESCRIPTION :   Reads back a posting list encode_postings wrote.
+    PARAMETERS  :   const uint8_t* data - Its first byte
+                    uint32_t count - Documents in it
+                    uint32_t* documents - Receives them, count of them
+    RETURNS     :   void
+*/
+static void decode_postings(const uint8_t* data, uint32_t count, uint32_t* documents)
+{
+    uint32_t previous = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t gap = 0;
+        int shift = 0;
+        while (*data & 0x80)
+        {
+            gap |= (uint32_t)(*data++ & 0x7f) << shift;
+            shift += 7;
+        }
+        gap |= (uint32_t)*data++ << shift;
+        previous += gap;
+        documents[i] = previous;
+    }
+}
+
+/*
+    FUNCTION    :   intersect
+    DESCRIPTION :   Keeps the candidates that are also in a second list. Both are ascending.
+    PARAMETERS  :   uint32_t* candidates - The candidates, narrowed in place
+                    size_t count - How many
+                    const uint32_t* documents - The other list
+                    size_t length - Its length
+    RETURNS     :   size_t - Candidates left
+*/
+static size_t intersect(uint32_t* candidates, size_t count, const uint32_t* documents, size_t length)
+{
+    size_t kept = 0;
+    size_t j = 0;
+    for (size_t i = 0; i < count && j < length; i++)
+    {
+        while (j < length && documents[j] < candidates[i])
+        {
+            j++;
+        }
+        if (j < length && documents[j] == candidates[i])
+        {
+            candidates[kept++] = candidates[i];
+        }
+    }
+    return kept;
+}
+
+/*
+    FUNCTION    :   hash_term
+    DESCRIPTION :   FNV-1a hash of a term, for the open segment's table.
+    PARAMETERS  :   const char* text - The term
+    RETURNS     :   uint32_t - The hash
+*/
+static uint32_t hash_term(const char* text)
+{
+    uint32_t hash = 2166136261u;
+    for (; *text != '\0'; text++)
+    {
+        hash = (hash ^ (unsigned char)*text) * 16777619u;
+    }
+    return hash;
+}
+
+/*
+    FUNCTION    :   find_open_term
+    DESCRIPTION :   Finds a term's place in the open segment's table. Caller holds openMutex.
+    PARAMETERS  :   const char* text - The term
+    RETURNS     :   OpenTerm* - Its entry, or the empty one it would take; NULL while the table is empty
+*/
+static OpenTerm* find_open_term(const char* text)
+{
+    if (openCapacity == 0)
+    {
+        return NULL;
+    }
+    for (uint32_t slot = hash_term(text) & (openCapacity - 1); ; slot = (slot + 1) & (openCapacity - 1))
+    {
+        if (openTerms[slot].text[0] == '\0' || strcmp(openTerms[slot].text, text) == 0)
+        {
+            return &openTerms[slot];
+        }
+    }
+}
+
+/*
+    FUNCTION    :   grow_open_terms
+    DESCRIPTION :   Doubles the open segment's table, keeping it at most half full. Caller holds openMutex.
+    PARAMETERS  :   none
+    RETURNS     :   void
+*/
+static void grow_open_terms(void)
+{
+    OpenTerm* old = openTerms;
+    uint32_t oldCapacity = openCapacity;
+    openCapacity = oldCapacity == 0 ? 4096 : oldCapacity * 2;
+    openTerms = calloc(openCapacity, sizeof(*openTerms));
+    if (openTerms == NULL)
+    {
+        perror("calloc failed");
+        exit(EXIT_FAILURE);
+    }
+    for (uint32_t i = 0; i < oldCapacity; i++)
+    {
+        if (old[i].text[0] != '\0')
+        {
+            *find_open_term(old[i].text) = old[i];
+        }
+    }
+    free(old);
+}
+
+/*
+    FUNCTION    :   add_posting
+    DESCRIPTION :   Records that a document contains a term. Caller holds openMutex.
+    PARAMETERS  :   const char* text - The term
+                    uint32_t document - The document, never lower than the last one added
+    RETURNS     :   void
+*/
+static void add_posting(const char* text, uint32_t document)
+{
+    if ((openTermCount + 1) * 2 > openCapacity)
+    {
+        grow_open_terms();
+    }
+    OpenTerm* term = find_open_term(text);
+    if (term->text[0] == '\0')
+    {
+        strcpy(term->text, text);
+        openTermCount++;
+    }
+    if (term->count > 0 && term->documents[term->count - 1] == document)
+    {
+        return; // the word came up before in the same message
+    }
+    size_t capacity = term->capacity;
+    grow((void**)&term->documents, &capacity, term->count + 1, sizeof(*term->documents));
+    term->capacity = (uint32_t)capacity;
+    term->documents[term->count++] = document;
+}
+
+/*
+    FUNCTION    :   new_list
+    DESCRIPTION :   Allocates a segment list holding one reference for being current.
+    PARAMETERS  :   int count - Segments in it
+    RETURNS     :   SegmentList* - The list, its segments still to be filled in
+*/
+static SegmentList* new_list(int count)
+{
+    SegmentList* list = malloc(sizeof(*list) + count * sizeof(Segment*));
+    if (list == NULL)
+    {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    atomic_init(&list->references, 1);
+    list->count = count;
+    return list;
+}
+
+/*
+    FUNCTION    :   release_segment
+    DESCRIPTION :   Drops a reference to a segment, freeing it with the last one.
+    PARAMETERS  :   Segment* segment - The segment
+    RETURNS     :   void
+*/
+static void release_segment(Segment* segment)
+{
+    if (atomic_fetch_sub(&segment->references, 1) == 1)
+    {
+        free(segment->terms);
+        free(segment->postings);
+        free(segment);
+    }
+}
+
+/*
+    FUNCTION    :   release_list
+    DESCRIPTION :   Drops a reference to a segment list, freeing it and its references to segments with
+                    the last one.
+    PARAMETERS  :   SegmentList* list - The list, NULL is ignored
+    RETURNS     :   void
+*/
+static void release_list(SegmentList* list)
+{
+    if (list != NULL && atomic_fetch_sub(&list->references, 1) == 1)
+    {
+        for (int i = 0; i < list->count; i++)
+        {
+            release_segment(list->segments[i]);
+        }
+        free(list);
+    }
+}
+
+/*
+    FUNCTION    :   publish_list
+    DESCRIPTION :   Makes a list the current one, taking a reference to each of its segments. Queries
+                    still using the old one keep it until they are done. Caller holds listMutex.
+    PARAMETERS  :   SegmentList* list - The new list
+    RETURNS     :   void
+*/
+static void publish_list(SegmentList* list)
+{
+    for (int i = 0; i < list->count; i++)
+    {
+        atomic_fetch_add(&list->segments[i]->references, 1);
+    }
+    SegmentList* old = currentList;
+    currentList = list;
+    release_list(old);
+}
+
+/*
+    FUNCTION    :   compare_open_terms
+    DESCRIPTION :   qsort comparison of pointers to open terms by their text.
+    PARAMETERS  :   const void* left, const void* right - The pointers
+    RETURNS     :   int - As strcmp
+*/
+static int compare_open_terms(const void* left, const void* right)
+{
+    return strcmp((*(OpenTerm* const*)left)->text, (*(OpenTerm* const*)right)->text);
+}
+
+/*
+    FUNCTION    :   find_sealed_term
+    DESCRIPTION :   Looks a term up in a sealed segment by binary search.
+    PARAMETERS  :   const Segment* segment - The segment
+                    const char* text - The term
+    RETURNS     :   const SealedTerm* - Its entry, NULL if no document of the segment contains it
+*/
+static const SealedTerm* find_sealed_term(const Segment* segment, const char* text)
+{
+    uint32_t low = 0;
+    uint32_t high = segment->termCount;
+    while (low < high)
+    {
+        uint32_t middle = low + (high - low) / 2;
+        int order = strcmp(segment->terms[middle].text, text);
+        if (order == 0)
+        {
+            return &segment->terms[middle];
+        }
+        if (order < 0)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return NULL;
+}
+
+/*
+    FUNCTION    :   new_segment
+    DESCRIPTION :   Allocates a sealed segment with room for its terms.
+    PARAMETERS  :   uint32_t termCount - Terms it will hold at most
+                    int level - Merges it went through
+    RETURNS     :   Segment* - The segment, holding no reference yet
+*/
+static Segment* new_segment(uint32_t termCount, int level)
+{
+    Segment* segment = calloc(1, sizeof(*segment));
+    if (segment == NULL || (segment->terms = malloc((termCount + 1) * sizeof(SealedTerm))) == NULL)
+    {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    segment->level = level;
+    return segment;
+}
+
+/*
+    FUNCTION    :   add_sealed_term
+    DESCRIPTION :   Appends a term and its postings to a segment being built, in term order.
+    PARAMETERS  :   Segment* segment - The segment
+                    ByteBuffer* postings - Its posting bytes so far
+                    const char* text - The term
+                    const uint32_t* documents - Its documents, ascending
+                    uint32_t count - How many
+    RETURNS     :   void
+*/
+static void add_sealed_term(Segment* segment, ByteBuffer* postings, const char* text, const uint32_t* documents, uint32_t count)
+{
+    SealedTerm* sealed = &segment->terms[segment->termCount++];
+    strcpy(sealed->text, text);
+    sealed->count = count;
+    sealed->offset = postings->length;
+    encode_postings(postings, documents, count);
+    sealed->bytes = (uint32_t)(postings->length - sealed->offset);
+}
+
+/*
+    FUNCTION    :   append_segment
+    DESCRIPTION :   Publishes a segment list with one more sealed segment and wakes the merger.
+    PARAMETERS  :   Segment* segment - The new newest segment
+    RETURNS     :   void
+*/
+static void append_segment(Segment* segment)
+{
+    pthread_mutex_lock(&listMutex);
+    int count = currentList == NULL ? 0 : currentList->count;
+    SegmentList* list = new_list(count + 1);
+    for (int i = 0; i < count; i++)
+    {
+        list->segments[i] = currentList->segments[i];
+    }
+    list->segments[count] = segment;
+    publish_list(list);
+    pthread_cond_signal(&mergeWanted);
+    pthread_mutex_unlock(&listMutex);
+}
+
+/*
+    FUNCTION    :   seal_open_segment
+    DESCRIPTION :   Turns the open segment into a sealed one and empties it. Caller holds openMutex, so
+                    that a query sees every document either in the open segment or in a sealed one.
+    PARAMETERS  :   none
+    RETURNS     :   void
+*/
+static void seal_open_segment(void)
+{
+    OpenTerm** sorted = malloc((openTermCount + 1) * sizeof(*sorted));
+    if (sorted == NULL)
+    {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < openCapacity; i++)
+    {
+        if (openTerms[i].text[0] != '\0')
+        {
+            sorted[count++] = &openTerms[i];
+        }
+    }
+    qsort(sorted, count, sizeof(*sorted), compare_open_terms);
+
+    Segment* segment = new_segment(count, 0);
+    ByteBuffer postings = { 0 };
+    for (uint32_t i = 0; i < count; i++)
+    {
+        add_sealed_term(segment, &postings, sorted[i]->text, sorted[i]->documents, sorted[i]->count);
+        free(sorted[i]->documents);
+    }
+    segment->postings = postings.data;
+    free(sorted);
+
+    memset(openTerms, 0, openCapacity * sizeof(*openTerms));
+    openTermCount = 0;
+    openDocuments = 0;
+    append_segment(segment);
+}
+
+/*
+    FUNCTION    :   index_document
+    DESCRIPTION :   Numbers a message, notes where the log holds it and adds the words of its body to
+                    the open segment, sealing the segment once it is full. Caller holds openMutex.
+    PARAMETERS  :   const char* serialized - The message as broadcast
+                    uint64_t offset - Where its record starts in the log
+    RETURNS     :   void
+*/
+static void index_document(const char* serialized, uint64_t offset)
+{
+    uint32_t document = documentCount;
+    uint32_t chunk = document / SEARCH_DOCUMENT_CHUNK;
+    if (chunk >= SEARCH_MAX_DOCUMENT_CHUNKS)
+    {
+        return; // numbers ran out, the log still keeps the message
+    }
+    if (documentOffsets[chunk] == NULL && (documentOffsets[chunk] = malloc(SEARCH_DOCUMENT_CHUNK * sizeof(uint64_t))) == NULL)
+    {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    documentOffsets[chunk][document % SEARCH_DOCUMENT_CHUNK] = offset;
+    documentCount++;
+
+    // The body follows the sender's address and name
+    const char* body = strchr(serialized, '|');
+    body = body == NULL ? NULL : strchr(body + 1, '|');
+    char term[SEARCH_MAX_TERM_LENGTH];
+    for (const char* cursor = body == NULL ? "" : body + 1; next_term(&cursor, term); )
+    {
+        add_posting(term, document);
+    }
+    if (++openDocuments == SEARCH_SEGMENT_DOCUMENTS)
+    {
+        seal_open_segment();
+    }
+}
+
+/*
+    FUNCTION    :   catch_up
+    DESCRIPTION :   Indexes the records in the log past those indexed already: the whole log on
+                    startup, and what another server process appended during a hot restart. A torn
+                    record at the end, left by a crash, is cut off. Caller holds the flock.
+    PARAMETERS  :   none
+    RETURNS     :   void
+*/
+static void catch_up(void)
+{
+    static char buffer[1 << 20];
+    char serialized[MAX_SERIALIZED_LENGTH];
+    off_t end = lseek(logFile, 0, SEEK_END);
+    bool torn = false;
+
+    while ((off_t)indexedBytes < end)
+    {
+        ssize_t got = pread(logFile, buffer, sizeof(buffer), indexedBytes);
+        if (got <= 0)
+        {
+            break;
+        }
+        size_t used = 0;
+        pthread_mutex_lock(&openMutex);
+        while (used + sizeof(SearchRecord) <= (size_t)got)
+        {
+            SearchRecord record;
+            memcpy(&record, buffer + used, sizeof(record));
+            if (record.magic != SEARCH_RECORD_MAGIC || record.length >= MAX_SERIALIZED_LENGTH)
+            {
+                torn = true;
+                break;
+            }
+            if (used + sizeof(record) + record.length > (size_t)got)
+            {
+                break; // continues in the next read
+            }
+            memcpy(serialized, buffer + used + sizeof(record), record.length);
+            serialized[record.length] = '\0';
+            index_document(serialized, indexedBytes + used);
+            used += sizeof(record) + record.length;
+        }
+        pthread_mutex_unlock(&openMutex);
+        indexedBytes += used;
+        if (torn || used == 0)
+        {
+            break;
+        }
+    }
+    if ((off_t)indexedBytes < end && ftruncate(logFile, indexedBytes) != 0)
+    {
+        perror("search log");
+    }
+}
+
+/*
+    FUNCTION    :   search_indexer
+    DESCRIPTION :   Indexer thread. Indexes the log, then appends whatever the broadcaster handed it
+                    since its last round with one write and adds it to the open segment.
+    PARAMETERS  :   void* arg - Unused
+    RETURNS     :   void* - NULL
+*/
+static void* search_indexer(void* arg)
+{
+    (void)arg;
+    flock(logFile, LOCK_EX);
+    catch_up();
+    flock(logFile, LOCK_UN);
+    while (true)
+    {
+        pthread_mutex_lock(&pendingMutex);
+        while (pendingFront == NULL && !indexerStopping)
+        {
+            pthread_cond_wait(&pendingArrived, &pendingMutex);
+        }
+        PendingSearch* batch = pendingFront;
+        if (batch == NULL)
+        {
+            pthread_mutex_unlock(&pendingMutex);
+            break;
+        }
+        pendingFront = pendingRear = NULL;
+        pendingCount = 0;
+        pthread_mutex_unlock(&pendingMutex);
+
+        size_t length = 0;
+        for (PendingSearch* pending = batch; pending != NULL; pending = pending->next)
+        {
+            length += sizeof(SearchRecord) + pending->length;
+        }
+        char* records = malloc(length);
+        if (records == NULL)
+        {
+            perror("malloc failed");
+            exit(EXIT_FAILURE);
+        }
+        size_t offset = 0;
+        for (PendingSearch* pending = batch; pending != NULL; pending = pending->next)
+        {
+            SearchRecord record = { SEARCH_RECORD_MAGIC, pending->length };
+            memcpy(records + offset, &record, sizeof(record));
+            memcpy(records + offset + sizeof(record), pending->serialized, pending->length);
+            offset += sizeof(record) + pending->length;
+        }
+
+        flock(logFile, LOCK_EX);
+        catch_up(); // afterwards the end of the log is where this batch goes
+        uint64_t start = indexedBytes;
+        if (pwrite(logFile, records, length, start) == (ssize_t)length)
+        {
+            offset = start;
+            pthread_mutex_lock(&openMutex);
+            for (PendingSearch* pending = batch; pending != NULL; pending = pending->next)
+            {
+                index_document(pending->serialized, offset);
+                offset += sizeof(SearchRecord) + pending->length;
+            }
+            pthread_mutex_unlock(&openMutex);
+            indexedBytes += length;
+        }
+        else
+        {
+            perror("search log");
+            if (ftruncate(logFile, start) != 0)
+            {
+                perror("search log");
+            }
+        }
+        flock(logFile, LOCK_UN);
+
+        free(records);
+        while (batch != NULL)
+        {
+            PendingSearch* next = batch->next;
+            free(batch);
+            batch = next;
+        }
+    }
+    return NULL;
+}
+
+/*
+    FUNCTION    :   mergeable_run
+    DESCRIPTION :   Finds SEARCH_MERGE_FACTOR neighbouring segments of one level. Caller holds listMutex.
+    PARAMETERS  :   const SegmentList* list - The current list
+    RETURNS     :   int - Index of the first of them, -1 if there are none
+*/
+static int mergeable_run(const SegmentList* list)
+{
+    for (int first = 0; list != NULL && first < list->count; )
+    {
+        int last = first;
+        while (last < list->count && list->segments[last]->level == list->segments[first]->level)
+        {
+            last++;
+        }
+        if (last - first >= SEARCH_MERGE_FACTOR)
+        {
+            return first;
+        }
+        first = last;
+    }
+    return -1;
+}
+
+/*
+    FUNCTION    :   merge_segments
+    DESCRIPTION :   Builds one segment holding the postings of neighbouring segments. Their documents
+                    do not overlap and are ascending from the first to the last, so each term's merged
+                    list is its lists one after another.
+    PARAMETERS  :   Segment** run - The segments, oldest first
+                    int count - How many
+    RETURNS     :   Segment* - The merged segment
+*/
+static Segment* merge_segments(Segment** run, int count)
+{
+    uint32_t termCount = 0;
+    uint32_t* next = calloc(count, sizeof(*next)); // every segment's next term, they are walked side by side
+    if (next == NULL)
+    {
+        perror("calloc failed");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < count; i++)
+    {
+        termCount += run[i]->termCount;
+    }
+
+    Segment* merged = new_segment(termCount, run[0]->level + 1);
+    ByteBuffer postings = { 0 };
+    DocumentList documents = { 0 };
+    while (true)
+    {
+        const char* lowest = NULL;
+        for (int i = 0; i < count; i++)
+        {
+            if (next[i] < run[i]->termCount && (lowest == NULL || strcmp(run[i]->terms[next[i]].text, lowest) < 0))
+            {
+                lowest = run[i]->terms[next[i]].text;
+            }
+        }
+        if (lowest == NULL)
+        {
+            break;
+        }
+        char text[SEARCH_MAX_TERM_LENGTH];
+        strcpy(text, lowest);
+        documents.count = 0;
+        for (int i = 0; i < count; i++)
+        {
+            const SealedTerm* term = next[i] < run[i]->termCount ? &run[i]->terms[next[i]] : NULL;
+            if (term != NULL && strcmp(term->text, text) == 0)
+            {
+                grow((void**)&documents.documents, &documents.capacity, documents.count + term->count, sizeof(uint32_t));
+                decode_postings(run[i]->postings + term->offset, term->count, documents.documents + documents.count);
+                documents.count += term->count;
+                next[i]++;
+            }
+        }
+        add_sealed_term(merged, &postings, text, documents.documents, (uint32_t)documents.count);
+    }
+    merged->postings = postings.data;
+    free(documents.documents);
+    free(next);
+    return merged;
+}
+
+/*
+    FUNCTION    :   search_merger
+    DESCRIPTION :   Merger thread. Whenever SEARCH_MERGE_FACTOR neighbouring segments are of one level
+                    it merges them outside any lock and swaps the result in for them; queries that
+                    started before keep the segments they use until they are done.
+    PARAMETERS  :   void* arg - Unused
+    RETURNS     :   void* - NULL
+*/
+static void* search_merger(void* arg)
+{
+    (void)arg;
+    Segment* run[SEARCH_MERGE_FACTOR];
+    while (true)
+    {
+        pthread_mutex_lock(&listMutex);
+        int first;
+        while ((first = mergeable_run(currentList)) < 0 && !mergerStopping)
+        {
+            pthread_cond_wait(&mergeWanted, &listMutex);
+        }
+        if (first < 0 || mergerStopping)
+        {
+            pthread_mutex_unlock(&listMutex);
+            break;
+        }
+        for (int i = 0; i < SEARCH_MERGE_FACTOR; i++)
+        {
+            run[i] = currentList->segments[first + i];
+            atomic_fetch_add(&run[i]->references, 1);
+        }
+        pthread_mutex_unlock(&listMutex);
+
+        Segment* merged = merge_segments(run, SEARCH_MERGE_FACTOR);
+
+        // Only this thread removes segments, so the run is still where it was
+        pthread_mutex_lock(&listMutex);
+        SegmentList* list = new_list(currentList->count - SEARCH_MERGE_FACTOR + 1);
+        for (int i = 0, kept = 0; i < currentList->count; i++)
+        {
+            if (i == first)
+            {
+                list->segments[kept++] = merged;
+            }
+            else if (i < first || i >= first + SEARCH_MERGE_FACTOR)
+            {
+                list->segments[kept++] = currentList->segments[i];
+            }
+        }
+        publish_list(list);
+        pthread_mutex_unlock(&listMutex);
+        for (int i = 0; i < SEARCH_MERGE_FACTOR; i++)
+        {
+            release_segment(run[i]);
+        }
+    }
+    return NULL;
+}
+
+/*
+    FUNCTION    :   match_open
+    DESCRIPTION :   Finds the documents of the open segment that contain every term. Caller holds openMutex.
+    PARAMETERS  :   char terms[][SEARCH_MAX_TERM_LENGTH] - The terms
+                    int termCount - How many
+                    DocumentList* matches - Receives the documents, ascending
+    RETURNS     :   void
+*/
+static void match_open(char terms[][SEARCH_MAX_TERM_LENGTH], int termCount, DocumentList* matches)
+{
+    const OpenTerm* found[SEARCH_MAX_QUERY_TERMS];
+    int shortest = 0;
+    for (int i = 0; i < termCount; i++)
+    {
+        found[i] = find_open_term(terms[i]);
+        if (found[i] == NULL || found[i]->text[0] == '\0')
+        {
+            return;
+        }
+        if (found[i]->count < found[shortest]->count)
+        {
+            shortest = i;
+        }
+    }
+    size_t first = matches->count;
+    grow((void**)&matches->documents, &matches->capacity, first + found[shortest]->count, sizeof(uint32_t));
+    memcpy(matches->documents + first, found[shortest]->documents, found[shortest]->count * sizeof(uint32_t));
+    size_t count = found[shortest]->count;
+    for (int i = 0; i < termCount && count > 0; i++)
+    {
+        if (i != shortest)
+        {
+            count = intersect(matches->documents + first, count, found[i]->documents, found[i]->count);
+        }
+    }
+    matches->count = first + count;
+}
+
+/*
+    FUNCTION    :   match_segment
+    DESCRIPTION :   Finds the documents of a sealed segment that contain every term. Only the posting
+                    lists of the query's terms are decoded.
+    PARAMETERS  :   const Segment* segment - The segment
+                    char terms[][SEARCH_MAX_TERM_LENGTH] - The terms
+                    int termCount - How many
+                    DocumentList* matches - Receives the documents, ascending
+                    DocumentList* scratch - Room to decode into
+    RETURNS     :   void
+*/
+static void match_segment(const Segment* segment, char terms[][SEARCH_MAX_TERM_LENGTH], int termCount,
+                          DocumentList* matches, DocumentList* scratch)
+{
+    const SealedTerm* found[SEARCH_MAX_QUERY_TERMS];
+    int shortest = 0;
+    for (int i = 0; i < termCount; i++)
+    {
+        found[i] = find_sealed_term(segment, terms[i]);
+        if (found[i] == NULL)
+        {
+            return;
+        }
+        if (found[i]->count < found[shortest]->count)
+        {
+            shortest = i;
+        }
+    }
+    size_t first = matches->count;
+    grow((void**)&matches->documents, &matches->capacity, first + found[shortest]->count, sizeof(uint32_t));
+    decode_postings(segment->postings + found[shortest]->offset, found[shortest]->count, matches->documents + first);
+    size_t count = found[shortest]->count;
+    for (int i = 0; i < termCount && count > 0; i++)
+    {
+        if (i != shortest)
+        {
+            grow((void**)&scratch->documents, &scratch->capacity, found[i]->count, sizeof(uint32_t));
+            decode_postings(segment->postings + found[i]->offset, found[i]->count, scratch->documents);
+            count = intersect(matches->documents + first, count, scratch->documents, found[i]->count);
+        }
+    }
+    matches->count = first + count;
+}
+
+/*
+    FUNCTION    :   read_document
+    DESCRIPTION :   Reads a matching message back from the log.
+    PARAMETERS  :   uint32_t document - Its number
+                    char* serialized - Receives the message, MAX_SERIALIZED_LENGTH bytes
+    RETURNS     :   bool - false if the log could not be read
+*/
+static bool read_document(uint32_t document, char* serialized)
+{
+    uint64_t offset = documentOffsets[document / SEARCH_DOCUMENT_CHUNK][document % SEARCH_DOCUMENT_CHUNK];
+    SearchRecord record;
+    if (pread(logFile, &record, sizeof(record), offset) != sizeof(record) || record.magic != SEARCH_RECORD_MAGIC ||
+        record.length >= MAX_SERIALIZED_LENGTH ||
+        pread(logFile, serialized, record.length, offset + sizeof(record)) != (ssize_t)record.length)
+    {
+        return false;
+    }
+    serialized[record.length] = '\0';
+    return true;
+}
+
+/*
+    FUNCTION    :   search_init
+    DESCRIPTION :   Opens the -search log and starts the indexer, which indexes what it already holds,
+                    and the merger. Without -search nothing is kept.
+    PARAMETERS  :   const ServerConfig* config - The parsed command line
+    RETURNS     :   bool - false if the log cannot be used
+*/
+bool search_init(const ServerConfig* config)
+{
+    if (config->searchPath == NULL)
+    {
+        return true;
+    }
+    logFile = open(config->searchPath, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (logFile < 0)
+    {
+        perror("search");
+        return false;
+    }
+    searchPath = config->searchPath;
+    if (pthread_create(&indexerThread, NULL, search_indexer, NULL) != 0 ||
+        pthread_create(&mergerThread, NULL, search_merger, NULL) != 0)
+    {
+        perror("pthread_create");
+        exit(EXIT_FAILURE);
+    }
+    return true;
+}
+
+/*
+    FUNCTION    :   search_store
+    DESCRIPTION :   Hands a broadcast to the indexer. Called by the broadcaster, so it only copies the
+                    message; when the indexer cannot keep up the message is dropped rather than held.
+    PARAMETERS  :   const char* serializedMessage - The message as broadcast
+    RETURNS     :   void
+*/
+void search_store(const char* serializedMessage)
+{
+    if (searchPath == NULL)
+    {
+        return;
+    }
+    size_t length = strlen(serializedMessage);
+    PendingSearch* pending = malloc(sizeof(*pending) + length + 1);
+    if (pending == NULL)
+    {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    pending->next = NULL;
+    pending->length = (uint32_t)length;
+    memcpy(pending->serialized, serializedMessage, length + 1);
+
+    pthread_mutex_lock(&pendingMutex);
+    if (pendingCount >= SEARCH_MAX_PENDING)
+    {
+        pthread_mutex_unlock(&pendingMutex);
+        free(pending);
+        atomic_fetch_add(&serverStats.searchDropped, 1);
+        return;
+    }
+    if (pendingRear == NULL)
+    {
+        pendingFront = pending;
+    }
+    else
+    {
+        pendingRear->next = pending;
+    }
+    pendingRear = pending;
+    pendingCount++;
+    pthread_cond_signal(&pendingArrived);
+    pthread_mutex_unlock(&pendingMutex);
+}
+
+/*
+    FUNCTION    :   search_answer
+    DESCRIPTION :   Answers a >>search<< with one page of the messages containing all its words, the
+                    newest page first and each page oldest first, then a summary. Runs in the asking
+                    client's handler, so neither the broadcaster nor the indexer waits for it beyond
+                    the look at the open segment.
+    PARAMETERS  :   int sock - The client socket
+                    int slot - Its registry slot
+                    const char* request - The request after its prefix, "<page> <words>..."
+    RETURNS     :   void
+*/
+void search_answer(int sock, int slot, const char* request)
+{
+    if (searchPath == NULL)
+    {
+        send_server_control(sock, SEARCH_UNAVAILABLE);
+        return;
+    }
+    char* words = NULL;
+    long page = strtol(request, &words, 10);
+    char terms[SEARCH_MAX_QUERY_TERMS][SEARCH_MAX_TERM_LENGTH];
+    int termCount = 0;
+    while (termCount < SEARCH_MAX_QUERY_TERMS && next_term((const char**)&words, terms[termCount]))
+    {
+        termCount++;
+    }
+
+    DocumentList matches = { 0 };
+    DocumentList scratch = { 0 };
+    if (termCount > 0)
+    {
+        // The open segment and the list are taken together, so a segment sealed meanwhile is seen once
+        pthread_mutex_lock(&openMutex);
+        pthread_mutex_lock(&listMutex);
+        SegmentList* list = currentList;
+        if (list != NULL)
+        {
+            atomic_fetch_add(&list->references, 1);
+        }
+        pthread_mutex_unlock(&listMutex);
+        DocumentList open = { 0 };
+        match_open(terms, termCount, &open);
+        pthread_mutex_unlock(&openMutex);
+
+        for (int i = 0; list != NULL && i < list->count; i++)
+        {
+            match_segment(list->segments[i], terms, termCount, &matches, &scratch);
+        }
+        release_list(list);
+        grow((void**)&matches.documents, &matches.capacity, matches.count + open.count, sizeof(uint32_t));
+        memcpy(matches.documents + matches.count, open.documents, open.count * sizeof(uint32_t));
+        matches.count += open.count;
+        free(open.documents);
+    }
+
+    long pages = (long)((matches.count + SEARCH_PAGE_SIZE - 1) / SEARCH_PAGE_SIZE);
+    page = page < 1 ? 1 : page;
+    long last = (long)matches.count - (page - 1) * SEARCH_PAGE_SIZE;  // one past the page's newest match
+    long first = last - SEARCH_PAGE_SIZE < 0 ? 0 : last - SEARCH_PAGE_SIZE;
+    char found[SEARCH_PAGE_SIZE][MAX_SERIALIZED_LENGTH + sizeof(SEARCH_RESULT_PREFIX)];
+    int foundCount = 0;
+    char serialized[MAX_SERIALIZED_LENGTH];
+    for (long i = first; i < last; i++)
+    {
+        if (read_document(matches.documents[i], serialized))
+        {
+            snprintf(found[foundCount++], sizeof(found[0]), SEARCH_RESULT_PREFIX "%s", serialized);
+        }
+    }
+    char summary[64];
+    snprintf(summary, sizeof(summary), SEARCH_SUMMARY_PREFIX "%ld %ld %zu", page, pages, matches.count);
+    free(matches.documents);
+    free(scratch.documents);
+
+    int reader;
+    const ClientSnapshot* snapshot = client_snapshot_enter(&reader);
+    if (client_snapshot_contains(snapshot, slot, sock))
+    {
+        // Corked, the page leaves in full segments instead of one frame per round trip behind Nagle's algorithm
+        int cork = 1;
+        pthread_mutex_lock(&clientWritesMutex);
+        setsockopt(sock, IPPROTO_TCP, TCP_CORK, &cork, sizeof(cork));
+        for (int i = 0; i < foundCount; i++)
+        {
+            write_server_control(sock, found[i]);
+        }
+        write_server_control(sock, summary);
+        cork = 0;
+        setsockopt(sock, IPPROTO_TCP, TCP_CORK, &cork, sizeof(cork));
+        pthread_mutex_unlock(&clientWritesMutex);
+    }
+    client_snapshot_exit(reader);
+    atomic_fetch_add(&serverStats.searchesAnswered, 1);
+}
+
+/*
+    FUNCTION    :   search_stop
+    DESCRIPTION :   Waits for the indexer to log what the broadcaster left it, then stops the merger.
+                    Called once the broadcaster stopped.
+    PARAMETERS  :   none
+    RETURNS     :   void
+*/
+void search_stop(void)
+{
+    if (searchPath == NULL)
+    {
+        return;
+    }
+    pthread_mutex_lock(&pendingMutex);
+    indexerStopping = true;
+    pthread_cond_signal(&pendingArrived);
+    pthread_mutex_unlock(&pendingMutex);
+    pthread_join(indexerThread, NULL);
+
+    pthread_mutex_lock(&listMutex);
+    mergerStopping = true;
+    pthread_cond_signal(&mergeWanted);
+    pthread_mutex_unlock(&listMutex);
+    pthread_join(mergerThread, NULL);
+}
@@ -0,0 +1,278 @@
+/*
+* FILE              :   server-config.c
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This file contains the command line parsing for the chat-server. Options follow
+                        the same -option<VALUE> convention as the chat-client.
+*/
+
+#include "../inc/server-config.h"
+#include "../inc/client-manager.h"
+#include "../inc/keepalive.h"
+#include "../inc/multicast-publisher.h"
+#include "../inc/overload.h"
+#include "../inc/memory-budget.h"
+#include "../inc/offline-mailbox.h"
+#include "../inc/fair-ingest.h"
+#include "../inc/hibernation.h"
+#include "../inc/presence-service.h"
+#include "../inc/write-ahead-log.h"
+#include "../inc/broadcast-tap.h"
+#include "../inc/spam-filter.h"
+
+/*
+    FUNCTION    :   display_server_usage
+    DESCRIPTION :   Displays the usage of the server program
+    PARAMETERS  :   none
+    RETURNS     :   void
+*/
+static void display_server_usage(void)
+{
+    printf("Usage: chat-server [-takeover] [-handoff<PATH>] [-backlog<N>] [-maxclients<N>] [-acceptrate<N>] [-acceptburst<N>] [-heartbeat<S>] [-idletimeout<S>] [-tlscert<PATH> -tlskey<PATH>] [-tlsport<N>] [-unix<PATH> | -nounix] [-latency [-spin<US>] [-busypoll<US>]] [-cpus<LIST>] [-multicast<GROUP> [-mcastport<N>] [-mcastif<ADDR>] [-mcastttl<N>]] [-codeltarget<MS>] [-codelinterval<MS>] [-maxqueue<N>] [-connsoft<KB>] [-connhard<KB>] [-memsoft<MB>] [-memhard<MB>] [-blocklist<PATH>] [-mailbox<DIR> [-mailboxquota<KB>] [-mailboxexpiry<H>]] [-weight<N>] [-weights<LIST>] [-hibernate<S>] [-presencewindow<MS>] [-search<PATH>] [-wal<PATH> [-durability<LEVEL>] [-commitinterval<US>]] [-tap<NAME> [-tapslots<N>]] [-spamrepeats<N> [-spamwindow<S>]]\n");
+    printf("  -takeover        inherit the listening socket and clients of the running server\n");
+    printf("  -handoff<PATH>   unix socket used for hot restart (default %s)\n", DEFAULT_HANDOFF_PATH);
+    printf("  -backlog<N>      listen backlog (default %d)\n", DEFAULT_LISTEN_BACKLOG);
+    printf("  -maxclients<N>   maximum connected clients (default %d)\n", MAX_CLIENTS);
+    printf("  -acceptrate<N>   connections per second admitted per source address, 0 = unlimited (default %d)\n", DEFAULT_ACCEPT_RATE);
+    printf("  -acceptburst<N>  connections a source address may open back to back (default %d)\n", DEFAULT_ACCEPT_BURST);
+    printf("  -heartbeat<S>    seconds of silence before a client is pinged, 0 = never (default %d)\n", DEFAULT_HEARTBEAT_SECONDS);
+    printf("  -idletimeout<S>  seconds of silence before a client is disconnected, 0 = never (default %d)\n", DEFAULT_IDLE_TIMEOUT_SECONDS);
+    printf("  -tlscert<PATH>   PEM certificate chain; with -tlskey also accept TLS connections\n");
+    printf("  -tlskey<PATH>    PEM private key of the certificate\n");
+    printf("  -tlsport<N>      port of the TLS listener (default %d)\n", DEFAULT_TLS_PORT);
+    printf("  -unix<PATH>      unix socket for clients on this host (default %s)\n", DEFAULT_UNIX_PATH);
+    printf("  -nounix          do not listen on a unix socket\n");
+    printf("  -latency         low latency profile: spin before blocking, busy poll sockets, disable Nagle\n");
+    printf("  -spin<US>        latency profile: microseconds a thread spins before it blocks (default %d)\n", DEFAULT_SPIN_MICROSECONDS);
+    printf("  -busypoll<US>    latency profile: SO_BUSY_POLL of client sockets, 0 = off (default %d)\n", DEFAULT_BUSY_POLL_MICROSECONDS);
+    printf("  -cpus<LIST>      pin the accept loop, the broadcaster and the connection handlers to these CPUs, e.g. 2,3,4\n");
+    printf("  -multicast<GROUP> publish broadcasts once to this IPv4 multicast group for clients that subscribe\n");
+    printf("  -mcastport<N>    UDP port of the multicast group (default %d)\n", DEFAULT_MULTICAST_PORT);
+    printf("  -mcastif<ADDR>   address of the interface to publish on, 127.0.0.1 for a single machine test\n");
+    printf("  -mcastttl<N>     hops a datagram may travel (default %d)\n", DEFAULT_MULTICAST_TTL);
+    printf("  -codeltarget<MS> queueing delay tolerated before heavy senders are slowed and messages shed (default %d)\n", DEFAULT_CODEL_TARGET_MILLISECONDS);
+    printf("  -codelinterval<MS> time the delay must stay above target before each escalation (default %d)\n", DEFAULT_CODEL_INTERVAL_MILLISECONDS);
+    printf("  -maxqueue<N>     queued messages before new ones are refused with >>busy<<, 0 = no limit (default %d)\n", DEFAULT_MAX_QUEUE);
+    printf("  -connsoft<KB>    memory a connection holds before it stops being read, 0 = no limit (default %d)\n", DEFAULT_CONNECTION_SOFT_KILOBYTES);
+    printf("  -connhard<KB>    memory a connection may never exceed, 0 = no limit (default %d)\n", DEFAULT_CONNECTION_HARD_KILOBYTES);
+    printf("  -memsoft<MB>     memory of all connections before the largest stop being read, 0 = no limit (default %d)\n", DEFAULT_MEMORY_SOFT_MEGABYTES);
+    printf("  -memhard<MB>     memory all connections together may never exceed, 0 = no limit (default %d)\n", DEFAULT_MEMORY_HARD_MEGABYTES);
+    printf("  -blocklist<PATH> drop messages containing any of the words in this file, one per line\n");
+    printf("  -mailbox<DIR>    keep the broadcasts an offline user misses in this directory\n");
+    printf("  -mailboxquota<KB> disk one user's mailbox may take, 0 = no limit (default %d)\n", DEFAULT_MAILBOX_QUOTA_KILOBYTES);
+    printf("  -mailboxexpiry<H> hours kept messages are delivered for, 0 = always (default %d)\n", DEFAULT_MAILBOX_EXPIRY_HOURS);
+    printf("  -weight<N>       share of the broadcaster a sender gets per round, 1 to %d (default %d)\n", MAX_SENDER_WEIGHT, DEFAULT_SENDER_WEIGHT);
+    printf("  -weights<LIST>   other shares for some users, e.g. alice=4,bob=2\n");
+    printf("  -hibernate<S>    seconds without a message before a connection gives up its thread, 0 = never (default %d)\n", DEFAULT_HIBERNATE_SECONDS);
+    printf("  -presencewindow<MS> roster changes collected into one update for the clients (default %d)\n", DEFAULT_PRESENCE_WINDOW_MILLISECONDS);
+    printf("  -search<PATH>    keep every broadcast in this file and let clients search it\n");
+    printf("  -wal<PATH>       log every accepted message in this file before it is queued, and queue the undelivered ones again on start\n");
+    printf("  -durability<LEVEL> when a logged message is acknowledged: write = handed to the OS, sync = on disk (default sync)\n");
+    printf("  -commitinterval<US> microseconds a logged message waits for others to share its commit (default %d)\n", DEFAULT_COMMIT_INTERVAL_MICROSECONDS);
+    printf("  -tap<NAME>       copy every broadcast into a shared memory ring of this name (e.g. /chat-tap) for local readers\n");
+    printf("  -tapslots<N>     messages the ring holds before a reader that fell behind loses the oldest (default %d)\n", DEFAULT_TAP_SLOTS);
+    printf("  -spamrepeats<N>  copies of the same line a sender may send per window, more are dropped, 0 = unlimited (default %d, at most %d)\n", DEFAULT_SPAM_REPEATS, SPAM_MAX_REPEATS);
+    printf("  -spamwindow<S>   seconds for which copies of a line are counted (default %d)\n", DEFAULT_SPAM_WINDOW_SECONDS);
+}
+
+/*
+    FUNCTION    :   parse_int_option
+    DESCRIPTION :   Parses an option of the form -name<N> into a non-negative integer.
+    PARAMETERS  :   const char* arg: The command line argument
+                    const char* name: The option name including the dash
+                    int* value: Receives the number
+    RETURNS     :   bool: true if the argument is this option with a valid number
+*/
+static bool parse_int_option(const char* arg, const char* name, int* value)
+{
+    size_t nameLength = strlen(name);
+    char* end;
+
+    if (strncmp(arg, name, nameLength) != 0 || arg[nameLength] == '\0')
+    {
+        return false;
+    }
+    long parsed = strtol(arg + nameLength, &end, 10);
+    if (*end != '\0' || parsed < 0 || parsed > INT_MAX)
+    {
+        return false;
+    }
+    *value = (int)parsed;
+    return true;
+}
+
+/*
+    FUNCTION    :   parse_string_option
+    DESCRIPTION :   Parses an option of the form -name<VALUE> into a pointer to its value.
+    PARAMETERS  :   const char* arg: The command line argument
+                    const char* name: The option name including the dash
+                    const char** value: Receives the value
+    RETURNS     :   bool: true if the argument is this option with a non-empty value
+*/
+static bool parse_string_option(const char* arg, const char* name, const char** value)
+{
+    size_t nameLength = strlen(name);
+
+    if (strncmp(arg, name, nameLength) != 0 || arg[nameLength] == '\0')
+    {
+        return false;
+    }
+    *value = arg + nameLength;
+    return true;
+}
+
+/*
+    FUNCTION    :   parse_server_args
+    DESCRIPTION :   Retrieves the command line arguments of the server and puts their values into
+                    the configuration struct. Unset options keep their defaults.
+    PARAMETERS  :   int argc: The number of arguments provided
+                    char* argv[]: The arguments
+                    ServerConfig* config: The struct to fill in
+    RETURNS     :   int: CONFIG_PARSING_SUCCESS or CONFIG_PARSING_ERROR
+*/
+int parse_server_args(int argc, char* argv[], ServerConfig* config)
+{
+    config->takeover = false;
+    config->handoffPath = DEFAULT_HANDOFF_PATH;
+    config->listenBacklog = DEFAULT_LISTEN_BACKLOG;
+    config->maxClients = MAX_CLIENTS;
+    config->acceptRate = DEFAULT_ACCEPT_RATE;
+    config->acceptBurst = DEFAULT_ACCEPT_BURST;
+    config->heartbeatSeconds = DEFAULT_HEARTBEAT_SECONDS;
+    config->idleTimeoutSeconds = DEFAULT_IDLE_TIMEOUT_SECONDS;
+    config->tlsCertFile = NULL;
+    config->tlsKeyFile = NULL;
+    config->tlsPort = DEFAULT_TLS_PORT;
+    config->unixPath = DEFAULT_UNIX_PATH;
+    config->latencyProfile = false;
+    config->spinMicroseconds = DEFAULT_SPIN_MICROSECONDS;
+    config->busyPollMicroseconds = DEFAULT_BUSY_POLL_MICROSECONDS;
+    config->cpuList = NULL;
+    config->multicastGroup = NULL;
+    config->multicastPort = DEFAULT_MULTICAST_PORT;
+    config->multicastInterface = NULL;
+    config->multicastTtl = DEFAULT_MULTICAST_TTL;
+    config->codelTargetMilliseconds = DEFAULT_CODEL_TARGET_MILLISECONDS;
+    config->codelIntervalMilliseconds = DEFAULT_CODEL_INTERVAL_MILLISECONDS;
+    config->maxQueue = DEFAULT_MAX_QUEUE;
+    config->connectionSoftKilobytes = DEFAULT_CONNECTION_SOFT_KILOBYTES;
+    config->connectionHardKilobytes = DEFAULT_CONNECTION_HARD_KILOBYTES;
+    config->memorySoftMegabytes = DEFAULT_MEMORY_SOFT_MEGABYTES;
+    config->memoryHardMegabytes = DEFAULT_MEMORY_HARD_MEGABYTES;
+    config->blocklistPath = NULL;
+    config->mailboxDirectory = NULL;
+    config->mailboxQuotaKilobytes = DEFAULT_MAILBOX_QUOTA_KILOBYTES;
+    config->mailboxExpiryHours = DEFAULT_MAILBOX_EXPIRY_HOURS;
+    config->senderWeight = DEFAULT_SENDER_WEIGHT;
+    config->senderWeights = NULL;
+    config->hibernateSeconds = DEFAULT_HIBERNATE_SECONDS;
+    config->presenceWindowMilliseconds = DEFAULT_PRESENCE_WINDOW_MILLISECONDS;
+    config->searchPath = NULL;
+    config->walPath = NULL;
+    config->walSync = true;
+    config->commitIntervalMicroseconds = DEFAULT_COMMIT_INTERVAL_MICROSECONDS;
+    config->tapName = NULL;
+    config->tapSlots = DEFAULT_TAP_SLOTS;
+    config->spamRepeats = DEFAULT_SPAM_REPEATS;
+    config->spamWindowSeconds = DEFAULT_SPAM_WINDOW_SECONDS;
+    const char* durability = NULL;
+
+    for (int counter = 1; counter < argc; counter++)
+    {
+        if (strcmp(argv[counter], "-takeover") == 0)
+        {
+            config->takeover = true;
+        }
+        else if (strcmp(argv[counter], "-nounix") == 0)
+        {
+            config->unixPath = NULL;
+        }
+        else if (strcmp(argv[counter], "-latency") == 0)
+        {
+            config->latencyProfile = true;
+        }
+        else if (parse_int_option(argv[counter], "-mailboxquota", &config->mailboxQuotaKilobytes) ||
+                 parse_int_option(argv[counter], "-mailboxexpiry", &config->mailboxExpiryHours) ||
+                 parse_int_option(argv[counter], "-tapslots", &config->tapSlots))
+        {
+            // value already stored by parse_int_option, tried before -mailbox and -tap which would take them for a name
+        }
+        else if (parse_string_option(argv[counter], "-handoff", &config->handoffPath) ||
+                 parse_string_option(argv[counter], "-tlscert", &config->tlsCertFile) ||
+                 parse_string_option(argv[counter], "-tlskey", &config->tlsKeyFile) ||
+                 parse_string_option(argv[counter], "-unix", &config->unixPath) ||
+                 parse_string_option(argv[counter], "-cpus", &config->cpuList) ||
+                 parse_string_option(argv[counter], "-multicast", &config->multicastGroup) ||
+                 parse_string_option(argv[counter], "-mcastif", &config->multicastInterface) ||
+                 parse_string_option(argv[counter], "-blocklist", &config->blocklistPath) ||
+                 parse_string_option(argv[counter], "-search", &config->searchPath) ||
+                 parse_string_option(argv[counter], "-wal", &config->walPath) ||
+                 parse_string_option(argv[counter], "-durability", &durability) ||
+                 parse_string_option(argv[counter], "-tap", &config->tapName) ||
+                 parse_string_option(argv[counter], "-mailbox", &config->mailboxDirectory) ||
+                 parse_string_option(argv[counter], "-weights", &config->senderWeights))
+        {
+            // value already stored by parse_string_option
+        }
+        else if (parse_int_option(argv[counter], "-backlog", &config->listenBacklog) ||
+                 parse_int_option(argv[counter], "-acceptrate", &config->acceptRate) ||
+                 parse_int_option(argv[counter], "-acceptburst", &config->acceptBurst) ||
+                 parse_int_option(argv[counter], "-heartbeat", &config->heartbeatSeconds) ||
+                 parse_int_option(argv[counter], "-idletimeout", &config->idleTimeoutSeconds) ||
+                 parse_int_option(argv[counter], "-tlsport", &config->tlsPort) ||
+                 parse_int_option(argv[counter], "-spin", &config->spinMicroseconds) ||
+                 parse_int_option(argv[counter], "-busypoll", &config->busyPollMicroseconds) ||
+                 parse_int_option(argv[counter], "-mcastport", &config->multicastPort) ||
+                 parse_int_option(argv[counter], "-mcastttl", &config->multicastTtl) ||
+                 parse_int_option(argv[counter], "-codeltarget", &config->codelTargetMilliseconds) ||
+                 parse_int_option(argv[counter], "-maxqueue", &config->maxQueue) ||
+                 parse_int_option(argv[counter], "-connsoft", &config->connectionSoftKilobytes) ||
+                 parse_int_option(argv[counter], "-connhard", &config->connectionHardKilobytes) ||
+                 parse_int_option(argv[counter], "-memsoft", &config->memorySoftMegabytes) ||
+                 parse_int_option(argv[counter], "-memhard", &config->memoryHardMegabytes) ||
+                 parse_int_option(argv[counter], "-hibernate", &config->hibernateSeconds) ||
+                 parse_int_option(argv[counter], "-presencewindow", &config->presenceWindowMilliseconds) ||
+                 parse_int_option(argv[counter], "-commitinterval", &config->commitIntervalMicroseconds) ||
+                 parse_int_option(argv[counter], "-spamrepeats", &config->spamRepeats) ||
+                 parse_int_option(argv[counter], "-spamwindow", &config->spamWindowSeconds))
+        {
+            // value already stored by parse_int_option
+        }
+        else if (parse_int_option(argv[counter], "-maxclients", &config->maxClients) && config->maxClients > 0)
+        {
+            // value already stored by parse_int_option
+        }
+        else if (parse_int_option(argv[counter], "-codelinterval", &config->codelIntervalMilliseconds) && config->codelIntervalMilliseconds > 0)
+        {
+            // value already stored by parse_int_option
+        }
+        else if (parse_int_option(argv[counter], "-weight", &config->senderWeight) &&
+                 config->senderWeight > 0 && config->senderWeight <= MAX_SENDER_WEIGHT)
+        {
+            // value already stored by parse_int_option
+        }
+        else
+        {
+            printf("Error: Invalid argument: %s\n", argv[counter]);
+            display_server_usage();
+            return CONFIG_PARSING_ERROR;
+        }
+    }
+
+    if ((config->tlsCertFile == NULL) != (config->tlsKeyFile == NULL))
+    {
+        printf("Error: -tlscert and -tlskey must be given together\n");
+        display_server_usage();
+        return CONFIG_PARSING_ERROR;
+    }
+    if (durability != NULL && strcmp(durability, "sync") != 0 && strcmp(durability, "write") != 0)
+    {
+        printf("Error: -durability takes write or sync\n");
+        display_server_usage();
+        return CONFIG_PARSING_ERROR;
+    }
+    config->walSync = durability == NULL || strcmp(durability, "sync") == 0;
+
+    return CONFIG_PARSING_SUCCESS;
+}
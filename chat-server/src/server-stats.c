@@ -0,0 +1,117 @@
+/*
+* FILE              :   server-stats.c
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This file contains the server counters. Instead of printing a line for every
+                        connection the server prints one summary per interval in which something happened.
+*/
+
+#include "../inc/server-stats.h"
+#include <stddef.h>
+
+ServerStats serverStats;
+
+// Counters in the order they are reported
+static const struct
+{
+    const char* label;
+    size_t offset;
+} statFields[] =
+{
+    { "accepted", offsetof(ServerStats, connectionsAccepted) },
+    { "rejected at capacity", offsetof(ServerStats, rejectedAtCapacity) },
+    { "rejected by rate limit", offsetof(ServerStats, rejectedByRate) },
+    { "accept errors", offsetof(ServerStats, acceptErrors) },
+    { "heartbeats", offsetof(ServerStats, heartbeatsSent) },
+    { "idle reaped", offsetof(ServerStats, connectionsReaped) },
+    { "TLS handshakes", offsetof(ServerStats, tlsHandshakes) },
+    { "of which kTLS", offsetof(ServerStats, tlsKernelOffloaded) },
+    { "TLS failures", offsetof(ServerStats, tlsHandshakeFailures) },
+    { "multicast sent", offsetof(ServerStats, multicastPublished) },
+    { "multicast repairs", offsetof(ServerStats, multicastRepaired) },
+    { "control frames", offsetof(ServerStats, controlFrames) },
+    { "overloaded", offsetof(ServerStats, overloadEpisodes) },
+    { "throttled reads", offsetof(ServerStats, readsThrottled) },
+    { "shed", offsetof(ServerStats, messagesShed) },
+    { "refused busy", offsetof(ServerStats, refusedBusy) },
+    { "memory pauses", offsetof(ServerStats, memoryPaused) },
+    { "memory refused", offsetof(ServerStats, memoryRefused) },
+    { "memory disconnects", offsetof(ServerStats, memoryDisconnects) },
+    { "filtered", offsetof(ServerStats, messagesFiltered) },
+    { "mailed", offsetof(ServerStats, mailStored) },
+    { "mail delivered", offsetof(ServerStats, mailDelivered) },
+    { "mail expired", offsetof(ServerStats, mailExpired) },
+    { "mail over quota", offsetof(ServerStats, mailTrimmed) },
+    { "mail dropped", offsetof(ServerStats, mailDropped) },
+    { "hibernated", offsetof(ServerStats, connectionsHibernated) },
+    { "woken", offsetof(ServerStats, connectionsWoken) },
+    { "searches", offsetof(ServerStats, searchesAnswered) },
+    { "unindexed", offsetof(ServerStats, searchDropped) },
+    { "logged", offsetof(ServerStats, walLogged) },
+    { "commits", offsetof(ServerStats, walCommits) },
+    { "tapped", offsetof(ServerStats, tapPublished) },
+    { "spam", offsetof(ServerStats, spamSuppressed) },
+    { "names refused", offsetof(ServerStats, namesRefused) },
+};
+
+// Levels in the order they are reported, in kilobytes
+static const struct
+{
+    const char* label;
+    size_t offset;
+} statLevels[] =
+{
+    { "memory KB", offsetof(ServerStats, memoryInUse) },
+    { "peak KB", offsetof(ServerStats, memoryPeak) },
+};
+
+#define STAT_FIELD_COUNT (sizeof(statFields) / sizeof(statFields[0]))
+#define STAT_LEVEL_COUNT (sizeof(statLevels) / sizeof(statLevels[0]))
+
+/*
+    FUNCTION    :   report_server_stats
+    DESCRIPTION :   Prints the counters accumulated since the previous report, if any changed and
+                    the reporting interval has passed, followed by the current levels. Only called from
+                    the main thread.
+    PARAMETERS  :   none
+    RETURNS     :   void
+*/
+void report_server_stats(void)
+{
+    static unsigned long previous[STAT_FIELD_COUNT];
+    static uint64_t lastReportMs = 0;
+    unsigned long current[STAT_FIELD_COUNT];
+    bool changed = false;
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t nowMs = (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+    if (nowMs - lastReportMs < STATS_INTERVAL_MILLISECONDS)
+    {
+        return;
+    }
+    lastReportMs = nowMs;
+
+    for (size_t i = 0; i < STAT_FIELD_COUNT; i++)
+    {
+        current[i] = atomic_load((atomic_ulong*)((char*)&serverStats + statFields[i].offset));
+        changed = changed || current[i] != previous[i];
+    }
+    if (!changed)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < STAT_FIELD_COUNT; i++)
+    {
+        printf("%s%s %lu", i == 0 ? "" : ", ", statFields[i].label, current[i] - previous[i]);
+        previous[i] = current[i];
+    }
+    for (size_t i = 0; i < STAT_LEVEL_COUNT; i++)
+    {
+        printf(", %s %lu", statLevels[i].label, atomic_load((atomic_ulong*)((char*)&serverStats + statLevels[i].offset)) / 1024);
+    }
+    printf("\n");
+    fflush(stdout);
+}
@@ -8,10 +8,36 @@
 */
 
 #include "server-utility.h"
+#include "../inc/keepalive.h"
+#include "../inc/accept-manager.h"
+#include "../inc/server-stats.h"
+#include "../inc/latency-profile.h"
+#include "../inc/multicast-publisher.h"
+#include "../inc/message-history.h"
+#include "../inc/overload.h"
+#include "../inc/memory-budget.h"
+#include "../inc/pipeline.h"
+#include "../inc/offline-mailbox.h"
+#include "../inc/client-snapshot.h"
+#include "../inc/fair-ingest.h"
+#include "../inc/hibernation.h"
+#include "../inc/presence-service.h"
+#include "../inc/direct-message.h"
+#include "../inc/search-index.h"
+#include "../inc/write-ahead-log.h"
+#include "../inc/broadcast-tap.h"
+#include "../inc/spam-filter.h"
+
+// connection handler bookkeeping used to wait for all of them to return
+static pthread_mutex_t handlersMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t handlersIdle = PTHREAD_COND_INITIALIZER;
+static int activeHandlers = 0;
+static bool broadcasterRunning = false;
+
 /*
  * Function:    signalHandler
  * Description: This function retrives and interperets a signal and acts accordingly based upon what the required response to the signal is.
- *              It cleans up and closes the server socket and message queue
+ *              It only raises the shutdown flags; the main thread notices them and performs the actual cleanup in serverShutdown
  * Parameters:  int sig: The signal
  * Returns:     void
  */
@@ -26,50 +52,71 @@ void signalHandler(int sig)
         runServer = 0;
     }
 
-    // shut down server and clean up resources
-    serverShutdown();
-    exit(EXIT_SUCCESS);
+    // wake every thread so the main thread can shut down server and clean up resources
+    wake_workers();
 }
 
 
 /*
  * Function:    init_server_socket
  * Description: This function creates and initializes a socket that listens for incomming connection on a specified port.
+ *              The socket is dual-stack: IPv6 clients connect natively and IPv4 clients arrive as IPv4-mapped
+ *              addresses. On a host without IPv6 it falls back to an IPv4 only socket.
  * Parameters:  int port: The port number that the socket should be set up to listen on
+ *              int backlog: The length of the queue of connections waiting to be accepted
  * Returns:     int: Error value if necessary else the socket file descriptor
  */
-int init_server_socket(int port)
+int init_server_socket(int port, int backlog)
 {
 
     int sockfd;
-    struct sockaddr_in server_addr;
-    sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    int v6only = 0;
+    struct sockaddr_storage server_addr;
+    socklen_t server_addr_length;
+
+    // zero out the memory block occupied by the server_addr structure
+    memset(&server_addr, 0, sizeof(server_addr));
+
+    sockfd = socket(AF_INET6, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sockfd >= 0)
+    {
+        struct sockaddr_in6* address = (struct sockaddr_in6*)&server_addr;
+        // accept IPv4 connections on the same socket, whatever net.ipv6.bindv6only says
+        setsockopt(sockfd, IPPROTO_IPV6, IPV6_V6ONLY, &v6only, sizeof(v6only));
+        address->sin6_family = AF_INET6;
+        address->sin6_addr = in6addr_any; // listen for incoming TCP/IP connections on any address
+        address->sin6_port = htons(port); // htons converts port number to network byte order (big endian)
+        server_addr_length = sizeof(*address);
+    }
+    else
+    {
+        struct sockaddr_in* address = (struct sockaddr_in*)&server_addr;
+        sockfd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        address->sin_family = AF_INET; // IPv4
+        address->sin_addr.s_addr = INADDR_ANY; // listen for incoming TCP/IP connections on any IPv4 address
+        address->sin_port = htons(port);
+        server_addr_length = sizeof(*address);
+    }
     // check for failure
     if (sockfd < 0)
     {
         perror("Error creating socket");
         return SOCKET_ERROR;
     }
-
-    // zero out the memory block occupied by the server_addr structure
-    memset(&server_addr, 0, sizeof(server_addr));
-
-    server_addr.sin_family = AF_INET; // IPv4
-    server_addr.sin_addr.s_addr = INADDR_ANY; // listen for incoming TCP/IP connections on any IPv4 address
-    
-    server_addr.sin_port = htons(port); // listen on port. htons converts port number to network byte
-                                        // order (big endian)
+    // allow a restarted server to bind while old connections are still in TIME_WAIT
+    setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
 
     // Bind the socket to the server address and port
-    if (bind(sockfd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0)
+    if (bind(sockfd, (struct sockaddr*)&server_addr, server_addr_length) < 0)
     {
         perror("Error in binding");
         close(sockfd);
         return SOCKET_ERROR;
     }
     printf("bind successful\n");
-    // Start listening on the socket for connections, with a maximum of 10 pending connections
-    if (listen(sockfd, 5) < 0) // Check if listen call was successful
+    // Start listening on the socket for connections, the kernel caps the backlog at net.core.somaxconn
+    if (listen(sockfd, backlog) < 0) // Check if listen call was successful
     {
         perror("Error on listening");
         return SOCKET_ERROR;
@@ -80,29 +127,43 @@ int init_server_socket(int port)
 
 
 /*
- * Function:    accept_client_connection
- * Description: This function accepts incoming connections on a specific socket. it creates a new socket for each connection with a client
- *              which allows for bi-directional communication
- * Parameters:  int server_socket: The socket file descriptor to accept connections on
- * Returns:     int: Error value if necessary else a new socket file descriptor
+ * Function:    init_unix_socket
+ * Description: This function creates a unix domain stream socket that listens for clients running on the same host.
+ *              They speak the same protocol as TCP clients but skip the TCP/IP stack. A stale socket file left behind
+ *              by a server that did not shut down cleanly is replaced.
+ * Parameters:  const char* path: The filesystem path of the socket
+ *              int backlog: The length of the queue of connections waiting to be accepted
+ * Returns:     int: Error value if necessary else the socket file descriptor
  */
-int accept_client_connection(int server_socket) 
+int init_unix_socket(const char* path, int backlog)
 {
-    struct sockaddr_in client_addr;
-    socklen_t clilen = sizeof(client_addr);
-
-    // Wait for a client connection
-    int newsockfd = accept(server_socket, (struct sockaddr *) &client_addr, &clilen);
+    struct sockaddr_un server_addr;
+    if (strlen(path) >= sizeof(server_addr.sun_path))
+    {
+        fprintf(stderr, "Unix socket path too long: %s\n", path);
+        return SOCKET_ERROR;
+    }
 
-    if (newsockfd < 0) 
+    int unixfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (unixfd < 0)
     {
-        perror("Error on accept");
+        perror("Error creating unix socket");
         return SOCKET_ERROR;
     }
 
-    printf("Client connected from IP: %s\n", inet_ntoa(client_addr.sin_addr));
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sun_family = AF_UNIX;
+    strcpy(server_addr.sun_path, path);
+    unlink(path);
 
-    return newsockfd; // Return the new socket file descriptor
+    if (bind(unixfd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0 || listen(unixfd, backlog) < 0)
+    {
+        perror("Error binding unix socket");
+        close(unixfd);
+        return SOCKET_ERROR;
+    }
+    printf("Server listening on unix socket %s\n", path);
+    return unixfd;
 }
 
 
@@ -124,104 +185,866 @@ void close_socket(int sock)
 }
 
 /*
- * Function:    connection_handler
- * Description: This function recives the messages from the clients and, allocate memory for it, deserializes it 
- *              and checks to see if the client wishes to disconnect via the ">>bye<<"" keyword
- * Parameters:  void* socket_desc: pointer to int representing socket file description
+ * Function:    init_worker_control
+ * Description: This function creates the wake pipe shared by the main loop, the connection handlers and the broadcaster.
+ *              Once something is written into it every worker leaves its loop at the next frame boundary.
+ * Parameters:  void.
  * Returns:     void
  */
-void* connection_handler(void* socket_desc)
+void init_worker_control(void)
 {
-    // unwrap the socket object
-    int sock = *(int*)socket_desc;
-    Message* chatMessage = NULL;
-    char* buffer = NULL;
-    while (runServer)
-    {
-		uint32_t msgLength;
-		// Receive the length of the message
-		if (recv(sock, &msgLength, sizeof(msgLength), 0) < READING_ERROR) 
-		{
-			perror("recv");
-		}
-
-		msgLength = ntohl(msgLength); // Convert message length to host byte order
-
-		buffer = malloc(msgLength + 1); // Allocate memory for the message
-		if (buffer == NULL) 
-		{
-			perror("malloc failed");
-			exit(EXIT_FAILURE);
-		}
-
-		// Receive the message itself
-		if (recv(sock, buffer, msgLength, 0) < READING_ERROR) 
-		{
-			perror("recv");
-		}
-
-		buffer[msgLength] = '\0'; // Null-terminate the string	
-        // Terminate the received string
-
-        chatMessage = (Message*)malloc(sizeof(Message));
-        if (!chatMessage) 
+    if (pipe(workerWakePipe) < 0)
+    {
+        perror("Failed to create wake pipe");
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+/*
+ * Function:    wake_workers
+ * Description: This function asks every worker thread to stop. It is async-signal-safe so it can be called from signalHandler.
+ * Parameters:  void.
+ * Returns:     void
+ */
+void wake_workers(void)
+{
+    char wake = 1;
+    stopWorkers = 1;
+    if (write(workerWakePipe[1], &wake, sizeof(wake)) < 0)
+    {
+        // the pipe only has to be readable, a full pipe already is
+    }
+}
+
+
+/*
+ * Function:    spawn_connection_handler
+ * Description: This function starts a detached connection_handler thread for a registered client socket.
+ * Parameters:  int sock: The client socket file descriptor
+ *              int slot: The registry slot holding the socket
+ *              bool resumed: true for a connection woken from hibernation, which is not set up again
+ * Returns:     bool: false if the thread could not be created
+ */
+bool spawn_connection_handler(int sock, int slot, bool resumed)
+{
+    pthread_t handler_tid;
+    // Allocate memory for the handler arguments
+    HandlerArgs* new_sock = malloc(sizeof(HandlerArgs));
+    if (!new_sock)
+    {
+        perror("malloc failed");
+        return false;
+    }
+    new_sock->sock = sock;
+    new_sock->slot = slot;
+    new_sock->resumed = resumed;
+
+    pthread_mutex_lock(&handlersMutex);
+    activeHandlers++;
+    pthread_mutex_unlock(&handlersMutex);
+
+    if (pthread_create(&handler_tid, NULL, connection_handler, (void*)new_sock) != 0)
+    {
+        perror("could not create thread");
+        pthread_mutex_lock(&handlersMutex);
+        activeHandlers--;
+        pthread_mutex_unlock(&handlersMutex);
+        free(new_sock);
+        return false;
+    }
+    pthread_detach(handler_tid);
+    return true;
+}
+
+
+/*
+ * Function:    start_workers
+ * Description: This function (re)starts a connection handler for every registered client and the broadcaster thread.
+ *              On a normal start the registry is empty, after a takeover it holds the inherited clients.
+ * Parameters:  void.
+ * Returns:     void
+ */
+void start_workers(void)
+{
+    char drain[16];
+    // Empty the wake pipe left over from a previous stop
+    int flags = fcntl(workerWakePipe[0], F_GETFL);
+    fcntl(workerWakePipe[0], F_SETFL, flags | O_NONBLOCK);
+    while (read(workerWakePipe[0], drain, sizeof(drain)) > 0)
+    {
+    }
+    fcntl(workerWakePipe[0], F_SETFL, flags);
+    stopWorkers = 0;
+
+    // Every registered client gets a handler below, hibernating or not
+    hibernation_forget_all();
+    pthread_mutex_lock(&clientsMutex);
+    for (int i = 0; i < maxClients; i++)
+    {
+        if (client_sockets[i] == -1)
         {
-            perror("malloc failed");
-            exit(EXIT_FAILURE);
+            continue;
         }
-
-        deserializeMessage(chatMessage, buffer);
-		if(strcmp(chatMessage->message, ">>bye<<") == STRING_EQUALITY)
-		{
-            // when client sent '>>bye<<' message, quit
-            puts("Client disconnected");
-            fflush(stdout);
-            remove_client(sock);
+        keepalive_track(i);
+        if (!spawn_connection_handler(client_sockets[i], i, false))
+        {
+            keepalive_untrack(i);
+            close(client_sockets[i]);
+            client_sockets[i] = -1;
             pthread_mutex_lock(&numClientsMutex);
             clientCount--;
             pthread_mutex_unlock(&numClientsMutex);
-			break;
-		}
-        chatMessage->senderSock = sock;
-        enqueue(&messageQueue, chatMessage);
+        }
+    }
+    // Also picks up the multicast subscriptions a predecessor handed over
+    client_snapshot_publish();
+    pthread_mutex_unlock(&clientsMutex);
+
+    // Start the broadcaster thread
+    if (pthread_create(&broadcaster_tid, NULL, broadcasterThread, NULL) != 0)
+    {
+        perror("Failed to create broadcaster thread");
+        exit(EXIT_FAILURE);
+    }
+    broadcasterRunning = true;
+}
+
+
+/*
+ * Function:    stop_workers
+ * Description: This function wakes all workers and waits until every connection handler has returned and the
+ *              broadcaster has finished its current message. Client sockets are left open and registered.
+ * Parameters:  void.
+ * Returns:     void
+ */
+void stop_workers(void)
+{
+    wake_workers();
+    // A broadcaster parked on the queue would otherwise only notice at the end of its park
+    pthread_mutex_lock(&messageQueue.lock);
+    pthread_cond_broadcast(&messageQueue.cond);
+    pthread_mutex_unlock(&messageQueue.lock);
+
+    pthread_mutex_lock(&handlersMutex);
+    while (activeHandlers > 0)
+    {
+        pthread_cond_wait(&handlersIdle, &handlersMutex);
+    }
+    pthread_mutex_unlock(&handlersMutex);
+
+    if (broadcasterRunning)
+    {
+        pthread_join(broadcaster_tid, NULL);
+        broadcasterRunning = false;
+    }
+}
+
+
+/*
+ * Function:    release_frame
+ * Description: This function frees a frame returned by receive_frame and gives its memory back to the connection.
+ * Parameters:  int sock: The socket it was read from
+ *              char* buffer: The frame
+ *              size_t charged: The bytes receive_frame charged for it
+ * Returns:     void
+ */
+static void release_frame(int sock, char* buffer, size_t charged)
+{
+    free(buffer);
+    memory_release(sock, charged);
+}
+
+/*
+ * Function:    receive_frame
+ * Description: This function reads one length-prefixed frame from a socket, plain or TLS, waiting for all of its bytes.
+ *              The type of the frame is read from its length, before any of its bytes. The buffer is charged to the
+ *              connection first, so a peer announcing a frame larger than its memory budget is never allocated one.
+ * Parameters:  int sock: The socket file descriptor
+ *              bool* control: Set when the frame is a typed control frame rather than a serialized message
+ *              size_t* charged: Receives the bytes charged, to be given back with release_frame
+ * Returns:     char*: A null-terminated buffer to pass to release_frame, or NULL if the peer went away or is dropped
+ */
+static char* receive_frame(int sock, bool* control, size_t* charged)
+{
+    uint32_t msgLength;
+    // Receive the length of the message
+    if (transportRecvAll(sock, &msgLength, sizeof(msgLength)) != sizeof(msgLength))
+    {
+        return NULL;
+    }
+
+    msgLength = ntohl(msgLength); // Convert message length to host byte order
+    *control = (msgLength & CONTROL_FRAME_FLAG) != 0;
+    msgLength &= ~CONTROL_FRAME_FLAG;
+
+    *charged = (size_t)msgLength + 1;
+    if (!memory_charge(sock, *charged))
+    {
+        // The rest of the frame cannot be skipped without reading it, so the connection goes
+        atomic_fetch_add(&serverStats.memoryDisconnects, 1);
+        return NULL;
+    }
+    char* buffer = malloc(msgLength + 1); // Allocate memory for the message
+    if (buffer == NULL)
+    {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+
+    // Receive the message itself
+    if (msgLength > 0 && transportRecvAll(sock, buffer, msgLength) != (ssize_t)msgLength)
+    {
+        release_frame(sock, buffer, *charged);
+        return NULL;
+    }
+
+    buffer[msgLength] = '\0'; // Null-terminate the string
+    return buffer;
+}
+
+
+/*
+ * Function:    is_server_control
+ * Description: This function tells whether a message body is one of the control messages only the server sends.
+ * Parameters:  const char* body: The message body
+ * Returns:     bool: true for a multicast offer, repair or loss notice, a history replay or sync, a busy notice, a
+ *              private delivery, a kept message, a roster update, a name taken notice, a search answer or an ack
+ */
+static bool is_server_control(const char* body)
+{
+    return strncmp(body, MULTICAST_OFFER_PREFIX, strlen(MULTICAST_OFFER_PREFIX)) == STRING_EQUALITY ||
+           strncmp(body, MULTICAST_REPAIR_PREFIX, strlen(MULTICAST_REPAIR_PREFIX)) == STRING_EQUALITY ||
+           strncmp(body, MULTICAST_LOST_PREFIX, strlen(MULTICAST_LOST_PREFIX)) == STRING_EQUALITY ||
+           strncmp(body, HISTORY_REPLAY_PREFIX, strlen(HISTORY_REPLAY_PREFIX)) == STRING_EQUALITY ||
+           strncmp(body, HISTORY_SYNC_PREFIX, strlen(HISTORY_SYNC_PREFIX)) == STRING_EQUALITY ||
+           strncmp(body, PRIVATE_DELIVERY_PREFIX, strlen(PRIVATE_DELIVERY_PREFIX)) == STRING_EQUALITY ||
+           strncmp(body, MAILBOX_DELIVERY_PREFIX, strlen(MAILBOX_DELIVERY_PREFIX)) == STRING_EQUALITY ||
+           strncmp(body, PRESENCE_ROSTER_PREFIX, strlen(PRESENCE_ROSTER_PREFIX)) == STRING_EQUALITY ||
+           strncmp(body, PRESENCE_DELTA_PREFIX, strlen(PRESENCE_DELTA_PREFIX)) == STRING_EQUALITY ||
+           strncmp(body, SEARCH_RESULT_PREFIX, strlen(SEARCH_RESULT_PREFIX)) == STRING_EQUALITY ||
+           strncmp(body, SEARCH_SUMMARY_PREFIX, strlen(SEARCH_SUMMARY_PREFIX)) == STRING_EQUALITY ||
+           strcmp(body, SEARCH_UNAVAILABLE) == STRING_EQUALITY ||
+           strncmp(body, DURABLE_ACK_PREFIX, strlen(DURABLE_ACK_PREFIX)) == STRING_EQUALITY ||
+           strncmp(body, DURABLE_ACKS_ON_PREFIX, strlen(DURABLE_ACKS_ON_PREFIX)) == STRING_EQUALITY ||
+           strcmp(body, DURABLE_ACKS_OFF) == STRING_EQUALITY ||
+           strcmp(body, MAILBOX_NAME_TAKEN) == STRING_EQUALITY ||
+           strcmp(body, SERVER_BUSY) == STRING_EQUALITY;
+}
+
+/*
+ * Function:    write_server_control
+ * Description: This function sends a control message from the server to one client. The caller holds clientWritesMutex,
+ *              which keeps it from interleaving with a broadcast or a heartbeat, and knows the socket is still open.
+ * Parameters:  int sock: The client socket
+ *              const char* body: The message body, it may carry a whole serialized message and so be longer than MAX_BODY_LENGTH
+ * Returns:     void
+ */
+void write_server_control(int sock, const char* body)
+{
+    char frame[2 * MAX_SERIALIZED_LENGTH];
+    snprintf(frame, sizeof(frame), "%s|%s|%s", HEARTBEAT_SENDER_IP, HEARTBEAT_SENDER_NAME, body);
+    sendLengthPrefixedMessage(frame, sock);
+}
+
+/*
+ * Function:    send_server_control
+ * Description: This function sends a control message from the server to one client, taking clientWritesMutex for it.
+ *              The caller knows the socket is still open.
+ * Parameters:  int sock: The client socket
+ *              const char* body: The message body
+ * Returns:     void
+ */
+void send_server_control(int sock, const char* body)
+{
+    pthread_mutex_lock(&clientWritesMutex);
+    write_server_control(sock, body);
+    pthread_mutex_unlock(&clientWritesMutex);
+}
+
+
+/*
+ * Function:    post_control
+ * Description: This function queues a request on the control lane of the message queue. The broadcaster serves it
+ *              ahead of waiting chat messages, so its latency stays bounded however much chat is queued, and as the
+ *              only thread writing to client sockets it orders the answer correctly among the broadcasts.
+ *              The request is charged to the client's memory budget until it was served, and dropped if it does not fit.
+ * Parameters:  int sock: The client socket the request is about
+ *              const char* request: The control request
+ * Returns:     void
+ */
+void post_control(int sock, const char* request)
+{
+    Message control;
+    initMessage(&control, HEARTBEAT_SENDER_IP, HEARTBEAT_SENDER_NAME);
+    setMessageBody(&control, request, strlen(request));
+    control.senderSock = sock;
+    if (!memory_charge(sock, message_footprint(&control)))
+    {
+        releaseMessage(&control);
+        return;
+    }
+    enqueueControl(&messageQueue, &control); // the queue owns the body from here on
+}
+
+/*
+ * Function:    handle_client_control
+ * Description: This function acts on a control request of a client. Requests whose answer goes out over the socket
+ *              are handed to the broadcaster through the control lane, the others are dealt with right here. A
+ *              >>hello<< reads the user's mailbox from disk, so it is answered here rather than by the broadcaster.
+ *              A >>hello<< naming a user another connection holds is answered with >>taken<< and ends the connection.
+ *              A >>search<< is answered here too, so that a long query holds up no other client, and so is >>acks<<.
+ * Parameters:  int sock: The client socket
+ *              int slot: Its registry slot
+ *              uint64_t joinedSequence: Sequence number of the first broadcast the client received live
+ *              const char* request: The request, the payload of a control frame or the body of a message
+ * Returns:     int: CLIENT_LEAVING for >>bye<< or a name taken, CONTROL_HANDLED for another request, NOT_CONTROL
+ *              otherwise
+ */
+static int handle_client_control(int sock, int slot, uint64_t joinedSequence, const char* request)
+{
+    if (strcmp(request, ">>bye<<") == STRING_EQUALITY)
+    {
+        return CLIENT_LEAVING;
+    }
+    if (strcmp(request, HEARTBEAT_REPLY) == STRING_EQUALITY)
+    {
+        return CONTROL_HANDLED; // only refreshes the activity tick, it does not keep the connection out of hibernation
+    }
+    hibernation_touch(slot);
+    if (strncmp(request, MAILBOX_HELLO_PREFIX, strlen(MAILBOX_HELLO_PREFIX)) == STRING_EQUALITY)
+    {
+        int nameOffset = 0;
+        sscanf(request + strlen(MAILBOX_HELLO_PREFIX), "%*u %*u %*u %n", &nameOffset);
+        if (nameOffset > 0)
+        {
+            int claim = direct_claim_name(slot, request + strlen(MAILBOX_HELLO_PREFIX) + nameOffset);
+            if (claim == DIRECT_TAKEN)
+            {
+                send_server_control(sock, MAILBOX_NAME_TAKEN);
+                return CLIENT_LEAVING;
+            }
+            if (claim == DIRECT_NO_ROOM)
+            {
+                overload_notify_busy(sock, slot);
+                return CONTROL_HANDLED; // the client may say >>hello<< again
+            }
+            presence_join(slot, direct_name(slot));
+        }
+        mailbox_hello(sock, slot, joinedSequence, request + strlen(MAILBOX_HELLO_PREFIX));
+        return CONTROL_HANDLED;
+    }
+    if (strncmp(request, SEARCH_REQUEST_PREFIX, strlen(SEARCH_REQUEST_PREFIX)) == STRING_EQUALITY)
+    {
+        search_answer(sock, slot, request + strlen(SEARCH_REQUEST_PREFIX));
+        return CONTROL_HANDLED;
+    }
+    if (strcmp(request, DURABLE_ACKS_REQUEST) == STRING_EQUALITY)
+    {
+        wal_subscribe(sock, slot);
+        return CONTROL_HANDLED;
+    }
+    if (strcmp(request, MULTICAST_SUBSCRIBE) == STRING_EQUALITY ||
+        strcmp(request, PRESENCE_SUBSCRIBE) == STRING_EQUALITY ||
+        strcmp(request, MULTICAST_UNSUBSCRIBE) == STRING_EQUALITY ||
+        strncmp(request, MULTICAST_NACK_PREFIX, strlen(MULTICAST_NACK_PREFIX)) == STRING_EQUALITY ||
+        strncmp(request, HISTORY_REQUEST_PREFIX, strlen(HISTORY_REQUEST_PREFIX)) == STRING_EQUALITY)
+    {
+        post_control(sock, request);
+        return CONTROL_HANDLED;
+    }
+    return NOT_CONTROL;
+}
+
+/*
+ * Function:    run_control
+ * Description: This function serves a request taken from the control lane by the broadcaster. A client that left in
+ *              the meantime is skipped. A roster delta is about no client in particular and goes to all that follow it.
+ * Parameters:  const Message* control: The request, its sender socket is the client it is about
+ * Returns:     void
+ */
+static void run_control(const Message* control)
+{
+    int sock = control->senderSock;
+    const char* request = messageBody(control);
+
+    if (sock == -1 && strncmp(request, PRESENCE_DELTA_PREFIX, strlen(PRESENCE_DELTA_PREFIX)) == STRING_EQUALITY)
+    {
+        presence_deliver(request);
+        return;
     }
 
+    pthread_mutex_lock(&clientsMutex);
+    int slot = find_client_slot(sock);
+    if (slot >= 0 && strcmp(request, HEARTBEAT_REQUEST) == STRING_EQUALITY)
+    {
+        pthread_mutex_lock(&clientWritesMutex);
+        keepalive_send_heartbeat(sock);
+        pthread_mutex_unlock(&clientWritesMutex);
+    }
+    else if (slot >= 0 && strcmp(request, SERVER_BUSY) == STRING_EQUALITY)
+    {
+        send_server_control(sock, SERVER_BUSY);
+    }
+    pthread_mutex_unlock(&clientsMutex);
+    if (slot < 0)
+    {
+        return;
+    }
+
+    if (strcmp(request, MULTICAST_SUBSCRIBE) == STRING_EQUALITY)
+    {
+        multicast_subscribe(sock, slot);
+    }
+    else if (strcmp(request, MULTICAST_UNSUBSCRIBE) == STRING_EQUALITY)
+    {
+        multicast_unsubscribe(sock, slot);
+    }
+    else if (strncmp(request, MULTICAST_NACK_PREFIX, strlen(MULTICAST_NACK_PREFIX)) == STRING_EQUALITY)
+    {
+        multicast_repair(sock, request + strlen(MULTICAST_NACK_PREFIX));
+    }
+    else if (strncmp(request, HISTORY_REQUEST_PREFIX, strlen(HISTORY_REQUEST_PREFIX)) == STRING_EQUALITY)
+    {
+        history_replay(sock, slot, request + strlen(HISTORY_REQUEST_PREFIX));
+    }
+    else if (strcmp(request, PRESENCE_SUBSCRIBE) == STRING_EQUALITY)
+    {
+        presence_subscribe(sock, slot);
+    }
+    atomic_fetch_add(&serverStats.controlFrames, 1);
+}
+
+/*
+ * Function:    disconnect_client
+ * Description: This function takes a client out of the registry and closes its connection. Only the thread that
+ *              owns the connection, its handler or the main loop for a hibernating one, may call it.
+ * Parameters:  int sock: The client socket
+ *              int slot: Its registry slot
+ * Returns:     void
+ */
+void disconnect_client(int sock, int slot)
+{
+    keepalive_untrack(slot);
+    mailbox_leave(slot);
+    presence_leave(slot);
+    direct_release(slot);
+    wal_leave(slot);
+    remove_client(sock);
+    pthread_mutex_lock(&numClientsMutex);
+    clientCount--;
+    pthread_mutex_unlock(&numClientsMutex);
+    // no other thread can reach the socket once it left the registry and every snapshot that still had it
+    client_snapshot_synchronize();
+    transportClose(sock);
     close(sock);
+}
+
+/*
+ * Function:    intern_peer_address
+ * Description: This function interns the address a connection comes from, the one its messages are shown with. An IPv4
+ *              client of the dual-stack listener gets the dotted address it sees for itself, and a client of the unix
+ *              socket UNIX_PEER_IP.
+ * Parameters:  int sock: The client socket
+ * Returns:     InternId: The address, holding a reference the caller releases
+ */
+static InternId intern_peer_address(int sock)
+{
+    struct sockaddr_storage peer;
+    socklen_t peerLength = sizeof(peer);
+    char address[MAX_IP_LENGTH] = UNIX_PEER_IP;
+
+    if (getpeername(sock, (struct sockaddr*)&peer, &peerLength) == 0)
+    {
+        if (peer.ss_family == AF_INET6)
+        {
+            const struct in6_addr* peerAddress = &((struct sockaddr_in6*)&peer)->sin6_addr;
+            if (IN6_IS_ADDR_V4MAPPED(peerAddress))
+            {
+                inet_ntop(AF_INET, &peerAddress->s6_addr[12], address, sizeof(address));
+            }
+            else
+            {
+                inet_ntop(AF_INET6, peerAddress, address, sizeof(address));
+            }
+        }
+        else if (peer.ss_family == AF_INET)
+        {
+            inet_ntop(AF_INET, &((struct sockaddr_in*)&peer)->sin_addr, address, sizeof(address));
+        }
+    }
+    return internString(address);
+}
+
+/*
+ * Function:    connection_handler
+ * Description: This function recives the messages from the clients and, allocate memory for it, deserializes it 
+ *              and checks to see if the client wishes to disconnect via the ">>bye<<"" keyword.
+ *              When the workers are woken it returns between two frames and leaves the socket open, so that
+ *              the socket can either be closed by serverShutdown or handed over to a new server process.
+ *              A connection from the TLS listener is handshaken here first, off the main thread. A connection that
+ *              stayed idle is handed to the main loop and the thread returns; its successor is started when the
+ *              connection wakes up again and skips the setup.
+ * Parameters:  void* socket_desc: pointer to HandlerArgs with the socket and its registry slot
+ * Returns:     void
+ */
+void* connection_handler(void* socket_desc)
+{
+    // unwrap the socket object
+    int sock = ((HandlerArgs*)socket_desc)->sock;
+    int slot = ((HandlerArgs*)socket_desc)->slot;
+    bool resumed = ((HandlerArgs*)socket_desc)->resumed;
     free(socket_desc);
-    free(chatMessage);
-    free(buffer);
+    Message chatMessage;
+    bool leaving = false;
+    // The client is in the registry already, every broadcast numbered from here on is sent to it
+    uint64_t joinedSequence = resumed ? hibernation_joined_sequence(slot) : history_next_sequence();
+
+    pin_current_thread(PIN_HANDLER);
+    InternId peerAddress = intern_peer_address(sock);
+
+    if (!resumed)
+    {
+        fair_ingest_join(slot);
+        hibernation_touch(slot);
+        if (transportAccept(sock) != TRANSPORT_SUCCESS)
+        {
+            atomic_fetch_add(&serverStats.tlsHandshakeFailures, 1);
+            leaving = true;
+        }
+        else if (strcmp(transportDescribe(sock), "plain") != STRING_EQUALITY && !stopWorkers)
+        {
+            atomic_fetch_add(&serverStats.tlsHandshakes, 1);
+            if (strcmp(transportDescribe(sock), "kTLS") == STRING_EQUALITY)
+            {
+                atomic_fetch_add(&serverStats.tlsKernelOffloaded, 1);
+            }
+        }
+    }
+
+    while (!stopWorkers && !leaving)
+    {
+        if (overload_throttled(slot))
+        {
+            // Leaving the bytes in the socket buffer a little longer lets TCP flow control slow the sender down
+            struct pollfd wake = { workerWakePipe[0], POLLIN, 0 };
+            poll(&wake, 1, THROTTLE_DELAY_MILLISECONDS);
+            atomic_fetch_add(&serverStats.readsThrottled, 1);
+        }
+        if (memory_over_soft(sock))
+        {
+            // Nothing more is read until the broadcaster has freed some of what this client already queued
+            struct pollfd wake = { workerWakePipe[0], POLLIN, 0 };
+            poll(&wake, 1, MEMORY_PAUSE_MILLISECONDS);
+            atomic_fetch_add(&serverStats.memoryPaused, 1);
+            continue;
+        }
+        // Records OpenSSL already decrypted never make the socket readable again, so only wait when none are buffered
+        if (!transportPending(sock))
+        {
+            struct pollfd fds[2] = { { sock, POLLIN, 0 }, { workerWakePipe[0], POLLIN, 0 } };
+            int ready = wait_for_input(fds, 2, hibernation_timeout(slot));
+            if (ready < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                perror("poll");
+                break;
+            }
+            if (ready == 0)
+            {
+                if (hibernation_enter(sock, slot, joinedSequence))
+                {
+                    break; // idle, the main loop starts a new handler once the client speaks again
+                }
+                continue;
+            }
+            if (fds[1].revents & POLLIN)
+            {
+                break; // asked to stop, the frame boundary is kept intact
+            }
+        }
+
+        bool control;
+        size_t charged;
+        char* buffer = receive_frame(sock, &control, &charged);
+        if (buffer == NULL)
+        {
+            // peer vanished without saying >>bye<<
+            leaving = true;
+            break;
+        }
+        keepalive_touch(slot);
+
+        if (control)
+        {
+            // A typed control frame is acted on straight from the buffer, unknown requests are dropped
+            leaving = handle_client_control(sock, slot, joinedSequence, buffer) == CLIENT_LEAVING;
+            release_frame(sock, buffer, charged);
+            if (leaving)
+            {
+                break;
+            }
+            continue;
+        }
+
+        // A line its sender keeps repeating is dropped before it costs a deserialization, and the sender is slowed down
+        if (spam_suppress(slot, buffer))
+        {
+            release_frame(sock, buffer, charged);
+            struct pollfd wake = { workerWakePipe[0], POLLIN, 0 };
+            poll(&wake, 1, SPAM_PENALTY_MILLISECONDS);
+            continue;
+        }
+
+        // Only the body, the sender's clock and the name are taken from the frame, none of them interned here: the
+        // address is the one the connection comes from, and the name is the one the connection holds
+        char userName[MAX_USERNAME_LENGTH];
+        uint64_t sent;
+        uint64_t clientStamp;
+        const char* body = parseSerializedMessage(buffer, NULL, userName, &sent, &clientStamp);
+        // Clients that predate control frames send their requests as ordinary messages
+        int outcome = handle_client_control(sock, slot, joinedSequence, body);
+        if (outcome != NOT_CONTROL || is_server_control(body)) // a client must not be able to speak for the server
+        {
+            release_frame(sock, buffer, charged);
+            leaving = outcome == CLIENT_LEAVING;
+            if (leaving)
+            {
+                break;
+            }
+            continue;
+        }
+        // A client that never said >>hello<< is reachable by the first name it sends, and claims every other name it
+        // changes to. One naming a user another connection holds is closed like after such a >>hello<<, before its
+        // message is counted or logged anywhere
+        if (userName[0] != '\0' && strcmp(userName, internedString(direct_name(slot))) != STRING_EQUALITY)
+        {
+            int claim = direct_claim_name(slot, userName);
+            if (claim != DIRECT_CLAIMED)
+            {
+                release_frame(sock, buffer, charged);
+                if (claim == DIRECT_NO_ROOM)
+                {
+                    overload_notify_busy(sock, slot);
+                    continue;
+                }
+                send_server_control(sock, MAILBOX_NAME_TAKEN);
+                leaving = true;
+                break;
+            }
+            set_client_name(sock, userName);
+            presence_join(slot, direct_name(slot));
+        }
+
+        initMessageFrom(&chatMessage, peerAddress, direct_name(slot));
+        setMessageBody(&chatMessage, body, strlen(body));
+        release_frame(sock, buffer, charged);
+        chatMessage.sentNanoseconds = sent;
+        // Stamped at ingest by the server's clock; whatever stamp the client sent in its place is overwritten
+        chatMessage.stampedNanoseconds = wallClockNanoseconds();
+        if (!overload_admit(sock, slot))
+        {
+            releaseMessage(&chatMessage);
+            continue; // refused, the sender is told the server is busy
+        }
+        if (!memory_charge(sock, message_footprint(&chatMessage)))
+        {
+            releaseMessage(&chatMessage);
+            overload_notify_busy(sock, slot);
+            continue; // over a hard memory limit, refused like a message to a full queue
+        }
+        chatMessage.senderSock = sock;
+        wal_append(sock, slot, &chatMessage); // on its way to the disk before it can be delivered
+        fair_ingest_enqueue(slot, &chatMessage); // the queue owns the body and its charge from here on
+    }
+
+    internRelease(peerAddress);
+    if (leaving)
+    {
+        puts("Client disconnected");
+        fflush(stdout);
+        disconnect_client(sock, slot);
+    }
+
+    pthread_mutex_lock(&handlersMutex);
+    activeHandlers--;
+    pthread_cond_broadcast(&handlersIdle);
+    pthread_mutex_unlock(&handlersMutex);
     return NULL;
 }
 
+/*
+ * Function:    shed_message
+ * Description: This function drops a message the broadcaster will not send and lets its sender know.
+ * Parameters:  Message* message: The dequeued message, released here
+ * Returns:     void
+ */
+static void shed_message(Message* message)
+{
+    int sock = message->senderSock;
+    releaseMessage(message);
+    atomic_fetch_add(&serverStats.messagesShed, 1);
+    if (sock < 0)
+    {
+        return; // handed over by a previous server process, its sender is unknown
+    }
+
+    pthread_mutex_lock(&clientsMutex);
+    int slot = find_client_slot(sock);
+    pthread_mutex_unlock(&clientsMutex);
+    if (slot >= 0)
+    {
+        overload_notify_busy(sock, slot);
+    }
+}
+
+/*
+ * Function:    deliver_batch
+ * Description: This function sends what is left of a batch after the pipeline: broadcasts are numbered and go to every
+ *              client, or once to the multicast group for its subscribers, while a message a stage rerouted goes to its
+ *              one recipient only, wrapped in >>private<< so that the client does not count it as a broadcast.
+ *              Messages are serialized first. The clients are read from the registry snapshot current when the batch
+ *              goes out, so clients joining or leaving meanwhile never wait for it, and clientWritesMutex is held once
+ *              for the whole batch to keep other threads' frames from landing in the middle of a broadcast.
+ * Parameters:  PipelineBatch* batch: The batch, every message in it is released here
+ * Returns:     void
+ */
+static void deliver_batch(PipelineBatch* batch)
+{
+    char serialized[PIPELINE_BATCH][MAX_SERIALIZED_LENGTH];
+    int delivered = 0;
+    for (int i = 0; i < batch->count; i++)
+    {
+        if (atomic_load_explicit(&batch->dropped[i], memory_order_relaxed))
+        {
+            atomic_fetch_add(&serverStats.messagesFiltered, 1);
+        }
+        else
+        {
+            // Serialized once, the same frame goes to every client
+            serializeMessage(&batch->messages[i], messageBody(&batch->messages[i]), serialized[i], MAX_SERIALIZED_LENGTH);
+            delivered++;
+        }
+        releaseMessage(&batch->messages[i]);
+    }
+    if (delivered == 0)
+    {
+        return;
+    }
+
+    int reader;
+    const ClientSnapshot* snapshot = client_snapshot_enter(&reader);
+    pthread_mutex_lock(&clientWritesMutex);
+    for (int i = 0; i < batch->count; i++)
+    {
+        if (atomic_load_explicit(&batch->dropped[i], memory_order_relaxed))
+        {
+            continue;
+        }
+        if (batch->recipients[i] != PIPELINE_EVERYONE)
+        {
+            if (client_snapshot_contains(snapshot, batch->recipientSlots[i], batch->recipients[i]))
+            {
+                char body[MAX_SERIALIZED_LENGTH + sizeof(PRIVATE_DELIVERY_PREFIX)];
+                snprintf(body, sizeof(body), PRIVATE_DELIVERY_PREFIX "%s", serialized[i]);
+                write_server_control(batch->recipients[i], body);
+            }
+            continue;
+        }
+
+        // Numbered in delivery order, so a client that counts what it receives knows each message's number
+        uint64_t sequence = history_append(serialized[i]);
+        mailbox_store(sequence, serialized[i]);
+        search_store(serialized[i]);
+        // One datagram serves every subscriber, and one slot every local reader, only the others get their own copy
+        if (multicast_enabled())
+        {
+            multicast_publish(sequence, serialized[i]);
+        }
+        if (tap_enabled())
+        {
+            tap_publish(sequence, serialized[i]);
+        }
+        for (int client = 0; client < snapshot->count; ++client) 
+        {
+            if (!snapshot->clients[client].multicast) 
+            {
+                // a failed send is noticed and cleaned up by that client's handler
+                sendLengthPrefixedMessage(serialized[i], snapshot->clients[client].sock);
+            }
+        }
+    }
+    pthread_mutex_unlock(&clientWritesMutex);
+    client_snapshot_exit(reader);
+    tap_flush();
+}
+
 /*
  * Function:    broadcasterThread
  * Description: This function is responsible for broadcasting the messages to the connected clients. 
- *              It dequeues messages from a message queue and sends them to their corresponding connected clients
+ *              It dequeues messages from a message queue and sends them to their corresponding connected clients.
+ *              Control requests in the queue's control lane overtake waiting chat messages and are served in between.
+ *              Chat messages are taken a batch at a time: while the queue is overloaded some of them are shed, see
+ *              overload.c, and the rest pass through the message pipeline before they are delivered.
  * Parameters:  void.
  * Returns:     void
  */
 void* broadcasterThread(void* arg) 
 {
-    while (runServer)
+    pin_current_thread(PIN_BROADCASTER);
+    PipelineBatch batch;
+    Message taken[PIPELINE_BATCH];
+    uint64_t sojourns[PIPELINE_BATCH];
+    while (!stopWorkers)
     {
-        Message message;
-        if (dequeue(&messageQueue, &message)) 
+        // Spins first in the latency profile, then parks until a handler enqueues
+        int lane = dequeueWait(&messageQueue, &taken[0], latency_spin_microseconds(), BROADCASTER_PARK_MILLISECONDS);
+        if (lane == CONTROL_DEQUEUED)
+        {
+            // Whatever happens to it next, a message no longer counts against its sender once it left the queue
+            memory_release(taken[0].senderSock, message_footprint(&taken[0]));
+            run_control(&taken[0]);
+            releaseMessage(&taken[0]);
+            continue;
+        }
+        if (lane != MESSAGE_DEQUEUED)
+        {
+            continue;
+        }
+
+        // The message that woke the broadcaster is joined by what queued up behind it, taken under a single lock
+        sojourns[0] = messageQueue.lastSojournNanoseconds;
+        int count = 1 + dequeueBatch(&messageQueue, &taken[1], &sojourns[1], PIPELINE_BATCH - 1);
+        batch.count = 0;
+        for (int i = 0; i < count; i++)
         {
-            pthread_mutex_lock(&clientsMutex);
-            for (int i = 0; i < MAX_CLIENTS; ++i) 
+            memory_release(taken[i].senderSock, message_footprint(&taken[i]));
+            if (overload_shed(sojourns[i], atomic_load(&messageQueue.length)))
             {
-                if (client_sockets[i] != -1) 
-                {
-                    // Serialize and send the message to the client
-                    char serializedMessage[MAX_SERIALIZED_LENGTH];
-                    serializeMessage(&message, message.message, serializedMessage, sizeof(serializedMessage));
-					sendLengthPrefixedMessage(serializedMessage, client_sockets[i]);
-                }
+                shed_message(&taken[i]);
+                continue;
             }
-            pthread_mutex_unlock(&clientsMutex);
+            batch.messages[batch.count] = taken[i];
+            atomic_init(&batch.dropped[batch.count], false);
+            batch.recipients[batch.count] = PIPELINE_EVERYONE;
+            batch.recipientSlots[batch.count] = PIPELINE_EVERYONE;
+            batch.count++;
         }
-        // Implementing sleep to avoid busy waiting
-        usleep(ONE_HUNDRED_MILLISECONDS); // Sleep for 100ms
+        pipeline_run(&batch);
+        deliver_batch(&batch);
+        wal_done(count); // the shed ones included, none of them needs queueing again after a crash
+    }
+
+    // Requests already accepted are answered before the clients are closed or handed over
+    Message control;
+    while (dequeueControl(&messageQueue, &control) == CONTROL_DEQUEUED)
+    {
+        memory_release(control.senderSock, message_footprint(&control));
+        run_control(&control);
+        releaseMessage(&control);
     }
     return NULL;
 }
@@ -236,24 +1059,20 @@ void* broadcasterThread(void* arg)
 void serverShutdown(void)
 {
     // Server shutdown procedure
-    // Join all client handler threads
-    for (int i = 0; i < MAX_CLIENTS; i++) 
-    {
-        if (thread_id[i]) 
-        {
-            pthread_join(thread_id[i], NULL);
-        }
-    }
+    // Stop all client handler threads and the broadcaster thread
+    stop_workers();
 
-    // Cancel and join the broadcaster thread
-    pthread_cancel(broadcaster_tid);
-    pthread_join(broadcaster_tid, NULL);
+    // What the broadcaster left for offline users is written before the process goes
+    mailbox_stop();
+    search_stop();
+    wal_stop();
+    tap_stop();
 
     cleanup_clients();
 
-    // Close the server socket
-    close_socket(sockfd);
+    // Close the listening sockets
+    close_listeners();
 
     // Clean up the message queue
     freeQueue(&messageQueue);
-}
\ No newline at end of file
+}
@@ -12,26 +12,54 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <sys/un.h>
 #include <stdbool.h>
 #include <signal.h>
 #include <netdb.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+#include <fcntl.h>
 
 extern volatile sig_atomic_t runServer;
-extern pthread_t thread_id[MAX_CLIENTS];
+extern volatile sig_atomic_t stopWorkers;
+extern int workerWakePipe[2];
 extern pthread_t broadcaster_tid;
 extern MessageQueue messageQueue;
-extern int sockfd;
+
+#define UNIX_PEER_IP "127.0.0.1" // address given to messages from the unix socket, the one its clients show for themselves
+
+// Outcomes of a client control request
+#define NOT_CONTROL 0
+#define CONTROL_HANDLED 1
+#define CLIENT_LEAVING 2
+
+// Arguments of a connection_handler thread
+typedef struct HandlerArgs
+{
+    int sock;
+    int slot;
+    bool resumed;   // woken from hibernation, the connection was set up by an earlier handler
+} HandlerArgs;
 // Function prototype for the thread that handles connections
 void* connection_handler(void* socket_desc);
 void signalHandler(int sig);
 void* broadcasterThread(void* arg);
-int init_server_socket(int port);
+int init_server_socket(int port, int backlog);
+int init_unix_socket(const char* path, int backlog);
 void close_socket(int sock);
 void* connection_handler(void* socket_desc);
 void* broadcasterThread(void* arg);
-int accept_client_connection(int server_socket);
 void serverShutdown(void);
+void init_worker_control(void);
+void wake_workers(void);
+void start_workers(void);
+void stop_workers(void);
+bool spawn_connection_handler(int sock, int slot, bool resumed);
+void disconnect_client(int sock, int slot);
+void write_server_control(int sock, const char* body);
+void send_server_control(int sock, const char* body);
+void post_control(int sock, const char* request);
 
 
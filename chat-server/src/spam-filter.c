@@ -0,0 +1,173 @@
+/*
+* FILE              :   spam-filter.c
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This file contains the repeat filter. With -spamrepeats<N> a handler looks up
+                        every chat frame it reads, before deserializing it, in a count-min sketch keyed
+                        on the sender's slot and the text of the line, and drops the copies a sender
+                        sent more than N of within the last window or two of -spamwindow<S> seconds.
+                        The sketch is a few rows of byte counters of fixed size, so the filter costs
+                        one hash of the line and a handful of loads and stores however many senders
+                        and lines there are. It may overestimate a line that collides with others in
+                        every row, never underestimate one. Two sketches take turns: the main loop
+                        empties the older one at the end of every window and counts into it from then
+                        on, while the newer one still remembers what came just before.
+*/
+
+#include "server-utility.h"
+#include "../inc/spam-filter.h"
+#include "../inc/server-stats.h"
+#include <stdatomic.h>
+#include <time.h>
+
+static _Atomic uint8_t sketches[2][SPAM_SKETCH_DEPTH][SPAM_SKETCH_WIDTH];
+static atomic_uint currentSketch = 0;   // the one counted into, the other holds the previous window
+static int allowedRepeats = DEFAULT_SPAM_REPEATS;
+static uint64_t windowMilliseconds = DEFAULT_SPAM_WINDOW_SECONDS * 1000;
+
+/*
+    FUNCTION    :   spam_init
+    DESCRIPTION :   Takes the number of copies allowed per window and the window length.
+    PARAMETERS  :   const ServerConfig* config - The parsed command line
+    RETURNS     :   void
+*/
+void spam_init(const ServerConfig* config)
+{
+    allowedRepeats = config->spamRepeats < SPAM_MAX_REPEATS ? config->spamRepeats : SPAM_MAX_REPEATS;
+    windowMilliseconds = (uint64_t)(config->spamWindowSeconds > 0 ? config->spamWindowSeconds : 1) * 1000;
+}
+
+/*
+    FUNCTION    :   hash_line
+    DESCRIPTION :   Hashes a sender's slot and a line eight bytes at a time, with a multiply and a
+                    shift per word and a final mix so that every bit of the line reaches the low
+                    bits the columns are taken from. The same line from two senders hashes apart.
+    PARAMETERS  :   int slot - The sender's registry slot
+                    const char* line - The message body
+    RETURNS     :   uint64_t - The hash
+*/
+static uint64_t hash_line(int slot, const char* line)
+{
+    size_t length = strlen(line);
+    uint64_t hash = ((uint64_t)(unsigned int)slot << 32 | length) * SPAM_HASH_MULTIPLIER;
+    uint64_t word;
+
+    for (; length >= sizeof(word); line += sizeof(word), length -= sizeof(word))
+    {
+        memcpy(&word, line, sizeof(word));
+        hash = (hash ^ word) * SPAM_HASH_MULTIPLIER;
+        hash ^= hash >> 32;
+    }
+    word = 0;
+    memcpy(&word, line, length);
+    hash = (hash ^ word) * SPAM_HASH_MULTIPLIER;
+    hash ^= hash >> 29;
+    hash *= SPAM_HASH_MULTIPLIER;
+    return hash ^ (hash >> 32);
+}
+
+/*
+    FUNCTION    :   spam_suppress
+    DESCRIPTION :   Counts a chat frame and tells whether it is one copy too many. Its estimate is the
+                    smallest of its counters in both sketches together; only the counters of the
+                    current sketch that are at its smallest there are raised, which keeps lines that
+                    share some of them from inflating each other. Suppressed copies are counted too,
+                    so a line stays suppressed for as long as its sender keeps flooding it. Handlers
+                    race on the counters with plain loads and stores, an increment lost now and then
+                    only lets one more copy through.
+    PARAMETERS  :   int slot - The sender's registry slot
+                    const char* serializedMessage - The frame as read, ip[@sent@stamped]|username|body
+    RETURNS     :   bool - true if the frame is to be dropped
+*/
+bool spam_suppress(int slot, const char* serializedMessage)
+{
+    if (allowedRepeats == 0)
+    {
+        return false;
+    }
+    // Everything after the second '|' is the body, as deserializeMessage reads it
+    const char* body = strchr(serializedMessage, '|');
+    body = body == NULL ? NULL : strchr(body + 1, '|');
+    if (body == NULL)
+    {
+        return false;
+    }
+
+    uint64_t hash = hash_line(slot, body + 1);
+    // The columns of all rows are derived from the two halves of one hash
+    uint32_t first = (uint32_t)hash;
+    uint32_t step = (uint32_t)(hash >> 32) | 1;
+    unsigned int current = atomic_load_explicit(&currentSketch, memory_order_relaxed) & 1;
+    _Atomic uint8_t* counters[SPAM_SKETCH_DEPTH];
+    unsigned int currentMinimum = UINT8_MAX;
+    unsigned int estimate = 2 * UINT8_MAX;
+    for (int row = 0; row < SPAM_SKETCH_DEPTH; row++)
+    {
+        uint32_t column = (first + row * step) & (SPAM_SKETCH_WIDTH - 1);
+        counters[row] = &sketches[current][row][column];
+        unsigned int count = atomic_load_explicit(counters[row], memory_order_relaxed);
+        unsigned int previous = atomic_load_explicit(&sketches[current ^ 1][row][column], memory_order_relaxed);
+        currentMinimum = count < currentMinimum ? count : currentMinimum;
+        estimate = count + previous < estimate ? count + previous : estimate;
+    }
+
+    if (currentMinimum < UINT8_MAX)
+    {
+        for (int row = 0; row < SPAM_SKETCH_DEPTH; row++)
+        {
+            if (atomic_load_explicit(counters[row], memory_order_relaxed) == currentMinimum)
+            {
+                atomic_store_explicit(counters[row], currentMinimum + 1, memory_order_relaxed);
+            }
+        }
+    }
+    if (estimate < (unsigned int)allowedRepeats)
+    {
+        return false;
+    }
+    atomic_fetch_add(&serverStats.spamSuppressed, 1);
+    return true;
+}
+
+/*
+    FUNCTION    :   spam_tick
+    DESCRIPTION :   Ends a window once it lasted -spamwindow<S>: the older sketch is emptied and
+                    becomes the current one. Handlers reading it while it is emptied see lower
+                    counts, which only lets a copy more through. Called by the main loop on every
+                    wakeup.
+    PARAMETERS  :   none
+    RETURNS     :   void
+*/
+void spam_tick(void)
+{
+    static uint64_t windowStartMs = 0;
+    struct timespec now;
+
+    if (allowedRepeats == 0)
+    {
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t nowMs = (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+    if (windowStartMs == 0)
+    {
+        windowStartMs = nowMs;
+        return;
+    }
+    if (nowMs - windowStartMs < windowMilliseconds)
+    {
+        return;
+    }
+
+    unsigned int older = (atomic_load(&currentSketch) + 1) & 1;
+    for (int row = 0; row < SPAM_SKETCH_DEPTH; row++)
+    {
+        for (int column = 0; column < SPAM_SKETCH_WIDTH; column++)
+        {
+            atomic_store_explicit(&sketches[older][row][column], 0, memory_order_relaxed);
+        }
+    }
+    atomic_fetch_add(&currentSketch, 1);
+    windowStartMs = nowMs;
+}
@@ -0,0 +1,165 @@
+/*
+* FILE              :   timer-wheel.c
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This file contains a hashed timer wheel. Each timer is an intrusive node in a
+                        preallocated array, linked into the bucket of its expiry tick, so arming and
+                        cancelling are O(1) and a timer costs twelve bytes whatever the connection count.
+*/
+
+#include "../inc/timer-wheel.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+    FUNCTION    :   unlink_timer
+    DESCRIPTION :   Removes an armed timer from its bucket list. Caller holds the wheel lock.
+    PARAMETERS  :   TimerWheel* wheel - The wheel
+                    int id - The timer to remove
+    RETURNS     :   void
+*/
+static void unlink_timer(TimerWheel* wheel, int id)
+{
+    TimerNode* node = &wheel->nodes[id];
+
+    if (node->prev == TIMER_UNLINKED)
+    {
+        return;
+    }
+    if (node->prev == TIMER_NONE)
+    {
+        wheel->buckets[node->expiryTick % TIMER_WHEEL_SLOTS] = node->next;
+    }
+    else
+    {
+        wheel->nodes[node->prev].next = node->next;
+    }
+    if (node->next != TIMER_NONE)
+    {
+        wheel->nodes[node->next].prev = node->prev;
+    }
+    node->prev = TIMER_UNLINKED;
+    node->next = TIMER_NONE;
+}
+
+/*
+    FUNCTION    :   timer_wheel_init
+    DESCRIPTION :   Allocates one timer node per id and empties every bucket.
+    PARAMETERS  :   TimerWheel* wheel - The wheel to initialize
+                    int capacity - Number of ids (registry slots)
+                    uint32_t startTick - The current tick
+    RETURNS     :   void
+*/
+void timer_wheel_init(TimerWheel* wheel, int capacity, uint32_t startTick)
+{
+    wheel->nodes = malloc(sizeof(TimerNode) * capacity);
+    if (wheel->nodes == NULL)
+    {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < capacity; i++)
+    {
+        wheel->nodes[i].next = TIMER_NONE;
+        wheel->nodes[i].prev = TIMER_UNLINKED;
+        wheel->nodes[i].expiryTick = 0;
+    }
+    for (int i = 0; i < TIMER_WHEEL_SLOTS; i++)
+    {
+        wheel->buckets[i] = TIMER_NONE;
+    }
+    wheel->capacity = capacity;
+    wheel->currentTick = startTick;
+    pthread_mutex_init(&wheel->lock, NULL);
+}
+
+/*
+    FUNCTION    :   timer_arm
+    DESCRIPTION :   Arms a timer, or moves it if it is already armed.
+    PARAMETERS  :   TimerWheel* wheel - The wheel
+                    int id - The timer
+                    uint32_t delayTicks - Ticks from now until it fires, at least one
+    RETURNS     :   void
+*/
+void timer_arm(TimerWheel* wheel, int id, uint32_t delayTicks)
+{
+    if (id < 0 || id >= wheel->capacity)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&wheel->lock);
+    unlink_timer(wheel, id);
+
+    TimerNode* node = &wheel->nodes[id];
+    node->expiryTick = wheel->currentTick + (delayTicks > 0 ? delayTicks : 1);
+    int32_t* head = &wheel->buckets[node->expiryTick % TIMER_WHEEL_SLOTS];
+    node->prev = TIMER_NONE;
+    node->next = *head;
+    if (*head != TIMER_NONE)
+    {
+        wheel->nodes[*head].prev = id;
+    }
+    *head = id;
+    pthread_mutex_unlock(&wheel->lock);
+}
+
+/*
+    FUNCTION    :   timer_cancel
+    DESCRIPTION :   Disarms a timer. Cancelling a timer that is not armed does nothing.
+    PARAMETERS  :   TimerWheel* wheel - The wheel
+                    int id - The timer
+    RETURNS     :   void
+*/
+void timer_cancel(TimerWheel* wheel, int id)
+{
+    if (id < 0 || id >= wheel->capacity)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&wheel->lock);
+    unlink_timer(wheel, id);
+    pthread_mutex_unlock(&wheel->lock);
+}
+
+/*
+    FUNCTION    :   timer_advance
+    DESCRIPTION :   Moves the wheel forward to nowTick and collects the timers that expired on the way.
+                    Timers in a visited bucket whose expiry lies in a later revolution stay linked.
+                    If the output array fills up the wheel stops early; call again to continue.
+    PARAMETERS  :   TimerWheel* wheel - The wheel
+                    uint32_t nowTick - The current tick
+                    int* expired - Receives the ids of expired timers, which are disarmed
+                    int maxExpired - Size of the expired array
+    RETURNS     :   int - Number of ids written to expired
+*/
+int timer_advance(TimerWheel* wheel, uint32_t nowTick, int* expired, int maxExpired)
+{
+    int count = 0;
+
+    pthread_mutex_lock(&wheel->lock);
+    while ((int32_t)(nowTick - wheel->currentTick) > 0 && count < maxExpired)
+    {
+        uint32_t tick = wheel->currentTick + 1;
+        int32_t id = wheel->buckets[tick % TIMER_WHEEL_SLOTS];
+        while (id != TIMER_NONE && count < maxExpired)
+        {
+            int32_t next = wheel->nodes[id].next;
+            if ((int32_t)(wheel->nodes[id].expiryTick - tick) <= 0)
+            {
+                unlink_timer(wheel, id);
+                expired[count++] = id;
+            }
+            id = next;
+        }
+        if (id != TIMER_NONE)
+        {
+            break; // output full part way through this bucket, revisit it next call
+        }
+        wheel->currentTick = tick;
+    }
+    pthread_mutex_unlock(&wheel->lock);
+    return count;
+}
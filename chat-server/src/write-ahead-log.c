@@ -0,0 +1,614 @@
+/*
+* FILE              :   write-ahead-log.c
+* PROJECT           :   SENG2030 - A04 - CanWeTalkSystem
+* PROGRAMMER        :   ​Md Saiful Islam, ​Minchul Hwang, ​Salman Nouman, ​Saje-Antonie Rose
+* FIRST VERSION     :   2026-10-19
+* DESCRIPTION       :   This file contains the write-ahead log of accepted messages. With -wal a handler
+                        appends every chat message it accepts to the group being filled before it queues
+                        the message. A writer thread commits the group once its first message waited
+                        -commitinterval, with one write and, at the sync level, one fdatasync for all the
+                        messages in it, and then tells the senders that asked for acks how many of their
+                        messages are durable. Delivery does not wait for the commit. Once every logged
+                        message has left the queue the next commit carries a checkpoint, and on startup
+                        the messages logged after the last checkpoint are queued again, so a crash loses
+                        no acknowledged message but may deliver some twice.
+*/
+
+#include "server-utility.h"
+#include "../inc/write-ahead-log.h"
+#include "../inc/client-snapshot.h"
+#include "../inc/server-stats.h"
+#include <sys/file.h>
+#include <netinet/tcp.h>
+
+// Records of the messages logged in one commit interval, and the acks they earn
+typedef struct WalGroup
+{
+    char* records;          // WAL_GROUP_BYTES of log records
+    size_t used;
+    int* acks;              // messages in the group of every slot that asked for acks
+    int* ackSockets;        // socket each count belongs to, a slot may be reused within a group
+    int* touched;           // slots with a count, touchedCount of them
+    int touchedCount;
+} WalGroup;
+
+// A message logged after the last checkpoint, found while reading the log on startup
+typedef struct RecoveredMessage
+{
+    uint64_t sequence;
+    struct RecoveredMessage* next;
+    char serialized[];
+} RecoveredMessage;
+
+static const char* logPath = NULL;
+static int logFile = -1;
+static off_t logBytes = 0;
+static bool syncCommits;
+static long commitIntervalMicroseconds;
+static atomic_bool* ackWanted;              // slots whose client sent >>acks<<
+
+static WalGroup groups[2];
+static WalGroup* filling = &groups[0];      // the group handlers append to, the other one is being committed
+static struct timespec groupOpened;         // when the first record of the filling group arrived
+static uint64_t nextSequence = 1;
+static uint64_t checkpointed = 0;           // newest sequence covered by a checkpoint in the log
+static atomic_long unfinished = 0;          // logged messages the broadcaster has not finished with yet
+static bool writerStopping = false;
+static pthread_mutex_t logMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t recordsArrived = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t groupTaken = PTHREAD_COND_INITIALIZER;
+static pthread_t writerThread;
+
+/*
+    FUNCTION    :   checkpoint_due
+    DESCRIPTION :   Tells whether every message logged so far left the queue since the last
+                    checkpoint, so that a new one can be written. Caller holds logMutex, which keeps
+                    handlers from logging meanwhile.
+    PARAMETERS  :   none
+    RETURNS     :   bool - true if a checkpoint would cover more messages than the last one
+*/
+static bool checkpoint_due(void)
+{
+    return nextSequence - 1 > checkpointed && atomic_load(&unfinished) == 0;
+}
+
+/*
+    FUNCTION    :   add_record
+    DESCRIPTION :   Appends a record to the filling group. Caller holds logMutex and made sure it fits.
+    PARAMETERS  :   uint64_t sequence - The sequence number of the record
+                    const char* serialized - The serialized message, NULL for a checkpoint
+                    uint32_t length - Its length without the terminator
+    RETURNS     :   void
+*/
+static void add_record(uint64_t sequence, const char* serialized, uint32_t length)
+{
+    WalRecord record = { WAL_RECORD_MAGIC, length, sequence };
+    memcpy(filling->records + filling->used, &record, sizeof(record));
+    if (length > 0)
+    {
+        memcpy(filling->records + filling->used + sizeof(record), serialized, length);
+    }
+    if (filling->used == 0)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &groupOpened);
+        pthread_cond_signal(&recordsArrived);
+    }
+    filling->used += sizeof(record) + length;
+}
+
+/*
+    FUNCTION    :   send_acks
+    DESCRIPTION :   Tells every client with messages in a committed group how many of them are
+                    durable now. Clients that left since are skipped.
+    PARAMETERS  :   WalGroup* group - The committed group, its counts are reset here
+    RETURNS     :   void
+*/
+static void send_acks(WalGroup* group)
+{
+    int reader;
+    const ClientSnapshot* snapshot = client_snapshot_enter(&reader);
+    pthread_mutex_lock(&clientWritesMutex);
+    for (int i = 0; i < group->touchedCount; i++)
+    {
+        int slot = group->touched[i];
+        if (client_snapshot_contains(snapshot, slot, group->ackSockets[slot]))
+        {
+            char ack[sizeof(DURABLE_ACK_PREFIX) + 16];
+            snprintf(ack, sizeof(ack), DURABLE_ACK_PREFIX "%d", group->acks[slot]);
+            write_server_control(group->ackSockets[slot], ack);
+        }
+        group->acks[slot] = 0;
+    }
+    pthread_mutex_unlock(&clientWritesMutex);
+    client_snapshot_exit(reader);
+    group->touchedCount = 0;
+}
+
+/*
+    FUNCTION    :   commit_group
+    DESCRIPTION :   Writes a group to the end of the log with one write and, at the sync level,
+                    makes it durable with one fdatasync. A failed write is cut off again, so that
+                    what follows it is still read on startup; its messages are not acknowledged.
+    PARAMETERS  :   const WalGroup* group - The group to write
+    RETURNS     :   bool - true if the group is durable
+*/
+static bool commit_group(const WalGroup* group)
+{
+    size_t written = 0;
+    while (written < group->used)
+    {
+        ssize_t result = write(logFile, group->records + written, group->used - written);
+        if (result < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (result <= 0)
+        {
+            perror("write-ahead log");
+            if (ftruncate(logFile, logBytes) != 0)
+            {
+                perror("write-ahead log");
+            }
+            return false;
+        }
+        written += result;
+    }
+    logBytes += written;
+    if (syncCommits && fdatasync(logFile) != 0)
+    {
+        perror("write-ahead log");
+        return false;
+    }
+    atomic_fetch_add(&serverStats.walCommits, 1);
+    return true;
+}
+
+/*
+    FUNCTION    :   wal_writer
+    DESCRIPTION :   Writer thread. Waits for the first record of a group, lets the group fill for the
+                    commit interval, then swaps it for the empty one so that handlers keep logging
+                    while it is committed. A checkpoint goes into the group whenever the queue drained,
+                    and once a checkpoint covers the whole of a large log the log is emptied. When asked
+                    to stop it commits what is still waiting first.
+    PARAMETERS  :   void* arg - Unused
+    RETURNS     :   void* - NULL
+*/
+static void* wal_writer(void* arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&logMutex);
+    while (true)
+    {
+        while (filling->used == 0 && !writerStopping && !checkpoint_due())
+        {
+            // Woken by the first record; without records it still looks for a drained queue now and then
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += WAL_IDLE_MILLISECONDS * 1000000L;
+            deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+            deadline.tv_nsec %= 1000000000L;
+            pthread_cond_timedwait(&recordsArrived, &logMutex, &deadline);
+        }
+        if (filling->used == 0 && !checkpoint_due())
+        {
+            break; // stopping with nothing left
+        }
+
+        if (filling->used > 0 && commitIntervalMicroseconds > 0 && !writerStopping)
+        {
+            struct timespec deadline = groupOpened;
+            deadline.tv_nsec += commitIntervalMicroseconds * 1000L;
+            deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+            deadline.tv_nsec %= 1000000000L;
+            pthread_mutex_unlock(&logMutex);
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR)
+            {
+            }
+            pthread_mutex_lock(&logMutex);
+        }
+
+        bool coversAll = checkpoint_due();
+        if (coversAll)
+        {
+            // Room for it was kept free by wal_append
+            checkpointed = nextSequence - 1;
+            add_record(checkpointed, NULL, 0);
+        }
+        WalGroup* group = filling;
+        filling = filling == &groups[0] ? &groups[1] : &groups[0];
+        pthread_cond_broadcast(&groupTaken);
+        pthread_mutex_unlock(&logMutex);
+
+        if (commit_group(group))
+        {
+            send_acks(group);
+        }
+        else
+        {
+            group->touchedCount = 0;
+            memset(group->acks, 0, maxClients * sizeof(*group->acks));
+        }
+        group->used = 0;
+
+        // Nothing in the log is still needed, the records of the filling group come after the cut
+        if (coversAll && logBytes > WAL_COMPACT_BYTES)
+        {
+            if (ftruncate(logFile, 0) == 0)
+            {
+                logBytes = 0;
+                fdatasync(logFile);
+            }
+            else
+            {
+                perror("write-ahead log");
+            }
+        }
+        pthread_mutex_lock(&logMutex);
+    }
+    pthread_mutex_unlock(&logMutex);
+    return NULL;
+}
+
+/*
+    FUNCTION    :   read_log
+    DESCRIPTION :   Reads the log from the start and collects the messages logged after its last
+                    checkpoint, oldest first. A torn record at the end, left by a crash, is cut off.
+    PARAMETERS  :   RecoveredMessage** recovered - Receives the list of those messages
+    RETURNS     :   int - How many there are
+*/
+static int read_log(RecoveredMessage** recovered)
+{
+    static char buffer[1 << 20];
+    off_t end = lseek(logFile, 0, SEEK_END);
+    off_t offset = 0;
+    bool torn = false;
+    RecoveredMessage* front = NULL;
+    RecoveredMessage** rear = &front;
+    int count = 0;
+
+    while (offset < end && !torn)
+    {
+        ssize_t got = pread(logFile, buffer, sizeof(buffer), offset);
+        if (got <= 0)
+        {
+            break;
+        }
+        size_t used = 0;
+        while (used + sizeof(WalRecord) <= (size_t)got)
+        {
+            WalRecord record;
+            memcpy(&record, buffer + used, sizeof(record));
+            if (record.magic != WAL_RECORD_MAGIC || record.length >= MAX_SERIALIZED_LENGTH)
+            {
+                torn = true;
+                break;
+            }
+            if (used + sizeof(record) + record.length > (size_t)got)
+            {
+                break; // continues in the next read
+            }
+            if (memchr(buffer + used + sizeof(record), '\0', record.length) != NULL)
+            {
+                torn = true; // zeros where the end of an unsynced write never reached the disk
+                break;
+            }
+            if (record.length == 0)
+            {
+                // Everything up to the checkpoint was delivered already
+                while (front != NULL && front->sequence <= record.sequence)
+                {
+                    RecoveredMessage* delivered = front;
+                    front = front->next;
+                    free(delivered);
+                    count--;
+                }
+                rear = &front;
+                while (*rear != NULL)
+                {
+                    rear = &(*rear)->next;
+                }
+                checkpointed = record.sequence;
+            }
+            else
+            {
+                RecoveredMessage* message = malloc(sizeof(*message) + record.length + 1);
+                if (message == NULL)
+                {
+                    perror("malloc failed");
+                    exit(EXIT_FAILURE);
+                }
+                message->sequence = record.sequence;
+                message->next = NULL;
+                memcpy(message->serialized, buffer + used + sizeof(record), record.length);
+                message->serialized[record.length] = '\0';
+                *rear = message;
+                rear = &message->next;
+                count++;
+            }
+            if (record.sequence >= nextSequence)
+            {
+                nextSequence = record.sequence + 1;
+            }
+            used += sizeof(record) + record.length;
+        }
+        offset += used;
+        if (used == 0)
+        {
+            torn = true; // a record longer than what is left of the file
+        }
+    }
+    if (offset < end)
+    {
+        fprintf(stderr, "Write-ahead log: cut off a torn record at byte %lld\n", (long long)offset);
+        if (ftruncate(logFile, offset) != 0)
+        {
+            perror("write-ahead log");
+        }
+    }
+    logBytes = offset;
+    *recovered = front;
+    return count;
+}
+
+/*
+    FUNCTION    :   wal_init
+    DESCRIPTION :   Takes the -wal settings and allocates the groups. The log itself is only opened by
+                    wal_start, once the messages of a predecessor were taken over. Without -wal nothing
+                    is logged.
+    PARAMETERS  :   const ServerConfig* config - The parsed command line
+                    int slots - Size of the client registry
+    RETURNS     :   void
+*/
+void wal_init(const ServerConfig* config, int slots)
+{
+    if (config->walPath == NULL)
+    {
+        return;
+    }
+    logPath = config->walPath;
+    syncCommits = config->walSync;
+    commitIntervalMicroseconds = config->commitIntervalMicroseconds;
+    ackWanted = calloc(slots, sizeof(*ackWanted));
+    for (int i = 0; i < 2; i++)
+    {
+        groups[i].records = malloc(WAL_GROUP_BYTES);
+        groups[i].acks = calloc(slots, sizeof(*groups[i].acks));
+        groups[i].ackSockets = calloc(slots, sizeof(*groups[i].ackSockets));
+        groups[i].touched = calloc(slots, sizeof(*groups[i].touched));
+        if (groups[i].records == NULL || groups[i].acks == NULL || groups[i].ackSockets == NULL || groups[i].touched == NULL)
+        {
+            perror("malloc failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (ackWanted == NULL)
+    {
+        perror("calloc failed");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*
+    FUNCTION    :   wal_start
+    DESCRIPTION :   Opens and locks the log, queues the messages logged after its last checkpoint and
+                    starts the writer. After a takeover the predecessor handed those messages over
+                    already, and its lock is waited for, which it holds until its last commit is done.
+    PARAMETERS  :   bool takenOver - This process took over from a running server
+    RETURNS     :   bool - false if the log cannot be used
+*/
+bool wal_start(bool takenOver)
+{
+    if (!wal_enabled())
+    {
+        return true;
+    }
+    logFile = open(logPath, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    if (logFile < 0)
+    {
+        perror("write-ahead log");
+        return false;
+    }
+    if (flock(logFile, takenOver ? LOCK_EX : LOCK_EX | LOCK_NB) != 0)
+    {
+        fprintf(stderr, "Write-ahead log %s is in use by another server\n", logPath);
+        return false;
+    }
+
+    RecoveredMessage* recovered;
+    int count = read_log(&recovered);
+    while (recovered != NULL)
+    {
+        if (!takenOver)
+        {
+            Message message;
+            deserializeMessage(&message, recovered->serialized);
+            message.senderSock = -1; // its sender is unknown to this process
+            atomic_fetch_add(&unfinished, 1);
+            enqueue(&messageQueue, &message);
+        }
+        RecoveredMessage* next = recovered->next;
+        free(recovered);
+        recovered = next;
+    }
+    if (!takenOver && count > 0)
+    {
+        printf("Recovered %d message(s) from the write-ahead log\n", count);
+    }
+
+    if (pthread_create(&writerThread, NULL, wal_writer, NULL) != 0)
+    {
+        perror("pthread_create");
+        exit(EXIT_FAILURE);
+    }
+    return true;
+}
+
+/*
+    FUNCTION    :   wal_enabled
+    DESCRIPTION :   Tells whether accepted messages are logged.
+    PARAMETERS  :   none
+    RETURNS     :   bool - true if -wal was given
+*/
+bool wal_enabled(void)
+{
+    return logPath != NULL;
+}
+
+/*
+    FUNCTION    :   wal_append
+    DESCRIPTION :   Logs an accepted message before its handler queues it. Only copies it into the
+                    filling group; when the group is full the handler waits for the next one, which
+                    slows the sender down to what the disk can take.
+    PARAMETERS  :   int sock - The sender's socket
+                    int slot - The sender's registry slot
+                    const Message* message - The message
+    RETURNS     :   void
+*/
+void wal_append(int sock, int slot, const Message* message)
+{
+    if (!wal_enabled())
+    {
+        return;
+    }
+    char serialized[MAX_SERIALIZED_LENGTH];
+    serializeMessage(message, messageBody(message), serialized, sizeof(serialized));
+    uint32_t length = strlen(serialized);
+
+    pthread_mutex_lock(&logMutex);
+    // A checkpoint record must still fit behind it
+    while (filling->used + length + 2 * sizeof(WalRecord) > WAL_GROUP_BYTES)
+    {
+        pthread_cond_wait(&groupTaken, &logMutex);
+    }
+    add_record(nextSequence++, serialized, length);
+    atomic_fetch_add(&unfinished, 1);
+    if (atomic_load_explicit(&ackWanted[slot], memory_order_relaxed))
+    {
+        if (filling->acks[slot] == 0)
+        {
+            filling->touched[filling->touchedCount++] = slot;
+        }
+        else if (filling->ackSockets[slot] != sock)
+        {
+            filling->acks[slot] = 0; // the slot's previous client left, its count is of no use
+        }
+        filling->ackSockets[slot] = sock;
+        filling->acks[slot]++;
+    }
+    pthread_mutex_unlock(&logMutex);
+    atomic_fetch_add(&serverStats.walLogged, 1);
+}
+
+/*
+    FUNCTION    :   wal_adopt
+    DESCRIPTION :   Counts a message a predecessor handed over. It is in the log already, as one of
+                    the messages after its last checkpoint.
+    PARAMETERS  :   none
+    RETURNS     :   void
+*/
+void wal_adopt(void)
+{
+    atomic_fetch_add(&unfinished, 1);
+}
+
+/*
+    FUNCTION    :   wal_done
+    DESCRIPTION :   Counts messages the broadcaster finished with, delivered, filtered or shed.
+                    Called after every batch.
+    PARAMETERS  :   int count - How many chat messages the batch held
+    RETURNS     :   void
+*/
+void wal_done(int count)
+{
+    if (wal_enabled())
+    {
+        atomic_fetch_sub(&unfinished, count);
+    }
+}
+
+/*
+    FUNCTION    :   wal_subscribe
+    DESCRIPTION :   Answers >>acks<<: from now on the client is told when its messages are durable,
+                    or it learns that this server keeps no log. Nagle is turned off for the client, since
+                    an ack held back behind the previous one stalls a sender waiting for it; on a unix
+                    socket that fails harmlessly.
+    PARAMETERS  :   int sock - The client socket
+                    int slot - Its registry slot
+    RETURNS     :   void
+*/
+void wal_subscribe(int sock, int slot)
+{
+    if (!wal_enabled())
+    {
+        send_server_control(sock, DURABLE_ACKS_OFF);
+        return;
+    }
+    char answer[sizeof(DURABLE_ACKS_ON_PREFIX) + 32];
+    snprintf(answer, sizeof(answer), DURABLE_ACKS_ON_PREFIX "%s %ld", syncCommits ? "sync" : "write", commitIntervalMicroseconds);
+    int enable = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    atomic_store(&ackWanted[slot], true);
+    send_server_control(sock, answer);
+}
+
+/*
+    FUNCTION    :   wal_acking
+    DESCRIPTION :   Tells whether a slot's client asked for acks, for the handoff.
+    PARAMETERS  :   int slot - The registry slot
+    RETURNS     :   bool - true if it did
+*/
+bool wal_acking(int slot)
+{
+    return wal_enabled() && atomic_load(&ackWanted[slot]);
+}
+
+/*
+    FUNCTION    :   wal_resume_acking
+    DESCRIPTION :   Keeps acknowledging the messages of a client taken over from a predecessor.
+    PARAMETERS  :   int slot - The registry slot
+    RETURNS     :   void
+*/
+void wal_resume_acking(int slot)
+{
+    if (wal_enabled())
+    {
+        atomic_store(&ackWanted[slot], true);
+    }
+}
+
+/*
+    FUNCTION    :   wal_leave
+    DESCRIPTION :   Forgets that a slot's client asked for acks when it disconnects.
+    PARAMETERS  :   int slot - The registry slot
+    RETURNS     :   void
+*/
+void wal_leave(int slot)
+{
+    if (wal_enabled())
+    {
+        atomic_store(&ackWanted[slot], false);
+    }
+}
+
+/*
+    FUNCTION    :   wal_stop
+    DESCRIPTION :   Waits for the writer to commit what the handlers left it and return, then closes
+                    the log, which lets a successor that is waiting for it go on. Called once the
+                    broadcaster stopped; messages still queued stay in the log for the next start.
+    PARAMETERS  :   none
+    RETURNS     :   void
+*/
+void wal_stop(void)
+{
+    if (!wal_enabled() || logFile < 0)
+    {
+        return;
+    }
+    pthread_mutex_lock(&logMutex);
+    writerStopping = true;
+    pthread_cond_signal(&recordsArrived);
+    pthread_mutex_unlock(&logMutex);
+    pthread_join(writerThread, NULL);
+    close(logFile);
+    logFile = -1;
+}